@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+#include <tins/tcp.h>
+#include <tins/ip.h>
+#include <tins/tcp_ip/ack_tracker.h>
+
+using std::cout;
+using std::endl;
+using std::setw;
+using std::vector;
+using std::min;
+using std::numeric_limits;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+using namespace Tins;
+using namespace Tins::TCPIP;
+
+// Deterministic pseudo random number generator, so every run uses the same trace
+class lcg {
+public:
+    lcg(uint32_t seed) : state_(seed) { }
+
+    uint32_t next() {
+        state_ = state_ * 1664525U + 1013904223U;
+        return state_ >> 8;
+    }
+private:
+    uint32_t state_;
+};
+
+// Generates the ACKs a receiver would send for a window based transfer in
+// which some segments are lost. Every ACK sent while there are holes carries
+// up to 3 SACK blocks, the most recently received one first. Holes are then
+// filled by retransmissions, which make the cumulative ACK jump forward.
+vector<IP> make_sack_trace(uint32_t initial_seq, size_t windows, size_t window_size,
+                           uint32_t loss_percent, uint32_t seed) {
+    static const uint32_t mss = 1460;
+    lcg rng(seed);
+    vector<IP> output;
+    uint32_t window_start = initial_seq;
+    for (size_t w = 0; w < windows; ++w) {
+        vector<bool> received(window_size, false);
+        vector<size_t> arrival_order;
+        for (size_t i = 0; i < window_size; ++i) {
+            if (rng.next() % 100 >= loss_percent) {
+                arrival_order.push_back(i);
+            }
+        }
+        size_t first_hole = 0;
+        for (size_t n = 0; n < arrival_order.size(); ++n) {
+            const size_t index = arrival_order[n];
+            received[index] = true;
+            while (first_hole < window_size && received[first_hole]) {
+                ++first_hole;
+            }
+            TCP tcp(80, 12345);
+            tcp.flags(TCP::ACK);
+            tcp.ack_seq(window_start + first_hole * mss);
+            // Build the SACK blocks: the block containing the segment that 
+            // just arrived goes first, then the highest other ones
+            TCP::sack_type sack;
+            size_t i = window_size;
+            vector<std::pair<size_t, size_t> > blocks;
+            while (i > first_hole) {
+                --i;
+                if (!received[i]) {
+                    continue;
+                }
+                size_t block_end = i + 1;
+                while (i > first_hole && received[i - 1]) {
+                    --i;
+                }
+                blocks.push_back(std::make_pair(i, block_end));
+            }
+            for (size_t b = 0; b < blocks.size(); ++b) {
+                if (blocks[b].first <= index && index < blocks[b].second) {
+                    std::swap(blocks[0], blocks[b]);
+                    break;
+                }
+            }
+            for (size_t b = 0; b < min<size_t>(blocks.size(), 3); ++b) {
+                sack.push_back(window_start + blocks[b].first * mss);
+                sack.push_back(window_start + blocks[b].second * mss);
+            }
+            if (!sack.empty()) {
+                tcp.sack(sack);
+            }
+            output.push_back(IP("1.2.3.4", "4.3.2.1") / tcp);
+        }
+        // Retransmissions: each one fills the first hole
+        while (first_hole < window_size) {
+            received[first_hole] = true;
+            while (first_hole < window_size && received[first_hole]) {
+                ++first_hole;
+            }
+            TCP tcp(80, 12345);
+            tcp.flags(TCP::ACK);
+            tcp.ack_seq(window_start + first_hole * mss);
+            output.push_back(IP("1.2.3.4", "4.3.2.1") / tcp);
+        }
+        window_start += window_size * mss;
+    }
+    return output;
+}
+
+void run_benchmark(const char* name, const vector<IP>& trace, uint32_t initial_seq,
+                   size_t iterations) {
+    size_t max_intervals = 0;
+    uint32_t dropped_intervals = 0;
+    const steady_clock::time_point start = steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        AckTracker tracker(initial_seq, true);
+        for (size_t p = 0; p < trace.size(); ++p) {
+            tracker.process_packet(trace[p]);
+            max_intervals = std::max(max_intervals, 
+                                     tracker.acked_intervals().iterative_size());
+        }
+        dropped_intervals += tracker.acked_intervals().dropped_intervals();
+    }
+    const steady_clock::duration elapsed = steady_clock::now() - start;
+    const double total_packets = static_cast<double>(trace.size()) * iterations;
+    const double ns_per_packet = duration_cast<nanoseconds>(elapsed).count() / total_packets;
+    cout << setw(28) << std::left << name
+         << setw(10) << std::right << std::fixed << std::setprecision(1) 
+         << ns_per_packet << " ns/packet"
+         << setw(10) << std::setprecision(2) << 1000.0 / ns_per_packet << " Mpps"
+         << "  (max intervals: " << max_intervals 
+         << ", dropped: " << dropped_intervals << ")" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    size_t iterations = 20;
+    if (argc > 1) {
+        iterations = std::stoul(argv[1]);
+    }
+    const uint32_t wrapping_seq = numeric_limits<uint32_t>::max() - 200 * 1460;
+    cout << "Processing " << iterations << " iterations per trace" << endl;
+    run_benchmark("no loss", make_sack_trace(1000, 2000, 64, 0, 1), 1000, iterations);
+    run_benchmark("1% loss, 64 segments", make_sack_trace(1000, 2000, 64, 1, 2), 1000,
+                  iterations);
+    run_benchmark("5% loss, 64 segments", make_sack_trace(1000, 2000, 64, 5, 3), 1000,
+                  iterations);
+    run_benchmark("20% loss, 256 segments", make_sack_trace(1000, 500, 256, 20, 4), 1000,
+                  iterations);
+    run_benchmark("5% loss, wrapping seq", 
+                  make_sack_trace(wrapping_seq, 2000, 64, 5, 5), wrapping_seq,
+                  iterations);
+}
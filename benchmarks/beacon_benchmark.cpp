@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <tins/dot11/dot11_beacon.h>
+#include <tins/rsn_information.h>
+
+using std::cout;
+using std::endl;
+using std::setw;
+using std::vector;
+using std::string;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+using namespace Tins;
+
+// A beacon carrying the tags usually seen on a modern access point
+PDU::serialization_type make_beacon() {
+    Dot11Beacon beacon("ff:ff:ff:ff:ff:ff", "00:01:02:03:04:05");
+    beacon.addr3(beacon.addr2());
+    beacon.interval(100);
+    beacon.ssid("libtins benchmark network");
+    Dot11Beacon::rates_type rates;
+    rates.push_back(1.0f);
+    rates.push_back(2.0f);
+    rates.push_back(5.5f);
+    rates.push_back(11.0f);
+    beacon.supported_rates(rates);
+    beacon.ds_parameter_set(6);
+    beacon.tim(Dot11Beacon::tim_type(0, 1, 0, byte_array(1)));
+    beacon.erp_information(0);
+    beacon.extended_supported_rates(rates);
+    beacon.rsn_information(RSNInformation::wpa2_psk());
+    beacon.qos_capability(0);
+    // HT, extended capabilities and a few vendor specific tags
+    for (uint8_t i = 0; i < 12; ++i) {
+        const uint8_t type = (i < 4) ? 45 + i : 221;
+        const byte_array data(10 + i * 3, i);
+        beacon.add_option(Dot11::option(type, data.begin(), data.end()));
+    }
+    return beacon.serialize();
+}
+
+// Parses the beacon once per iteration. If full_parse is true, every tag is
+// turned into an option, otherwise only the SSID and channel are read.
+void run_benchmark(const PDU::serialization_type& buffer, size_t iterations,
+                   bool full_parse, bool lazy) {
+    Dot11::lazy_tagged_parameters(lazy);
+    size_t checksum = 0;
+    const steady_clock::time_point start = steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        Dot11Beacon beacon(&buffer[0], static_cast<uint32_t>(buffer.size()));
+        if (full_parse) {
+            checksum += beacon.options().size();
+        }
+        else {
+            checksum += beacon.ssid().size() + beacon.ds_parameter_set();
+        }
+    }
+    const steady_clock::duration elapsed = steady_clock::now() - start;
+    const double seconds = duration_cast<nanoseconds>(elapsed).count() / 1e9;
+    cout << (lazy ? "lazy,  " : "eager, ")
+         << (full_parse ? "all tags      " : "ssid, channel ") << ": "
+         << std::fixed << std::setprecision(2)
+         << setw(8) << iterations / seconds / 1e3 << " kpps"
+         << " (checksum " << checksum << ")" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    size_t iterations = 1000000;
+    if (argc > 1) {
+        iterations = std::stoul(argv[1]);
+    }
+    const PDU::serialization_type buffer = make_beacon();
+    cout << buffer.size() << " byte beacon" << endl;
+    run_benchmark(buffer, iterations, true, false);
+    run_benchmark(buffer, iterations, false, false);
+    run_benchmark(buffer, iterations, true, true);
+    run_benchmark(buffer, iterations, false, true);
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <openssl/evp.h>
+#include <tins/config.h>
+#include <tins/crypto.h>
+#include <tins/dot11/dot11_data.h>
+#include <tins/rawpdu.h>
+#include <tins/snap.h>
+
+using std::cout;
+using std::endl;
+using std::setw;
+using std::vector;
+using std::string;
+using std::unique_ptr;
+using std::runtime_error;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+using namespace Tins;
+using Tins::Crypto::WPA2::SessionKeys;
+
+// A frame as seen by SessionKeys::decrypt_unicast: the parsed 802.11 header
+// and the encrypted payload, including the CCMP header and the MIC
+struct Frame {
+    unique_ptr<Dot11Data> dot11;
+    RawPDU::payload_type payload;
+};
+
+// Encrypts a payload the way a station would, using CCMP with the temporal
+// key in the given PTK
+Frame make_frame(const SessionKeys::ptk_type& ptk, uint64_t packet_number,
+                 size_t payload_size) {
+    static const size_t mic_size = 8;
+    Frame frame;
+    frame.dot11.reset(new Dot11Data("00:01:02:03:04:05", "06:07:08:09:0a:0b"));
+    Dot11Data& dot11 = *frame.dot11;
+    dot11.addr3("0c:0d:0e:0f:10:11");
+    dot11.to_ds(1);
+    dot11.wep(1);
+
+    uint8_t aad[22] = { 0 };
+    aad[0] = dot11.protocol() | (dot11.type() << 2) | ((dot11.subtype() << 4) & 0x80);
+    aad[1] = 0x40 | dot11.to_ds() | (dot11.from_ds() << 1) |
+             (dot11.more_frag() << 2) | (dot11.order() << 7);
+    dot11.addr1().copy(aad + 2);
+    dot11.addr2().copy(aad + 8);
+    dot11.addr3().copy(aad + 14);
+    aad[20] = dot11.frag_num();
+
+    uint8_t nonce[13] = { 0 };
+    dot11.addr2().copy(nonce + 1);
+    for (size_t i = 0; i < 6; ++i) {
+        nonce[12 - i] = (packet_number >> (i * 8)) & 0xff;
+    }
+
+    // CCMP header: PN0, PN1, reserved, key id + ExtIV, PN2 to PN5
+    RawPDU::payload_type& payload = frame.payload;
+    payload.resize(8 + payload_size + mic_size);
+    payload[0] = nonce[12];
+    payload[1] = nonce[11];
+    payload[3] = 0x20;
+    payload[4] = nonce[10];
+    payload[5] = nonce[9];
+    payload[6] = nonce[8];
+    payload[7] = nonce[7];
+    vector<uint8_t> plaintext(payload_size);
+    for (size_t i = 0; i < payload_size; ++i) {
+        plaintext[i] = static_cast<uint8_t>(i * 7 + packet_number);
+    }
+
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    int output_size;
+    if (!EVP_EncryptInit_ex(ctx, EVP_aes_128_ccm(), 0, 0, 0) ||
+        !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_IVLEN, sizeof(nonce), 0) ||
+        !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_TAG, mic_size, 0) ||
+        !EVP_EncryptInit_ex(ctx, 0, 0, &ptk[32], nonce) ||
+        !EVP_EncryptUpdate(ctx, 0, &output_size, 0, payload_size) ||
+        !EVP_EncryptUpdate(ctx, 0, &output_size, aad, sizeof(aad)) ||
+        !EVP_EncryptUpdate(ctx, &payload[8], &output_size, &plaintext[0], payload_size) ||
+        !EVP_EncryptFinal_ex(ctx, &payload[8], &output_size) ||
+        !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_GET_TAG, mic_size,
+                             &payload[8 + payload_size])) {
+        EVP_CIPHER_CTX_free(ctx);
+        throw runtime_error("Failed to encrypt frame");
+    }
+    EVP_CIPHER_CTX_free(ctx);
+    return frame;
+}
+
+// Decrypts every frame once per iteration. If keys_per_frame is true, a new
+// SessionKeys object is constructed for every frame, which includes
+// expanding the AES key.
+void run_benchmark(const SessionKeys::ptk_type& ptk, size_t payload_size,
+                   size_t iterations, bool keys_per_frame) {
+    static const size_t frame_count = 256;
+    vector<Frame> frames;
+    for (size_t i = 0; i < frame_count; ++i) {
+        frames.push_back(make_frame(ptk, i + 1, payload_size));
+    }
+
+    SessionKeys keys(ptk, true);
+    RawPDU raw(0, 0);
+    size_t decrypted = 0;
+    steady_clock::duration elapsed(0);
+    for (size_t n = 0; n < iterations; ++n) {
+        for (size_t i = 0; i < frames.size(); ++i) {
+            // Decryption happens in place, so restore the encrypted payload
+            raw.payload() = frames[i].payload;
+            const steady_clock::time_point start = steady_clock::now();
+            SNAP* snap = 0;
+            if (keys_per_frame) {
+                SessionKeys frame_keys(ptk, true);
+                snap = frame_keys.decrypt_unicast(*frames[i].dot11, raw);
+            }
+            else {
+                snap = keys.decrypt_unicast(*frames[i].dot11, raw);
+            }
+            elapsed += steady_clock::now() - start;
+            if (snap) {
+                ++decrypted;
+                delete snap;
+            }
+        }
+    }
+
+    const size_t total_frames = iterations * frames.size();
+    const double seconds = duration_cast<nanoseconds>(elapsed).count() / 1e9;
+    cout << setw(6) << payload_size << " bytes, " 
+         << (keys_per_frame ? "keys per frame" : "cached keys   ") << ": "
+         << std::fixed << std::setprecision(2)
+         << setw(8) << total_frames / seconds / 1e3 << " kpps, "
+         << setw(8) << total_frames * payload_size / seconds / (1024 * 1024) << " MB/s";
+    if (decrypted != total_frames) {
+        cout << " (" << total_frames - decrypted << " frames failed to decrypt)";
+    }
+    cout << endl;
+}
+
+int main(int argc, char* argv[]) {
+    size_t iterations = 200;
+    if (argc > 1) {
+        iterations = std::stoul(argv[1]);
+    }
+    SessionKeys::ptk_type ptk(SessionKeys::PTK_SIZE);
+    for (size_t i = 0; i < ptk.size(); ++i) {
+        ptk[i] = static_cast<uint8_t>(i * 13 + 5);
+    }
+    const size_t payload_sizes[] = { 64, 512, 1500 };
+    for (size_t i = 0; i < sizeof(payload_sizes) / sizeof(payload_sizes[0]); ++i) {
+        run_benchmark(ptk, payload_sizes[i], iterations, true);
+        run_benchmark(ptk, payload_sizes[i], iterations, false);
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <tins/radiotap.h>
+#include <tins/dot11/dot11_data.h>
+#include <tins/rawpdu.h>
+#include <tins/utils/radiotap_decoder.h>
+
+using std::cout;
+using std::endl;
+using std::setw;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+using namespace Tins;
+using Tins::Utils::RadioTapDecoder;
+
+// The fields needed for airtime accounting
+const uint32_t FIELDS = RadioTap::TSFT | RadioTap::RATE | RadioTap::CHANNEL |
+                        RadioTap::DBM_SIGNAL;
+
+void report(const char* name, size_t iterations, steady_clock::duration elapsed,
+            uint64_t checksum) {
+    const double seconds = duration_cast<nanoseconds>(elapsed).count() / 1e9;
+    cout << name << ": " << std::fixed << std::setprecision(2)
+         << setw(10) << iterations / seconds / 1e3 << " kpps"
+         << " (checksum " << checksum << ")" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    size_t iterations = 1000000;
+    if (argc > 1) {
+        iterations = std::stoul(argv[1]);
+    }
+    RadioTap radio;
+    radio.rate(0x6c);
+    radio.dbm_noise(-95);
+    radio.inner_pdu(Dot11Data("00:01:02:03:04:05", "06:07:08:09:0a:0b") /
+                    RawPDU(std::string(200, 'a')));
+    const PDU::serialization_type buffer = radio.serialize();
+    const uint32_t total_sz = static_cast<uint32_t>(buffer.size());
+
+    uint64_t checksum = 0;
+    steady_clock::time_point start = steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        RadioTap parsed(&buffer[0], total_sz);
+        checksum += parsed.tsft() + parsed.rate() + parsed.channel_freq() +
+                    parsed.dbm_signal();
+    }
+    report("RadioTap getters", iterations, steady_clock::now() - start, checksum);
+
+    checksum = 0;
+    RadioTapDecoder decoder(FIELDS);
+    start = steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        decoder.decode(&buffer[0], total_sz);
+        checksum += decoder.tsft() + decoder.rate() + decoder.channel_freq() +
+                    decoder.dbm_signal();
+    }
+    report("RadioTapDecoder ", iterations, steady_clock::now() - start, checksum);
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <algorithm>
+#include <unordered_set>
+#ifndef _WIN32
+    #include <sys/resource.h>
+#endif // _WIN32
+#include <tins/config.h>
+#include <tins/ethernetII.h>
+#include <tins/packet.h>
+#include <tins/tcp_ip/stream_follower.h>
+#include <tins/tcp_ip/stream.h>
+#include "traffic_generator.h"
+
+using std::cout;
+using std::endl;
+using std::setw;
+using std::vector;
+using std::string;
+using std::max;
+using std::sort;
+using std::unordered_set;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+
+using namespace Tins;
+using namespace Tins::TCPIP;
+
+// All the frames generated for a profile, stored back to back
+struct Trace {
+    vector<uint8_t> data;
+    vector<size_t> offsets;
+    vector<microseconds> timestamps;
+    uint64_t payload_bytes;
+};
+
+Trace generate_trace(const TrafficProfile& profile) {
+    Trace trace;
+    TrafficGenerator generator(profile);
+    vector<uint8_t> frame;
+    TrafficGenerator::timestamp_type timestamp;
+    trace.offsets.push_back(0);
+    while (generator.next_frame(frame, timestamp)) {
+        trace.data.insert(trace.data.end(), frame.begin(), frame.end());
+        trace.offsets.push_back(trace.data.size());
+        trace.timestamps.push_back(timestamp);
+    }
+    trace.payload_bytes = generator.payload_bytes();
+    return trace;
+}
+
+long peak_rss_kb() {
+    #ifndef _WIN32
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    #else
+        return 0;
+    #endif // _WIN32
+}
+
+uint64_t percentile(const vector<uint64_t>& sorted_values, double value) {
+    if (sorted_values.empty()) {
+        return 0;
+    }
+    const size_t index = static_cast<size_t>((sorted_values.size() - 1) * value);
+    return sorted_values[index];
+}
+
+void run_benchmark(const char* name, const TrafficProfile& profile, 
+                   bool ack_tracking) {
+    // How often the amount of buffered data is sampled, in packets
+    static const size_t SAMPLE_INTERVAL = 1024;
+
+    const Trace trace = generate_trace(profile);
+    const size_t packet_count = trace.timestamps.size();
+
+    StreamFollower follower;
+    unordered_set<Stream*> live_streams;
+    uint64_t delivered_bytes = 0;
+    size_t max_live_streams = 0;
+    uint64_t max_buffered_bytes = 0;
+    vector<uint64_t> callback_latencies;
+    callback_latencies.reserve(packet_count);
+    steady_clock::time_point packet_start;
+
+    auto on_data = [&](const Stream::payload_type& payload) {
+        delivered_bytes += payload.size();
+        const steady_clock::duration latency = steady_clock::now() - packet_start;
+        callback_latencies.push_back(duration_cast<nanoseconds>(latency).count());
+    };
+    follower.new_stream_callback([&](Stream& stream) {
+        live_streams.insert(&stream);
+        max_live_streams = max(max_live_streams, live_streams.size());
+        stream.client_data_callback([&](Stream& stream) {
+            on_data(stream.client_payload());
+        });
+        stream.server_data_callback([&](Stream& stream) {
+            on_data(stream.server_payload());
+        });
+        stream.stream_closed_callback([&](Stream& stream) {
+            live_streams.erase(&stream);
+        });
+        #ifdef TINS_HAVE_ACK_TRACKER
+            if (ack_tracking) {
+                stream.enable_ack_tracking();
+            }
+        #endif // TINS_HAVE_ACK_TRACKER
+    });
+    follower.stream_termination_callback([&](Stream& stream, 
+                                             StreamFollower::TerminationReason) {
+        live_streams.erase(&stream);
+    });
+
+    steady_clock::duration elapsed(0);
+    for (size_t i = 0; i < packet_count; ++i) {
+        const uint8_t* frame = &trace.data[trace.offsets[i]];
+        const uint32_t frame_size = trace.offsets[i + 1] - trace.offsets[i];
+        packet_start = steady_clock::now();
+        Packet packet(new EthernetII(frame, frame_size), trace.timestamps[i], 
+                      Packet::own_pdu());
+        follower.process_packet(packet);
+        elapsed += steady_clock::now() - packet_start;
+
+        if (i % SAMPLE_INTERVAL == 0) {
+            uint64_t buffered_bytes = 0;
+            for (Stream* stream : live_streams) {
+                buffered_bytes += stream->client_flow().total_buffered_bytes() +
+                                  stream->server_flow().total_buffered_bytes() +
+                                  stream->client_payload().size() +
+                                  stream->server_payload().size();
+            }
+            max_buffered_bytes = max(max_buffered_bytes, buffered_bytes);
+        }
+    }
+
+    sort(callback_latencies.begin(), callback_latencies.end());
+    const double seconds = duration_cast<nanoseconds>(elapsed).count() / 1e9;
+    cout << name << endl
+         << "  packets:          " << packet_count << " (" 
+         << std::fixed << std::setprecision(2)
+         << packet_count / seconds / 1e6 << " Mpps, "
+         << trace.data.size() / seconds / (1024 * 1024) << " MB/s)" << endl
+         << "  delivered:        " << delivered_bytes << " of " 
+         << trace.payload_bytes << " payload bytes" << endl
+         << "  max streams:      " << max_live_streams << endl
+         << "  max buffered:     " << max_buffered_bytes / 1024 << " kb" << endl
+         << "  callback latency: p50 " << percentile(callback_latencies, 0.5)
+         << " ns, p99 " << percentile(callback_latencies, 0.99)
+         << " ns, max " << percentile(callback_latencies, 1.0) << " ns" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    size_t scale = 1;
+    if (argc > 1) {
+        scale = std::stoul(argv[1]);
+    }
+    TrafficProfile base;
+    base.total_connections = 2000 * scale;
+    base.concurrent_connections = 1000;
+    base.server_bytes = 32 * 1024;
+
+    run_benchmark("in order", base, false);
+
+    TrafficProfile reordered = base;
+    reordered.reorder_percent = 10;
+    reordered.duplicate_percent = 2;
+    reordered.seed = 2;
+    run_benchmark("10% reordering, 2% duplicates", reordered, false);
+
+    TrafficProfile lossy = base;
+    lossy.loss_percent = 5;
+    lossy.sack = true;
+    lossy.seed = 3;
+    run_benchmark("5% loss with SACK", lossy, false);
+    #ifdef TINS_HAVE_ACK_TRACKER
+        run_benchmark("5% loss with SACK, ACK tracking", lossy, true);
+    #endif // TINS_HAVE_ACK_TRACKER
+
+    TrafficProfile wrapping = base;
+    wrapping.reorder_percent = 5;
+    wrapping.loss_percent = 2;
+    wrapping.wrap_sequence_numbers = true;
+    wrapping.seed = 4;
+    run_benchmark("wrapping sequence numbers", wrapping, false);
+
+    TrafficProfile crowded = base;
+    crowded.total_connections = 10000 * scale;
+    crowded.concurrent_connections = 5000;
+    crowded.server_bytes = 8 * 1024;
+    crowded.reorder_percent = 5;
+    crowded.seed = 5;
+    run_benchmark("5000 concurrent connections", crowded, false);
+
+    cout << "peak RSS: " << peak_rss_kb() << " kb" << endl;
+}
@@ -0,0 +1,360 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "traffic_generator.h"
+#include <algorithm>
+#include <utility>
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/tcp.h>
+#include <tins/rawpdu.h>
+#include <tins/endianness.h>
+
+using std::vector;
+using std::pair;
+using std::make_pair;
+using std::min;
+using std::swap;
+using std::chrono::microseconds;
+
+using namespace Tins;
+
+TrafficProfile::TrafficProfile() 
+: total_connections(1000), concurrent_connections(100), client_bytes(1024),
+  server_bytes(64 * 1024), mss(1460), window_segments(16), reorder_percent(0),
+  duplicate_percent(0), loss_percent(0), sack(false), wrap_sequence_numbers(false),
+  packet_interval(10), seed(1) {
+
+}
+
+TrafficGenerator::TrafficGenerator(const TrafficProfile& profile)
+: profile_(profile), packets_generated_(0), payload_bytes_(0), 
+  connections_started_(0), now_(0), rng_state_(profile.seed) {
+    // Payloads are slices of this buffer, starting at different offsets
+    pattern_.resize(profile_.mss + 256);
+    for (size_t i = 0; i < pattern_.size(); ++i) {
+        pattern_[i] = static_cast<uint8_t>(random());
+    }
+    active_.resize(min(profile_.concurrent_connections, profile_.total_connections));
+    for (size_t i = 0; i < active_.size(); ++i) {
+        start_connection(active_[i]);
+    }
+}
+
+bool TrafficGenerator::next_packet(EthernetII& packet, timestamp_type& timestamp) {
+    Segment segment;
+    const Connection* connection;
+    if (!pop_segment(segment, connection)) {
+        return false;
+    }
+    build_packet(*connection, segment, packet);
+    timestamp = now_;
+    now_ += profile_.packet_interval;
+    ++packets_generated_;
+    return true;
+}
+
+bool TrafficGenerator::next_frame(vector<uint8_t>& frame, timestamp_type& timestamp) {
+    EthernetII packet;
+    if (!next_packet(packet, timestamp)) {
+        return false;
+    }
+    frame = packet.serialize();
+    return true;
+}
+
+uint64_t TrafficGenerator::packets_generated() const {
+    return packets_generated_;
+}
+
+uint64_t TrafficGenerator::payload_bytes() const {
+    return payload_bytes_;
+}
+
+uint32_t TrafficGenerator::random() {
+    rng_state_ = rng_state_ * 1664525U + 1013904223U;
+    return rng_state_ >> 8;
+}
+
+bool TrafficGenerator::chance(uint32_t percent) {
+    return percent > 0 && random() % 100 < percent;
+}
+
+void TrafficGenerator::start_connection(Connection& connection) {
+    const size_t index = connections_started_++;
+    connection.client_addr = IPv4Address(
+        Endian::host_to_be<uint32_t>(0x0a000000 + index / 50000 + 1)
+    );
+    connection.client_port = static_cast<uint16_t>(1024 + index % 50000);
+    connection.server_addr = IPv4Address(
+        Endian::host_to_be<uint32_t>(0xc0a80001 + index % 16)
+    );
+    connection.server_port = 80;
+    if (profile_.wrap_sequence_numbers) {
+        // Wrap around somewhere in the middle of the data
+        connection.client_isn = 0xffffffff - random() % (profile_.client_bytes + 1);
+        connection.server_isn = 0xffffffff - random() % (profile_.server_bytes + 1);
+    }
+    else {
+        connection.client_isn = random() ^ (random() << 16);
+        connection.server_isn = random() ^ (random() << 16);
+    }
+    connection.client_sent = 0;
+    connection.server_sent = 0;
+    connection.stage = HANDSHAKE;
+    connection.queue.clear();
+
+    Segment syn = make_segment(connection, true, TCP::SYN);
+    syn.seq = connection.client_isn;
+    syn.ack = 0;
+    Segment syn_ack = make_segment(connection, false, TCP::SYN | TCP::ACK);
+    syn_ack.seq = connection.server_isn;
+    connection.queue.push_back(syn);
+    connection.queue.push_back(syn_ack);
+    connection.queue.push_back(make_segment(connection, true, TCP::ACK));
+}
+
+void TrafficGenerator::advance(Connection& connection) {
+    while (connection.queue.empty() && connection.stage != DONE) {
+        switch (connection.stage) {
+            case HANDSHAKE:
+                connection.stage = CLIENT_DATA;
+                break;
+            case CLIENT_DATA:
+                if (connection.client_sent < profile_.client_bytes) {
+                    queue_window(connection, true);
+                }
+                else {
+                    connection.stage = SERVER_DATA;
+                }
+                break;
+            case SERVER_DATA:
+                if (connection.server_sent < profile_.server_bytes) {
+                    queue_window(connection, false);
+                }
+                else {
+                    // Client closes first, server answers with its own FIN
+                    Segment client_fin = make_segment(connection, true, 
+                                                      TCP::FIN | TCP::ACK);
+                    Segment server_fin = make_segment(connection, false,
+                                                      TCP::FIN | TCP::ACK);
+                    server_fin.ack += 1;
+                    Segment last_ack = make_segment(connection, true, TCP::ACK);
+                    last_ack.seq += 1;
+                    last_ack.ack += 1;
+                    connection.queue.push_back(client_fin);
+                    connection.queue.push_back(server_fin);
+                    connection.queue.push_back(last_ack);
+                    connection.stage = CLOSE;
+                }
+                break;
+            default:
+                connection.stage = DONE;
+                break;
+        }
+    }
+}
+
+void TrafficGenerator::queue_window(Connection& connection, bool from_client) {
+    size_t& sent = from_client ? connection.client_sent : connection.server_sent;
+    const size_t total = from_client ? profile_.client_bytes : profile_.server_bytes;
+    const uint32_t window_start = (from_client ? connection.client_isn : 
+                                                 connection.server_isn) + 1 + sent;
+    const size_t window_bytes = min(total - sent, 
+                                    profile_.window_segments * profile_.mss);
+    const size_t segments = (window_bytes + profile_.mss - 1) / profile_.mss;
+
+    // Decide which segments are lost and in which order the rest arrive
+    arrivals_.clear();
+    lost_.clear();
+    for (size_t i = 0; i < segments; ++i) {
+        if (chance(profile_.loss_percent)) {
+            lost_.push_back(i);
+        }
+        else {
+            arrivals_.push_back(i);
+        }
+    }
+    for (size_t i = 0; i < arrivals_.size(); ++i) {
+        if (chance(profile_.reorder_percent)) {
+            swap(arrivals_[i], arrivals_[i + random() % (arrivals_.size() - i)]);
+        }
+    }
+    // Retransmissions go at the end of the window
+    arrivals_.insert(arrivals_.end(), lost_.begin(), lost_.end());
+
+    received_.assign(segments, false);
+    size_t first_hole = 0;
+    size_t unacked = 0;
+    for (size_t n = 0; n < arrivals_.size(); ++n) {
+        const size_t index = arrivals_[n];
+        const bool in_order = index == first_hole;
+        Segment segment = make_segment(connection, from_client, TCP::ACK | TCP::PSH);
+        segment.seq = window_start + index * profile_.mss;
+        segment.payload_offset = static_cast<uint32_t>(sent + index * profile_.mss);
+        segment.payload_size = static_cast<uint16_t>(
+            min<size_t>(profile_.mss, window_bytes - index * profile_.mss)
+        );
+        connection.queue.push_back(segment);
+        if (chance(profile_.duplicate_percent)) {
+            connection.queue.push_back(segment);
+        }
+
+        received_[index] = true;
+        while (first_hole < segments && received_[first_hole]) {
+            ++first_hole;
+        }
+        // Receivers ACK every other segment, or right away if there are holes
+        const bool has_holes = !in_order || first_hole != index + 1;
+        if (has_holes || ++unacked == 2 || n + 1 == arrivals_.size()) {
+            const uint32_t ack = window_start + static_cast<uint32_t>(
+                min(first_hole * profile_.mss, window_bytes)
+            );
+            connection.queue.push_back(make_ack(connection, !from_client, ack,
+                                                first_hole, window_start,
+                                                window_bytes, index));
+            unacked = 0;
+        }
+    }
+    sent += window_bytes;
+    payload_bytes_ += window_bytes;
+}
+
+TrafficGenerator::Segment TrafficGenerator::make_segment(const Connection& connection,
+                                                         bool from_client,
+                                                         uint8_t flags) const {
+    Segment segment;
+    segment.from_client = from_client;
+    segment.flags = flags;
+    segment.sack_edges = 0;
+    segment.payload_size = 0;
+    segment.payload_offset = 0;
+    const uint32_t client_next = connection.client_isn + 1 + connection.client_sent;
+    const uint32_t server_next = connection.server_isn + 1 + connection.server_sent;
+    segment.seq = from_client ? client_next : server_next;
+    segment.ack = from_client ? server_next : client_next;
+    return segment;
+}
+
+TrafficGenerator::Segment TrafficGenerator::make_ack(const Connection& connection, 
+                                                     bool from_client, uint32_t ack,
+                                                     size_t first_hole,
+                                                     uint32_t window_start,
+                                                     size_t window_bytes,
+                                                     size_t last_arrival) const {
+    Segment segment = make_segment(connection, from_client, TCP::ACK);
+    segment.ack = ack;
+    if (!profile_.sack) {
+        return segment;
+    }
+    // Build the SACK blocks: the block containing the segment that just 
+    // arrived goes first, then the highest other ones
+    pair<size_t, size_t> blocks[3];
+    size_t block_count = 0;
+    size_t i = received_.size();
+    while (i > first_hole) {
+        --i;
+        if (!received_[i]) {
+            continue;
+        }
+        const size_t block_end = i + 1;
+        while (i > first_hole && received_[i - 1]) {
+            --i;
+        }
+        const pair<size_t, size_t> block = make_pair(i, block_end);
+        if (i <= last_arrival && last_arrival < block_end) {
+            // Make room for it in the first position
+            if (block_count == 3) {
+                block_count = 2;
+            }
+            for (size_t b = block_count; b > 0; --b) {
+                blocks[b] = blocks[b - 1];
+            }
+            blocks[0] = block;
+            ++block_count;
+        }
+        else if (block_count < 3) {
+            blocks[block_count++] = block;
+        }
+    }
+    for (size_t b = 0; b < block_count; ++b) {
+        segment.sack[segment.sack_edges++] = window_start + 
+            static_cast<uint32_t>(blocks[b].first * profile_.mss);
+        segment.sack[segment.sack_edges++] = window_start + 
+            static_cast<uint32_t>(min(blocks[b].second * profile_.mss, window_bytes));
+    }
+    return segment;
+}
+
+bool TrafficGenerator::pop_segment(Segment& segment, const Connection*& connection) {
+    while (!active_.empty()) {
+        const size_t index = random() % active_.size();
+        Connection& current = active_[index];
+        advance(current);
+        if (current.queue.empty()) {
+            // This one is done, replace it with a new connection if needed
+            if (connections_started_ < profile_.total_connections) {
+                start_connection(current);
+            }
+            else {
+                swap(current, active_.back());
+                active_.pop_back();
+            }
+            continue;
+        }
+        segment = current.queue.front();
+        current.queue.pop_front();
+        connection = &current;
+        return true;
+    }
+    return false;
+}
+
+void TrafficGenerator::build_packet(const Connection& connection, const Segment& segment,
+                                    EthernetII& packet) const {
+    if (segment.from_client) {
+        packet = EthernetII() / IP(connection.server_addr, connection.client_addr) /
+                 TCP(connection.server_port, connection.client_port);
+    }
+    else {
+        packet = EthernetII() / IP(connection.client_addr, connection.server_addr) /
+                 TCP(connection.client_port, connection.server_port);
+    }
+    TCP& tcp = packet.rfind_pdu<TCP>();
+    tcp.flags(segment.flags);
+    tcp.seq(segment.seq);
+    tcp.ack_seq(segment.ack);
+    tcp.window(65535);
+    if (segment.sack_edges > 0) {
+        tcp.sack(TCP::sack_type(segment.sack, segment.sack + segment.sack_edges));
+    }
+    if (segment.payload_size > 0) {
+        packet /= RawPDU(&pattern_[segment.payload_offset % 256], segment.payload_size);
+    }
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_BENCHMARKS_TRAFFIC_GENERATOR_H
+#define TINS_BENCHMARKS_TRAFFIC_GENERATOR_H
+
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <stdint.h>
+#include <tins/ip_address.h>
+
+namespace Tins {
+class EthernetII;
+}
+
+/**
+ * \brief Parameters used to generate synthetic TCP traffic
+ *
+ * Every connection performs a three way handshake, the client sends a
+ * request, the server sends a response and then the connection is closed.
+ * Data is sent in windows: within each window segments can be reordered,
+ * duplicated or lost. Lost segments are retransmitted at the end of the 
+ * window, so every connection eventually delivers all of its data.
+ */
+struct TrafficProfile {
+    TrafficProfile();
+
+    // The total amount of connections to generate
+    size_t total_connections;
+    // The amount of connections that are active at any given time
+    size_t concurrent_connections;
+    // The amount of payload bytes sent by each client and server
+    size_t client_bytes;
+    size_t server_bytes;
+    // The maximum payload size of each segment
+    uint16_t mss;
+    // The amount of segments sent before waiting for the receiver to catch up
+    size_t window_segments;
+    // Probabilities, in percent, applied to each data segment
+    uint32_t reorder_percent;
+    uint32_t duplicate_percent;
+    uint32_t loss_percent;
+    // Whether receivers include SACK blocks in their ACKs
+    bool sack;
+    // Whether initial sequence numbers are chosen so they wrap around
+    bool wrap_sequence_numbers;
+    // The time between two consecutive packets
+    std::chrono::microseconds packet_interval;
+    uint32_t seed;
+};
+
+/**
+ * \brief Deterministic synthetic TCP traffic generator
+ *
+ * Packets belonging to all active connections are interleaved randomly. Two
+ * generators built using the same profile produce exactly the same packets.
+ */
+class TrafficGenerator {
+public:
+    typedef std::chrono::microseconds timestamp_type;
+
+    TrafficGenerator(const TrafficProfile& profile);
+
+    /**
+     * \brief Generates the next packet as a PDU chain
+     *
+     * \return false iff all connections are done
+     */
+    bool next_packet(Tins::EthernetII& packet, timestamp_type& timestamp);
+
+    /**
+     * \brief Generates the next packet as a serialized frame
+     *
+     * \return false iff all connections are done
+     */
+    bool next_frame(std::vector<uint8_t>& frame, timestamp_type& timestamp);
+
+    // The amount of packets generated so far
+    uint64_t packets_generated() const;
+    // The amount of distinct payload bytes generated so far. This is what a 
+    // reassembler should deliver.
+    uint64_t payload_bytes() const;
+private:
+    enum Stage {
+        HANDSHAKE,
+        CLIENT_DATA,
+        SERVER_DATA,
+        CLOSE,
+        DONE
+    };
+
+    struct Segment {
+        bool from_client;
+        uint8_t flags;
+        uint8_t sack_edges;
+        uint16_t payload_size;
+        uint32_t seq;
+        uint32_t ack;
+        uint32_t payload_offset;
+        uint32_t sack[6];
+    };
+
+    struct Connection {
+        Tins::IPv4Address client_addr;
+        Tins::IPv4Address server_addr;
+        uint16_t client_port;
+        uint16_t server_port;
+        uint32_t client_isn;
+        uint32_t server_isn;
+        size_t client_sent;
+        size_t server_sent;
+        Stage stage;
+        std::deque<Segment> queue;
+    };
+
+    uint32_t random();
+    bool chance(uint32_t percent);
+    void start_connection(Connection& connection);
+    void advance(Connection& connection);
+    void queue_window(Connection& connection, bool from_client);
+    Segment make_segment(const Connection& connection, bool from_client,
+                         uint8_t flags) const;
+    Segment make_ack(const Connection& connection, bool from_client, uint32_t ack,
+                     size_t first_hole, uint32_t window_start, size_t window_bytes,
+                     size_t last_arrival) const;
+    bool pop_segment(Segment& segment, const Connection*& connection);
+    void build_packet(const Connection& connection, const Segment& segment,
+                      Tins::EthernetII& packet) const;
+
+    TrafficProfile profile_;
+    std::vector<Connection> active_;
+    std::vector<uint8_t> pattern_;
+    std::vector<bool> received_;
+    std::vector<size_t> arrivals_;
+    std::vector<size_t> lost_;
+    uint64_t packets_generated_;
+    uint64_t payload_bytes_;
+    size_t connections_started_;
+    timestamp_type now_;
+    uint32_t rng_state_;
+};
+
+#endif // TINS_BENCHMARKS_TRAFFIC_GENERATOR_H
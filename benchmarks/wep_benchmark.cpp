@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <tins/config.h>
+#include <tins/crypto.h>
+#include <tins/dot11/dot11_data.h>
+#include <tins/utils/checksum_utils.h>
+
+using std::cout;
+using std::endl;
+using std::setw;
+using std::vector;
+using std::string;
+using std::swap;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+using namespace Tins;
+
+const string PASSWORD = "\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d";
+const HWAddress<6> BSSID = "00:01:02:03:04:05";
+
+// Encrypts data in place using RC4
+void rc4(const uint8_t* key, size_t key_size, uint8_t* data, size_t data_size) {
+    uint8_t state[256];
+    for (size_t i = 0; i < 256; ++i) {
+        state[i] = static_cast<uint8_t>(i);
+    }
+    for (size_t i = 0, j = 0; i < 256; ++i) {
+        j = (j + state[i] + key[i % key_size]) & 0xff;
+        swap(state[i], state[j]);
+    }
+    for (size_t n = 0, i = 0, j = 0; n < data_size; ++n) {
+        i = (i + 1) & 0xff;
+        j = (j + state[i]) & 0xff;
+        swap(state[i], state[j]);
+        data[n] ^= state[(state[i] + state[j]) & 0xff];
+    }
+}
+
+// Builds a WEP encrypted data frame, as sent by an access point
+vector<uint8_t> make_frame(uint32_t iv, size_t payload_size) {
+    Dot11Data dot11("06:07:08:09:0a:0b", BSSID);
+    dot11.addr3(BSSID);
+    dot11.from_ds(1);
+    dot11.wep(1);
+    vector<uint8_t> frame = dot11.serialize();
+
+    // IV, key index, then the encrypted payload and ICV
+    vector<uint8_t> data(payload_size + 4);
+    // LLC/SNAP header using the local experimental ethertype, so the
+    // payload is not parsed any further
+    const uint8_t snap[] = { 0xaa, 0xaa, 0x03, 0, 0, 0, 0x88, 0xb5 };
+    for (size_t i = 0; i < payload_size; ++i) {
+        data[i] = (i < sizeof(snap)) ? snap[i] : static_cast<uint8_t>(i * 7 + iv);
+    }
+    const uint32_t crc = Utils::crc32(&data[0], static_cast<uint32_t>(payload_size));
+    for (size_t i = 0; i < 4; ++i) {
+        data[payload_size + i] = (crc >> (i * 8)) & 0xff;
+    }
+    uint8_t key[16] = { (uint8_t)(iv >> 16), (uint8_t)(iv >> 8), (uint8_t)iv };
+    std::copy(PASSWORD.begin(), PASSWORD.end(), key + 3);
+    rc4(key, 3 + PASSWORD.size(), &data[0], data.size());
+
+    frame.push_back(key[0]);
+    frame.push_back(key[1]);
+    frame.push_back(key[2]);
+    frame.push_back(0);
+    frame.insert(frame.end(), data.begin(), data.end());
+    return frame;
+}
+
+void report(size_t payload_size, const char* name, size_t total_frames,
+            size_t decrypted, steady_clock::duration elapsed) {
+    const double seconds = duration_cast<nanoseconds>(elapsed).count() / 1e9;
+    cout << setw(6) << payload_size << " bytes, " << name << ": "
+         << std::fixed << std::setprecision(2)
+         << setw(8) << total_frames / seconds / 1e3 << " kpps, "
+         << setw(8) << total_frames * payload_size / seconds / (1024 * 1024) << " MB/s";
+    if (decrypted != total_frames) {
+        cout << " (" << total_frames - decrypted << " frames failed to decrypt)";
+    }
+    cout << endl;
+}
+
+// Decrypts every frame once per iteration, parsing each of them
+void run_pdu_benchmark(const vector<vector<uint8_t> >& frames, size_t payload_size,
+                       size_t iterations) {
+    Crypto::WEPDecrypter decrypter;
+    decrypter.add_password(BSSID, PASSWORD);
+    size_t decrypted = 0;
+    steady_clock::duration elapsed(0);
+    for (size_t n = 0; n < iterations; ++n) {
+        for (size_t i = 0; i < frames.size(); ++i) {
+            Dot11Data dot11(&frames[i][0], static_cast<uint32_t>(frames[i].size()));
+            const steady_clock::time_point start = steady_clock::now();
+            if (decrypter.decrypt(dot11)) {
+                ++decrypted;
+            }
+            elapsed += steady_clock::now() - start;
+        }
+    }
+    report(payload_size, "PDU    ", iterations * frames.size(), decrypted, elapsed);
+}
+
+// Decrypts every frame in place once per iteration, using a single batch
+void run_batch_benchmark(const vector<vector<uint8_t> >& frames, size_t payload_size,
+                         size_t iterations) {
+    Crypto::WEPDecrypter decrypter;
+    decrypter.add_password(BSSID, PASSWORD);
+    vector<vector<uint8_t> > buffers(frames);
+    vector<Crypto::InPlaceFrame> batch;
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        batch.push_back(Crypto::InPlaceFrame(&buffers[i][0],
+                                             static_cast<uint32_t>(buffers[i].size())));
+    }
+    size_t decrypted = 0;
+    steady_clock::duration elapsed(0);
+    for (size_t n = 0; n < iterations; ++n) {
+        // Decryption happens in place, so restore the encrypted frames
+        for (size_t i = 0; i < frames.size(); ++i) {
+            std::copy(frames[i].begin(), frames[i].end(), buffers[i].begin());
+        }
+        const steady_clock::time_point start = steady_clock::now();
+        decrypted += decrypter.decrypt_in_place(&batch[0], batch.size());
+        elapsed += steady_clock::now() - start;
+    }
+    report(payload_size, "batch  ", iterations * frames.size(), decrypted, elapsed);
+}
+
+int main(int argc, char* argv[]) {
+    static const size_t frame_count = 256;
+    size_t iterations = 200;
+    if (argc > 1) {
+        iterations = std::stoul(argv[1]);
+    }
+    const size_t payload_sizes[] = { 64, 512, 1500 };
+    for (size_t i = 0; i < sizeof(payload_sizes) / sizeof(payload_sizes[0]); ++i) {
+        vector<vector<uint8_t> > frames;
+        for (size_t n = 0; n < frame_count; ++n) {
+            frames.push_back(make_frame(static_cast<uint32_t>(n * 4099), payload_sizes[i]));
+        }
+        run_pdu_benchmark(frames, payload_sizes[i], iterations);
+        run_batch_benchmark(frames, payload_sizes[i], iterations);
+    }
+}
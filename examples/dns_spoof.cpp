@@ -51,11 +51,25 @@ bool callback(const PDU& pdu) {
 
     // Is it a DNS query?
     if (dns.type() == DNS::QUERY) {
+        // The response is written in a single pass into this buffer
+        uint8_t buffer[512];
+        DNSBuilder builder(buffer, sizeof(buffer));
+        builder.id(dns.id());
+        // It's a response
+        builder.type(DNS::RESPONSE);
+        builder.recursion_desired(dns.recursion_desired());
+        // Recursion is available(just in case)
+        builder.recursion_available(1);
+        // Queries go first, then the answers
+        const DNS::queries_type queries = dns.queries();
+        for (const auto& query : queries) {
+            builder.add_query(query);
+        }
         // Let's see if there's any query for an "A" record.
-        for (const auto& query : dns.queries()) {
+        for (const auto& query : queries) {
             if (query.query_type() == DNS::A) {
                 // Here's one! Let's add an answer.
-                dns.add_answer(
+                builder.add_answer(
                     DNS::resource(
                         query.dname(), 
                         "127.0.0.1",
@@ -68,16 +82,12 @@ bool callback(const PDU& pdu) {
             }
         }
         // Have we added some answers?
-        if (dns.answers_count() > 0) {
-            // It's a response now
-            dns.type(DNS::RESPONSE);
-            // Recursion is available(just in case)
-            dns.recursion_available(1);
+        if (builder.count(DNS::ANSWERS) > 0) {
             // Build our packet
             auto pkt = EthernetII(eth.src_addr(), eth.dst_addr()) /
                        IP(ip.src_addr(), ip.dst_addr()) /
                        UDP(udp.sport(), udp.dport()) /
-                       dns;
+                       RawPDU(buffer, builder.size());
             // Send it!
             sender.send(pkt);
         }
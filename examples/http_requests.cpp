@@ -28,84 +28,93 @@
  */
 
 #include <string>
+#include <deque>
+#include <memory>
 #include <iostream>
 #include <stdexcept>
-#include <boost/regex.hpp>
 #include "tins/tcp_ip/stream_follower.h"
+#include "tins/tcp_ip/http_stream_parser.h"
 #include "tins/sniffer.h"
 
 using std::string;
+using std::deque;
+using std::shared_ptr;
+using std::make_shared;
 using std::cout;
 using std::cerr;
 using std::endl;
 using std::exception;
 
-using boost::regex;
-using boost::match_results;
-
 using Tins::PDU;
 using Tins::Sniffer;
 using Tins::SnifferConfiguration;
 using Tins::TCPIP::Stream;
 using Tins::TCPIP::StreamFollower;
+using Tins::TCPIP::HTTPParser;
+using Tins::TCPIP::HTTPStreamParser;
 
-// This example captures and follows TCP streams seen on port 80. It will
-// wait until both the client and server send data and then apply a regex
-// to both payloads, extrating some information and printing it.
-
-// Don't buffer more than 3kb of data in either request/response
-const size_t MAX_PAYLOAD = 3 * 1024;
-// The regex to be applied on the request. This will extract the HTTP
-// method being used, the request's path and the Host header value.
-regex request_regex("([\\w]+) ([^ ]+).+\r\nHost: ([\\d\\w\\.-]+)\r\n");
-// The regex to be applied on the response. This finds the response code.
-regex response_regex("HTTP/[^ ]+ ([\\d]+)");
-
-void on_server_data(Stream& stream) {
-    match_results<Stream::payload_type::const_iterator> client_match;
-    match_results<Stream::payload_type::const_iterator> server_match;
-    const Stream::payload_type& client_payload = stream.client_payload();
-    const Stream::payload_type& server_payload = stream.server_payload();
-    // Run the regexes on client/server payloads
-    bool valid = regex_search(server_payload.begin(), server_payload.end(),
-                              server_match, response_regex) &&
-                 regex_search(client_payload.begin(), client_payload.end(),
-                              client_match, request_regex);
-    // If we matched both the client and the server regexes
-    if (valid) {
-        // Extract all fields
-        string method = string(client_match[1].first, client_match[1].second);
-        string url = string(client_match[2].first, client_match[2].second);
-        string host = string(client_match[3].first, client_match[3].second);
-        string response_code = string(server_match[1].first, server_match[1].second);
-        // Now print them
-        cout << method << " http://" << host << url << " -> " << response_code << endl;
+// This example captures and follows TCP streams seen on port 80. Each
+// stream gets an HTTP parser attached, which incrementally parses the
+// requests and responses as data arrives. For every response, the method,
+// URL and response code are printed.
+//
+// Since the parser consumes the stream's payload as it goes, only a few
+// bytes are kept buffered on each stream and every request on a 
+// persistent connection is seen, not just the first one.
 
-        // Once we've seen the first request on this stream, ignore it
-        stream.ignore_client_data();
-        stream.ignore_server_data();
-    }
-    
-    // Just in case the server returns invalid data, stop at 3kb
-    if (stream.server_payload().size() > MAX_PAYLOAD) {
-        stream.ignore_server_data();
+// Holds a stream's parser along with the requests that haven't been answered yet
+class HTTPSession {
+public:
+    HTTPSession() {
+        HTTPParser& requests = parser_.request_parser();
+        requests.request_line_callback([&](const HTTPParser::RequestLine& line) {
+            current_ = line.method.to_string() + " ";
+            url_ = line.target.to_string();
+            host_.clear();
+        });
+        requests.header_callback([&](const HTTPParser::Slice& name,
+                                     const HTTPParser::Slice& value) {
+            if (name.iequals("Host")) {
+                host_ = value.to_string();
+            }
+        });
+        requests.headers_complete_callback([&]() {
+            pending_.push_back(current_ + "http://" + host_ + url_);
+        });
+        parser_.response_parser().status_line_callback(
+            [&](const HTTPParser::StatusLine& line) {
+                // Interim responses don't answer a request
+                if (line.status_code >= 100 && line.status_code < 200 &&
+                    line.status_code != 101) {
+                    return;
+                }
+                if (!pending_.empty()) {
+                    cout << pending_.front() << " -> " << line.status_code << endl;
+                    pending_.pop_front();
+                }
+            });
     }
-}
 
-void on_client_data(Stream& stream) {
-    // Don't hold more than 3kb of data from the client's flow
-    if (stream.client_payload().size() > MAX_PAYLOAD) {
-        stream.ignore_client_data();
+    HTTPStreamParser& parser() {
+        return parser_;
     }
-}
+private:
+    HTTPStreamParser parser_;
+    deque<string> pending_;
+    string current_;
+    string url_;
+    string host_;
+};
 
 void on_new_connection(Stream& stream) {
-    stream.client_data_callback(&on_client_data);
-    stream.server_data_callback(&on_server_data);
-    // Don't automatically cleanup the stream's data, as we'll manage
-    // the buffer ourselves and let it grow until we see a full request
-    // and response
-    stream.auto_cleanup_payloads(false);
+    shared_ptr<HTTPSession> session = make_shared<HTTPSession>();
+    // Let the parser handle the stream's data callbacks
+    session->parser().attach(stream);
+    // The closed callback holds a reference to the session so it lives 
+    // for as long as the stream does
+    stream.stream_closed_callback([session](Stream&) {
+        session->parser().finish();
+    });
 }
 
 int main(int argc, char* argv[]) {
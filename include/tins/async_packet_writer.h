@@ -0,0 +1,315 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_ASYNC_PACKET_WRITER_H
+#define TINS_ASYNC_PACKET_WRITER_H
+
+#include <tins/cxxstd.h>
+
+#if TINS_IS_CXX11 && !defined(_WIN32)
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/buffered_packet_writer.h>
+#include <tins/timestamp.h>
+
+namespace Tins {
+
+class PDU;
+class Packet;
+
+/**
+ * \class AsyncPacketWriter
+ * \brief Writes packets to pcap files from a dedicated thread.
+ *
+ * Writing to disk from a capture callback means any latency spike on the
+ * disk stalls the capture and makes the kernel drop packets. This class
+ * decouples both: packets are copied into a bounded lock-free queue and
+ * a dedicated I/O thread pops them and writes them using a
+ * BufferedPacketWriter.
+ *
+ * The queue has a single producer: write must always be called from the
+ * same thread (or calls must be serialized by the caller). Queue slots
+ * keep their memory after being consumed, so once the queue is warm
+ * enqueuing a packet doesn't allocate.
+ *
+ * When the queue is full, the overflow policy determines what happens:
+ * with AsyncPacketWriter::DROP_NEWEST the packet is discarded and counted,
+ * while with AsyncPacketWriter::BLOCK the caller waits until the I/O
+ * thread frees a slot.
+ *
+ * If writing to the file fails, the I/O thread stops writing and discards
+ * every queued packet from then on, counting them as dropped. The error is
+ * rethrown by AsyncPacketWriter::close.
+ *
+ * \code
+ * AsyncPacketWriter writer("capture.pcap", DataLinkType<EthernetII>());
+ * SnifferConfiguration config;
+ * config.set_retain_raw_frames(true);
+ * Sniffer sniffer("eth0", config);
+ * sniffer.sniff_loop([&](Packet& packet) {
+ *     writer.write(packet);
+ *     return true;
+ * });
+ * \endcode
+ *
+ * This class is not available on Windows.
+ */
+class TINS_API AsyncPacketWriter {
+public:
+    /**
+     * The policies applied when the queue is full.
+     */
+    enum OverflowPolicy {
+        DROP_NEWEST,
+        BLOCK
+    };
+
+    /**
+     * The default amount of queue slots.
+     */
+    static const size_t DEFAULT_QUEUE_SIZE;
+
+    /**
+     * \brief Constructs an AsyncPacketWriter that writes to a file.
+     *
+     * \param file_name The name of the file to write.
+     * \param lt A DataLinkType that indicates the link type of the packets
+     * that will be written.
+     * \param queue_size The amount of packets that can be queued. This is
+     * rounded up to a power of 2.
+     * \param policy The overflow policy.
+     */
+    template<typename T>
+    AsyncPacketWriter(const std::string& file_name, const DataLinkType<T>& lt,
+                      size_t queue_size = DEFAULT_QUEUE_SIZE,
+                      OverflowPolicy policy = DROP_NEWEST)
+    : writer_(new BufferedPacketWriter(file_name, lt)) {
+        init(queue_size, policy);
+    }
+
+    /**
+     * \brief Constructs an AsyncPacketWriter that writes to a file.
+     *
+     * \param file_name The name of the file to write.
+     * \param link_type The pcap link type (DLT_*) of the packets that
+     * will be written.
+     * \param queue_size The amount of packets that can be queued.
+     * \param policy The overflow policy.
+     */
+    AsyncPacketWriter(const std::string& file_name, int link_type,
+                      size_t queue_size = DEFAULT_QUEUE_SIZE,
+                      OverflowPolicy policy = DROP_NEWEST);
+
+    /**
+     * \brief Constructs an AsyncPacketWriter that uses an existing writer.
+     *
+     * This allows configuring file rotation before handing the writer
+     * over. The writer is only used by the I/O thread from then on, so
+     * it must not be accessed by any other thread.
+     *
+     * \param writer The writer to use.
+     * \param queue_size The amount of packets that can be queued.
+     * \param policy The overflow policy.
+     */
+    AsyncPacketWriter(std::unique_ptr<BufferedPacketWriter> writer,
+                      size_t queue_size = DEFAULT_QUEUE_SIZE,
+                      OverflowPolicy policy = DROP_NEWEST);
+
+    /**
+     * \brief Destructor.
+     *
+     * Every queued packet is written before the I/O thread is stopped.
+     * Errors are ignored; call AsyncPacketWriter::close to handle them.
+     */
+    ~AsyncPacketWriter();
+
+    /**
+     * \brief Queues a serialized packet.
+     *
+     * \param buffer The serialized packet.
+     * \param total_sz The size of the serialized packet.
+     * \param timestamp The timestamp to use on the entry for this packet.
+     * \return false iff the packet was dropped.
+     */
+    bool write(const uint8_t* buffer, uint32_t total_sz, const Timestamp& timestamp);
+
+    /**
+     * \brief Queues a serialized packet that was truncated when captured.
+     *
+     * \param buffer The serialized packet.
+     * \param total_sz The size of the serialized packet.
+     * \param original_sz The size of the packet on the wire.
+     * \param timestamp The timestamp to use on the entry for this packet.
+     * \return false iff the packet was dropped.
+     */
+    bool write(const uint8_t* buffer, uint32_t total_sz, uint32_t original_sz,
+               const Timestamp& timestamp);
+
+    /**
+     * \brief Queues a Packet.
+     *
+     * If the packet holds the bytes it was captured from, those are
+     * queued. Otherwise, its PDU is serialized on the calling thread.
+     * If the packet doesn't contain a PDU, an invalid_packet exception
+     * is thrown.
+     *
+     * \param packet The packet to be written.
+     * \return false iff the packet was dropped.
+     */
+    bool write(Packet& packet);
+
+    /**
+     * \brief Queues a PDU.
+     *
+     * The PDU is serialized on the calling thread.
+     *
+     * \param pdu The PDU to be written.
+     * \param timestamp The timestamp to use on the entry for this packet.
+     * \return false iff the packet was dropped.
+     */
+    bool write(PDU& pdu, const Timestamp& timestamp);
+
+    /**
+     * \brief Queues a PDU, using the current time as its timestamp.
+     *
+     * \param pdu The PDU to be written.
+     * \return false iff the packet was dropped.
+     */
+    bool write(PDU& pdu);
+
+    /**
+     * \brief Writes every queued packet, stops the I/O thread and closes
+     * the file.
+     *
+     * If the I/O thread failed to write, the error is rethrown. No more
+     * packets can be written afterwards.
+     */
+    void close();
+
+    /**
+     * \brief Retrieves the amount of packets currently queued.
+     */
+    size_t queue_depth() const;
+
+    /**
+     * \brief Retrieves the amount of queue slots.
+     */
+    size_t queue_capacity() const {
+        return slots_.size();
+    }
+
+    /**
+     * \brief Retrieves the largest queue depth seen so far.
+     */
+    size_t max_queue_depth() const {
+        return max_queue_depth_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Retrieves the amount of packets dropped.
+     */
+    uint64_t dropped_frames() const {
+        return dropped_frames_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Retrieves the amount of packets written to disk so far.
+     */
+    uint64_t frames_written() const {
+        return frames_written_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Retrieves the amount of packet bytes written to disk so far.
+     *
+     * This doesn't include the pcap file and record headers.
+     */
+    uint64_t bytes_written() const {
+        return bytes_written_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Retrieves the overflow policy.
+     */
+    OverflowPolicy overflow_policy() const {
+        return policy_;
+    }
+private:
+    struct Slot {
+        std::vector<uint8_t> data;
+        Timestamp timestamp;
+        uint32_t original_size;
+    };
+
+    // You shall not copy
+    AsyncPacketWriter(const AsyncPacketWriter&);
+    AsyncPacketWriter& operator=(const AsyncPacketWriter&);
+
+    void init(size_t queue_size, OverflowPolicy policy);
+    Slot* acquire_slot();
+    void publish_slot();
+    void run();
+    void stop();
+
+    std::unique_ptr<BufferedPacketWriter> writer_;
+    std::vector<Slot> slots_;
+    size_t mask_;
+    OverflowPolicy policy_;
+    // The indexes are kept in different cache lines, since each of them
+    // is written by a different thread
+    std::atomic<size_t> head_;
+    char head_padding_[64];
+    std::atomic<size_t> tail_;
+    char tail_padding_[64];
+    std::atomic<bool> stopping_;
+    std::atomic<bool> consumer_waiting_;
+    std::atomic<size_t> max_queue_depth_;
+    std::atomic<uint64_t> dropped_frames_;
+    std::atomic<uint64_t> frames_written_;
+    std::atomic<uint64_t> bytes_written_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::exception_ptr error_;
+    std::thread thread_;
+};
+
+} // Tins
+
+#endif // TINS_IS_CXX11 && !_WIN32
+
+#endif // TINS_ASYNC_PACKET_WRITER_H
@@ -0,0 +1,377 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_BUFFERED_PACKET_WRITER_H
+#define TINS_BUFFERED_PACKET_WRITER_H
+
+#include <tins/cxxstd.h>
+
+#if TINS_IS_CXX11 && !defined(_WIN32)
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/pdu.h>
+#include <tins/timestamp.h>
+#include <tins/utils/pdu_utils.h>
+
+namespace Tins {
+
+class Packet;
+
+template<typename T>
+struct DataLinkType;
+
+/**
+ * \class BufferedPacketWriter
+ * \brief Writes packets to pcap files using large buffers and rotating
+ * files.
+ *
+ * PacketWriter writes every packet through libpcap's pcap_dump, which in
+ * turn goes through stdio's small buffer. This class produces the same
+ * file format on its own: records are appended to a large, page aligned
+ * buffer which is written to the file using a single system call when it
+ * fills up. Packets larger than the buffer are written along with the
+ * pending records using writev.
+ *
+ * Files can be rotated once they reach a certain size, once they span a
+ * certain amount of time (measured using packet timestamps) or once they
+ * contain a certain amount of packets. The first file uses the name given
+ * on construction; subsequent ones have their index inserted before the
+ * extension, e.g. "capture.pcap", "capture.1.pcap", "capture.2.pcap".
+ * A callback can be executed every time a file is completed.
+ *
+ * Pending records are only written when the buffer fills up, when
+ * BufferedPacketWriter::flush is called, when rotating and when closing
+ * the writer.
+ *
+ * \code
+ * BufferedPacketWriter writer("capture.pcap", DataLinkType<EthernetII>());
+ * // Keep files under 100MB and 1 hour of traffic
+ * writer.max_file_size(100 * 1024 * 1024);
+ * writer.max_file_duration(std::chrono::hours(1));
+ * writer.rotation_callback([](const std::string& file_name) {
+ *     std::cout << file_name << " completed" << std::endl;
+ * });
+ * Sniffer sniffer("eth0");
+ * while (true) {
+ *     Packet packet = sniffer.next_packet();
+ *     writer.write(packet);
+ * }
+ * \endcode
+ *
+ * This class is not available on Windows.
+ */
+class TINS_API BufferedPacketWriter {
+public:
+    /**
+     * \brief The type of the rotation callback.
+     *
+     * The argument is the name of the file that was just completed.
+     */
+    typedef std::function<void(const std::string&)> rotation_callback_type;
+
+    /**
+     * The default buffer size.
+     */
+    static const uint32_t DEFAULT_BUFFER_SIZE;
+
+    /**
+     * The snapshot length written on file headers. Larger packets are
+     * truncated.
+     */
+    static const uint32_t SNAPSHOT_LENGTH;
+
+    /**
+     * \brief Constructs a BufferedPacketWriter.
+     *
+     * The file is created, or truncated if it already exists, and its
+     * header is written. If the file can't be opened, a file_open_error
+     * exception is thrown.
+     *
+     * \param file_name The name of the first file to write.
+     * \param lt A DataLinkType that indicates the link type of the packets
+     * that will be written.
+     * \param buffer_size The size of the buffer used to hold pending records.
+     */
+    template<typename T>
+    BufferedPacketWriter(const std::string& file_name, const DataLinkType<T>& lt,
+                         uint32_t buffer_size = DEFAULT_BUFFER_SIZE)
+    : buffer_(0) {
+        init(file_name, lt.get_type(), buffer_size);
+    }
+
+    /**
+     * \brief Constructs a BufferedPacketWriter.
+     *
+     * \sa BufferedPacketWriter(const std::string&, const DataLinkType<T>&, uint32_t)
+     * \param file_name The name of the first file to write.
+     * \param link_type The pcap link type (DLT_*) of the packets that
+     * will be written.
+     * \param buffer_size The size of the buffer used to hold pending records.
+     */
+    BufferedPacketWriter(const std::string& file_name, int link_type,
+                         uint32_t buffer_size = DEFAULT_BUFFER_SIZE);
+
+    /**
+     * \brief Destructor.
+     *
+     * Pending records are written and the file is closed. Errors are
+     * ignored and the rotation callback is not executed; call
+     * BufferedPacketWriter::close to handle those.
+     */
+    ~BufferedPacketWriter();
+
+    /**
+     * \brief Sets the maximum size of each file.
+     *
+     * A file is rotated when writing a packet would make it larger than
+     * this. A file always holds at least one packet. 0 means no limit.
+     *
+     * \param value The maximum file size, in bytes.
+     */
+    void max_file_size(uint64_t value);
+
+    /**
+     * \brief Sets the maximum time span of each file.
+     *
+     * A file is rotated when a packet's timestamp is this far or farther
+     * from the timestamp of the file's first packet. 0 means no limit.
+     *
+     * \param value The maximum time span.
+     */
+    void max_file_duration(std::chrono::microseconds value);
+
+    /**
+     * \brief Sets the maximum amount of packets in each file.
+     *
+     * 0 means no limit.
+     *
+     * \param value The maximum amount of packets.
+     */
+    void max_file_packets(uint64_t value);
+
+    /**
+     * \brief Sets the callback executed every time a file is completed.
+     *
+     * \param callback The callback to be set.
+     */
+    void rotation_callback(rotation_callback_type callback);
+
+    /**
+     * \brief Writes a PDU, using the current time as its timestamp.
+     *
+     * \param pdu The PDU to be written.
+     */
+    void write(PDU& pdu);
+
+    /**
+     * \brief Writes a PDU.
+     *
+     * \param pdu The PDU to be written.
+     * \param timestamp The timestamp to use on the entry for this packet.
+     */
+    void write(PDU& pdu, const Timestamp& timestamp);
+
+    /**
+     * \brief Writes a Packet, using its timestamp.
+     *
+     * If the packet holds the bytes it was captured from, those are
+     * written instead of serializing its PDU.
+     *
+     * \param packet The packet to be written.
+     */
+    void write(Packet& packet);
+
+    /**
+     * \brief Writes a serialized packet, using the current time as its
+     * timestamp.
+     *
+     * The buffer is written as is, which allows storing captured bytes
+     * without parsing and serializing them again.
+     *
+     * \param buffer The serialized packet.
+     * \param total_sz The size of the serialized packet.
+     */
+    void write(const uint8_t* buffer, uint32_t total_sz);
+
+    /**
+     * \brief Writes a serialized packet.
+     *
+     * \sa BufferedPacketWriter::write(const uint8_t*, uint32_t)
+     * \param buffer The serialized packet.
+     * \param total_sz The size of the serialized packet.
+     * \param timestamp The timestamp to use on the entry for this packet.
+     */
+    void write(const uint8_t* buffer, uint32_t total_sz, const Timestamp& timestamp);
+
+    /**
+     * \brief Writes a serialized packet that was truncated when captured.
+     *
+     * \sa BufferedPacketWriter::write(const uint8_t*, uint32_t)
+     * \param buffer The serialized packet.
+     * \param total_sz The size of the serialized packet.
+     * \param original_sz The size of the packet on the wire.
+     * \param timestamp The timestamp to use on the entry for this packet.
+     */
+    void write(const uint8_t* buffer, uint32_t total_sz, uint32_t original_sz,
+               const Timestamp& timestamp);
+
+    /**
+     * \brief Writes a PDU.
+     *
+     * The template parameter T must at some point yield a PDU& after
+     * applying operator* one or more than one time. This accepts both
+     * raw and smart pointers.
+     */
+    template<typename T>
+    void write(T& pdu) {
+        write(Utils::dereference_until_pdu(pdu));
+    }
+
+    /**
+     * \brief Writes all the PDUs in the range [start, end)
+     * \param start A forward iterator pointing to the first PDU
+     * to be written.
+     * \param end A forward iterator pointing to one past the last
+     * PDU in the range.
+     */
+    template<typename ForwardIterator>
+    void write(ForwardIterator start, ForwardIterator end) {
+        while (start != end) {
+            write(Utils::dereference_until_pdu(*start++));
+        }
+    }
+
+    /**
+     * \brief Writes the pending records to the current file.
+     *
+     * If writing fails, a file_write_error exception is thrown.
+     */
+    void flush();
+
+    /**
+     * \brief Completes the current file and starts the next one.
+     *
+     * This is done automatically when any of the file limits is hit.
+     */
+    void rotate();
+
+    /**
+     * \brief Writes the pending records and closes the current file.
+     *
+     * The rotation callback is executed for the file. No more packets
+     * can be written afterwards.
+     */
+    void close();
+
+    /**
+     * \brief Builds the name of one of the files written by a
+     * BufferedPacketWriter.
+     *
+     * \param base_file_name The file name given on construction.
+     * \param index The index of the file.
+     */
+    static std::string file_name(const std::string& base_file_name, uint32_t index);
+
+    /**
+     * \brief Retrieves the name of the file currently being written.
+     */
+    const std::string& current_file_name() const {
+        return current_file_name_;
+    }
+
+    /**
+     * \brief Retrieves the index of the file currently being written.
+     */
+    uint32_t file_index() const {
+        return file_index_;
+    }
+
+    /**
+     * \brief Retrieves the amount of packets written to the current file.
+     */
+    uint64_t file_packets() const {
+        return file_packets_;
+    }
+
+    /**
+     * \brief Retrieves the size of the current file, including pending
+     * records.
+     */
+    uint64_t file_size() const {
+        return file_size_;
+    }
+
+    /**
+     * \brief Retrieves the amount of packets written to all files.
+     */
+    uint64_t packets_written() const {
+        return packets_written_;
+    }
+private:
+    // You shall not copy
+    BufferedPacketWriter(const BufferedPacketWriter&);
+    BufferedPacketWriter& operator=(const BufferedPacketWriter&);
+
+    void init(const std::string& file_name, int link_type, uint32_t buffer_size);
+    void open_file();
+    void close_file();
+    void write_record(const uint8_t* buffer, uint32_t total_sz, uint32_t original_sz,
+                      const Timestamp& timestamp);
+    void record_written(uint32_t record_size);
+    bool should_rotate(uint32_t record_size, std::chrono::microseconds timestamp) const;
+
+    std::string base_file_name_;
+    std::string current_file_name_;
+    int link_type_;
+    int fd_;
+    uint8_t* buffer_;
+    uint32_t buffer_size_;
+    uint32_t buffer_used_;
+    uint32_t file_index_;
+    uint64_t file_size_;
+    uint64_t file_packets_;
+    uint64_t packets_written_;
+    uint64_t max_file_size_;
+    uint64_t max_file_packets_;
+    std::chrono::microseconds max_file_duration_;
+    std::chrono::microseconds file_start_;
+    rotation_callback_type rotation_callback_;
+    PDU::serialization_type serialization_buffer_;
+};
+
+} // Tins
+
+#endif // TINS_IS_CXX11 && !_WIN32
+
+#endif // TINS_BUFFERED_PACKET_WRITER_H
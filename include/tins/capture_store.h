@@ -0,0 +1,506 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_CAPTURE_STORE_H
+#define TINS_CAPTURE_STORE_H
+
+#include <tins/cxxstd.h>
+
+#if TINS_IS_CXX11 && !defined(_WIN32)
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/buffered_packet_writer.h>
+#include <tins/timestamp.h>
+
+namespace Tins {
+
+class PDU;
+class Packet;
+class IPv4Address;
+class IPv6Address;
+
+/**
+ * \class CaptureStore
+ * \brief Writes rotating pcap files along with an index of their flows.
+ *
+ * Packets are written using a BufferedPacketWriter. For every file, the
+ * store also keeps track of the offset of each record, grouped by flow
+ * and by time bucket. Once a file is completed, this index is written to
+ * a sidecar file named after it with an ".idx" suffix, e.g.
+ * "capture.pcap.idx". CaptureStoreReader uses these files to retrieve a
+ * single flow or time range without scanning the captures.
+ *
+ * Flows are identified by their protocol and both endpoints' addresses
+ * and ports, regardless of the direction of each packet. Flows are
+ * extracted from the packets' bytes, which is supported for ethernet
+ * (including 802.1Q tags), raw IP, loopback and Linux cooked captures.
+ * Packets that don't belong to a flow, e.g. ARP packets or IPv4
+ * fragments other than the first one, are only indexed by time.
+ *
+ * \code
+ * CaptureStore store("capture.pcap", DataLinkType<EthernetII>());
+ * store.max_file_size(512 * 1024 * 1024);
+ * Sniffer sniffer("eth0");
+ * while (true) {
+ *     Packet packet = sniffer.next_packet();
+ *     store.write(packet);
+ * }
+ * \endcode
+ *
+ * This class is not available on Windows.
+ *
+ * \sa CaptureStoreReader
+ */
+class TINS_API CaptureStore {
+public:
+    /**
+     * \brief Identifies a bidirectional flow.
+     *
+     * Endpoints are sorted, so both directions of a flow yield the same
+     * key. IPv4 addresses are stored in the first 4 bytes of each address.
+     */
+    struct TINS_API FlowKey {
+        /**
+         * The type used to store each endpoint's address
+         */
+        typedef std::array<uint8_t, 16> address_type;
+
+        /**
+         * Hash functor, so keys can be used on unordered containers
+         */
+        struct Hasher {
+            size_t operator()(const FlowKey& key) const {
+                return static_cast<size_t>(key.hash());
+            }
+        };
+
+        /**
+         * Default constructor
+         */
+        FlowKey();
+
+        /**
+         * \brief Constructs a FlowKey for an IPv4 flow.
+         *
+         * \param address1 The address of one of the endpoints.
+         * \param port1 The port of that endpoint.
+         * \param address2 The address of the other endpoint.
+         * \param port2 The port of the other endpoint.
+         * \param protocol The transport protocol number, e.g. 6 for TCP.
+         */
+        FlowKey(IPv4Address address1, uint16_t port1,
+                IPv4Address address2, uint16_t port2, uint8_t protocol);
+
+        /**
+         * \brief Constructs a FlowKey for an IPv6 flow.
+         *
+         * \param address1 The address of one of the endpoints.
+         * \param port1 The port of that endpoint.
+         * \param address2 The address of the other endpoint.
+         * \param port2 The port of the other endpoint.
+         * \param protocol The transport protocol number, e.g. 6 for TCP.
+         */
+        FlowKey(const IPv6Address& address1, uint16_t port1,
+                const IPv6Address& address2, uint16_t port2, uint8_t protocol);
+
+        /**
+         * \brief Extracts the key of the flow a frame belongs to.
+         *
+         * \param buffer The frame.
+         * \param total_sz The size of the frame.
+         * \param link_type The pcap link type (DLT_*) of the frame.
+         * \param key The key in which to store the output.
+         * \return true iff the frame belongs to a flow.
+         */
+        static bool from_frame(const uint8_t* buffer, uint32_t total_sz,
+                               int link_type, FlowKey& key);
+
+        /**
+         * \brief Computes a 64 bit hash of this key.
+         *
+         * This is the value stored on index files, so it doesn't depend
+         * on the platform.
+         */
+        uint64_t hash() const;
+
+        /**
+         * Compares this key for equality
+         */
+        bool operator==(const FlowKey& rhs) const;
+
+        /**
+         * Compares this key for inequality
+         */
+        bool operator!=(const FlowKey& rhs) const {
+            return !(*this == rhs);
+        }
+
+        address_type min_address;
+        address_type max_address;
+        uint16_t min_address_port;
+        uint16_t max_address_port;
+        uint8_t protocol;
+        uint8_t ip_version;
+    };
+
+    /**
+     * \brief The type of the rotation callback.
+     *
+     * The argument is the name of the capture file that was just completed.
+     * Its index file has already been written when this is called.
+     */
+    typedef BufferedPacketWriter::rotation_callback_type rotation_callback_type;
+
+    /**
+     * The default time bucket duration.
+     */
+    static const std::chrono::seconds DEFAULT_BUCKET_DURATION;
+
+    /**
+     * The suffix appended to capture file names to build their index
+     * file names.
+     */
+    static const std::string INDEX_SUFFIX;
+
+    /**
+     * \brief Constructs a CaptureStore.
+     *
+     * Existing capture files with the same names are overwritten, and any
+     * index files left next to them by a previous run are removed.
+     *
+     * \param file_name The name of the first capture file to write.
+     * \param lt A DataLinkType that indicates the link type of the packets
+     * that will be written.
+     */
+    template<typename T>
+    CaptureStore(const std::string& file_name, const DataLinkType<T>& lt)
+    : writer_(file_name, lt) {
+        init(file_name, lt.get_type());
+    }
+
+    /**
+     * \brief Constructs a CaptureStore.
+     *
+     * \param file_name The name of the first capture file to write.
+     * \param link_type The pcap link type (DLT_*) of the packets that
+     * will be written.
+     */
+    CaptureStore(const std::string& file_name, int link_type);
+
+    /**
+     * \brief Destructor.
+     *
+     * The current file and its index are written. Errors are ignored;
+     * call CaptureStore::close to handle them.
+     */
+    ~CaptureStore();
+
+    /**
+     * \brief Sets the duration of the time buckets.
+     *
+     * Time range queries read every record in the buckets the range
+     * overlaps, so smaller buckets mean less wasted reads at the expense
+     * of larger indexes. This only affects files started afterwards.
+     *
+     * \param value The bucket duration. Must be at least 1 second.
+     */
+    void bucket_duration(std::chrono::seconds value);
+
+    /**
+     * \brief Sets the maximum size of each capture file.
+     *
+     * \sa BufferedPacketWriter::max_file_size
+     */
+    void max_file_size(uint64_t value);
+
+    /**
+     * \brief Sets the maximum time span of each capture file.
+     *
+     * \sa BufferedPacketWriter::max_file_duration
+     */
+    void max_file_duration(std::chrono::microseconds value);
+
+    /**
+     * \brief Sets the maximum amount of packets in each capture file.
+     *
+     * \sa BufferedPacketWriter::max_file_packets
+     */
+    void max_file_packets(uint64_t value);
+
+    /**
+     * \brief Sets the callback executed every time a file is completed.
+     *
+     * \param callback The callback to be set.
+     */
+    void rotation_callback(rotation_callback_type callback);
+
+    /**
+     * \brief Writes a PDU.
+     *
+     * \param pdu The PDU to be written.
+     * \param timestamp The timestamp to use on the entry for this packet.
+     */
+    void write(PDU& pdu, const Timestamp& timestamp);
+
+    /**
+     * \brief Writes a Packet, using its timestamp.
+     *
+     * If the packet holds the bytes it was captured from, those are
+     * written instead of serializing its PDU.
+     *
+     * \param packet The packet to be written.
+     */
+    void write(Packet& packet);
+
+    /**
+     * \brief Writes a serialized packet.
+     *
+     * \param buffer The serialized packet.
+     * \param total_sz The size of the serialized packet.
+     * \param timestamp The timestamp to use on the entry for this packet.
+     */
+    void write(const uint8_t* buffer, uint32_t total_sz, const Timestamp& timestamp);
+
+    /**
+     * \brief Writes a serialized packet that was truncated when captured.
+     *
+     * \param buffer The serialized packet.
+     * \param total_sz The size of the serialized packet.
+     * \param original_sz The size of the packet on the wire.
+     * \param timestamp The timestamp to use on the entry for this packet.
+     */
+    void write(const uint8_t* buffer, uint32_t total_sz, uint32_t original_sz,
+               const Timestamp& timestamp);
+
+    /**
+     * \brief Completes the current capture file and starts the next one.
+     */
+    void rotate();
+
+    /**
+     * \brief Writes the current capture file and its index and closes it.
+     *
+     * No more packets can be written afterwards.
+     */
+    void close();
+
+    /**
+     * \brief Retrieves the name of the capture file currently being written.
+     */
+    const std::string& current_file_name() const {
+        return writer_.current_file_name();
+    }
+
+    /**
+     * \brief Retrieves the amount of packets written to all files.
+     */
+    uint64_t packets_written() const {
+        return writer_.packets_written();
+    }
+private:
+    struct IndexEntry {
+        uint64_t offset;
+        uint64_t timestamp;
+    };
+
+    struct Bucket {
+        uint64_t start_offset;
+        uint64_t end_offset;
+    };
+
+    typedef std::unordered_map<FlowKey, std::vector<IndexEntry>, FlowKey::Hasher> flows_type;
+    typedef std::map<uint64_t, Bucket> buckets_type;
+
+    // You shall not copy
+    CaptureStore(const CaptureStore&);
+    CaptureStore& operator=(const CaptureStore&);
+
+    void init(const std::string& file_name, int link_type);
+    void remove_stale_indexes(const std::string& file_name);
+    void reset_index();
+    void index_record(const uint8_t* buffer, uint32_t total_sz,
+                      const Timestamp& timestamp);
+    void file_completed(const std::string& file_name);
+    void write_index(const std::string& file_name);
+
+    BufferedPacketWriter writer_;
+    int link_type_;
+    uint64_t bucket_duration_;
+    uint64_t file_bucket_duration_;
+    uint64_t first_timestamp_;
+    uint64_t last_timestamp_;
+    uint64_t entry_count_;
+    flows_type flows_;
+    buckets_type buckets_;
+    rotation_callback_type rotation_callback_;
+    PDU::serialization_type serialization_buffer_;
+};
+
+/**
+ * \class CaptureStoreReader
+ * \brief Retrieves flows and time ranges from files written by a
+ * CaptureStore.
+ *
+ * Every index file is loaded on construction. Queries then read only
+ * the matching records, seeking directly to their offsets.
+ *
+ * \code
+ * CaptureStoreReader reader("capture.pcap");
+ * CaptureStore::FlowKey key(IPv4Address("10.0.0.1"), 1337,
+ *                           IPv4Address("10.0.0.2"), 80, 6);
+ * for (const auto& record : reader.read_flow(key)) {
+ *     EthernetII packet(&record.data[0], record.data.size());
+ *     // ...
+ * }
+ * \endcode
+ *
+ * This class is not available on Windows.
+ */
+class TINS_API CaptureStoreReader {
+public:
+    /**
+     * The type used to identify flows.
+     */
+    typedef CaptureStore::FlowKey FlowKey;
+
+    /**
+     * \brief A record read from a capture file.
+     */
+    struct Record {
+        Timestamp timestamp;
+        uint32_t original_size;
+        std::vector<uint8_t> data;
+    };
+
+    /**
+     * \brief Information about a flow stored in the capture files.
+     */
+    struct FlowInfo {
+        FlowKey key;
+        uint64_t packets;
+    };
+
+    /**
+     * \brief Constructs a CaptureStoreReader.
+     *
+     * Index files are loaded starting from the one for the given capture
+     * file, up to the first missing one. If any of them is invalid, a
+     * file_read_error exception is thrown.
+     *
+     * \param file_name The name of the first capture file, as given to
+     * the CaptureStore that wrote it.
+     */
+    explicit CaptureStoreReader(const std::string& file_name);
+
+    /**
+     * \brief Retrieves the pcap link type of the stored packets.
+     */
+    int link_type() const {
+        return link_type_;
+    }
+
+    /**
+     * \brief Retrieves the amount of capture files found.
+     */
+    size_t file_count() const {
+        return files_.size();
+    }
+
+    /**
+     * \brief Retrieves every flow in the capture files.
+     */
+    std::vector<FlowInfo> flows() const;
+
+    /**
+     * \brief Reads every record that belongs to a flow.
+     *
+     * Records are returned in the order they were written.
+     *
+     * \param key The key of the flow.
+     */
+    std::vector<Record> read_flow(const FlowKey& key) const;
+
+    /**
+     * \brief Reads every record with a timestamp within [start, end).
+     *
+     * Records are returned in the order they were written.
+     *
+     * \param start The start of the time range.
+     * \param end The end of the time range.
+     */
+    std::vector<Record> read_time_range(const Timestamp& start,
+                                        const Timestamp& end) const;
+private:
+    struct FlowEntry {
+        uint64_t hash;
+        FlowKey key;
+        uint32_t first_entry;
+        uint32_t entry_count;
+    };
+
+    struct IndexEntry {
+        uint64_t offset;
+        uint64_t timestamp;
+    };
+
+    struct Bucket {
+        uint64_t bucket;
+        uint64_t start_offset;
+        uint64_t end_offset;
+    };
+
+    struct IndexFile {
+        std::string file_name;
+        uint64_t bucket_duration;
+        uint64_t first_timestamp;
+        uint64_t last_timestamp;
+        std::vector<FlowEntry> flows;
+        std::vector<IndexEntry> entries;
+        std::vector<Bucket> buckets;
+    };
+
+    void load_index(const std::string& file_name, const std::string& index_file_name);
+
+    int link_type_;
+    std::vector<IndexFile> files_;
+};
+
+} // Tins
+
+#endif // TINS_IS_CXX11 && !_WIN32
+
+#endif // TINS_CAPTURE_STORE_H
@@ -35,12 +35,21 @@
 #include <map>
 #include <string>
 #include <vector>
+#include <tins/cxxstd.h>
+#ifdef TINS_HAVE_CXX11
+    #include <unordered_map>
+#endif // TINS_HAVE_CXX11
 #ifdef TINS_HAVE_WPA2_CALLBACKS
     #include <functional>
 #endif // TINS_HAVE_WPA2_CALLBACKS
 #include <tins/macros.h>
 #include <tins/handshake_capturer.h>
 
+#ifdef TINS_HAVE_WPA2_DECRYPTION
+// OpenSSL's EVP_CIPHER_CTX
+struct evp_cipher_ctx_st;
+#endif // TINS_HAVE_WPA2_DECRYPTION
+
 namespace Tins {
 
 class PDU;
@@ -103,9 +112,64 @@ public:
      */
     SessionKeys(const RSNHandshake& hs, const pmk_type& pmk);
 
+    /**
+     * \brief Copy constructor.
+     */
+    SessionKeys(const SessionKeys& other);
+
+    /**
+     * \brief Copy assignment operator.
+     */
+    SessionKeys& operator=(const SessionKeys& other);
+
+    /**
+     * \brief Destructor.
+     */
+    ~SessionKeys();
+
     /**
      * \brief Decrypts a unicast packet.
      *
+     * When using CCMP, the AES key schedule is computed once, when this
+     * object is constructed, and kept along with the cipher context. That
+     * context is updated on every packet, which is why this overload isn't
+     * const. To decrypt packets from several threads at the same time,
+     * use a copy of this object on each thread.
+     *
+     * \param dot11 The encrypted packet to decrypt.
+     * \param raw The raw layer on the packet to decrypt.
+     * \return A SNAP layer containing the decrypted traffic or a null pointer
+     * if decryption failed.
+     */
+    SNAP* decrypt_unicast(const Dot11Data& dot11, RawPDU& raw);
+
+    /**
+     * \brief Decrypts a unicast data frame in place.
+     *
+     * The decrypted payload, which starts with its LLC/SNAP header, is
+     * written over the encrypted one, right after the frame's 802.11
+     * header. The protected flag in the frame control field is cleared if
+     * decryption succeeds. The rest of the buffer is left as is.
+     *
+     * The same threading considerations as in the other decrypt_unicast
+     * overload apply.
+     *
+     * \param buffer The frame, starting at the 802.11 header and without
+     * the FCS.
+     * \param total_sz The size of the frame.
+     * \param plaintext Set to point to the decrypted payload on success.
+     * \param plaintext_size Set to the decrypted payload's size on success.
+     * \return true iff decryption succeeded.
+     */
+    bool decrypt_unicast(uint8_t* buffer, uint32_t total_sz, uint8_t*& plaintext,
+                         uint32_t& plaintext_size);
+
+    /**
+     * \brief Decrypts a unicast packet.
+     *
+     * This overload builds a temporary cipher context on every call, so
+     * it's slower than the non-const one when using CCMP.
+     *
      * \param dot11 The encrypted packet to decrypt.
      * \param raw The raw layer on the packet to decrypt.
      * \return A SNAP layer containing the decrypted traffic or a null pointer
@@ -113,6 +177,22 @@ public:
      */
     SNAP* decrypt_unicast(const Dot11Data& dot11, RawPDU& raw) const;
 
+    /**
+     * \brief Decrypts a unicast data frame in place.
+     *
+     * This overload builds a temporary cipher context on every call, so
+     * it's slower than the non-const one when using CCMP.
+     *
+     * \param buffer The frame, starting at the 802.11 header and without
+     * the FCS.
+     * \param total_sz The size of the frame.
+     * \param plaintext Set to point to the decrypted payload on success.
+     * \param plaintext_size Set to the decrypted payload's size on success.
+     * \return true iff decryption succeeded.
+     */
+    bool decrypt_unicast(uint8_t* buffer, uint32_t total_sz, uint8_t*& plaintext,
+                         uint32_t& plaintext_size) const;
+
     /**
      * \brief Gets the PTK for this session keys.
      * \return The Pairwise Transcient Key.
@@ -125,11 +205,20 @@ public:
      */
     bool uses_ccmp() const;
 private:
-    SNAP* ccmp_decrypt_unicast(const Dot11Data& dot11, RawPDU& raw) const;
-    SNAP* tkip_decrypt_unicast(const Dot11Data& dot11, RawPDU& raw) const;
+    struct frame_info;
+
+    static void make_frame_info(const Dot11Data& dot11, frame_info& info);
+    void init_ccmp_context();
+    bool decrypt(const frame_info& info, uint8_t* payload, uint32_t payload_size,
+                 uint32_t& plaintext_size);
+    bool ccmp_decrypt(const frame_info& info, uint8_t* payload, uint32_t payload_size,
+                      uint32_t& plaintext_size);
+    bool tkip_decrypt(const frame_info& info, uint8_t* payload, uint32_t payload_size,
+                      uint32_t& plaintext_size) const;
 
     ptk_type ptk_;
     bool is_ccmp_;
+    evp_cipher_ctx_st* ccmp_context_;
 };
 
 /**
@@ -152,6 +241,13 @@ public:
      * \param ssid The access point's SSID.
      */
     SupplicantData(const std::string& psk, const std::string& ssid);
+
+    /**
+     * \brief Constructs a SupplicantData using an already computed PMK.
+     * \param pmk The PMK derived from the pre-shared key and the SSID.
+     * \param ssid The access point's SSID.
+     */
+    SupplicantData(const pmk_type& pmk, const std::string& ssid);
     
     /**
      * \brief Getter for the PMK.
@@ -169,9 +265,127 @@ private:
     std::string ssid_;
 };
 
+/**
+ * \brief Stores PMKs so they don't have to be derived again.
+ *
+ * Deriving a PMK from a pre-shared key takes 4096 iterations of
+ * HMAC-SHA1, which adds up when loading many networks. This class maps
+ * each SSID and pre-shared key pair to its PMK and can be saved to and
+ * loaded from a file, so later runs don't have to derive them again.
+ * Pre-shared keys themselves are never stored, only their SHA-256 hashes.
+ *
+ * \sa WPA2Decrypter::add_ap_data
+ */
+class TINS_API PMKCache {
+public:
+    /**
+     * The type used to store the PMK.
+     */
+    typedef SessionKeys::pmk_type pmk_type;
+
+    /**
+     * \brief Default constructs an empty cache.
+     */
+    PMKCache();
+
+    /**
+     * \brief Constructs a cache by loading the given file.
+     *
+     * \param file_name The name of the file to load.
+     * \sa PMKCache::load
+     */
+    explicit PMKCache(const std::string& file_name);
+
+    /**
+     * \brief Loads the entries in the given file.
+     *
+     * Entries are added to the ones already in this cache.
+     *
+     * \param file_name The name of the file to load.
+     * \throw file_open_error If the file can't be opened.
+     * \throw file_read_error If the file's contents are not valid.
+     */
+    void load(const std::string& file_name);
+
+    /**
+     * \brief Saves every entry in this cache to the given file.
+     *
+     * The file is first written under a temporary name and then renamed,
+     * so an existing cache is never left partially written. Since the 
+     * file contains PMKs, it's created so that only its owner can read it.
+     *
+     * \param file_name The name of the file to write.
+     * \throw file_open_error If the file can't be created.
+     * \throw file_write_error If writing the file fails.
+     */
+    void save(const std::string& file_name) const;
+
+    /**
+     * \brief Looks up the PMK for a pre-shared key and SSID.
+     *
+     * \param psk The pre-shared key.
+     * \param ssid The access point's SSID.
+     * \param pmk The PMK is stored here if found.
+     * \return true iff the PMK was found.
+     */
+    bool find(const std::string& psk, const std::string& ssid, pmk_type& pmk) const;
+
+    /**
+     * \brief Stores the PMK for a pre-shared key and SSID.
+     *
+     * Entries whose SSID is longer than 255 bytes or whose PMK is not 
+     * PMK_SIZE bytes long can't be stored.
+     *
+     * \param psk The pre-shared key.
+     * \param ssid The access point's SSID.
+     * \param pmk The PMK derived from them.
+     * \return true iff the entry was stored.
+     */
+    bool insert(const std::string& psk, const std::string& ssid, const pmk_type& pmk);
+
+    /**
+     * \brief Getter for the amount of entries in this cache.
+     */
+    size_t size() const;
+private:
+    // The SSID and the hashed pre-shared key
+    typedef std::pair<std::string, std::string> key_type;
+    typedef std::map<key_type, pmk_type> pmks_map;
+
+    static key_type make_key(const std::string& psk, const std::string& ssid);
+
+    pmks_map pmks_;
+};
+
 } // WPA2
 #endif // TINS_HAVE_WPA2_DECRYPTION
 
+/**
+ * \brief A frame to be decrypted in place by the batch decryption methods.
+ *
+ * The buffer should contain the frame, starting at the 802.11 header and
+ * without the FCS. After decryption, plaintext and plaintext_size describe
+ * the decrypted payload, or are set to a null pointer and 0 if the frame
+ * couldn't be decrypted.
+ */
+struct InPlaceFrame {
+    /**
+     * \brief Constructs an InPlaceFrame.
+     *
+     * \param buffer The frame to be decrypted.
+     * \param size The size of the frame.
+     */
+    InPlaceFrame(uint8_t* buffer = 0, uint32_t size = 0)
+    : buffer(buffer), size(size), plaintext(0), plaintext_size(0) {
+
+    }
+
+    uint8_t* buffer;
+    uint32_t size;
+    uint8_t* plaintext;
+    uint32_t plaintext_size;
+};
+
 /**
  * \brief Decrypts WEP-encrypted traffic.
  */
@@ -215,10 +429,49 @@ public:
      * failed, true otherwise.
      */
     bool decrypt(PDU& pdu);
+
+    /**
+     * \brief Decrypts a frame in place.
+     *
+     * This is a lighter alternative to WEPDecrypter::decrypt for callers
+     * that only want the decrypted bytes. The decrypted payload, which 
+     * starts with its LLC/SNAP header, is written over the IV, right after
+     * the frame's 802.11 header, and the protected flag is cleared. Frames
+     * that aren't protected data frames are left intact.
+     *
+     * \param buffer The frame, starting at the 802.11 header and without
+     * the FCS.
+     * \param total_sz The size of the frame.
+     * \param plaintext Set to point to the decrypted payload on success.
+     * \param plaintext_size Set to the decrypted payload's size on success.
+     * \return true iff the frame was decrypted.
+     */
+    bool decrypt_in_place(uint8_t* buffer, uint32_t total_sz, uint8_t*& plaintext,
+                          uint32_t& plaintext_size);
+
+    /**
+     * \brief Decrypts several frames in place.
+     *
+     * Each frame is decrypted as in the single frame overload. The password
+     * found for a frame is reused for the following ones as long as they
+     * belong to the same access point, so batches work best when frames
+     * from the same network are kept together.
+     *
+     * \param frames The frames to be decrypted.
+     * \param count The amount of frames.
+     * \return The amount of frames that were decrypted.
+     */
+    size_t decrypt_in_place(InPlaceFrame* frames, size_t count);
 private:
     typedef std::map<address_type, std::string> passwords_type;
 
+    struct password_cache;
+
     PDU* decrypt(RawPDU& raw, const std::string& password);
+    bool do_decrypt_in_place(uint8_t* buffer, uint32_t total_sz, uint8_t*& plaintext,
+                             uint32_t& plaintext_size, password_cache* cache);
+    bool decrypt_payload(uint8_t* payload, uint32_t payload_size,
+                         const std::string& password, uint32_t& plaintext_size);
 
     passwords_type passwords_;
     std::vector<uint8_t> key_buffer_;
@@ -259,6 +512,17 @@ public:
      */
     typedef std::map<addr_pair, WPA2::SessionKeys> keys_map;
 
+    /**
+     * \brief A PSK along with the SSID of the network it belongs to.
+     */
+    struct ap_credentials {
+        ap_credentials(const std::string& psk, const std::string& ssid)
+        : psk(psk), ssid(ssid) { }
+
+        std::string psk;
+        std::string ssid;
+    };
+
     #ifdef TINS_HAVE_WPA2_CALLBACKS
 
     /**
@@ -285,6 +549,21 @@ public:
     
     #endif // TINS_HAVE_WPA2_CALLBACKS
 
+    /**
+     * \brief Default constructs a WPA2Decrypter.
+     */
+    WPA2Decrypter();
+
+    /**
+     * \brief Copy constructor.
+     */
+    WPA2Decrypter(const WPA2Decrypter& other);
+
+    /**
+     * \brief Copy assignment operator.
+     */
+    WPA2Decrypter& operator=(const WPA2Decrypter& other);
+
     /**
      * \brief Adds an access points's information.
      *
@@ -322,6 +601,26 @@ public:
     void add_ap_data(const std::string& psk,
                      const std::string& ssid,
                      const address_type& addr);
+
+    /**
+     * \brief Adds many access points' information at once.
+     *
+     * This is the same as calling add_ap_data(psk, ssid) for each of the
+     * provided credentials, but PMKs are derived in parallel.
+     *
+     * If a cache is provided, PMKs found in it are used rather than
+     * derived again, and the ones that had to be derived are added to it.
+     * The cache can then be saved so later runs load them right away.
+     *
+     * \param credentials The PSKs and SSIDs of the networks to add.
+     * \param cache The cache to use, or a null pointer to always derive
+     * the PMKs.
+     * \param thread_count The amount of threads used to derive PMKs. If
+     * this is 0, one thread per hardware thread is used.
+     */
+    void add_ap_data(const std::vector<ap_credentials>& credentials,
+                     WPA2::PMKCache* cache = 0,
+                     size_t thread_count = 0);
     
     /**
      * \brief Explicitly add decryption keys.
@@ -363,6 +662,45 @@ public:
      */
     bool decrypt(PDU& pdu);
 
+    /**
+     * \brief Decrypts a frame in place.
+     *
+     * This is a lighter alternative to WPA2Decrypter::decrypt for callers
+     * that only want the decrypted bytes. Protected data frames are
+     * decrypted within the provided buffer, without parsing them into
+     * PDUs. See WPA2::SessionKeys::decrypt_unicast for details on where
+     * the decrypted payload is written.
+     *
+     * Beacons and EAPOL frames should be provided as well, since they're
+     * used to find access points and capture handshakes. They are parsed
+     * and processed as in WPA2Decrypter::decrypt, and this returns false
+     * for them.
+     *
+     * \param buffer The frame, starting at the 802.11 header and without
+     * the FCS.
+     * \param total_sz The size of the frame.
+     * \param plaintext Set to point to the decrypted payload on success.
+     * \param plaintext_size Set to the decrypted payload's size on success.
+     * \return true iff the frame was decrypted.
+     */
+    bool decrypt_in_place(uint8_t* buffer, uint32_t total_sz, uint8_t*& plaintext,
+                          uint32_t& plaintext_size);
+
+    /**
+     * \brief Decrypts several frames in place.
+     *
+     * Each frame is processed as in the single frame overload, in order,
+     * so handshakes found in a batch are used to decrypt the frames that
+     * follow them. The keys found for a frame are reused for the following
+     * ones as long as they're sent between the same addresses, so batches
+     * work best when frames from the same conversation are kept together.
+     *
+     * \param frames The frames to be decrypted.
+     * \param count The amount of frames.
+     * \return The amount of frames that were decrypted.
+     */
+    size_t decrypt_in_place(InPlaceFrame* frames, size_t count);
+
     #ifdef TINS_HAVE_WPA2_CALLBACKS
     /**
      * \brief Sets the handshake captured callback
@@ -399,6 +737,35 @@ public:
 private:
     typedef std::map<std::string, WPA2::SupplicantData> pmks_map;
     typedef std::map<address_type, WPA2::SupplicantData> bssids_map;
+    // Both addresses in a pair, packed into integers and sorted
+    typedef std::pair<uint64_t, uint64_t> packed_addr_pair;
+
+    struct packed_addr_pair_hash {
+        size_t operator()(const packed_addr_pair& addresses) const {
+            const uint64_t value = addresses.first * 0x9e3779b97f4a7c15ULL ^ addresses.second;
+            return static_cast<size_t>(value ^ (value >> 32));
+        }
+    };
+
+    // Points to the keys stored in keys_. The layout can't depend on
+    // TINS_IS_CXX11, as that depends on how the application including this
+    // header is built
+    #ifdef TINS_HAVE_CXX11
+        typedef std::unordered_map<packed_addr_pair, WPA2::SessionKeys*,
+                                   packed_addr_pair_hash> keys_index;
+    #else
+        typedef std::map<packed_addr_pair, WPA2::SessionKeys*> keys_index;
+    #endif // TINS_HAVE_CXX11
+
+    struct keys_cache;
+
+    static packed_addr_pair pack_addr_pair(const uint8_t* addr1, const uint8_t* addr2);
+    WPA2::SessionKeys* find_keys(bool to_ds, bool from_ds, const uint8_t* addr1,
+                                 const uint8_t* addr2, const uint8_t* addr3);
+    void store_keys(const addr_pair& addresses, const WPA2::SessionKeys& session_keys);
+    void index_keys();
+    bool do_decrypt_in_place(uint8_t* buffer, uint32_t total_sz, uint8_t*& plaintext,
+                             uint32_t& plaintext_size, keys_cache* cache);
     
     void try_add_keys(const Dot11Data& dot11, const RSNHandshake& hs);
     addr_pair make_addr_pair(const address_type& addr1, const address_type& addr2) {
@@ -407,7 +774,6 @@ private:
             std::make_pair(addr2, addr1);
     }
     addr_pair extract_addr_pair(const Dot11Data& dot11);
-    addr_pair extract_addr_pair_dst(const Dot11Data& dot11);
     bssids_map::const_iterator find_ap(const Dot11Data& dot11);
     void add_access_point(const std::string& ssid, const address_type& addr);
 
@@ -415,6 +781,8 @@ private:
     pmks_map pmks_;
     bssids_map aps_;
     keys_map keys_;
+    // Used to look up the keys in keys_ when decrypting
+    keys_index keys_index_;
     #ifdef TINS_HAVE_WPA2_CALLBACKS
         handshake_captured_callback_type handshake_captured_callback_;
         ap_found_callback_type ap_found_callback_;
@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/config.h>
+
+#ifndef TINS_DECRYPTION_PIPELINE_H
+#define TINS_DECRYPTION_PIPELINE_H
+
+#if defined(TINS_HAVE_DOT11) && defined(TINS_HAVE_WPA2_CALLBACKS)
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <tins/crypto.h>
+#include <tins/packet.h>
+#include <tins/macros.h>
+
+namespace Tins {
+namespace Crypto {
+
+/**
+ * \brief Decrypts WPA2 traffic using several worker threads.
+ *
+ * Frames are handed over to DecryptionPipeline::process, which must
+ * always be called from the same thread. Each frame is assigned to a
+ * shard based on the pair of station addresses it's sent between (the
+ * same pair that's used to look up its session keys), and every shard
+ * is decrypted by a single worker thread. This means frames exchanged
+ * between an access point and one of its clients are always decrypted
+ * in the order they were processed in.
+ *
+ * Beacons and handshakes are handled on the calling thread by a
+ * WPA2Decrypter. Whenever a handshake is captured, the new session keys
+ * are queued to the worker that owns the address pair, right before the
+ * frame that completed the handshake. Workers keep their own copy of
+ * the keys, so no key state is shared among threads and frames processed
+ * after a handshake are always decrypted using its keys.
+ *
+ * Every processed frame, decrypted or not, is handed to the output
+ * callback. Depending on the output mode, this happens either:
+ *
+ * - DecryptionPipeline::ORDERED: on a single consumer thread, in the same
+ *   order the frames were processed in.
+ * - DecryptionPipeline::PER_SHARD: on each shard's worker thread, right
+ *   after the frame is decrypted. This avoids reordering frames, but the
+ *   callback can be executed concurrently by several threads and only
+ *   the frames within a shard keep their order.
+ *
+ * \code
+ * DecryptionPipeline pipeline(4, DecryptionPipeline::ORDERED,
+ *     [&](Packet& packet, bool decrypted) {
+ *         // Handle the packet
+ *     });
+ * pipeline.add_ap_data("passphrase", "MyNetwork");
+ * sniffer.sniff_loop([&](Packet& packet) {
+ *     pipeline.process(std::move(packet));
+ *     return true;
+ * });
+ * pipeline.stop();
+ * \endcode
+ *
+ * If the output callback throws, the pipeline keeps decrypting frames but
+ * stops executing the callback. The exception is rethrown by
+ * DecryptionPipeline::flush or DecryptionPipeline::stop.
+ */
+class TINS_API DecryptionPipeline {
+public:
+    /**
+     * The ways decrypted frames can be handed to the output callback.
+     */
+    enum OutputMode {
+        ORDERED,
+        PER_SHARD
+    };
+
+    /**
+     * \brief The type of the output callback.
+     *
+     * The first argument is the processed packet, while the second one
+     * indicates whether it was decrypted. The packet's raw frame, if any,
+     * is only discarded when the frame was decrypted.
+     */
+    typedef std::function<void(Packet&, bool)> output_callback_type;
+
+    /**
+     * The default amount of frames that can be queued on each worker.
+     */
+    static const size_t DEFAULT_QUEUE_SIZE;
+
+    /**
+     * \brief Constructs a DecryptionPipeline and starts its threads.
+     *
+     * \param thread_count The amount of worker threads. If this is 0, then
+     * one worker per hardware thread is used.
+     * \param mode The output mode.
+     * \param callback The callback executed for every processed frame.
+     * \param queue_size The amount of frames that can be queued on each
+     * worker before DecryptionPipeline::process blocks.
+     */
+    DecryptionPipeline(size_t thread_count, OutputMode mode,
+                       const output_callback_type& callback,
+                       size_t queue_size = DEFAULT_QUEUE_SIZE);
+
+    /**
+     * \brief Destructor.
+     *
+     * Every queued frame is processed before the threads are stopped.
+     * Errors are ignored; call DecryptionPipeline::stop to handle them.
+     */
+    ~DecryptionPipeline();
+
+    /**
+     * \brief Adds an access point's information.
+     *
+     * \sa WPA2Decrypter::add_ap_data
+     * \param psk The PSK associated with the SSID.
+     * \param ssid The network's SSID.
+     */
+    void add_ap_data(const std::string& psk, const std::string& ssid);
+
+    /**
+     * \brief Adds an access point's information, including its BSSID.
+     *
+     * \sa WPA2Decrypter::add_ap_data
+     * \param psk The PSK associated with this SSID.
+     * \param ssid The network's SSID.
+     * \param addr The access point's BSSID.
+     */
+    void add_ap_data(const std::string& psk,
+                     const std::string& ssid,
+                     const WPA2Decrypter::address_type& addr);
+
+    /**
+     * \brief Explicitly add decryption keys.
+     *
+     * Frames processed after this call are decrypted using these keys.
+     *
+     * \param addresses The address pair (client, access point) to add.
+     * \param session_keys The keys to use when decrypting messages sent
+     * between the given addresses.
+     */
+    void add_decryption_keys(const WPA2Decrypter::addr_pair& addresses,
+                             const WPA2::SessionKeys& session_keys);
+
+    /**
+     * \brief Sets the handshake captured callback.
+     *
+     * This is executed on the thread calling DecryptionPipeline::process.
+     *
+     * \sa WPA2Decrypter::handshake_captured_callback
+     * \param callback The new callback to be set.
+     */
+    void handshake_captured_callback(
+        const WPA2Decrypter::handshake_captured_callback_type& callback);
+
+    /**
+     * \brief Queues a frame to be decrypted.
+     *
+     * This blocks while the queue of the frame's shard is full.
+     *
+     * \param packet The packet to be processed.
+     * \return false iff the pipeline was already stopped.
+     */
+    bool process(Packet packet);
+
+    /**
+     * \brief Waits until every processed frame has been handed to the
+     * output callback.
+     *
+     * If the output callback threw, the exception is rethrown.
+     */
+    void flush();
+
+    /**
+     * \brief Processes every queued frame and stops the threads.
+     *
+     * If the output callback threw, the exception is rethrown. No more
+     * frames can be processed afterwards.
+     */
+    void stop();
+
+    /**
+     * \brief Retrieves the amount of worker threads.
+     */
+    size_t thread_count() const {
+        return workers_.size();
+    }
+
+    /**
+     * \brief Retrieves the keys captured so far.
+     *
+     * \sa WPA2Decrypter::get_keys
+     */
+    const WPA2Decrypter::keys_map& get_keys() const {
+        return decrypter_.get_keys();
+    }
+private:
+    struct Task {
+        Task() : sequence(0) { }
+
+        Packet packet;
+        uint64_t sequence;
+        // Set when this task installs keys rather than decrypting a frame
+        std::unique_ptr<std::pair<WPA2Decrypter::addr_pair, WPA2::SessionKeys> > keys;
+    };
+
+    struct Worker {
+        Worker() : stopping(false) { }
+
+        std::deque<Task> tasks;
+        std::mutex mutex;
+        std::condition_variable task_condition;
+        std::condition_variable space_condition;
+        bool stopping;
+        WPA2Decrypter decrypter;
+        std::thread thread;
+    };
+
+    struct ReorderSlot {
+        ReorderSlot() : decrypted(false), ready(false) { }
+
+        Packet packet;
+        bool decrypted;
+        bool ready;
+    };
+
+    // You shall not copy
+    DecryptionPipeline(const DecryptionPipeline&);
+    DecryptionPipeline& operator=(const DecryptionPipeline&);
+
+    static size_t shard_hash(const uint8_t* addr1, const uint8_t* addr2);
+    void on_handshake_captured(const std::string& ssid,
+                               const WPA2Decrypter::address_type& bssid,
+                               const WPA2Decrypter::address_type& client);
+    void enqueue_keys(const WPA2Decrypter::addr_pair& addresses,
+                      const WPA2::SessionKeys& session_keys);
+    void enqueue(Worker& worker, Task task);
+    void run_worker(Worker& worker);
+    void run_consumer();
+    void deliver(Packet& packet, bool decrypted);
+    void frames_delivered(size_t count);
+    void shutdown();
+
+    OutputMode mode_;
+    output_callback_type callback_;
+    size_t queue_size_;
+    WPA2Decrypter decrypter_;
+    WPA2Decrypter::handshake_captured_callback_type handshake_captured_callback_;
+    std::vector<std::unique_ptr<Worker> > workers_;
+    bool running_;
+    uint64_t next_sequence_;
+    // The last value of delivered_frames_ seen by the calling thread
+    uint64_t known_delivered_frames_;
+    std::atomic<bool> failed_;
+    // Guards everything below
+    std::mutex output_mutex_;
+    std::condition_variable ready_condition_;
+    std::condition_variable delivered_condition_;
+    std::vector<ReorderSlot> reorder_slots_;
+    uint64_t delivered_frames_;
+    bool stopping_;
+    std::exception_ptr error_;
+    std::thread consumer_;
+};
+
+} // Crypto
+} // Tins
+
+#endif // TINS_HAVE_DOT11 && TINS_HAVE_WPA2_CALLBACKS
+
+#endif // TINS_DECRYPTION_PIPELINE_H
@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_FRAGMENT_HELPERS_H
+#define TINS_FRAGMENT_HELPERS_H
+
+#include <map>
+#include <list>
+#include <vector>
+#include <utility>
+#include <stdint.h>
+#include <tins/macros.h>
+
+/**
+ * \cond
+ */
+namespace Tins {
+
+class PDU;
+class Timestamp;
+
+namespace Internals {
+
+// Converts a timestamp into microseconds
+uint64_t timestamp_to_microseconds(const Timestamp& timestamp);
+
+// Assembles the payload of a fragmented datagram. Every fragment is copied
+// straight into its final position within a single buffer. When fragments
+// overlap, the data received first is kept.
+class TINS_API FragmentBuffer {
+public:
+    // The maximum size of a reassembled payload
+    static const uint32_t MAX_DATAGRAM_SIZE;
+
+    FragmentBuffer();
+
+    // Adds a fragment. Returns false if the fragment is inconsistent with the
+    // ones seen so far, e.g. if it goes past the end of the datagram, or if
+    // it ends past MAX_DATAGRAM_SIZE.
+    bool add_fragment(uint32_t offset, const uint8_t* data, uint32_t size,
+                      bool last_fragment);
+    bool add_fragment(uint32_t offset, PDU& payload, bool last_fragment);
+    // Returns true if no fragment was added
+    bool empty() const;
+    bool is_complete() const;
+    const std::vector<uint8_t>& payload() const;
+    // The amount of heap memory used by this buffer
+    size_t memory_usage() const;
+private:
+    typedef std::vector<std::pair<uint32_t, uint32_t> > ranges_type;
+
+    bool is_covered(uint32_t first, uint32_t last) const;
+    void copy_missing(uint32_t first, uint32_t last, const uint8_t* data);
+    void add_range(uint32_t first, uint32_t last);
+
+    std::vector<uint8_t> buffer_;
+    // Sorted, non adjacent [first, last) ranges that were received
+    ranges_type ranges_;
+    uint32_t total_size_;
+    bool received_end_;
+};
+
+// Keeps track of datagrams being reassembled. Datagrams are expired once 
+// they're older than the configured timeout and the oldest ones are evicted
+// whenever the amount of datagrams or their memory usage goes above the 
+// configured limits.
+//
+// Datagram must provide a memory_usage() member function.
+template <typename Key, typename Datagram>
+class FragmentCache {
+private:
+    typedef std::list<Key> order_type;
+
+    struct Entry {
+        Entry(uint64_t created_at) 
+        : created_at(created_at), memory_usage(0) {
+
+        }
+
+        Datagram datagram;
+        typename order_type::iterator order_iterator;
+        uint64_t created_at;
+        size_t memory_usage;
+    };
+
+    typedef std::map<Key, Entry> entries_type;
+public:
+    typedef typename entries_type::iterator iterator;
+
+    FragmentCache(uint64_t timeout, size_t max_datagrams, size_t max_memory)
+    : memory_usage_(0), expired_datagrams_(0), evicted_datagrams_(0),
+      max_datagrams_(max_datagrams), max_memory_(max_memory), timeout_(timeout) {
+
+    }
+
+    // Removes every datagram created at or before now - timeout
+    void expire(uint64_t now) {
+        while (!order_.empty()) {
+            iterator oldest = entries_.find(order_.front());
+            if (oldest->second.created_at + timeout_ > now) {
+                break;
+            }
+            erase(oldest);
+            ++expired_datagrams_;
+        }
+    }
+
+    // Finds the datagram for the given key, creating it if it doesn't exist
+    iterator find_or_insert(const Key& key, uint64_t now) {
+        iterator iter = entries_.find(key);
+        if (iter != entries_.end()) {
+            return iter;
+        }
+        if (max_datagrams_ > 0) {
+            while (entries_.size() >= max_datagrams_) {
+                evict_oldest();
+            }
+        }
+        iter = entries_.insert(std::make_pair(key, Entry(now))).first;
+        iter->second.order_iterator = order_.insert(order_.end(), key);
+        iter->second.memory_usage = iter->second.datagram.memory_usage();
+        memory_usage_ += iter->second.memory_usage;
+        return iter;
+    }
+
+    // Must be called after a datagram is modified. Evicts the oldest 
+    // datagrams if the memory limit is exceeded. Returns false if the given
+    // datagram itself had to be evicted.
+    bool update_memory_usage(iterator iter) {
+        memory_usage_ -= iter->second.memory_usage;
+        iter->second.memory_usage = iter->second.datagram.memory_usage();
+        memory_usage_ += iter->second.memory_usage;
+        if (max_memory_ == 0) {
+            return true;
+        }
+        while (memory_usage_ > max_memory_ && 
+               order_.begin() != iter->second.order_iterator) {
+            evict_oldest();
+        }
+        if (memory_usage_ > max_memory_) {
+            evict_oldest();
+            return false;
+        }
+        return true;
+    }
+
+    void erase(iterator iter) {
+        memory_usage_ -= iter->second.memory_usage;
+        order_.erase(iter->second.order_iterator);
+        entries_.erase(iter);
+    }
+
+    void erase(const Key& key) {
+        iterator iter = entries_.find(key);
+        if (iter != entries_.end()) {
+            erase(iter);
+        }
+    }
+
+    void clear() {
+        order_.clear();
+        entries_.clear();
+        memory_usage_ = 0;
+    }
+
+    size_t size() const {
+        return entries_.size();
+    }
+
+    size_t memory_usage() const {
+        return memory_usage_;
+    }
+
+    uint64_t expired_datagrams() const {
+        return expired_datagrams_;
+    }
+
+    uint64_t evicted_datagrams() const {
+        return evicted_datagrams_;
+    }
+
+    uint64_t timeout() const {
+        return timeout_;
+    }
+
+    void timeout(uint64_t value) {
+        timeout_ = value;
+    }
+
+    size_t max_datagrams() const {
+        return max_datagrams_;
+    }
+
+    void max_datagrams(size_t value) {
+        max_datagrams_ = value;
+    }
+
+    size_t max_memory() const {
+        return max_memory_;
+    }
+
+    void max_memory(size_t value) {
+        max_memory_ = value;
+    }
+private:
+    void evict_oldest() {
+        erase(entries_.find(order_.front()));
+        ++evicted_datagrams_;
+    }
+
+    entries_type entries_;
+    // Keys of the datagrams, sorted by creation time
+    order_type order_;
+    size_t memory_usage_;
+    uint64_t expired_datagrams_;
+    uint64_t evicted_datagrams_;
+    size_t max_datagrams_;
+    size_t max_memory_;
+    uint64_t timeout_;
+};
+
+} // Internals
+} // Tins
+/**
+ * \endcond
+ */
+
+#endif // TINS_FRAGMENT_HELPERS_H
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_SHARED_FRAME_H
+#define TINS_SHARED_FRAME_H
+
+#include <vector>
+#include <stdint.h>
+#include <tins/macros.h>
+
+/**
+ * \cond
+ */
+namespace Tins {
+namespace Internals {
+
+// An immutable, reference counted copy of a captured frame. Copies share
+// the same bytes, so copying is cheap and never mutates the source.
+class TINS_API SharedFrame {
+public:
+    typedef std::vector<uint8_t> buffer_type;
+
+    SharedFrame();
+    SharedFrame(const uint8_t* buffer, uint32_t total_sz);
+    // original_sz is the frame's size on the wire, which is larger than
+    // total_sz if the frame was truncated when captured
+    SharedFrame(const uint8_t* buffer, uint32_t total_sz, uint32_t original_sz);
+    SharedFrame(const SharedFrame& rhs);
+    SharedFrame& operator=(const SharedFrame& rhs);
+    ~SharedFrame();
+
+    void swap(SharedFrame& rhs) {
+        Storage* tmp = storage_;
+        storage_ = rhs.storage_;
+        rhs.storage_ = tmp;
+    }
+
+    bool empty() const {
+        return storage_ == 0;
+    }
+
+    // Returns an empty buffer if there's no frame
+    const buffer_type& buffer() const;
+    // Returns 0 if there's no frame
+    uint32_t original_size() const;
+    void clear();
+private:
+    struct Storage;
+
+    void release();
+
+    Storage* storage_;
+};
+
+} // Internals
+} // Tins
+/**
+ * \endcond
+ */
+
+#endif // TINS_SHARED_FRAME_H
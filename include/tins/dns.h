@@ -621,6 +621,267 @@ public:
     typedef std::vector<resource> resources_type;
     typedef IPv4Address address_type;
     typedef IPv6Address address_v6_type;
+
+    /**
+     * \brief The sections records can be found in.
+     */
+    enum SectionType {
+        QUESTIONS,
+        ANSWERS,
+        AUTHORITY,
+        ADDITIONAL
+    };
+
+    class record_view;
+    class record_cursor;
+
+    /**
+     * \brief A reference to a domain name inside a DNS PDU.
+     *
+     * The name is not decompressed until it's requested, either into a
+     * buffer provided by the caller or by comparing it against another
+     * name label by label. Neither of these allocate memory.
+     *
+     * A name_view is only valid as long as the DNS PDU it was taken from
+     * is alive and not modified.
+     */
+    class TINS_API name_view {
+    public:
+        /**
+         * The size of a buffer that can hold any decompressed name,
+         * including the null terminator.
+         */
+        static const size_t MAX_NAME_SIZE = 256;
+
+        /**
+         * \brief Default constructor.
+         *
+         * This constructs an empty name view.
+         */
+        name_view() : records_(0), records_size_(0), offset_(0) { }
+
+        /**
+         * \brief Decompresses this name into a buffer.
+         *
+         * The output is a null terminated dotted name, e.g.
+         * "www.example.com". If the name doesn't fit in the buffer, a
+         * std::length_error exception is thrown. A buffer of
+         * MAX_NAME_SIZE bytes can hold any valid name.
+         *
+         * \param buffer The output buffer.
+         * \param buffer_size The size of the output buffer.
+         * \return The length of the name, not including the null terminator.
+         */
+        size_t decode(char* buffer, size_t buffer_size) const;
+
+        /**
+         * \brief Compares this name against a dotted domain name.
+         *
+         * The comparison is case insensitive, as mandated by RFC 4343,
+         * and a trailing dot in the given name is ignored.
+         *
+         * \param name The dotted domain name, e.g. "www.example.com".
+         */
+        bool matches(const char* name) const;
+
+        /**
+         * \brief Compares this name against a dotted domain name.
+         *
+         * \sa name_view::matches(const char*) const
+         */
+        bool matches(const std::string& name) const {
+            return matches(name.c_str());
+        }
+
+        /**
+         * \brief Compares this name against an encoded label sequence.
+         *
+         * The sequence must not contain offset labels, e.g. the output of
+         * DNS::encode_domain_name. The comparison is case insensitive.
+         *
+         * \param labels The encoded name, e.g. "\x03www\x07example\x03com\x00".
+         */
+        bool matches_labels(const uint8_t* labels) const;
+
+        /**
+         * \brief Decompresses this name into a string.
+         *
+         * This allocates; use name_view::decode on hot paths.
+         */
+        std::string to_string() const;
+    private:
+        friend class record_view;
+        friend class record_cursor;
+
+        name_view(const uint8_t* records, uint32_t records_size, uint32_t offset)
+        : records_(records), records_size_(records_size), offset_(offset) { }
+
+        const uint8_t* records_;
+        uint32_t records_size_;
+        uint32_t offset_;
+    };
+
+    /**
+     * \brief A lightweight view of a record inside a DNS PDU.
+     *
+     * Record views are produced by a record_cursor. Fields are read from
+     * the PDU's buffer and nothing is converted until requested. Questions
+     * have no TTL nor data.
+     *
+     * A record_view is only valid as long as the DNS PDU it was taken from
+     * is alive and not modified.
+     */
+    class TINS_API record_view {
+    public:
+        /**
+         * Default constructor.
+         */
+        record_view()
+        : section_(QUESTIONS), type_(0), qclass_(0), ttl_(0), data_size_(0),
+        data_offset_(0) { }
+
+        /**
+         * \brief Getter for the section this record belongs to.
+         */
+        SectionType section() const {
+            return section_;
+        }
+
+        /**
+         * \brief Getter for this record's domain name.
+         */
+        const name_view& name() const {
+            return name_;
+        }
+
+        /**
+         * \brief Getter for the type field.
+         */
+        uint16_t type() const {
+            return type_;
+        }
+
+        /**
+         * \brief Getter for the class field.
+         */
+        uint16_t query_class() const {
+            return qclass_;
+        }
+
+        /**
+         * \brief Getter for the TTL field.
+         */
+        uint32_t ttl() const {
+            return ttl_;
+        }
+
+        /**
+         * \brief Getter for the raw record data.
+         */
+        const uint8_t* data() const {
+            return name_.records_ + data_offset_;
+        }
+
+        /**
+         * \brief Getter for the size of the raw record data.
+         */
+        uint16_t data_size() const {
+            return data_size_;
+        }
+
+        /**
+         * \brief Getter for the address in an A record.
+         *
+         * If the record data is not 4 bytes long, a malformed_packet
+         * exception is thrown.
+         */
+        IPv4Address address() const;
+
+        /**
+         * \brief Getter for the address in an AAAA record.
+         *
+         * If the record data is not 16 bytes long, a malformed_packet
+         * exception is thrown.
+         */
+        IPv6Address address_v6() const;
+
+        /**
+         * \brief Getter for the domain name in NS, CNAME, PTR, DNAME and
+         * MX records.
+         *
+         * If the record has any other type, a malformed_packet exception
+         * is thrown.
+         */
+        name_view data_name() const;
+
+        /**
+         * \brief Getter for the preference field in MX records.
+         *
+         * If the record isn't an MX record, a malformed_packet exception
+         * is thrown.
+         */
+        uint16_t preference() const;
+    private:
+        friend class record_cursor;
+
+        name_view name_;
+        SectionType section_;
+        uint16_t type_;
+        uint16_t qclass_;
+        uint32_t ttl_;
+        uint16_t data_size_;
+        uint32_t data_offset_;
+    };
+
+    /**
+     * \brief Forward only cursor over the records in a DNS PDU.
+     *
+     * This is the allocation free alternative to DNS::queries,
+     * DNS::answers, DNS::authority and DNS::additional, meant for code
+     * that only looks at a few fields of each record:
+     *
+     * \code
+     * DNS::record_cursor cursor = dns.records(DNS::ANSWERS);
+     * DNS::record_view record;
+     * char name[DNS::name_view::MAX_NAME_SIZE];
+     * while (cursor.next(record)) {
+     *     if (record.type() == DNS::A) {
+     *         record.name().decode(name, sizeof(name));
+     *         // use name and record.address()
+     *     }
+     * }
+     * \endcode
+     *
+     * A record_cursor is only valid as long as the DNS PDU it was taken
+     * from is alive and not modified.
+     */
+    class TINS_API record_cursor {
+    public:
+        /**
+         * \brief Advances to the next record.
+         *
+         * If the record is malformed, a malformed_packet exception is
+         * thrown.
+         *
+         * \param record The record view in which to store the record.
+         * \return false iff there are no more records.
+         */
+        bool next(record_view& record);
+    private:
+        friend class DNS;
+
+        record_cursor(const uint8_t* records, uint32_t records_size, uint32_t offset,
+                      uint32_t end_offset, uint32_t count, SectionType section)
+        : records_(records), records_size_(records_size), offset_(offset),
+        end_offset_(end_offset), remaining_(count), section_(section) { }
+
+        const uint8_t* records_;
+        uint32_t records_size_;
+        uint32_t offset_;
+        uint32_t end_offset_;
+        uint32_t remaining_;
+        SectionType section_;
+    };
     
     /**
      * \brief Extracts metadata for this protocol based on the buffer provided
@@ -947,6 +1208,15 @@ public:
      * \return The additional records in this PDU.
      */
     resources_type additional() const;
+
+    /**
+     * \brief Creates a cursor over the records in a section.
+     *
+     * \sa record_cursor
+     * \param section The section to iterate.
+     * \return A cursor positioned before the section's first record.
+     */
+    record_cursor records(SectionType section) const;
     
     /**
      * \brief Encodes a domain name.
@@ -1038,7 +1308,7 @@ private:
                          const uint16_t rr_count) const;
     void skip_to_section_end(Memory::InputMemoryStream& stream, 
                              const uint32_t num_records) const;
-    void skip_to_dname_end(Memory::InputMemoryStream& stream) const;
+    static void skip_to_dname_end(Memory::InputMemoryStream& stream);
     void update_records(uint32_t& section_start, 
                         uint32_t num_records,
                         uint32_t threshold,
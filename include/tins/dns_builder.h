@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_DNS_BUILDER_H
+#define TINS_DNS_BUILDER_H
+
+#include <string>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/dns.h>
+
+namespace Tins {
+
+/**
+ * \class DNSBuilder
+ * \brief Builds DNS messages in a single pass over a caller-owned buffer.
+ *
+ * DNS::add_query and friends insert each record in the middle of the
+ * PDU's buffer and then fix up the offsets of the following sections,
+ * which makes building a message with many records quadratic. This class
+ * writes the header and then every record right after the previous one,
+ * so records have to be added in section order: queries, then answers,
+ * then authority and finally additional records. Adding a record to a
+ * section that precedes the current one throws dns_section_out_of_order.
+ *
+ * Domain names are compressed by pointing to the suffixes of names that
+ * were already written. This applies to the records' names and to the
+ * data of NS, CNAME, PTR and MX records. When compression is disabled,
+ * the output is byte for byte the same as the one produced by serializing
+ * a DNS PDU containing the same records.
+ *
+ * If a record doesn't fit in the buffer, a serialization_error is thrown
+ * and the message is left as it was before adding it, so the caller can
+ * e.g. set the truncated flag and send what's been built so far.
+ *
+ * \code
+ * uint8_t buffer[512];
+ * DNSBuilder builder(buffer, sizeof(buffer));
+ * builder.id(query.id());
+ * builder.type(DNS::RESPONSE);
+ * builder.recursion_available(1);
+ * builder.add_query(DNS::query("www.example.com", DNS::A, DNS::INTERNET));
+ * builder.add_answer(
+ *     DNS::resource("www.example.com", "127.0.0.1", DNS::A, DNS::INTERNET, 777)
+ * );
+ * sender.send(EthernetII() / IP(dst, src) / UDP(sport, dport) /
+ *             RawPDU(builder.buffer(), builder.size()));
+ * \endcode
+ */
+class TINS_API DNSBuilder {
+public:
+    /**
+     * The maximum amount of name suffixes that can be pointed to.
+     */
+    static const uint32_t MAX_COMPRESSION_ENTRIES = 64;
+
+    /**
+     * \brief Constructs a builder that writes into the given buffer.
+     *
+     * The buffer must outlive this object and be able to hold at least
+     * the DNS header.
+     *
+     * \param buffer The buffer to write the message into.
+     * \param total_sz The size of the buffer.
+     */
+    DNSBuilder(uint8_t* buffer, uint32_t total_sz);
+
+    /**
+     * \brief Discards the message built so far.
+     *
+     * The header flags are cleared as well. The compression setting is
+     * kept.
+     */
+    void reset();
+
+    /**
+     * \brief Setter for the id field.
+     */
+    void id(uint16_t new_id);
+
+    /**
+     * \brief Setter for the query response field.
+     */
+    void type(DNS::QRType new_qr);
+
+    /**
+     * \brief Setter for the opcode field.
+     */
+    void opcode(uint8_t new_opcode);
+
+    /**
+     * \brief Setter for the authoritative answer field.
+     */
+    void authoritative_answer(uint8_t new_aa);
+
+    /**
+     * \brief Setter for the truncated field.
+     */
+    void truncated(uint8_t new_tc);
+
+    /**
+     * \brief Setter for the recursion desired field.
+     */
+    void recursion_desired(uint8_t new_rd);
+
+    /**
+     * \brief Setter for the recursion available field.
+     */
+    void recursion_available(uint8_t new_ra);
+
+    /**
+     * \brief Setter for the authenticated data field.
+     */
+    void authenticated_data(uint8_t new_ad);
+
+    /**
+     * \brief Setter for the checking disabled field.
+     */
+    void checking_disabled(uint8_t new_cd);
+
+    /**
+     * \brief Setter for the rcode field.
+     */
+    void rcode(uint8_t new_rcode);
+
+    /**
+     * \brief Enables or disables name compression.
+     *
+     * Compression is enabled by default. Changing this setting only
+     * affects the records added afterwards.
+     */
+    void compression(bool enabled);
+
+    /**
+     * \brief Indicates whether name compression is enabled.
+     */
+    bool compression() const {
+        return compression_;
+    }
+
+    /**
+     * \brief Adds a query.
+     *
+     * \param query The query to be added.
+     */
+    void add_query(const DNS::query& query);
+
+    /**
+     * \brief Adds an answer.
+     *
+     * \param resource The resource to be added.
+     */
+    void add_answer(const DNS::resource& resource);
+
+    /**
+     * \brief Adds an authority record.
+     *
+     * \param resource The resource to be added.
+     */
+    void add_authority(const DNS::resource& resource);
+
+    /**
+     * \brief Adds an additional record.
+     *
+     * \param resource The resource to be added.
+     */
+    void add_additional(const DNS::resource& resource);
+
+    /**
+     * \brief Getter for the amount of records in a section.
+     */
+    uint16_t count(DNS::SectionType section) const {
+        return counts_[section];
+    }
+
+    /**
+     * \brief Getter for the buffer the message is written into.
+     */
+    const uint8_t* buffer() const {
+        return buffer_;
+    }
+
+    /**
+     * \brief Getter for the size of the message built so far.
+     */
+    uint32_t size() const {
+        return size_;
+    }
+private:
+    static const uint32_t MAX_LABELS = 128;
+
+    struct label {
+        label() : data(0), size(0) { }
+
+        const char* data;
+        uint8_t size;
+    };
+
+    void set_flag(uint32_t index, uint8_t mask, uint8_t value);
+    void add_resource(const DNS::resource& resource, DNS::SectionType section);
+    void begin_section(DNS::SectionType section);
+    void end_record(DNS::SectionType section);
+    uint8_t* reserve(uint32_t size);
+    void write(const void* data, uint32_t size);
+    void write_be16(uint16_t value);
+    void write_be32(uint32_t value);
+    void write_name(const std::string& name, bool compress);
+    bool suffix_matches(uint32_t offset, const label* labels, uint32_t count) const;
+    uint32_t find_suffix(const label* labels, uint32_t count, uint32_t& pointer) const;
+
+    // You shall not copy
+    DNSBuilder(const DNSBuilder&);
+    DNSBuilder& operator=(const DNSBuilder&);
+
+    uint8_t* buffer_;
+    uint32_t buffer_size_;
+    uint32_t size_;
+    DNS::SectionType section_;
+    uint16_t counts_[4];
+    uint16_t name_offsets_[MAX_COMPRESSION_ENTRIES];
+    uint32_t name_offsets_count_;
+    bool compression_;
+};
+
+} // Tins
+
+#endif // TINS_DNS_BUILDER_H
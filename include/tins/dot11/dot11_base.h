@@ -32,6 +32,9 @@
 #if !defined(TINS_DOT11_DOT11_H) && defined(TINS_HAVE_DOT11)
 #define TINS_DOT11_DOT11_H
 
+#ifdef TINS_HAVE_CXX11
+    #include <atomic>
+#endif // TINS_HAVE_CXX11
 #include <tins/pdu.h>
 #include <tins/pdu_option.h>
 #include <tins/small_uint.h>
@@ -587,6 +590,7 @@ public:
          * \param opt The option to be added.
          */
         void add_option(option &&opt) {
+            materialize_options();
             internal_add_option(opt);
             options_.push_back(std::move(opt));
         }
@@ -607,6 +611,10 @@ public:
      * \brief Looks up a tagged option in the option list.
      * 
      * The returned pointer <b>must not</b> be free'd.
+     *
+     * If lazy_tagged_parameters is enabled, on frames constructed from a
+     * buffer this creates the option objects for every tagged parameter
+     * the first time it's called.
      * 
      * \param type The option identifier.
      * \return The option found, or 0 if no such option has been set.
@@ -639,13 +647,46 @@ public:
     
     /**
      * \brief Getter for the option list.
+     *
+     * If lazy_tagged_parameters is enabled, on frames constructed from a
+     * buffer this creates the option objects for every tagged parameter
+     * the first time it's called.
      * 
      * \return The options list.
      */
     const options_type& options() const {
+        materialize_options();
         return options_;
     }
 
+    /**
+     * \brief Enables or disables lazy parsing of tagged parameters.
+     *
+     * When enabled, management frames constructed from a buffer only
+     * validate their tagged parameters and index where each tag starts.
+     * The getters for specific options (e.g. Dot11ManagementFrame::ssid)
+     * only create the option they return, while options(), search_option()
+     * and any change to the options create all of them.
+     *
+     * Since options() and search_option() modify the frame even though
+     * they're const, a lazily parsed frame must not be accessed from
+     * several threads at once until one of them has been called on it.
+     *
+     * This setting is global to the process: it affects every thread and
+     * every sniffer. It's disabled by default and applies to frames parsed
+     * after the call, so it should be set before any frames are parsed.
+     *
+     * \param value Whether tagged parameters should be parsed lazily.
+     */
+    static void lazy_tagged_parameters(bool value);
+
+    /**
+     * \brief Indicates whether tagged parameters are parsed lazily.
+     *
+     * \sa lazy_tagged_parameters(bool)
+     */
+    static bool lazy_tagged_parameters();
+
     /**
      * \brief Allocates an Dot11 PDU from a buffer.
      * 
@@ -666,6 +707,7 @@ protected:
     virtual void write_fixed_parameters(Memory::OutputMemoryStream& stream);
     void parse_tagged_parameters(Memory::InputMemoryStream& stream);
     void add_tagged_option(OptionTypes opt, uint8_t len, const uint8_t* val);
+    const option* lookup_option(OptionTypes type, option& storage) const;
 protected:
     /**
      * Struct that represents the 802.11 header
@@ -711,11 +753,23 @@ private:
     void write_serialization(uint8_t* buffer, uint32_t total_sz);
     options_type::const_iterator search_option_iterator(OptionTypes type) const;
     options_type::iterator search_option_iterator(OptionTypes type);
+    void materialize_options() const;
 
 
     dot11_header header_;
     uint32_t options_size_;
-    options_type options_;
+    // When parsing lazily, frames constructed from a buffer keep their tagged
+    // parameters as they were read, along with the offset of each tag, until
+    // they're modified or the whole option list is requested
+    mutable options_type options_;
+    mutable std::vector<uint8_t> tagged_parameters_;
+    mutable std::vector<uint32_t> tag_offsets_;
+
+    #ifdef TINS_HAVE_CXX11
+        static std::atomic<bool> lazy_tagged_parameters_;
+    #else
+        static bool lazy_tagged_parameters_;
+    #endif // TINS_HAVE_CXX11
 };
 
 } // Tins
@@ -1265,7 +1265,8 @@ private:
     
     template<typename T>
     T search_and_convert(OptionTypes opt_type) const {
-        const option* opt = search_option(opt_type);
+        option storage;
+        const option* opt = lookup_option(opt_type, storage);
         if (!opt) {
             throw option_not_found();
         }
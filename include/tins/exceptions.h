@@ -83,6 +83,14 @@ public:
     dns_decompression_pointer_loops() : malformed_packet("DNS decompression: pointer loops") { }
 };
 
+/**
+ * \brief Exception thrown when DNS records are added out of section order.
+ */
+class dns_section_out_of_order : public exception_base {
+public:
+    dns_section_out_of_order() : exception_base("DNS records added out of section order") { }
+};
+
 
 /**
  * \brief Exception thrown when serializing a packet fails.
@@ -161,6 +169,34 @@ public:
     : exception_base(msg) { }
 };
 
+/**
+ * \brief Exception thrown when a file can't be opened.
+ */
+class file_open_error : public exception_base {
+public:
+    file_open_error(const std::string& msg)
+    : exception_base(msg) { }
+};
+
+/**
+ * \brief Exception thrown when writing to a file fails.
+ */
+class file_write_error : public exception_base {
+public:
+    file_write_error(const std::string& msg)
+    : exception_base(msg) { }
+};
+
+/**
+ * \brief Exception thrown when reading a file fails or its contents
+ * are invalid.
+ */
+class file_read_error : public exception_base {
+public:
+    file_read_error(const std::string& msg)
+    : exception_base(msg) { }
+};
+
 /**
  * \brief Exception thrown when an invalid socket type is provided
  * to PacketSender.
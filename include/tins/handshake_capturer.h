@@ -35,12 +35,22 @@
 #include <vector>
 #include <map>
 #include <utility>
+#include <tins/cxxstd.h>
+#if TINS_IS_CXX11
+    #include <chrono>
+#endif // TINS_IS_CXX11
+#ifdef TINS_HAVE_CXX11
+    #include <functional>
+    #include <unordered_map>
+#endif // TINS_HAVE_CXX11
 #include <tins/hw_address.h>
 #include <tins/macros.h>
 #include <tins/eapol.h>
 
 namespace Tins {
 
+class Packet;
+
 /**
  * \brief Generic EAPOL handshake.
  *
@@ -104,7 +114,21 @@ private:
 typedef EAPOLHandshake<RSNEAPOL> RSNHandshake;
 
 /**
- * Captures 802.1X RSN handshakes.
+ * \brief Captures 802.1X RSN handshakes.
+ *
+ * Partial handshakes are kept in a table indexed by the pair of addresses
+ * involved. In order to keep memory bounded on long captures, the amount of
+ * partial handshakes is limited (see
+ * RSNHandshakeCapturer::max_partial_handshakes), in which case the least
+ * recently seen one is dropped to make room for a new one.
+ *
+ * When packets are processed along with their timestamps, partial
+ * handshakes that haven't seen any packets for a while are also dropped.
+ * This happens incrementally while processing packets.
+ *
+ * Completed handshakes are stored until RSNHandshakeCapturer::clear_handshakes
+ * is called, unless a handshake callback is set. In that case, they're only
+ * handed to the callback.
  */
 class TINS_API RSNHandshakeCapturer {
 public:
@@ -118,6 +142,40 @@ public:
      * will be stored.
      */
     typedef std::vector<handshake_type> handshakes_type;
+
+    #if TINS_IS_CXX11
+        /**
+         * The type used to store packet timestamps
+         */
+        typedef std::chrono::microseconds timestamp_type;
+    #endif // TINS_IS_CXX11
+
+    #ifdef TINS_HAVE_CXX11
+        /**
+         * The type used for completed handshake callbacks
+         */
+        typedef std::function<void(const handshake_type&)> handshake_callback_type;
+    #endif // TINS_HAVE_CXX11
+
+    /**
+     * The default maximum amount of partial handshakes kept.
+     */
+    static const size_t DEFAULT_MAX_PARTIAL_HANDSHAKES;
+
+    /**
+     * \brief Default constructor.
+     */
+    RSNHandshakeCapturer();
+
+    /**
+     * \brief Copy constructor.
+     */
+    RSNHandshakeCapturer(const RSNHandshakeCapturer& other);
+
+    /**
+     * \brief Copy assignment operator.
+     */
+    RSNHandshakeCapturer& operator=(const RSNHandshakeCapturer& other);
     
     /**
      * \brief Processes a packet.
@@ -126,10 +184,91 @@ public:
      * it in an intermediate storage. When a handshake is 
      * completed, it will be stored separately. 
      *
+     * Partial handshakes updated by this packet are considered to be seen
+     * at the latest timestamp processed so far.
+     *
+     * \return true iff a handshake was completed by this packet.
      * \sa RSNHandshakeCapturer::handshakes
      */
     bool process_packet(const PDU& pdu);
 
+    #if TINS_IS_CXX11
+        /**
+         * \brief Processes a packet captured at the given time.
+         *
+         * Besides processing the packet, this drops a few of the partial
+         * handshakes that have expired at the given time.
+         *
+         * \param pdu The packet to be processed
+         * \param ts The packet's timestamp
+         * \return true iff a handshake was completed by this packet.
+         */
+        bool process_packet(const PDU& pdu, const timestamp_type& ts);
+
+        /**
+         * \brief Processes a packet, using its timestamp.
+         *
+         * Packets without a PDU are ignored.
+         *
+         * \param packet The packet to be processed
+         * \return true iff a handshake was completed by this packet.
+         */
+        bool process_packet(const Packet& packet);
+
+        /**
+         * \brief Sets the maximum time a partial handshake is kept without
+         * seeing any of its packets.
+         *
+         * The default keep alive is 60 seconds.
+         *
+         * \param keep_alive The maximum time to keep partial handshakes
+         */
+        template <typename Rep, typename Period>
+        void partial_handshake_keep_alive(const std::chrono::duration<Rep, Period>& keep_alive) {
+            keep_alive_ = std::chrono::duration_cast<timestamp_type>(keep_alive).count();
+        }
+
+        /**
+         * \brief Drops every partial handshake that has expired at the given time
+         *
+         * Packet processing already drops them incrementally, so this only
+         * needs to be called once no more packets are captured.
+         *
+         * \param now The current time
+         */
+        void cleanup_handshakes(const timestamp_type& now);
+    #endif // TINS_IS_CXX11
+
+    #ifdef TINS_HAVE_CXX11
+        /**
+         * \brief Sets the completed handshake callback.
+         *
+         * Once set, completed handshakes are handed to the callback instead
+         * of being stored.
+         *
+         * \param callback The callback to be set
+         */
+        void handshake_callback(const handshake_callback_type& callback);
+    #endif // TINS_HAVE_CXX11
+
+    /**
+     * \brief Sets the maximum amount of partial handshakes to be kept
+     *
+     * The default is DEFAULT_MAX_PARTIAL_HANDSHAKES. This is the only
+     * limit that applies when packets are processed without timestamps,
+     * as WPA2Decrypter does. A value of 0 means there's no limit.
+     *
+     * \param value The maximum amount of partial handshakes
+     */
+    void max_partial_handshakes(size_t value);
+
+    /**
+     * Retrieves the amount of partial handshakes being kept
+     */
+    size_t partial_handshakes_count() const {
+        return handshakes_.size();
+    }
+
     /**
      * \brief Retrieves the completed handshakes.
      *
@@ -156,13 +295,58 @@ public:
 private:
     typedef handshake_type::address_type address_type;
     typedef handshake_type::container_type eapol_list;
-    typedef std::map<std::pair<address_type, address_type>, eapol_list> handshake_map;
+    typedef std::pair<address_type, address_type> addr_pair;
+
+    // Partial handshakes are kept in an intrusive list sorted by last seen time.
+    // Packets processed without a timestamp use the latest one seen so far
+    struct partial_handshake {
+        partial_handshake()
+        : last_seen(0), key(0), previous(0), next(0) {
+
+        }
+
+        eapol_list packets;
+        uint64_t last_seen;
+        const addr_pair* key;
+        partial_handshake* previous;
+        partial_handshake* next;
+    };
+
+    struct addr_pair_hash {
+        size_t operator()(const addr_pair& addresses) const;
+    };
+
+    // The layout can't depend on TINS_IS_CXX11, as that depends on how
+    // the application including this header is built
+    #ifdef TINS_HAVE_CXX11
+        typedef std::unordered_map<addr_pair, partial_handshake,
+                                   addr_pair_hash> handshake_map;
+    #else
+        typedef std::map<addr_pair, partial_handshake> handshake_map;
+    #endif // TINS_HAVE_CXX11
+
+    static const uint64_t DEFAULT_KEEP_ALIVE;
+    static const size_t MAX_EXPIRATIONS_PER_PACKET;
 
-    bool do_insert(const handshake_map::key_type& key, const RSNEAPOL* eapol, 
-      size_t expected);
+    bool do_process(const PDU& pdu);
+    partial_handshake& find_or_create(const addr_pair& key);
+    bool do_insert(const addr_pair& key, const RSNEAPOL* eapol, size_t expected);
+    void complete_handshake(const addr_pair& key);
+    void expire_handshakes(uint64_t now, size_t max_expirations);
+    void erase(partial_handshake* entry);
+    void link_back(partial_handshake* entry);
+    void unlink(partial_handshake* entry);
 
     handshake_map handshakes_;
     handshakes_type completed_handshakes_;
+    partial_handshake* oldest_;
+    partial_handshake* newest_;
+    uint64_t latest_timestamp_;
+    uint64_t keep_alive_;
+    size_t max_partial_handshakes_;
+    #ifdef TINS_HAVE_CXX11
+        handshake_callback_type on_handshake_;
+    #endif // TINS_HAVE_CXX11
 };
 
 } // Tins
@@ -36,6 +36,8 @@
 #include <tins/macros.h>
 #include <tins/ip_address.h>
 #include <tins/ip.h>
+#include <tins/timestamp.h>
+#include <tins/detail/fragment_helpers.h>
 
 namespace Tins {
 
@@ -43,49 +45,21 @@ namespace Tins {
  * \cond
  */
 namespace Internals {
-class IPv4Fragment {
-public:
-    typedef PDU::serialization_type payload_type;
-
-    IPv4Fragment() : offset_() { }
-
-    template<typename T>
-    IPv4Fragment(T* pdu, uint16_t offset)
-    : payload_(pdu->serialize()), offset_(offset) {
-        
-    }
-    
-    const payload_type& payload() const {
-        return payload_;
-    }
-    
-    uint16_t offset() const {
-        return offset_;
-    }
-private:
-    payload_type payload_;
-    uint16_t offset_;
-};
-
 class TINS_API IPv4Stream {
 public:
     IPv4Stream();
     
-    void add_fragment(IP* ip);
+    bool add_fragment(IP* ip);
+    bool empty() const;
     bool is_complete() const;
     PDU* allocate_pdu() const;
     const IP& first_fragment() const;
+    size_t memory_usage() const;
 private:
-    typedef std::vector<IPv4Fragment> fragments_type;
-    
     uint16_t extract_offset(const IP* ip);
-    bool extract_more_frag(const IP* ip);
 
-    fragments_type fragments_;
-    size_t received_size_;
-    size_t total_size_;
+    FragmentBuffer buffer_;
     IP first_fragment_;
-    bool received_end_;
 };
 } // namespace Internals
 
@@ -116,6 +90,21 @@ private:
  *     }
  * });
  * \endcode 
+ *
+ * Incomplete datagrams are kept for at most IPv4Reassembler::fragment_timeout
+ * seconds since their first fragment was seen. IPv4Reassembler::process(PDU&)
+ * measures this using the current time, so use the overload that takes a
+ * Timestamp when reading packets from a file. The amount of memory used by
+ * incomplete datagrams and, optionally, their amount are limited as well. 
+ * Whenever a limit is reached, the oldest datagrams are evicted. This keeps 
+ * memory usage bounded even when processing a flood of fragments that are
+ * never completed.
+ *
+ * Fragments are copied directly into a single buffer, at the position they
+ * occupy in the reassembled payload. When fragments overlap, the bytes that
+ * were received first are kept. Fragments that are inconsistent with the
+ * ones seen before, such as those that would make the payload larger than
+ * 65535 bytes, are dropped while the rest of the datagram is kept.
  */
 class TINS_API IPv4Reassembler {
 public:
@@ -138,6 +127,16 @@ public:
         NONE 
     };
 
+    /**
+     * The default amount of seconds an incomplete datagram is kept for
+     */
+    static const uint32_t DEFAULT_FRAGMENT_TIMEOUT;
+
+    /**
+     * The default maximum amount of memory used by incomplete datagrams
+     */
+    static const size_t DEFAULT_MAX_BUFFERED_BYTES;
+
     /**
      * Default constructor
      */
@@ -158,6 +157,8 @@ public:
      * the packet is successfully reassembled using previously
      * processed packets, its contents will be modified so that
      * it contains the whole payload and not just a fragment.
+     *
+     * The current time is used to expire incomplete datagrams. 
      * 
      * \param pdu The PDU to process.
      * \return NOT_FRAGMENTED if the PDU does not contain an IP
@@ -167,6 +168,19 @@ public:
      */
     PacketStatus process(PDU& pdu);
 
+    /**
+     * \brief Processes a PDU captured at the given time and tries to 
+     * reassemble it.
+     *
+     * The timestamp is used to expire incomplete datagrams, which makes
+     * this the right overload to use when reading packets from a file.
+     *
+     * \param pdu The PDU to process.
+     * \param timestamp The time at which the PDU was captured
+     * \sa IPv4Reassembler::process(PDU&)
+     */
+    PacketStatus process(PDU& pdu, const Timestamp& timestamp);
+
     /**
      * Removes all of the packets and data stored.
      */
@@ -183,10 +197,76 @@ public:
      * \sa IP::id
      */
     void remove_stream(uint16_t id, IPv4Address addr1, IPv4Address addr2);
+
+    /**
+     * \brief Sets the amount of seconds an incomplete datagram is kept for
+     *
+     * The timeout is measured since the datagram's first fragment was seen.
+     *
+     * \param seconds The timeout to be used
+     */
+    void fragment_timeout(uint32_t seconds);
+
+    /**
+     * \brief Getter for the amount of seconds an incomplete datagram is 
+     * kept for
+     */
+    uint32_t fragment_timeout() const;
+
+    /**
+     * \brief Sets the maximum amount of incomplete datagrams to be kept
+     *
+     * A value of 0 means there's no limit. This is the default.
+     *
+     * \param value The maximum amount of incomplete datagrams
+     */
+    void max_datagrams(size_t value);
+
+    /**
+     * \brief Getter for the maximum amount of incomplete datagrams to be kept
+     */
+    size_t max_datagrams() const;
+
+    /**
+     * \brief Sets the maximum amount of memory used by incomplete datagrams
+     *
+     * A value of 0 means there's no limit.
+     *
+     * \param value The maximum amount of bytes
+     */
+    void max_buffered_bytes(size_t value);
+
+    /**
+     * \brief Getter for the maximum amount of memory used by incomplete 
+     * datagrams
+     */
+    size_t max_buffered_bytes() const;
+
+    /**
+     * \brief Getter for the amount of incomplete datagrams being kept
+     */
+    size_t datagram_count() const;
+
+    /**
+     * \brief Getter for the amount of memory used by incomplete datagrams
+     */
+    size_t buffered_bytes() const;
+
+    /**
+     * \brief Getter for the amount of incomplete datagrams removed because
+     * their timeout expired
+     */
+    uint64_t expired_datagrams() const;
+
+    /**
+     * \brief Getter for the amount of incomplete datagrams removed because
+     * a limit was reached
+     */
+    uint64_t evicted_datagrams() const;
 private:
     typedef std::pair<IPv4Address, IPv4Address> address_pair;
     typedef std::pair<uint16_t, address_pair> key_type;
-    typedef std::map<key_type, Internals::IPv4Stream> streams_type;
+    typedef Internals::FragmentCache<key_type, Internals::IPv4Stream> streams_type;
 
     key_type make_key(const IP* ip) const;
     address_pair make_address_pair(IPv4Address addr1, IPv4Address addr2) const;
@@ -46,6 +46,18 @@ class OutputMemoryStream;
 } // Memory
 
 class PacketSender;
+
+/**
+ * \cond
+ */
+namespace Internals {
+
+class IPv6Stream;
+
+} // Internals
+/**
+ * \endcond
+ */
     
 /**
  * \class IPv6
@@ -404,6 +416,9 @@ public:
      */
     const ext_header* search_header(ExtensionHeader id) const;
 private:
+    // Needs to strip the fragment header and know the fragmented protocol
+    friend class Internals::IPv6Stream;
+
     void write_serialization(uint8_t* buffer, uint32_t total_sz);
     void set_last_next_header(uint8_t value);
     uint32_t calculate_headers_size() const;
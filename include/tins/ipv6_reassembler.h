@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_IPV6_REASSEMBLER_H
+#define TINS_IPV6_REASSEMBLER_H
+
+#include <map>
+#include <utility>
+#include <tins/pdu.h>
+#include <tins/macros.h>
+#include <tins/ipv6_address.h>
+#include <tins/ipv6.h>
+#include <tins/timestamp.h>
+#include <tins/detail/fragment_helpers.h>
+
+namespace Tins {
+
+/** 
+ * \cond
+ */
+namespace Internals {
+class TINS_API IPv6Stream {
+public:
+    IPv6Stream();
+    
+    bool add_fragment(IPv6* ipv6, const IPv6::fragment_header& header);
+    bool is_complete() const;
+    PDU* allocate_pdu() const;
+    const IPv6& first_fragment() const;
+    size_t memory_usage() const;
+private:
+    FragmentBuffer buffer_;
+    IPv6 first_fragment_;
+    uint8_t next_header_;
+};
+} // namespace Internals
+
+/** 
+ * \endcond
+ */
+
+/**
+ * \brief Reassembles fragmented IPv6 packets.
+ *
+ * This is the IPv6 counterpart of IPv4Reassembler and it's used the same 
+ * way. Packets that carry a Fragment extension header are kept until every 
+ * fragment of their datagram is seen. The reassembled packet uses the 
+ * first fragment's header and extension headers, minus the Fragment header,
+ * and its payload is parsed into the appropriate PDU.
+ *
+ * Incomplete datagrams are expired and evicted exactly like in 
+ * IPv4Reassembler, so memory usage stays bounded.
+ *
+ * Datagrams in which other extension headers follow the Fragment header 
+ * are not reassembled and their fragments are reported as FRAGMENTED.
+ *
+ * \code
+ * IPv6Reassembler reassembler;
+ * Sniffer sniffer = ...;
+ * sniffer.sniff_loop([&](PDU& pdu) {
+ *     if (reassembler.process(pdu) != IPv6Reassembler::FRAGMENTED) {
+ *         process_packet(pdu);
+ *     }
+ * });
+ * \endcode 
+ *
+ * \sa IPv4Reassembler
+ */
+class TINS_API IPv6Reassembler {
+public:
+    /**
+     * The status of each processed packet.
+     */
+    enum PacketStatus {
+        NOT_FRAGMENTED, ///< The given packet is not fragmented
+        FRAGMENTED, ///< The given packet is fragmented and can't be reassembled yet
+        REASSEMBLED ///< The given packet was fragmented but is now reassembled
+    };
+
+    /**
+     * The default amount of seconds an incomplete datagram is kept for
+     */
+    static const uint32_t DEFAULT_FRAGMENT_TIMEOUT;
+
+    /**
+     * The default maximum amount of memory used by incomplete datagrams
+     */
+    static const size_t DEFAULT_MAX_BUFFERED_BYTES;
+
+    /**
+     * Default constructor
+     */
+    IPv6Reassembler();
+
+    /**
+     * \brief Processes a PDU and tries to reassemble it.
+     *
+     * If the packet is successfully reassembled using previously processed
+     * packets, its contents will be modified so that it contains the whole
+     * payload and not just a fragment.
+     *
+     * The current time is used to expire incomplete datagrams. 
+     * 
+     * \param pdu The PDU to process.
+     * \return NOT_FRAGMENTED if the PDU does not contain an IPv6
+     * layer or is not fragmented, FRAGMENTED if the packet is 
+     * fragmented or REASSEMBLED if the packet was fragmented 
+     * but has now been reassembled.
+     */
+    PacketStatus process(PDU& pdu);
+
+    /**
+     * \brief Processes a PDU captured at the given time and tries to 
+     * reassemble it.
+     *
+     * \param pdu The PDU to process.
+     * \param timestamp The time at which the PDU was captured
+     * \sa IPv6Reassembler::process(PDU&)
+     */
+    PacketStatus process(PDU& pdu, const Timestamp& timestamp);
+
+    /**
+     * Removes all of the packets and data stored.
+     */
+    void clear_streams();
+
+    /**
+     * \brief Removes all of the packets and data stored that belong to the
+     * given datagram.
+     * 
+     * \param id The Fragment header identification to search.
+     * \param src_addr The source address to search.
+     * \param dst_addr The destination address to search.
+     */
+    void remove_stream(uint32_t id, const IPv6Address& src_addr, 
+                       const IPv6Address& dst_addr);
+
+    /**
+     * \brief Sets the amount of seconds an incomplete datagram is kept for
+     *
+     * \param seconds The timeout to be used
+     * \sa IPv4Reassembler::fragment_timeout
+     */
+    void fragment_timeout(uint32_t seconds);
+
+    /**
+     * \brief Getter for the amount of seconds an incomplete datagram is 
+     * kept for
+     */
+    uint32_t fragment_timeout() const;
+
+    /**
+     * \brief Sets the maximum amount of incomplete datagrams to be kept
+     *
+     * A value of 0 means there's no limit. This is the default.
+     *
+     * \param value The maximum amount of incomplete datagrams
+     */
+    void max_datagrams(size_t value);
+
+    /**
+     * \brief Getter for the maximum amount of incomplete datagrams to be kept
+     */
+    size_t max_datagrams() const;
+
+    /**
+     * \brief Sets the maximum amount of memory used by incomplete datagrams
+     *
+     * A value of 0 means there's no limit.
+     *
+     * \param value The maximum amount of bytes
+     */
+    void max_buffered_bytes(size_t value);
+
+    /**
+     * \brief Getter for the maximum amount of memory used by incomplete 
+     * datagrams
+     */
+    size_t max_buffered_bytes() const;
+
+    /**
+     * \brief Getter for the amount of incomplete datagrams being kept
+     */
+    size_t datagram_count() const;
+
+    /**
+     * \brief Getter for the amount of memory used by incomplete datagrams
+     */
+    size_t buffered_bytes() const;
+
+    /**
+     * \brief Getter for the amount of incomplete datagrams removed because
+     * their timeout expired
+     */
+    uint64_t expired_datagrams() const;
+
+    /**
+     * \brief Getter for the amount of incomplete datagrams removed because
+     * a limit was reached
+     */
+    uint64_t evicted_datagrams() const;
+private:
+    typedef std::pair<IPv6Address, IPv6Address> address_pair;
+    typedef std::pair<uint32_t, address_pair> key_type;
+    typedef Internals::FragmentCache<key_type, Internals::IPv6Stream> streams_type;
+
+    streams_type streams_;
+};
+
+/**
+ * Proxy functor class that reassembles IPv6 PDUs.
+ */
+template<typename Functor>
+class IPv6ReassemblerProxy {
+public:
+    /**
+     * Constructs the proxy from a functor object.
+     *
+     * \param func The functor object.
+     */
+    IPv6ReassemblerProxy(Functor func)
+    : functor_(func) {
+
+    }
+
+    /**
+     * \brief Tries to reassemble the packet and forwards it to 
+     * the functor.
+     * 
+     * \param pdu The packet to process
+     * \return true if the packet wasn't forwarded, otherwise
+     * the value returned by the functor.
+     */
+    bool operator()(PDU& pdu) {
+        // Forward it unless it's fragmented.
+        if (reassembler_.process(pdu) != IPv6Reassembler::FRAGMENTED) {
+            return functor_(pdu);
+        }
+        else {
+            return true;
+        }
+    }
+private:
+    IPv6Reassembler reassembler_;
+    Functor functor_;
+};
+
+/**
+ * Helper function that creates an IPv6ReassemblerProxy.
+ *
+ * \param func The functor object to use in the IPv6ReassemblerProxy.
+ * \return An IPv6ReassemblerProxy.
+ */
+template<typename Functor>
+IPv6ReassemblerProxy<Functor> make_ipv6_reassembler_proxy(Functor func) {
+    return IPv6ReassemblerProxy<Functor>(func);
+}
+
+} // Tins
+
+#endif // TINS_IPV6_REASSEMBLER_H
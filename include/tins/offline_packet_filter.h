@@ -41,6 +41,7 @@
 namespace Tins {
 
 class PDU;
+class Packet;
 
 /**
  * \class OfflinePacketFilter
@@ -148,6 +149,17 @@ public:
       * \return true iff the packet matches the filter.
       */
      bool matches_filter(PDU& pdu) const;
+
+     /**
+      * \brief Applies the compiled filter on the provided packet.
+      *
+      * If the packet holds the bytes it was captured from, the filter is
+      * applied on them directly. Otherwise, its PDU is serialized.
+      *
+      * \param packet The packet to be matched against the filter.
+      * \return true iff the packet matches the filter.
+      */
+     bool matches_filter(Packet& packet) const;
 private:
     void init(const std::string& pcap_filter, int link_type, 
         unsigned int snap_len);
@@ -30,9 +30,11 @@
 #ifndef TINS_PACKET_H
 #define TINS_PACKET_H
 
+#include <vector>
 #include <tins/cxxstd.h>
 #include <tins/pdu.h>
 #include <tins/timestamp.h>
+#include <tins/detail/shared_frame.h>
 
 /**
  * \namespace Tins
@@ -107,9 +109,11 @@ public:
 private:
     friend class BaseSniffer;
     friend class SnifferIterator;
+    friend class Packet;
     
-    PacketWrapper(pdu_type pdu, const Timestamp& ts) 
-    : pdu_(pdu), ts_(ts) {}
+    PacketWrapper(pdu_type pdu, const Timestamp& ts,
+                  const Internals::SharedFrame* raw_frame = 0) 
+    : pdu_(pdu), ts_(ts), raw_frame_(raw_frame) {}
     
     PacketWrapper(const PacketWrapper&);
     PacketWrapper& operator=(const PacketWrapper&);
@@ -118,6 +122,8 @@ private:
 
     pdu_type pdu_;
     timestamp_type ts_;
+    // The captured bytes, owned by the sniffer, if it retains them
+    const Internals::SharedFrame* raw_frame_;
 };
 
 /**
@@ -126,9 +132,24 @@ private:
  * A Packet contains a PDU pointer and a Timestamp object. Packets
  * <b>will delete</b> the stored PDU* unless you call release_pdu at 
  * some point before destruction. 
+ *
+ * Packets can also hold the bytes they were captured from. This is
+ * enabled using SnifferConfiguration::set_retain_raw_frames. These bytes
+ * are used instead of serializing the PDU by PacketWriter::write,
+ * BufferedPacketWriter::write and OfflinePacketFilter::matches_filter,
+ * which is faster and keeps the frame exactly as it was captured.
+ * Since the PDU could be modified through it, the non const Packet::pdu
+ * overload and Packet::release_pdu discard these bytes. Use a const Packet
+ * to inspect the PDU while keeping them. The bytes are shared between 
+ * copies of a Packet, so copying one doesn't copy the frame.
  */
 class Packet {
 public:
+    /**
+     * The type used to store the captured bytes.
+     */
+    typedef std::vector<uint8_t> raw_frame_type;
+
     /**
      * Tag used to specify that a Packet should own a PDU pointer.
      */
@@ -193,16 +214,23 @@ public:
 
     /**
      * \brief Constructs a Packet from a PtrPacket object.
+     *
+     * If the sniffer that produced the PtrPacket retains raw frames,
+     * this Packet shares the captured frame with it.
      */
     Packet(const PtrPacket& pck)
-    : pdu_(pck.pdu()), ts_(pck.timestamp()) { }
+    : pdu_(pck.pdu()), ts_(pck.timestamp()) {
+        if (pck.raw_frame_) {
+            raw_frame_ = *pck.raw_frame_;
+        }
+    }
     
     /**
      * \brief Copy constructor.
      * 
      * This calls PDU::clone on the rhs's PDU* member.
      */
-    Packet(const Packet& rhs) : ts_(rhs.timestamp()) {
+    Packet(const Packet& rhs) : ts_(rhs.timestamp()), raw_frame_(rhs.raw_frame_) {
         pdu_ = rhs.pdu() ? rhs.pdu()->clone() : 0;
     }
     
@@ -216,6 +244,7 @@ public:
             delete pdu_;
             ts_ = rhs.timestamp();
             pdu_ = rhs.pdu() ? rhs.pdu()->clone() : 0;
+            raw_frame_ = rhs.raw_frame_;
         }
         return* this;
     }
@@ -224,8 +253,10 @@ public:
     /**
      * Move constructor.
      */
-    Packet(Packet &&rhs) TINS_NOEXCEPT : pdu_(rhs.pdu()), ts_(rhs.timestamp()) {
+    Packet(Packet &&rhs) TINS_NOEXCEPT
+    : pdu_(rhs.pdu_), ts_(rhs.timestamp()) {
         rhs.pdu_ = nullptr;
+        raw_frame_.swap(rhs.raw_frame_);
     }
     
     /**
@@ -237,6 +268,7 @@ public:
             pdu_ = std::move(rhs.pdu_);
             rhs.pdu_ = std::move(tmp);
             ts_ = rhs.timestamp();
+            raw_frame_.swap(rhs.raw_frame_);
         }
         return* this;
     }
@@ -261,9 +293,13 @@ public:
     /**
      * \brief Returns the stored PDU*. 
      * 
+     * Since the PDU may be modified through the returned pointer, this
+     * discards the bytes the Packet was captured from.
+     *
      * Caller <b>must not</b> delete the pointer. \sa Packet::release_pdu
      */
     PDU* pdu() {
+        raw_frame_.clear();
         return pdu_;
     }
     
@@ -288,8 +324,74 @@ public:
     PDU* release_pdu() {
         PDU* some_pdu = pdu_;
         pdu_ = 0;
+        raw_frame_.clear();
         return some_pdu;
     }
+
+    /**
+     * \brief Indicates whether this Packet holds the bytes it was
+     * captured from.
+     */
+    bool has_raw_frame() const {
+        return !raw_frame_.empty();
+    }
+
+    /**
+     * \brief Returns the bytes this Packet was captured from.
+     *
+     * This is empty unless the sniffer retains raw frames or they were
+     * set using Packet::raw_frame(const uint8_t*, uint32_t).
+     */
+    const raw_frame_type& raw_frame() const {
+        return raw_frame_.buffer();
+    }
+
+    /**
+     * \brief Returns the size the raw frame had on the wire.
+     *
+     * This is larger than raw_frame().size() if the frame was truncated
+     * when captured, and 0 if this Packet holds no raw frame.
+     */
+    uint32_t raw_frame_length() const {
+        return raw_frame_.original_size();
+    }
+
+    /**
+     * \brief Sets the bytes this Packet was captured from.
+     *
+     * These must be the serialized form of the stored PDU, from the link
+     * layer on, possibly including padding or trailing bytes the PDU
+     * doesn't represent.
+     *
+     * \param buffer The captured bytes.
+     * \param total_sz The amount of captured bytes.
+     */
+    void raw_frame(const uint8_t* buffer, uint32_t total_sz) {
+        raw_frame_ = Internals::SharedFrame(buffer, total_sz);
+    }
+
+    /**
+     * \brief Sets the bytes this Packet was captured from, which were
+     * truncated when captured.
+     *
+     * \sa Packet::raw_frame(const uint8_t*, uint32_t)
+     * \param buffer The captured bytes.
+     * \param total_sz The amount of captured bytes.
+     * \param original_sz The size of the frame on the wire.
+     */
+    void raw_frame(const uint8_t* buffer, uint32_t total_sz, uint32_t original_sz) {
+        raw_frame_ = Internals::SharedFrame(buffer, total_sz, original_sz);
+    }
+
+    /**
+     * \brief Discards the bytes this Packet was captured from.
+     *
+     * This has to be called after modifying the stored PDU, so that the
+     * modified PDU is serialized when writing this Packet.
+     */
+    void discard_raw_frame() {
+        raw_frame_.clear();
+    }
     
     /**
      * \brief Tests whether this is Packet contains a valid PDU.
@@ -304,17 +406,20 @@ public:
      * 
      * \brief Concatenation operator.
      * 
-     * Adds the PDU at the end of the PDU stack. 
+     * Adds the PDU at the end of the PDU stack. The raw frame, if any,
+     * is discarded.
      * 
      * \param rhs The PDU to be appended.
      */
     Packet& operator/=(const PDU& rhs) {
         pdu_ /= rhs;
+        discard_raw_frame();
         return* this;
     }
 private:
     PDU* pdu_;
     Timestamp ts_;
+    Internals::SharedFrame raw_frame_;
 };
 }
 
@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_PACKET_REPLAYER_H
+#define TINS_PACKET_REPLAYER_H
+
+#include <tins/cxxstd.h>
+
+#if TINS_IS_CXX11
+
+#include <chrono>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/network_interface.h>
+#include <tins/packet.h>
+#include <tins/timestamp.h>
+
+namespace Tins {
+
+class PDU;
+class PacketSender;
+
+/**
+ * \class PacketReplayer
+ * \brief Sends captured packets again, reproducing their timing.
+ *
+ * Packets are handed to this class in capture order along with the
+ * timestamp they were captured at. Each of them is sent using a
+ * PacketSender once its scheduled time arrives. The schedule depends on
+ * the pacing mode:
+ *
+ * - PacketReplayer::ORIGINAL_TIMING keeps the original gaps between
+ *   packets, optionally scaled by a speed multiplier.
+ * - PacketReplayer::PACKETS_PER_SECOND and PacketReplayer::BITS_PER_SECOND
+ *   ignore timestamps and send packets at a fixed rate, as dictated by a
+ *   token bucket. The bucket's depth determines how large bursts can be.
+ * - PacketReplayer::TOP_SPEED sends packets as fast as possible.
+ *
+ * Waiting is done by sleeping until the scheduled time is close and then
+ * busy polling the clock, which gives microsecond accuracy without
+ * spinning during long gaps. The spin threshold can be modified; setting
+ * it to zero disables busy polling completely.
+ *
+ * The delay between the scheduled and the actual transmission time of
+ * each packet is recorded and reported, along with the achieved rate,
+ * in PacketReplayer::statistics.
+ *
+ * \code
+ * FileSniffer sniffer("capture.pcap");
+ * PacketSender sender;
+ * PacketReplayer replayer(sender, "eth0");
+ * // Replay the capture twice as fast as it was captured
+ * replayer.pace_original(2.0);
+ * replayer.replay(sniffer);
+ * std::cout << replayer.statistics().bits_per_second() << std::endl;
+ * \endcode
+ */
+class TINS_API PacketReplayer {
+public:
+    /**
+     * The type used to represent durations.
+     */
+    typedef std::chrono::nanoseconds duration_type;
+
+    /**
+     * The pacing modes.
+     */
+    enum PacingMode {
+        ORIGINAL_TIMING,
+        PACKETS_PER_SECOND,
+        BITS_PER_SECOND,
+        TOP_SPEED
+    };
+
+    /**
+     * \brief Statistics about the packets replayed.
+     *
+     * Jitter is the delay between the time a packet was scheduled to be
+     * sent and the time it was actually handed to the PacketSender.
+     */
+    struct Statistics {
+        Statistics()
+        : packets_sent(0), bytes_sent(0), send_errors(0), elapsed(0),
+        total_jitter(0), max_jitter(0) {
+
+        }
+
+        /**
+         * \brief Retrieves the average amount of packets sent per second.
+         */
+        double packets_per_second() const;
+
+        /**
+         * \brief Retrieves the average amount of bits sent per second.
+         */
+        double bits_per_second() const;
+
+        /**
+         * \brief Retrieves the average jitter.
+         */
+        duration_type mean_jitter() const;
+
+        uint64_t packets_sent;
+        uint64_t bytes_sent;
+        uint64_t send_errors;
+        // The time between the first and the last packet sent
+        duration_type elapsed;
+        duration_type total_jitter;
+        duration_type max_jitter;
+    };
+
+    /**
+     * The default spin threshold.
+     */
+    static const duration_type DEFAULT_SPIN_THRESHOLD;
+
+    /**
+     * \brief Constructs a PacketReplayer.
+     *
+     * \param sender The PacketSender used to send packets.
+     * \param iface The interface used to send link layer packets. If it's
+     * the default constructed interface, the sender's default interface is
+     * used.
+     */
+    PacketReplayer(PacketSender& sender,
+                   const NetworkInterface& iface = NetworkInterface());
+
+    /**
+     * \brief Replays packets keeping their original gaps.
+     *
+     * \param multiplier The speed multiplier. A value of 2 replays packets
+     * twice as fast as they were captured. This must be positive.
+     */
+    void pace_original(double multiplier = 1.0);
+
+    /**
+     * \brief Replays packets at a fixed packet rate.
+     *
+     * \param rate The amount of packets per second. This must be positive.
+     * \param burst_size The maximum amount of packets sent back to back.
+     */
+    void pace_packets_per_second(double rate, uint32_t burst_size = 1);
+
+    /**
+     * \brief Replays packets at a fixed bit rate.
+     *
+     * The size of each packet is its serialized size, starting at the
+     * link layer for link layer packets.
+     *
+     * \param rate The amount of bits per second. This must be positive.
+     * \param burst_size The maximum amount of bytes sent back to back. It
+     * is raised to the size of a packet whenever a larger one is sent.
+     */
+    void pace_bits_per_second(double rate, uint32_t burst_size = 1514);
+
+    /**
+     * \brief Replays packets as fast as possible.
+     */
+    void pace_top_speed();
+
+    /**
+     * \brief Getter for the pacing mode.
+     */
+    PacingMode pacing_mode() const {
+        return mode_;
+    }
+
+    /**
+     * \brief Sets the spin threshold.
+     *
+     * When the time to wait for the next packet is larger than this value,
+     * the thread sleeps until this much time is left and busy polls after
+     * that.
+     *
+     * \param value The new spin threshold.
+     */
+    void spin_threshold(duration_type value);
+
+    /**
+     * \brief Getter for the spin threshold.
+     */
+    duration_type spin_threshold() const {
+        return spin_threshold_;
+    }
+
+    /**
+     * \brief Sends a packet once its scheduled time arrives.
+     *
+     * If the packet can't be written to the socket, it's counted as a
+     * send error and the socket_write_error is not propagated.
+     *
+     * \param pdu The packet to be sent.
+     * \param timestamp The time the packet was captured at.
+     */
+    void send(PDU& pdu, const Timestamp& timestamp);
+
+    /**
+     * \brief Sends a packet once its scheduled time arrives.
+     *
+     * If the packet doesn't contain a PDU, an invalid_packet exception 
+     * is thrown.
+     *
+     * \sa PacketReplayer::send(PDU&, const Timestamp&)
+     * \param packet The packet to be sent.
+     */
+    void send(Packet& packet);
+
+    /**
+     * \brief Sends a serialized link layer frame once its scheduled time
+     * arrives.
+     *
+     * The frame is written as is to the replayer's interface.
+     *
+     * \sa PacketReplayer::send(PDU&, const Timestamp&)
+     * \param buffer The frame to be sent.
+     * \param total_sz The size of the frame.
+     * \param timestamp The time the frame was captured at.
+     */
+    void send(const uint8_t* buffer, uint32_t total_sz, const Timestamp& timestamp);
+
+    /**
+     * \brief Replays every packet read from a sniffer.
+     *
+     * Packets are read using the sniffer's next_packet method until it
+     * returns an invalid packet. This is usually used with a FileSniffer.
+     *
+     * \param sniffer The sniffer to read packets from.
+     * \param max_packets The maximum amount of packets to replay. If it's
+     * 0, there's no limit.
+     */
+    template <typename Sniffer>
+    void replay(Sniffer& sniffer, uint64_t max_packets = 0) {
+        for (uint64_t i = 0; max_packets == 0 || i < max_packets; ++i) {
+            Packet packet = sniffer.next_packet();
+            if (!packet) {
+                break;
+            }
+            send(packet);
+        }
+    }
+
+    /**
+     * \brief Replays a range of Packets.
+     *
+     * \param start The beginning of the range.
+     * \param end The end of the range.
+     */
+    template <typename ForwardIterator>
+    void replay(ForwardIterator start, ForwardIterator end) {
+        while (start != end) {
+            send(*start);
+            ++start;
+        }
+    }
+
+    /**
+     * \brief Restarts the replay.
+     *
+     * The next packet sent is treated as the first one: it's sent right
+     * away and the gaps of the ones that follow are measured from it.
+     * The statistics and the token bucket are reset as well.
+     */
+    void reset();
+
+    /**
+     * \brief Retrieves the statistics of the packets sent so far.
+     */
+    const Statistics& statistics() const {
+        return stats_;
+    }
+private:
+    typedef std::chrono::steady_clock clock_type;
+    typedef clock_type::time_point time_point;
+
+    time_point schedule(uint32_t size, const Timestamp& timestamp);
+    time_point wait_until(time_point deadline);
+    void sent(time_point scheduled, time_point handoff, uint32_t size, bool success);
+    void send_frame(const uint8_t* buffer, uint32_t total_sz);
+
+    PacketSender* sender_;
+    NetworkInterface iface_;
+    PacingMode mode_;
+    double multiplier_;
+    double rate_;
+    double bucket_depth_;
+    double tokens_;
+    duration_type spin_threshold_;
+    bool started_;
+    time_point first_send_time_;
+    time_point last_refill_time_;
+    std::chrono::microseconds first_timestamp_;
+    Statistics stats_;
+};
+
+} // Tins
+
+#endif // TINS_IS_CXX11
+
+#endif // TINS_PACKET_REPLAYER_H
@@ -35,6 +35,7 @@
 #include <vector>
 #include <stdint.h>
 #include <map>
+#include <algorithm>
 #include <tins/config.h>
 #ifdef TINS_HAVE_PACKET_SENDER_PCAP_SENDPACKET
     #include <pcap.h>
@@ -49,6 +50,7 @@ struct sockaddr;
 namespace Tins {
 
 class PDU;
+class PacketTemplate;
 
 /**
  * \class PacketSender
@@ -109,6 +111,19 @@ class PDU;
  * PacketSender also supports sending a packet and waiting for a response.
  * This can be done by using PacketSender::send_recv.
  *
+ * Packets can also be sent in batches. PacketSender::queue serializes
+ * a packet into an internal buffer, which is reused across batches, and
+ * PacketSender::flush sends every queued packet, using as few system calls
+ * as the platform allows:
+ *
+ * \code
+ * for (size_t i = 0; i < packets.size(); ++i) {
+ *     sender.queue(packets[i], "eth0");
+ * }
+ * PacketSender::BatchResult result = sender.flush();
+ * std::cout << result.sent << " packets sent, " << result.failed << " failed\n";
+ * \endcode
+ *
  * This class opens sockets as it needs to, and closes them when the object
  * is destructed.
  *
@@ -137,6 +152,37 @@ public:
         SOCKETS_END
     };
 
+    /**
+     * \brief The result of sending a batch of packets.
+     *
+     * \sa PacketSender::flush
+     */
+    struct BatchResult {
+        BatchResult() : sent(0), failed(0) { }
+
+        /**
+         * The amount of packets that were sent.
+         */
+        size_t sent;
+
+        /**
+         * The amount of packets that couldn't be sent.
+         */
+        size_t failed;
+    };
+
+    #ifdef TINS_HAVE_PACKET_TX_RING
+    /**
+     * The default amount of frames in a TX ring.
+     */
+    static const uint32_t DEFAULT_TX_RING_FRAMES;
+
+    /**
+     * The default size of each frame in a TX ring.
+     */
+    static const uint32_t DEFAULT_TX_RING_FRAME_SIZE;
+    #endif // TINS_HAVE_PACKET_TX_RING
+
     /**
      * \brief Constructor for PacketSender objects.
      * 
@@ -152,7 +198,8 @@ public:
          * \brief Move constructor.
          * \param rhs The sender to be moved.
          */
-        PacketSender(PacketSender &&rhs) TINS_NOEXCEPT {
+        PacketSender(PacketSender &&rhs) TINS_NOEXCEPT
+        : queued_frames_(0), batching_(false), tx_ring_(0) {
             *this = std::move(rhs);
         }
         
@@ -175,6 +222,9 @@ public:
             _timeout = rhs._timeout;
             timeout_usec_ = rhs.timeout_usec_;
             default_iface_ = rhs.default_iface_;
+            batch_frames_.swap(rhs.batch_frames_);
+            std::swap(queued_frames_, rhs.queued_frames_);
+            std::swap(tx_ring_, rhs.tx_ring_);
             return* this;
         }
     #endif
@@ -270,6 +320,27 @@ public:
      */
     void send(PDU& pdu, const NetworkInterface& iface);
 
+    /**
+     * \brief Sends a pre-serialized packet.
+     *
+     * The packet's serialized buffer is sent as is. If the packet starts
+     * with a link layer protocol, then default_interface is used.
+     *
+     * If any send error occurs, then a socket_write_error is thrown.
+     *
+     * \param packet The packet to be sent.
+     */
+    void send(const PacketTemplate& packet);
+
+    /**
+     * \brief Sends a pre-serialized packet through an interface.
+     *
+     * \sa PacketSender::send(const PacketTemplate&)
+     * \param packet The packet to be sent.
+     * \param iface The network interface to use.
+     */
+    void send(const PacketTemplate& packet, const NetworkInterface& iface);
+
     /** 
      * \brief Sends a PDU and waits for its response. 
      * 
@@ -306,6 +377,139 @@ public:
      */
     PDU* send_recv(PDU& pdu, const NetworkInterface& iface);
 
+    /**
+     * \brief Queues a PDU to be sent on the next call to PacketSender::flush.
+     *
+     * The PDU is serialized right away, so it can be modified or destroyed
+     * as soon as this method returns. Serialization buffers are kept and 
+     * reused on later batches, so queueing doesn't allocate once the buffer
+     * pool has grown to fit the batches being sent.
+     *
+     * Sockets are opened as required, just like PacketSender::send does.
+     * 
+     * If the PDU contains a link layer protocol, then default_interface
+     * is used.
+     *
+     * \param pdu The PDU to be queued.
+     */
+    void queue(PDU& pdu);
+
+    /**
+     * \brief Queues a PDU to be sent on the next call to PacketSender::flush.
+     *
+     * This overload takes a NetworkInterface. The packet is sent
+     * through that interface if a link-layer PDU is present, 
+     * otherwise this call is equivalent to queue(PDU&).
+     *
+     * \sa PacketSender::queue(PDU&)
+     * \param pdu The PDU to be queued.
+     * \param iface The network interface to use.
+     */
+    void queue(PDU& pdu, const NetworkInterface& iface);
+
+    /**
+     * \brief Queues a pre-serialized packet to be sent on the next flush.
+     *
+     * The packet's buffer is copied, so it can be modified as soon as 
+     * this method returns.
+     *
+     * \sa PacketSender::queue(PDU&)
+     * \param packet The packet to be queued.
+     */
+    void queue(const PacketTemplate& packet);
+
+    /**
+     * \brief Queues a pre-serialized packet to be sent on the next flush.
+     *
+     * \sa PacketSender::queue(PDU&, const NetworkInterface&)
+     * \param packet The packet to be queued.
+     * \param iface The network interface to use.
+     */
+    void queue(const PacketTemplate& packet, const NetworkInterface& iface);
+
+    /**
+     * \brief Sends all queued packets.
+     *
+     * Packets are sent in the order they were queued. Where available,
+     * consecutive packets that go through the same socket are submitted
+     * using a single sendmmsg call, while layer 2 packets that go through
+     * an interface with a TX ring enabled are written into the ring and 
+     * transmitted using a single system call. Otherwise packets are sent 
+     * one at a time.
+     *
+     * Unlike PacketSender::send, this method doesn't throw on write errors.
+     * Packets that can't be sent are counted in the returned BatchResult
+     * and the rest of the batch is still sent. This includes packets that
+     * serialized to no bytes, which are never sent. The queue is always
+     * empty after this call, and every packet that was queued is counted
+     * as either sent or failed.
+     *
+     * \return The amount of packets that were sent and that failed.
+     */
+    BatchResult flush();
+
+    /**
+     * \brief Sends a range of PDUs as a single batch.
+     *
+     * Every PDU in the range is queued and then PacketSender::flush is 
+     * called. If queueing a PDU throws, the PDUs queued before it are kept
+     * in the queue.
+     *
+     * \param start The beginning of the range of PDUs.
+     * \param end The end of the range of PDUs.
+     * \return The amount of packets that were sent and that failed.
+     */
+    template <typename ForwardIterator>
+    BatchResult send_batch(ForwardIterator start, ForwardIterator end) {
+        for (; start != end; ++start) {
+            queue(*start);
+        }
+        return flush();
+    }
+
+    /**
+     * \brief Retrieves the amount of packets waiting to be flushed.
+     */
+    size_t queued_packets() const;
+
+    /**
+     * \brief Discards all queued packets without sending them.
+     */
+    void clear_queue();
+
+    #ifdef TINS_HAVE_PACKET_TX_RING
+    /**
+     * \brief Enables a PACKET_TX_RING for the given interface.
+     *
+     * Once enabled, layer 2 packets flushed through this interface are 
+     * written into a ring buffer shared with the kernel and sent using
+     * a single system call per batch. Packets that don't fit in a frame
+     * are sent through the regular layer 2 socket.
+     *
+     * Note that frames sent through the ring are counted as sent in 
+     * BatchResult once the kernel is done with them. Frames the kernel 
+     * discards as malformed are skipped rather than aborting the batch, so
+     * they are counted as sent as well.
+     *
+     * Only one ring can be enabled at a time; enabling a new one replaces
+     * the previous one. If the ring can't be set up, a socket_open_error 
+     * is thrown.
+     *
+     * \param iface The interface the ring will send packets through.
+     * \param frame_count The amount of frames in the ring.
+     * \param frame_size The size of each frame, including the kernel's 
+     * frame header. This must be a multiple of 16.
+     */
+    void enable_tx_ring(const NetworkInterface& iface,
+                        uint32_t frame_count = DEFAULT_TX_RING_FRAMES,
+                        uint32_t frame_size = DEFAULT_TX_RING_FRAME_SIZE);
+
+    /**
+     * \brief Disables the TX ring, if any.
+     */
+    void disable_tx_ring();
+    #endif // TINS_HAVE_PACKET_TX_RING
+
     #ifndef _WIN32
     /** 
      * \brief Receives a layer 2 PDU response to a previously sent PDU.
@@ -344,6 +548,20 @@ public:
      */
     void send_l2(PDU& pdu, struct sockaddr* link_addr, uint32_t len_addr, 
       const NetworkInterface& iface = NetworkInterface());
+
+    /** 
+     * \brief Sends a serialized level 2 packet.
+     *
+     * This method is used internally. You should just use PacketSender::send.
+     *
+     * \sa PacketSender::send_l2(PDU&, struct sockaddr*, uint32_t, const NetworkInterface&)
+     * \param buffer The serialized packet.
+     * \param total_sz The size of the serialized packet.
+     * \param link_addr The sockaddr struct which will be used to send the packet.
+     * \param len_addr The sockaddr struct length.
+     */
+    void send_l2(const uint8_t* buffer, uint32_t total_sz, struct sockaddr* link_addr,
+      uint32_t len_addr, const NetworkInterface& iface = NetworkInterface());
     #endif // !_WIN32 || TINS_HAVE_PACKET_SENDER_PCAP_SENDPACKET
 
     /** 
@@ -378,11 +596,41 @@ public:
      * \param type The socket protocol type.
      */
     void send_l3(PDU& pdu, struct sockaddr* link_addr, uint32_t len_addr, SocketType type);
+
+    /** 
+     * \brief Sends a serialized level 3 packet.
+     *
+     * This method is used internally. You should just use PacketSender::send.
+     *
+     * \sa PacketSender::send_l3(PDU&, struct sockaddr*, uint32_t, SocketType)
+     * \param buffer The serialized packet.
+     * \param total_sz The size of the serialized packet.
+     * \param link_addr The sockaddr struct which will be used to send the packet.
+     * \param len_addr The sockaddr struct length.
+     * \param type The socket protocol type.
+     */
+    void send_l3(const uint8_t* buffer, uint32_t total_sz, struct sockaddr* link_addr,
+                 uint32_t len_addr, SocketType type);
 private:
     static const int INVALID_RAW_SOCKET;
 
     typedef std::map<SocketType, int> SocketTypeMap;
 
+    // A packet serialized by PacketSender::queue
+    struct BatchFrame {
+        std::vector<uint8_t> buffer;
+        // Large enough to hold a sockaddr_storage
+        uint8_t address[128];
+        uint32_t address_length;
+        int socket;
+        NetworkInterface iface;
+        bool is_layer_2;
+    };
+
+    typedef std::vector<BatchFrame> BatchFrames;
+
+    struct TxRing;
+
     PacketSender(const PacketSender&);
     PacketSender& operator=(const PacketSender&);
     int find_type(SocketType type);
@@ -398,6 +646,16 @@ private:
         pcap_t* make_pcap_handle(const NetworkInterface& iface) const;
     #endif // TINS_HAVE_PACKET_SENDER_PCAP_SENDPACKET
     
+    void queue_frame(PDU* pdu, const uint8_t* buffer, uint32_t total_sz,
+                     struct sockaddr* link_addr, uint32_t len_addr, int sock,
+                     const NetworkInterface& iface, bool is_layer_2);
+    bool send_frame(BatchFrame& frame);
+    void send_frames(size_t start, size_t end, BatchResult& result);
+    #ifdef TINS_HAVE_PACKET_TX_RING
+        bool fits_tx_ring(const BatchFrame& frame) const;
+        void send_tx_ring_frames(size_t start, size_t end, BatchResult& result);
+    #endif // TINS_HAVE_PACKET_TX_RING
+    
     PDU* recv_match_loop(const std::vector<int>& sockets, 
                          PDU& pdu,
                          struct sockaddr* link_addr, 
@@ -424,6 +682,10 @@ private:
         typedef std::map<NetworkInterface, pcap_t*> PcapHandleMap; 
         PcapHandleMap pcap_handles_;
     #endif // TINS_HAVE_PACKET_SENDER_PCAP_SENDPACKET
+    BatchFrames batch_frames_;
+    size_t queued_frames_;
+    bool batching_;
+    TxRing* tx_ring_;
 };
 
 } // Tins
@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_PACKET_TEMPLATE_H
+#define TINS_PACKET_TEMPLATE_H
+
+#include <vector>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/hw_address.h>
+#include <tins/ip_address.h>
+#include <tins/ipv6_address.h>
+#include <tins/network_interface.h>
+
+namespace Tins {
+
+class PDU;
+class PacketSender;
+
+/**
+ * \class PacketTemplate
+ * \brief A serialized packet whose fields can be modified in place.
+ *
+ * When generating traffic, usually only a few fields change from one
+ * packet to the next. Building and serializing a whole PDU chain for each
+ * of them is wasteful, so this class serializes a PDU chain once and then
+ * allows modifying some of its fields directly on the serialized buffer.
+ *
+ * Every time a field or the payload is modified, the checksums that cover
+ * it (the IP header checksum and the TCP, UDP, ICMP or ICMPv6 checksum)
+ * are updated incrementally, as described in RFC 1624, rather than being
+ * recalculated.
+ *
+ * Only the fields in the first Ethernet, IP or IPv6 and TCP, UDP, ICMP or
+ * ICMPv6 PDUs in the chain can be modified.
+ *
+ * \code
+ * EthernetII eth = EthernetII(dst_hw, src_hw) / IP("192.168.0.1", "192.168.0.2") /
+ *                  UDP(53, 1024) / RawPDU("payload");
+ * PacketTemplate packet(eth);
+ * for (uint16_t port = 1024; port < 2048; ++port) {
+ *     packet.sport(port);
+ *     packet.ip_id(port);
+ *     sender.send(packet, "eth0");
+ * }
+ * \endcode
+ */
+class TINS_API PacketTemplate {
+public:
+    /**
+     * The type used to store the serialized packet.
+     */
+    typedef std::vector<uint8_t> buffer_type;
+
+    /**
+     * The fields that can be modified.
+     */
+    enum Field {
+        ETH_DST_ADDR,
+        ETH_SRC_ADDR,
+        IPV4_ID,
+        IPV4_TTL,
+        IPV4_SRC_ADDR,
+        IPV4_DST_ADDR,
+        IPV6_HOP_LIMIT,
+        IPV6_SRC_ADDR,
+        IPV6_DST_ADDR,
+        SPORT,
+        DPORT,
+        TCP_SEQ,
+        TCP_ACK_SEQ,
+        TCP_WINDOW,
+        ICMP_ID,
+        ICMP_SEQUENCE
+    };
+
+    /**
+     * \brief Constructs a PacketTemplate from a PDU chain.
+     *
+     * The PDU is serialized and the location of every supported field
+     * is recorded. ICMP and ICMPv6 identifier and sequence fields are
+     * only available on echo, timestamp and address mask messages.
+     *
+     * \param pdu The PDU to be serialized.
+     */
+    explicit PacketTemplate(PDU& pdu);
+
+    /**
+     * \brief Indicates whether the given field is present in this packet.
+     *
+     * \param field The field to be checked.
+     */
+    bool has_field(Field field) const;
+
+    /**
+     * \brief Retrieves the offset of a field within the serialized packet.
+     *
+     * If the field is not present, a field_not_present exception is thrown.
+     *
+     * \param field The field to be looked up.
+     */
+    uint32_t field_offset(Field field) const;
+
+    /**
+     * \brief Retrieves the size of a field.
+     *
+     * If the field is not present, a field_not_present exception is thrown.
+     *
+     * \param field The field to be looked up.
+     */
+    uint32_t field_size(Field field) const;
+
+    /**
+     * \brief Overwrites a field.
+     *
+     * The field's checksums are updated. If the field is not present, a
+     * field_not_present exception is thrown.
+     *
+     * \param field The field to be modified.
+     * \param data The new value of the field, in network byte order. This
+     * has to contain field_size(field) bytes.
+     */
+    void patch(Field field, const uint8_t* data);
+
+    /**
+     * \brief Overwrites part of the payload.
+     *
+     * The payload is whatever follows the transport layer header or, if
+     * there's no transport layer, the network layer header. The transport
+     * layer checksum is updated. If the range doesn't fit in the payload,
+     * a serialization_error exception is thrown.
+     *
+     * \param offset The offset within the payload to write to.
+     * \param data The data to be written.
+     * \param size The amount of bytes to be written.
+     */
+    void write_payload(uint32_t offset, const uint8_t* data, uint32_t size);
+
+    /**
+     * \brief Setter for the Ethernet destination address.
+     * \param value The new destination address.
+     */
+    void eth_dst_addr(const HWAddress<6>& value);
+
+    /**
+     * \brief Setter for the Ethernet source address.
+     * \param value The new source address.
+     */
+    void eth_src_addr(const HWAddress<6>& value);
+
+    /**
+     * \brief Setter for the IP identification field.
+     * \param value The new identification.
+     */
+    void ip_id(uint16_t value);
+
+    /**
+     * \brief Setter for the IP time to live field.
+     * \param value The new time to live.
+     */
+    void ip_ttl(uint8_t value);
+
+    /**
+     * \brief Setter for the IP source address.
+     * \param value The new source address.
+     */
+    void ip_src_addr(IPv4Address value);
+
+    /**
+     * \brief Setter for the IP destination address.
+     * \param value The new destination address.
+     */
+    void ip_dst_addr(IPv4Address value);
+
+    /**
+     * \brief Setter for the IPv6 hop limit field.
+     * \param value The new hop limit.
+     */
+    void ipv6_hop_limit(uint8_t value);
+
+    /**
+     * \brief Setter for the IPv6 source address.
+     * \param value The new source address.
+     */
+    void ipv6_src_addr(const IPv6Address& value);
+
+    /**
+     * \brief Setter for the IPv6 destination address.
+     * \param value The new destination address.
+     */
+    void ipv6_dst_addr(const IPv6Address& value);
+
+    /**
+     * \brief Setter for the TCP or UDP source port.
+     * \param value The new source port.
+     */
+    void sport(uint16_t value);
+
+    /**
+     * \brief Setter for the TCP or UDP destination port.
+     * \param value The new destination port.
+     */
+    void dport(uint16_t value);
+
+    /**
+     * \brief Setter for the TCP sequence number.
+     * \param value The new sequence number.
+     */
+    void seq(uint32_t value);
+
+    /**
+     * \brief Setter for the TCP acknowledgement number.
+     * \param value The new acknowledgement number.
+     */
+    void ack_seq(uint32_t value);
+
+    /**
+     * \brief Setter for the TCP window size.
+     * \param value The new window size.
+     */
+    void window(uint16_t value);
+
+    /**
+     * \brief Setter for the ICMP or ICMPv6 identifier.
+     * \param value The new identifier.
+     */
+    void icmp_id(uint16_t value);
+
+    /**
+     * \brief Setter for the ICMP or ICMPv6 sequence number.
+     * \param value The new sequence number.
+     */
+    void icmp_sequence(uint16_t value);
+
+    /**
+     * \brief Retrieves the offset of the payload within the serialized packet.
+     */
+    uint32_t payload_offset() const {
+        return payload_offset_;
+    }
+
+    /**
+     * \brief Retrieves the size of the payload.
+     */
+    uint32_t payload_size() const {
+        return payload_size_;
+    }
+
+    /**
+     * \brief Retrieves the serialized packet.
+     */
+    const buffer_type& buffer() const {
+        return buffer_;
+    }
+
+    /**
+     * \brief Retrieves a pointer to the serialized packet.
+     *
+     * This is a null pointer if the packet is empty.
+     */
+    const uint8_t* data() const {
+        return buffer_.empty() ? 0 : &buffer_[0];
+    }
+
+    /**
+     * \brief Retrieves the size of the serialized packet.
+     */
+    uint32_t size() const {
+        return static_cast<uint32_t>(buffer_.size());
+    }
+
+    /**
+     * \brief Sends the serialized packet.
+     *
+     * This method is used internally. You should just use PacketSender::send.
+     *
+     * Packets that start with an IP or IPv6 header are sent through a layer
+     * 3 socket, any other one is sent through the given interface.
+     *
+     * \param sender The PacketSender to use.
+     * \param iface The interface to use.
+     */
+    void send(PacketSender& sender, const NetworkInterface& iface) const;
+private:
+    static const unsigned FIELD_COUNT = ICMP_SEQUENCE + 1;
+    static const uint32_t NOT_PRESENT = 0xffffffff;
+
+    enum NetworkType {
+        NO_NETWORK,
+        NETWORK_IPV4,
+        NETWORK_IPV6
+    };
+
+    enum TransportType {
+        NO_TRANSPORT,
+        TRANSPORT_TCP,
+        TRANSPORT_UDP,
+        TRANSPORT_ICMP,
+        TRANSPORT_ICMPV6
+    };
+
+    void record_field(Field field, uint32_t offset, uint32_t size);
+    void update_checksum(uint32_t checksum_offset, uint32_t region_offset,
+                         uint32_t offset, const uint8_t* data, uint32_t size,
+                         bool is_udp);
+    void write(uint32_t offset, const uint8_t* data, uint32_t size,
+               bool ip_checksum, uint32_t transport_region_offset);
+    bool has_pseudo_header() const;
+
+    buffer_type buffer_;
+    uint32_t field_offsets_[FIELD_COUNT];
+    uint8_t field_sizes_[FIELD_COUNT];
+    NetworkType network_type_;
+    TransportType transport_type_;
+    bool starts_at_network_layer_;
+    uint32_t network_offset_;
+    uint32_t transport_offset_;
+    uint32_t payload_offset_;
+    uint32_t payload_size_;
+};
+
+} // Tins
+
+#endif // TINS_PACKET_TEMPLATE_H
@@ -44,6 +44,7 @@ struct timeval;
 namespace Tins {
 class PDU;
 class Packet;
+class Timestamp;
 
 /**
  * \class PacketWriter
@@ -179,11 +180,46 @@ public:
      * \brief Writes a Packet to this file. 
      *
      * The timestamp used on the entry for this packet will be the Timestamp
-     * object associated with this packet.
+     * object associated with this packet. If the packet holds the bytes it
+     * was captured from, those are written instead of serializing its PDU.
      *
      * \param packet The packet to be written.
      */
     void write(Packet& packet);
+
+    /**
+     * \brief Writes a serialized packet to this file.
+     *
+     * The buffer is written as is, which allows writing packets that were
+     * serialized beforehand, such as the contents of a PacketTemplate.
+     * The current time is used as the packet's timestamp.
+     *
+     * \param buffer The serialized packet.
+     * \param total_sz The size of the serialized packet.
+     */
+    void write(const uint8_t* buffer, uint32_t total_sz);
+
+    /**
+     * \brief Writes a serialized packet to this file.
+     *
+     * \sa PacketWriter::write(const uint8_t*, uint32_t)
+     * \param buffer The serialized packet.
+     * \param total_sz The size of the serialized packet.
+     * \param timestamp The timestamp to use on the entry for this packet.
+     */
+    void write(const uint8_t* buffer, uint32_t total_sz, const Timestamp& timestamp);
+
+    /**
+     * \brief Writes a serialized packet that was truncated when captured.
+     *
+     * \sa PacketWriter::write(const uint8_t*, uint32_t)
+     * \param buffer The serialized packet.
+     * \param total_sz The size of the serialized packet.
+     * \param original_sz The size of the packet on the wire.
+     * \param timestamp The timestamp to use on the entry for this packet.
+     */
+    void write(const uint8_t* buffer, uint32_t total_sz, uint32_t original_sz,
+               const Timestamp& timestamp);
     
     /**
      * \brief Writes a PDU to this file. 
@@ -217,6 +253,8 @@ private:
 
     void init(const std::string& file_name, int link_type);
     void write(PDU& pdu, const struct timeval& tv);
+    void write(const uint8_t* buffer, uint32_t total_sz, uint32_t original_sz,
+               const struct timeval& tv);
 
     pcap_t* handle_;
     pcap_dumper_t* dumper_; 
@@ -351,6 +351,17 @@ public:
      */
     serialization_type serialize();
 
+    /**
+     * \brief Serializes the whole chain of PDU's into the given buffer.
+     *
+     * The buffer is resized to size() before serializing. Since its
+     * storage is reused, calling this repeatedly on the same buffer
+     * avoids allocating once its capacity is large enough.
+     *
+     * \param buffer The buffer in which to store the serialization.
+     */
+    void serialize(serialization_type& buffer);
+
     /**
      * \brief Finds and returns the first PDU that matches the given flag.
      *
@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_PROBE_ENGINE_H
+#define TINS_PROBE_ENGINE_H
+
+#include <tins/config.h>
+#include <tins/cxxstd.h>
+
+#if defined(TINS_HAVE_EPOLL) && TINS_IS_CXX11
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/network_interface.h>
+
+namespace Tins {
+
+class PDU;
+class PacketSender;
+
+/**
+ * \class ProbeEngine
+ * \brief Sends probes and matches their responses asynchronously.
+ *
+ * Unlike PacketSender::send_recv, which sends a single packet and blocks
+ * until its response arrives, this class allows keeping any number of
+ * probes in flight. Every probe has a deadline and a callback which is
+ * executed once, either when its response arrives or when it times out.
+ *
+ * Responses are read from a packet socket which is multiplexed using epoll,
+ * and looked up in a hash table of outstanding probes. The key used is 
+ * derived from the same fields PDU::matches_response looks at: the swapped
+ * addresses, the swapped ports for TCP and UDP, the identifier and sequence
+ * number for ICMP and ICMPv6 queries and the sender and target addresses 
+ * for ARP. The key only narrows down the candidates: a response completes
+ * a probe only if the probe's PDU::matches_response accepts it. ICMP and
+ * ICMPv6 errors (e.g. port unreachable or time exceeded) are matched using
+ * the probe headers they carry. Probes that can't be keyed, like those sent
+ * to a broadcast or multicast address, are checked one by one using 
+ * PDU::matches_response.
+ *
+ * Responses are always handed to callbacks starting at the network layer
+ * (IP, IPv6 or ARP), even if the probe contained a link layer PDU.
+ *
+ * \code
+ * PacketSender sender;
+ * ProbeEngine engine(sender);
+ * for (int port = 1; port < 1024; ++port) {
+ *     IP probe = IP("192.168.0.1") / TCP(port, 1337);
+ *     probe.rfind_pdu<TCP>().set_flag(TCP::SYN, 1);
+ *     engine.send(probe, [](ProbeEngine::probe_id, const PDU& probe, PDU* response) {
+ *         // response is null if the probe timed out
+ *     });
+ * }
+ * // Process responses until every probe completed
+ * engine.run();
+ * \endcode
+ *
+ * This class is only available on Linux.
+ */
+class TINS_API ProbeEngine {
+public:
+    /**
+     * The type used to identify probes.
+     */
+    typedef uint64_t probe_id;
+
+    /**
+     * The type used to represent durations.
+     */
+    typedef std::chrono::milliseconds duration_type;
+
+    /**
+     * \brief The type of the probe completion callbacks.
+     *
+     * The arguments are the probe's identifier, the probe itself and
+     * the response PDU, which is null if the probe timed out. Both PDUs
+     * are destroyed after the callback returns.
+     */
+    typedef std::function<void(probe_id, const PDU&, PDU*)> callback_type;
+
+    /**
+     * The default timeout for each probe.
+     */
+    static const duration_type DEFAULT_TIMEOUT;
+
+    /**
+     * \brief Constructs a ProbeEngine.
+     *
+     * The receive socket is opened when it's first needed, so no special
+     * privileges are required until probes are sent or polled for.
+     *
+     * \param sender The PacketSender used to send probes.
+     * \param iface The interface in which responses are received. If it's
+     * the default constructed interface, responses are received on every
+     * interface.
+     */
+    ProbeEngine(PacketSender& sender, const NetworkInterface& iface = NetworkInterface());
+
+    /**
+     * \brief Destructor.
+     *
+     * Outstanding probes are dropped without executing their callbacks.
+     */
+    ~ProbeEngine();
+
+    /**
+     * \brief Sends a probe and tracks it until it completes.
+     *
+     * The probe is sent using PacketSender::send. Any exception thrown
+     * while sending it is propagated and the probe isn't tracked.
+     *
+     * \param probe The probe to be sent.
+     * \param callback The callback to execute once the probe completes.
+     * \param timeout The time to wait for a response.
+     * \return The identifier assigned to the probe.
+     */
+    probe_id send(PDU& probe, callback_type callback,
+                  duration_type timeout = DEFAULT_TIMEOUT);
+
+    /**
+     * \brief Sends a probe through an interface and tracks it.
+     *
+     * \sa ProbeEngine::send(PDU&, callback_type, duration_type)
+     * \param probe The probe to be sent.
+     * \param iface The interface to send the probe through.
+     * \param callback The callback to execute once the probe completes.
+     * \param timeout The time to wait for a response.
+     * \return The identifier assigned to the probe.
+     */
+    probe_id send(PDU& probe, const NetworkInterface& iface, callback_type callback,
+                  duration_type timeout = DEFAULT_TIMEOUT);
+
+    /**
+     * \brief Tracks a probe that was sent by other means.
+     *
+     * This allows matching responses to probes sent, for example, using
+     * PacketSender::flush. The probe must be the same one that was sent,
+     * after being sent, since fields like the IP source address are only
+     * filled in when serializing it.
+     *
+     * \param probe The probe to be tracked. It's cloned.
+     * \param callback The callback to execute once the probe completes.
+     * \param timeout The time to wait for a response.
+     * \return The identifier assigned to the probe.
+     */
+    probe_id expect(const PDU& probe, callback_type callback,
+                    duration_type timeout = DEFAULT_TIMEOUT);
+
+    /**
+     * \brief Stops tracking a probe without executing its callback.
+     *
+     * \param id The identifier of the probe.
+     * \return true iff the probe was outstanding.
+     */
+    bool cancel(probe_id id);
+
+    /**
+     * \brief Processes responses and timeouts.
+     *
+     * This waits at most the given time for responses to arrive, though
+     * it will return earlier if the next deadline is reached first. All
+     * responses read and all expired probes are processed before returning.
+     *
+     * \param max_wait The maximum time to wait.
+     * \return The amount of probes that completed.
+     */
+    size_t poll(duration_type max_wait);
+
+    /**
+     * \brief Processes responses and timeouts until no probes are outstanding.
+     *
+     * Callbacks can send new probes, which will also be waited for.
+     */
+    void run();
+
+    /**
+     * \brief Matches a network layer packet against the outstanding probes.
+     *
+     * This is called for every packet read from the receive socket. It can
+     * also be used to feed packets captured by other means, like a Sniffer.
+     *
+     * \param buffer The packet, starting at the network layer.
+     * \param total_sz The size of the packet.
+     * \param ether_type The Ethernet type of the packet (e.g. 0x0800 for IP).
+     * \return true iff the packet completed a probe.
+     */
+    bool process_packet(const uint8_t* buffer, uint32_t total_sz, uint16_t ether_type);
+
+    /**
+     * \brief Expires every probe whose deadline is not after the given time.
+     *
+     * \param now The current time, as given by std::chrono::steady_clock.
+     * \return The amount of probes that expired.
+     */
+    size_t expire(std::chrono::steady_clock::time_point now);
+
+    /**
+     * \brief Retrieves the amount of outstanding probes.
+     */
+    size_t outstanding_probes() const;
+
+    /**
+     * \brief Retrieves the epoll file descriptor.
+     *
+     * This can be registered on an external event loop; it becomes
+     * readable whenever a response may be available, at which point
+     * ProbeEngine::poll should be called. The receive socket is opened
+     * by this call if it wasn't open yet.
+     */
+    int file_descriptor();
+private:
+    typedef std::chrono::steady_clock clock_type;
+    typedef clock_type::time_point time_point;
+
+    // The fields of a probe that its responses carry, in probe order
+    struct ResponseKey {
+        ResponseKey();
+
+        bool operator==(const ResponseKey& rhs) const;
+
+        uint16_t ether_type;
+        uint8_t protocol;
+        uint8_t src_addr[16];
+        uint8_t dst_addr[16];
+        uint16_t first_id;
+        uint16_t second_id;
+    };
+
+    struct ResponseKeyHasher {
+        size_t operator()(const ResponseKey& key) const;
+    };
+
+    struct Probe {
+        std::unique_ptr<PDU> pdu;
+        // The network layer PDU within pdu
+        const PDU* network_pdu;
+        callback_type callback;
+        ResponseKey key;
+        bool keyed;
+        uint16_t ip_id;
+    };
+
+    typedef std::unordered_map<probe_id, Probe> ProbeMap;
+    typedef std::unordered_multimap<ResponseKey, probe_id, ResponseKeyHasher> ProbeIndex;
+    typedef std::pair<time_point, probe_id> Deadline;
+    typedef std::priority_queue<Deadline, std::vector<Deadline>,
+                                std::greater<Deadline> > DeadlineHeap;
+
+    ProbeEngine(const ProbeEngine&);
+    ProbeEngine& operator=(const ProbeEngine&);
+
+    static bool make_request_key(const PDU& network_pdu, ResponseKey& key,
+                                 uint16_t& ip_id);
+    static bool make_embedded_key(const uint8_t* buffer, uint32_t total_sz,
+                                  uint16_t ether_type, ResponseKey& key,
+                                  uint16_t& ip_id);
+    static bool make_response_key(const uint8_t* buffer, uint32_t total_sz,
+                                  uint16_t ether_type, ResponseKey& key,
+                                  bool& is_error, uint16_t& ip_id);
+    probe_id track(std::unique_ptr<PDU> probe, callback_type callback,
+                   duration_type timeout);
+    void open_socket();
+    void read_responses();
+    void complete(ProbeMap::iterator iter, const uint8_t* buffer,
+                  uint32_t total_sz, uint16_t ether_type);
+    void unindex(ProbeMap::iterator iter);
+
+    PacketSender* sender_;
+    NetworkInterface iface_;
+    int socket_;
+    int epoll_fd_;
+    probe_id next_id_;
+    size_t completed_;
+    ProbeMap probes_;
+    ProbeIndex index_;
+    std::vector<probe_id> unkeyed_probes_;
+    DeadlineHeap deadlines_;
+    std::vector<uint8_t> buffer_;
+};
+
+} // Tins
+
+#endif // TINS_HAVE_EPOLL && TINS_IS_CXX11
+
+#endif // TINS_PROBE_ENGINE_H
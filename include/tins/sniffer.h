@@ -240,6 +240,18 @@ public:
      */
     void set_extract_raw_pdus(bool value);
 
+    /**
+     * \brief Sets whether packets keep the bytes they were captured from.
+     *
+     * If the parameter is true, the Packets created from this sniffer
+     * hold a copy of their captured bytes, which writers and filters
+     * use instead of serializing the PDU again.
+     *
+     * \sa Packet::raw_frame
+     * \param value Whether to retain raw frames or not.
+     */
+    void set_retain_raw_frames(bool value);
+
     /**
      * \brief function pointer for the sniffing method
      *
@@ -314,6 +326,8 @@ private:
     pcap_t* handle_;
     bpf_u_int32 mask_;
     bool extract_raw_;
+    bool retain_raw_frames_;
+    Internals::SharedFrame raw_frame_;
     PcapSniffingMethod pcap_sniffing_method_;
 };
 
@@ -657,6 +671,12 @@ public:
      * \param value The timestamp option value.
      */
     void set_timestamp_precision(int value);
+
+    /**
+     * Sets whether packets keep the bytes they were captured from.
+     * \param enabled The retain raw frames option value.
+     */
+    void set_retain_raw_frames(bool enabled);
 protected:
     friend class Sniffer;
     friend class FileSniffer;
@@ -670,6 +690,7 @@ protected:
         DIRECTION = 32,
         TIMESTAMP_PRECISION = 64,
         PCAP_SNIFFING_METHOD = 128,
+        RETAIN_RAW_FRAMES = 256
     };
 
     void configure_sniffer_pre_activation(Sniffer& sniffer) const;
@@ -688,6 +709,7 @@ protected:
     bool immediate_mode_;
     pcap_direction_t direction_;
     int timestamp_precision_;
+    bool retain_raw_frames_;
 };
 
 template <typename Functor>
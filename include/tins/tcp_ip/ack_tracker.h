@@ -35,8 +35,8 @@
 #ifdef TINS_HAVE_ACK_TRACKER
 
 #include <vector>
-#include <boost/icl/interval_set.hpp>
 #include <tins/macros.h>
+#include <tins/tcp_ip/sack_scoreboard.h>
 
 namespace Tins {
 
@@ -51,7 +51,7 @@ namespace TCPIP {
  */
 class TINS_API AckedRange {
 public:
-    typedef boost::icl::discrete_interval<uint32_t> interval_type;
+    typedef SequenceInterval interval_type;
 
     /**
      * \brief Constructs an acked range
@@ -96,7 +96,7 @@ public:
     /**
      * The type used to store ACKed intervals
      */
-    typedef boost::icl::interval_set<uint32_t> interval_set_type;
+    typedef SackScoreboard interval_set_type;
 
     /**
      * Default constructor
@@ -140,7 +140,7 @@ public:
     bool is_segment_acked(uint32_t sequence_number, uint32_t length) const;
 private:
     void process_sack(const std::vector<uint32_t>& sack);
-    void cleanup_sacked_intervals(uint32_t old_ack, uint32_t new_ack);
+    void cleanup_sacked_intervals(uint32_t new_ack);
 
     interval_set_type acked_intervals_;
     uint32_t ack_number_;
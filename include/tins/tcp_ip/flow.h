@@ -36,10 +36,12 @@
 
 #include <array>
 #include <functional>
+#include <memory>
 #include <stdint.h>
 #include <tins/macros.h>
 #include <tins/tcp_ip/ack_tracker.h>
 #include <tins/tcp_ip/data_tracker.h>
+#include <tins/tcp_ip/flow_metrics.h>
 
 namespace Tins {
 
@@ -91,6 +93,11 @@ public:
      */
     typedef DataTracker::buffered_payload_type buffered_payload_type;
 
+    /**
+     * The type used to represent timestamps
+     */
+    typedef FlowMetrics::timestamp_type timestamp_type;
+
     /**
      * The type used to store the callback called when new data is available
      */
@@ -126,6 +133,26 @@ public:
     Flow(const IPv6Address& dst_address, uint16_t dst_port,
          uint32_t sequence_number);
 
+    /**
+     * \brief Copy constructor.
+     */
+    Flow(const Flow& other);
+
+    /**
+     * \brief Copy assignment operator.
+     */
+    Flow& operator=(const Flow& other);
+
+    /**
+     * \brief Move constructor.
+     */
+    Flow(Flow&& other) = default;
+
+    /**
+     * \brief Move assignment operator.
+     */
+    Flow& operator=(Flow&& other) = default;
+
     /**
      * \brief Sets the callback that will be executed when data is readable
      *
@@ -156,12 +183,38 @@ public:
      * If this packet contains out-of-order data, it will be buffered and the
      * buffering_callback will be executed.
      *
+     * Since there's no timestamp, this flow's metrics are not updated.
+     *
      * \param pdu The packet to be processed
      * \sa Flow::data_callback
      * \sa Flow::buffering_callback
      */
     void process_packet(PDU& pdu);
 
+    /**
+     * \brief Processes a packet using the given timestamp.
+     *
+     * This behaves exactly as process_packet(PDU&), but the timestamp is used
+     * to update this flow's metrics, in case they're enabled.
+     *
+     * \param pdu The packet to be processed
+     * \param ts The packet's timestamp
+     * \sa Flow::enable_metrics
+     */
+    void process_packet(PDU& pdu, const timestamp_type& ts);
+
+    /**
+     * \brief Processes a packet sent by this flow's peer.
+     *
+     * The packet's ACK number is used to update this flow's metrics. If 
+     * metrics are not enabled, this does nothing.
+     *
+     * \param pdu The packet to be processed
+     * \param ts The packet's timestamp
+     * \sa Flow::enable_metrics
+     */
+    void process_peer_packet(const PDU& pdu, const timestamp_type& ts);
+
     /**
      * \brief Skip forward to a sequence number
      *
@@ -287,8 +340,7 @@ public:
     /** 
      * \brief Enables tracking of ACK numbers
      *
-     * This requires having the boost.icl library. If the library is not installed
-     * or ACK tracking was disabled when compiling the library, then this method
+     * If ACK tracking was disabled when compiling the library, then this method
      * will throw an exception.
      */
     void enable_ack_tracking();
@@ -298,6 +350,31 @@ public:
      */
     bool ack_tracking_enabled() const;
 
+    /**
+     * \brief Enables tracking of this flow's metrics
+     *
+     * Note that RTT samples are computed using ACKs sent by this flow's peer,
+     * so metrics are best enabled through Stream::enable_metrics.
+     *
+     * Metrics are only allocated once enabled, so flows that don't use them
+     * don't pay for them.
+     *
+     * \sa FlowMetrics
+     */
+    void enable_metrics();
+
+    /**
+     * \brief Indicates whether metrics tracking is enabled
+     */
+    bool metrics_enabled() const;
+
+    /**
+     * \brief Retrieves the metrics for this Flow
+     *
+     * If metrics are not enabled, this returns an empty FlowMetrics object.
+     */
+    const FlowMetrics& metrics() const;
+
     #ifdef TINS_HAVE_ACK_TRACKER
     /**
      * Retrieves the ACK tracker for this Flow (const)
@@ -322,6 +399,7 @@ private:
                  ack_tracking:1;
     };
 
+    void process_packet(PDU& pdu, const timestamp_type* ts);
     void update_state(const TCP& tcp);
     void initialize();
 
@@ -333,6 +411,7 @@ private:
     State state_;
     int mss_;
     flags flags_;
+    std::unique_ptr<FlowMetrics> metrics_;
     #ifdef TINS_HAVE_ACK_TRACKER
     AckTracker ack_tracker_;
     #endif // TINS_HAVE_ACK_TRACKER
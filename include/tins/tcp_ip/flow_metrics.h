@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_TCP_IP_FLOW_METRICS_H
+#define TINS_TCP_IP_FLOW_METRICS_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <chrono>
+#include <stdint.h>
+#include <tins/macros.h>
+
+namespace Tins {
+
+class TCP;
+
+namespace TCPIP {
+
+class DataTracker;
+
+/**
+ * \brief Keeps health metrics for an unidirectional TCP flow
+ *
+ * The metrics are updated incrementally as packets are processed by the 
+ * owning Flow, so no second pass over the captured packets is needed. All
+ * metrics are computed from the point of view of the capture point: 
+ * 
+ * * The handshake RTT is the time between this flow's SYN and the packet that
+ *   acknowledged it. For the client flow this is the SYN to SYN/ACK time, for 
+ *   the server flow it's the SYN/ACK to ACK time.
+ * * Data RTT samples are taken using Karn's algorithm: a single segment is 
+ *   timed at a time and the sample is discarded if that segment is 
+ *   retransmitted before being acknowledged.
+ * * Retransmitted segments are the ones that only carry data that was 
+ *   already seen. Out of order segments are the ones that start after the 
+ *   next expected sequence number. Both of these require the flow not to 
+ *   ignore data packets.
+ * * Zero window events are counted every time this flow's sender starts 
+ *   advertising a zero receive window.
+ * * Bytes in flight is the amount of sequence space sent by this flow's 
+ *   sender that hasn't been acknowledged by its peer yet.
+ *
+ * \sa Flow::enable_metrics
+ */
+class TINS_API FlowMetrics {
+public:
+    /**
+     * The type used to represent timestamps and durations
+     */
+    typedef std::chrono::microseconds timestamp_type;
+
+    /**
+     * Default constructs an instance
+     */
+    FlowMetrics();
+
+    /**
+     * \brief Processes a segment sent by this flow's sender
+     *
+     * \param tcp The segment's TCP header
+     * \param payload_size The size of the segment's payload
+     * \param tracker The data tracker, in the state before processing this 
+     * segment's payload. If null, segments won't be classified as retransmitted
+     * or out of order.
+     * \param ts The segment's timestamp
+     */
+    void process_segment(const TCP& tcp, uint32_t payload_size, const DataTracker* tracker,
+                         const timestamp_type& ts);
+
+    /**
+     * \brief Processes a segment sent by this flow's peer
+     *
+     * This uses the segment's ACK number to compute RTT samples and bytes in flight.
+     *
+     * \param tcp The segment's TCP header
+     * \param ts The segment's timestamp
+     */
+    void process_ack(const TCP& tcp, const timestamp_type& ts);
+
+    /**
+     * Indicates whether the handshake RTT has been measured
+     */
+    bool has_handshake_rtt() const;
+
+    /**
+     * \brief Retrieves the handshake RTT
+     *
+     * This is only valid if has_handshake_rtt() == true
+     */
+    const timestamp_type& handshake_rtt() const;
+
+    /**
+     * Retrieves the amount of data RTT samples taken
+     */
+    uint32_t rtt_samples() const;
+
+    /**
+     * Retrieves the last data RTT sample
+     */
+    const timestamp_type& last_rtt() const;
+
+    /**
+     * Retrieves the lowest data RTT sample
+     */
+    const timestamp_type& min_rtt() const;
+
+    /**
+     * Retrieves the highest data RTT sample
+     */
+    const timestamp_type& max_rtt() const;
+
+    /**
+     * \brief Retrieves the smoothed data RTT
+     *
+     * This is computed as defined in RFC 6298
+     */
+    const timestamp_type& smoothed_rtt() const;
+
+    /**
+     * Retrieves the amount of retransmitted segments
+     */
+    uint32_t retransmitted_segments() const;
+
+    /**
+     * Retrieves the amount of out of order segments
+     */
+    uint32_t out_of_order_segments() const;
+
+    /**
+     * Retrieves the amount of times a zero window was advertised
+     */
+    uint32_t zero_window_events() const;
+
+    /**
+     * Retrieves the current amount of bytes in flight
+     */
+    uint32_t bytes_in_flight() const;
+
+    /**
+     * Retrieves the highest amount of bytes in flight seen
+     */
+    uint32_t max_bytes_in_flight() const;
+private:
+    // Compress all flags into just one struct using bitfields 
+    struct flags {
+        flags() : syn_seen(0), handshake_done(0), next_seq_known(0), ack_known(0),
+                  timing(0), zero_window(0) {
+
+        }
+
+        uint32_t syn_seen:1,
+                 handshake_done:1,
+                 next_seq_known:1,
+                 ack_known:1,
+                 timing:1,
+                 zero_window:1;
+    };
+
+    void classify_segment(uint32_t seq, uint32_t payload_size, const DataTracker& tracker);
+    void update_bytes_in_flight();
+
+    timestamp_type syn_time_;
+    timestamp_type handshake_rtt_;
+    timestamp_type timed_segment_time_;
+    timestamp_type last_rtt_;
+    timestamp_type min_rtt_;
+    timestamp_type max_rtt_;
+    timestamp_type smoothed_rtt_;
+    uint32_t syn_seq_;
+    uint32_t next_seq_;
+    uint32_t ack_number_;
+    uint32_t timed_segment_end_;
+    uint32_t rtt_samples_;
+    uint32_t retransmitted_segments_;
+    uint32_t out_of_order_segments_;
+    uint32_t zero_window_events_;
+    uint32_t bytes_in_flight_;
+    uint32_t max_bytes_in_flight_;
+    flags flags_;
+};
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
+#endif // TINS_TCP_IP_FLOW_METRICS_H
@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_TCP_IP_HTTP_PARSER_H
+#define TINS_TCP_IP_HTTP_PARSER_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <string>
+#include <functional>
+#include <stdint.h>
+#include <tins/macros.h>
+
+namespace Tins {
+namespace TCPIP {
+
+/**
+ * \brief Incremental HTTP/1.x message parser
+ *
+ * This class parses a sequence of HTTP/1.x requests or responses, as sent
+ * on one direction of a TCP connection. Data is fed through HTTPParser::parse
+ * as it arrives and the parser keeps its state across calls, so messages can
+ * be split in arbitrary ways. Pipelined messages, chunked transfer encoding
+ * and bodies delimited by the connection being closed are supported.
+ *
+ * The parser never copies nor allocates memory while parsing. Every event
+ * is notified through a callback that receives Slice objects, which point
+ * directly into the buffer given to HTTPParser::parse. These are only valid
+ * during the callback's execution.
+ *
+ * The parse method returns the amount of bytes that were consumed. Body data
+ * is always consumed entirely, but an incomplete line (e.g. half a header) is
+ * left untouched. The caller is expected to discard the consumed bytes and 
+ * call parse again once more data arrives, starting with the bytes that were
+ * not consumed. 
+ *
+ * \sa HTTPStreamParser
+ */
+class TINS_API HTTPParser {
+public:
+    /**
+     * The type of messages being parsed
+     */
+    enum Type {
+        REQUEST,
+        RESPONSE
+    };
+
+    /**
+     * \brief A non owning reference to a sequence of characters
+     */
+    struct Slice {
+        const char* data;
+        size_t size;
+
+        Slice() : data(0), size(0) { }
+        Slice(const char* data, size_t size) : data(data), size(size) { }
+
+        /**
+         * \brief Compares this slice against a string, ignoring case
+         */
+        bool iequals(const char* str) const;
+
+        /**
+         * \brief Creates a std::string out of this slice
+         */
+        std::string to_string() const {
+            return std::string(data, data + size);
+        }
+    };
+
+    /**
+     * \brief The start line of a request
+     */
+    struct RequestLine {
+        Slice method;
+        Slice target;
+        uint8_t version_major;
+        uint8_t version_minor;
+    };
+
+    /**
+     * \brief The start line of a response
+     */
+    struct StatusLine {
+        uint16_t status_code;
+        Slice reason;
+        uint8_t version_major;
+        uint8_t version_minor;
+    };
+
+    /**
+     * The type used for request line callbacks
+     */
+    typedef std::function<void(const RequestLine&)> request_line_callback_type;
+
+    /**
+     * The type used for status line callbacks
+     */
+    typedef std::function<void(const StatusLine&)> status_line_callback_type;
+
+    /**
+     * The type used for header callbacks. The arguments are the header's 
+     * name and value.
+     */
+    typedef std::function<void(const Slice&, const Slice&)> header_callback_type;
+
+    /**
+     * The type used for body callbacks
+     */
+    typedef std::function<void(const Slice&)> body_callback_type;
+
+    /**
+     * The type used for callbacks that notify that a message reached some state
+     */
+    typedef std::function<void()> event_callback_type;
+
+    /**
+     * The default maximum size of a start, header or chunk size line
+     */
+    static const size_t DEFAULT_MAX_LINE_SIZE;
+
+    /**
+     * \brief Constructs a parser
+     *
+     * \param type The type of messages to be parsed
+     */
+    HTTPParser(Type type);
+
+    /**
+     * \brief Parses the given data
+     *
+     * Callbacks are executed as events are found. Parsing stops at the end
+     * of the buffer, when an incomplete line is found, when an error is
+     * found or once the connection is upgraded to a different protocol.
+     *
+     * \param data The data to be parsed
+     * \param size The size of the data buffer
+     * \return The amount of bytes consumed from the beginning of the buffer
+     */
+    size_t parse(const uint8_t* data, size_t size);
+
+    /**
+     * \brief Indicates that no more data will be seen in this direction
+     *
+     * Responses that have neither a content length nor use chunked encoding
+     * are delimited by the connection being closed. Calling this method 
+     * completes such a message.
+     */
+    void finish();
+
+    /**
+     * \brief Resets the parser state, as if it was just constructed
+     *
+     * Callbacks and settings are kept.
+     */
+    void reset();
+
+    /**
+     * \brief Links a response parser to this request parser
+     *
+     * Whether a response has a body can depend on the request it answers
+     * (e.g. responses to HEAD requests never do). Once linked, every request
+     * parsed by this object is announced to the given response parser, which
+     * will match them in order against the responses it parses.
+     *
+     * \param parser The response parser, or a null pointer to unlink it
+     */
+    void link_response_parser(HTTPParser* parser);
+
+    /**
+     * \brief Sets the maximum size of a single line
+     *
+     * If a line longer than this is found, parsing fails.
+     *
+     * \param value The maximum line size
+     */
+    void max_line_size(size_t value);
+
+    /**
+     * \brief Getter for the maximum size of a single line
+     */
+    size_t max_line_size() const;
+
+    /**
+     * \brief Getter for the type of messages being parsed
+     */
+    Type type() const;
+
+    /**
+     * \brief Indicates whether the parser found malformed data
+     *
+     * Once an error is found, the parser won't consume any more data.
+     */
+    bool has_error() const;
+
+    /**
+     * \brief Indicates whether the connection switched to another protocol
+     *
+     * This happens after a CONNECT request or a 101 response. Once this 
+     * happens, the parser won't consume any more data.
+     */
+    bool is_upgraded() const;
+
+    /**
+     * \brief Indicates whether a message is partially parsed
+     */
+    bool is_message_in_progress() const;
+
+    /**
+     * \brief Getter for the amount of messages completely parsed so far
+     */
+    uint64_t messages_parsed() const;
+
+    /**
+     * \brief Sets the callback executed when a request line is parsed
+     */
+    void request_line_callback(const request_line_callback_type& callback);
+
+    /**
+     * \brief Sets the callback executed when a status line is parsed
+     */
+    void status_line_callback(const status_line_callback_type& callback);
+
+    /**
+     * \brief Sets the callback executed for each header
+     */
+    void header_callback(const header_callback_type& callback);
+
+    /**
+     * \brief Sets the callback executed once all headers are parsed
+     */
+    void headers_complete_callback(const event_callback_type& callback);
+
+    /**
+     * \brief Sets the callback executed for each piece of body data
+     *
+     * A body can be notified in multiple pieces, depending on how the data 
+     * was split when fed to the parser. For chunked messages, only the 
+     * chunk data is notified.
+     */
+    void body_callback(const body_callback_type& callback);
+
+    /**
+     * \brief Sets the callback executed once a message is completely parsed
+     */
+    void message_complete_callback(const event_callback_type& callback);
+private:
+    enum State {
+        START_LINE,
+        HEADERS,
+        BODY,
+        BODY_UNTIL_CLOSE,
+        CHUNK_SIZE,
+        CHUNK_DATA,
+        CHUNK_END,
+        TRAILERS,
+        UPGRADED,
+        PARSE_ERROR
+    };
+
+    enum RequestKind {
+        REGULAR_REQUEST,
+        HEAD_REQUEST,
+        CONNECT_REQUEST
+    };
+
+    // The maximum amount of requests tracked by a response parser
+    static const size_t MAX_PENDING_REQUESTS = 64;
+
+    bool process_line(const char* data, size_t size);
+    bool process_start_line(const char* data, size_t size);
+    bool process_header(const char* data, size_t size);
+    bool process_chunk_size(const char* data, size_t size);
+    bool on_headers_complete();
+    void on_message_complete();
+    void on_body_data(const char* data, size_t size);
+    void push_request(RequestKind kind);
+    RequestKind pop_request();
+
+    request_line_callback_type request_line_callback_;
+    status_line_callback_type status_line_callback_;
+    header_callback_type header_callback_;
+    event_callback_type headers_complete_callback_;
+    body_callback_type body_callback_;
+    event_callback_type message_complete_callback_;
+    HTTPParser* response_parser_;
+    uint64_t remaining_;
+    uint64_t content_length_;
+    uint64_t messages_parsed_;
+    uint64_t pending_head_requests_;
+    uint64_t pending_connect_requests_;
+    size_t pending_requests_;
+    size_t max_line_size_;
+    uint16_t status_code_;
+    Type type_;
+    State state_;
+    RequestKind request_kind_;
+    bool has_content_length_;
+    bool is_chunked_;
+    bool has_transfer_encoding_;
+};
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
+#endif // TINS_TCP_IP_HTTP_PARSER_H
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_TCP_IP_HTTP_STREAM_PARSER_H
+#define TINS_TCP_IP_HTTP_STREAM_PARSER_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <tins/macros.h>
+#include <tins/tcp_ip/http_parser.h>
+#include <tins/tcp_ip/flow.h>
+
+namespace Tins {
+namespace TCPIP {
+
+class Stream;
+
+/**
+ * \brief Parses the HTTP messages exchanged over a Stream
+ *
+ * This class holds a request parser for the client's data and a response
+ * parser for the server's data. Once attached to a Stream, it takes over its
+ * data callbacks and feeds every new piece of payload to the appropriate 
+ * parser. Bytes consumed by the parsers are removed from the stream's 
+ * payload buffers right away, so only incomplete lines are kept around.
+ *
+ * If either parser finds malformed data or the connection is upgraded to a
+ * different protocol, the data on that direction of the stream is ignored
+ * from then on.
+ *
+ * Callbacks must be set on the parsers returned by 
+ * HTTPStreamParser::request_parser and HTTPStreamParser::response_parser.
+ *
+ * \code
+ * follower.new_stream_callback([](Stream& stream) {
+ *     auto parser = std::make_shared<HTTPStreamParser>();
+ *     parser->request_parser().request_line_callback(...);
+ *     parser->attach(stream);
+ *     // Keep the parser alive for as long as the stream is
+ *     stream.stream_closed_callback([parser](Stream&) {
+ *         parser->finish();
+ *     });
+ * });
+ * \endcode
+ */
+class TINS_API HTTPStreamParser {
+public:
+    /**
+     * \brief Default constructs an HTTPStreamParser
+     */
+    HTTPStreamParser();
+
+    /**
+     * \brief Attaches this parser to a stream
+     *
+     * This sets the stream's client and server data callbacks and disables
+     * the automatic cleanup of its payloads. The stream must not outlive 
+     * this object.
+     *
+     * \param stream The stream to be attached to
+     */
+    void attach(Stream& stream);
+
+    /**
+     * \brief Indicates that the stream was closed
+     *
+     * \sa HTTPParser::finish
+     */
+    void finish();
+
+    /**
+     * \brief Getter for the parser used on the client's data
+     */
+    HTTPParser& request_parser();
+
+    /**
+     * \brief Getter for the parser used on the client's data (const)
+     */
+    const HTTPParser& request_parser() const;
+
+    /**
+     * \brief Getter for the parser used on the server's data
+     */
+    HTTPParser& response_parser();
+
+    /**
+     * \brief Getter for the parser used on the server's data (const)
+     */
+    const HTTPParser& response_parser() const;
+private:
+    // Not copyable, the request parser points to the response one
+    HTTPStreamParser(const HTTPStreamParser&);
+    HTTPStreamParser& operator=(const HTTPStreamParser&);
+
+    static bool parse_payload(HTTPParser& parser, Flow::payload_type& payload);
+    void on_client_data(Stream& stream);
+    void on_server_data(Stream& stream);
+
+    HTTPParser request_parser_;
+    HTTPParser response_parser_;
+};
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
+#endif // TINS_TCP_IP_HTTP_STREAM_PARSER_H
@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_TCP_IP_SACK_SCOREBOARD_H
+#define TINS_TCP_IP_SACK_SCOREBOARD_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_ACK_TRACKER
+
+#include <stddef.h>
+#include <stdint.h>
+#include <tins/macros.h>
+
+namespace Tins {
+namespace TCPIP {
+
+/**
+ * \brief Represents a closed interval of sequence numbers [first, last]
+ *
+ * Intervals may wrap around the sequence number space, in which case
+ * first() > last() when compared as plain integers.
+ */
+class TINS_API SequenceInterval {
+public:
+    /**
+     * \brief Constructs a closed interval [first, last]
+     *
+     * \param first The first sequence number in the interval
+     * \param last The last sequence number in the interval (inclusive)
+     */
+    static SequenceInterval closed(uint32_t first, uint32_t last) {
+        return SequenceInterval(first, last);
+    }
+
+    /**
+     * Default constructs an interval containing only sequence number 0
+     */
+    SequenceInterval() : first_(0), last_(0) {
+
+    }
+
+    /**
+     * \brief Constructs a closed interval [first, last]
+     *
+     * \param first The first sequence number in the interval
+     * \param last The last sequence number in the interval (inclusive)
+     */
+    SequenceInterval(uint32_t first, uint32_t last) : first_(first), last_(last) {
+
+    }
+
+    /**
+     * Retrieves the first sequence number in this interval
+     */
+    uint32_t first() const {
+        return first_;
+    }
+
+    /**
+     * Retrieves the last sequence number in this interval
+     */
+    uint32_t last() const {
+        return last_;
+    }
+
+    /**
+     * \brief Retrieves the amount of sequence numbers in this interval
+     *
+     * The returned value is 64 bits wide, as an interval can contain up
+     * to 2^32 sequence numbers.
+     */
+    uint64_t length() const {
+        return static_cast<uint64_t>(static_cast<uint32_t>(last_ - first_)) + 1;
+    }
+
+    bool operator==(const SequenceInterval& rhs) const {
+        return first_ == rhs.first_ && last_ == rhs.last_;
+    }
+
+    bool operator!=(const SequenceInterval& rhs) const {
+        return !(*this == rhs);
+    }
+private:
+    uint32_t first_;
+    uint32_t last_;
+};
+
+/**
+ * \brief Fixed capacity set of selectively acknowledged sequence number intervals
+ *
+ * The scoreboard keeps at most MAX_INTERVALS disjoint, non adjacent intervals
+ * sorted by sequence number in an inline array, so tracking SACKs never
+ * allocates memory. Intervals are compared using sequence number arithmetic
+ * (RFC 1982), so they're allowed to wrap around. This means every stored
+ * interval is expected to lie within a 2^31 window, which always holds for
+ * the data in flight in a TCP connection.
+ *
+ * If inserting an interval would require more than MAX_INTERVALS entries,
+ * the interval furthest away in sequence space is dropped. Dropping information
+ * is safe as it only makes some segments look like they're not acknowledged.
+ * The amount of intervals dropped since the last call to erase_until can be
+ * queried using dropped_intervals().
+ */
+class TINS_API SackScoreboard {
+public:
+    /**
+     * The type of each of the stored intervals
+     */
+    typedef SequenceInterval interval_type;
+
+    /**
+     * The iterator type
+     */
+    typedef const interval_type* const_iterator;
+
+    /**
+     * The maximum amount of intervals that can be stored
+     */
+    static const size_t MAX_INTERVALS = 32;
+
+    /**
+     * Default constructs an empty scoreboard
+     */
+    SackScoreboard();
+
+    /**
+     * \brief Adds the closed interval [first, last] to this scoreboard
+     *
+     * The interval will be merged with any overlapping or adjacent ones.
+     *
+     * \param first The first sequence number in the interval
+     * \param last The last sequence number in the interval (inclusive)
+     */
+    void insert(uint32_t first, uint32_t last);
+
+    /**
+     * \brief Removes all sequence numbers up to and including the given one
+     *
+     * This is meant to be called when the cumulative ACK advances, so it
+     * also resets the dropped intervals count.
+     *
+     * \param last The last sequence number to be removed
+     */
+    void erase_until(uint32_t last);
+
+    /**
+     * \brief Indicates whether the whole interval [first, last] is contained
+     *
+     * \param first The first sequence number in the interval
+     * \param last The last sequence number in the interval (inclusive)
+     */
+    bool contains(uint32_t first, uint32_t last) const;
+
+    /**
+     * Removes all intervals in this scoreboard and resets the dropped
+     * intervals count
+     */
+    void clear();
+
+    /**
+     * \brief Retrieves the amount of sequence numbers contained
+     *
+     * Note that this is not the amount of intervals, use iterative_size for that.
+     */
+    uint64_t size() const;
+
+    /**
+     * Retrieves the amount of intervals stored
+     */
+    size_t iterative_size() const {
+        return count_;
+    }
+
+    /**
+     * Indicates whether this scoreboard contains no intervals
+     */
+    bool empty() const {
+        return count_ == 0;
+    }
+
+    /**
+     * \brief Retrieves the amount of intervals dropped because of lack of space
+     *
+     * This only counts the intervals dropped since the last call to
+     * erase_until or clear.
+     */
+    uint32_t dropped_intervals() const {
+        return dropped_intervals_;
+    }
+
+    /**
+     * Retrieves an iterator to the first interval
+     */
+    const_iterator begin() const {
+        return intervals_;
+    }
+
+    /**
+     * Retrieves an iterator to one past the last interval
+     */
+    const_iterator end() const {
+        return intervals_ + count_;
+    }
+private:
+    size_t lower_bound(uint32_t sequence_number) const;
+    void erase_intervals(size_t start, size_t end);
+
+    interval_type intervals_[MAX_INTERVALS];
+    uint32_t count_;
+    uint32_t dropped_intervals_;
+};
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_ACK_TRACKER
+
+#endif // TINS_TCP_IP_SACK_SCOREBOARD_H
@@ -128,7 +128,8 @@ public:
      * \brief Processes this packet.
      *
      * This will forward the packet appropriately to the client
-     * or server flow.
+     * or server flow. Since there's no timestamp, the flows' metrics
+     * are not updated.
      *
      * \param packet The packet to be processed
      */
@@ -369,6 +370,21 @@ public:
      */
     bool ack_tracking_enabled() const;
 
+    /**
+     * \brief Enables tracking of both flows' metrics
+     *
+     * Metrics can be retrieved via the FlowMetrics objects in each of the flows.
+     *
+     * \sa Flow::enable_metrics
+     * \sa FlowMetrics
+     */
+    void enable_metrics();
+
+    /**
+     * \brief Indicates whether metrics tracking is enabled for this stream
+     */
+    bool metrics_enabled() const;
+
     #ifdef TINS_HAVE_TCP_STREAM_CUSTOM_DATA
     /**
      * \brief Create or retrieve an application-specific payload for this stream.
@@ -205,12 +205,28 @@ public:
      * \sa Stream::enable_recovery_mode
      */
     void follow_partial_streams(bool value);
+
+    /**
+     * \brief Sets the maximum amount of SACKed intervals a flow can drop
+     *
+     * When ACK tracking is enabled, each flow keeps a limited amount of SACKed
+     * intervals (see SackScoreboard). Once that space runs out, intervals are
+     * dropped, which only means that some SACKed segments won't be reported 
+     * as ACKed.
+     *
+     * A stream is terminated with reason SACKED_SEGMENTS once either of its
+     * flows dropped more than this amount of intervals without its
+     * cumulative ACK advancing. The default is 1024.
+     *
+     * \param value The maximum amount of dropped intervals
+     */
+    void max_dropped_sacked_intervals(uint32_t value);
 private:
     typedef Stream::timestamp_type timestamp_type;
 
     static const size_t DEFAULT_MAX_BUFFERED_CHUNKS;
-    static const size_t DEFAULT_MAX_SACKED_INTERVALS;
     static const uint32_t DEFAULT_MAX_BUFFERED_BYTES;
+    static const uint32_t DEFAULT_MAX_DROPPED_SACKED_INTERVALS;
     static const timestamp_type DEFAULT_KEEP_ALIVE;
 
     typedef std::map<stream_id, Stream> streams_type;
@@ -224,6 +240,7 @@ private:
     stream_termination_callback_type on_stream_termination_;
     size_t max_buffered_chunks_;
     uint32_t max_buffered_bytes_;
+    uint32_t max_dropped_sacked_intervals_;
     timestamp_type last_cleanup_;
     timestamp_type stream_keep_alive_;
     bool attach_to_flows_;
@@ -35,6 +35,8 @@
 #ifdef TINS_HAVE_TCPIP
 
 #include <array>
+#include <functional>
+#include <cstring>
 #include <stdint.h>
 
 namespace Tins {
@@ -102,6 +104,27 @@ struct StreamIdentifier {
 } // TCPIP
 } // Tins
 
+namespace std {
+
+template<>
+struct hash<Tins::TCPIP::StreamIdentifier> {
+    // Uses boost.functional's hash_combine over 64 bit words
+    size_t operator()(const Tins::TCPIP::StreamIdentifier& id) const {
+        uint64_t words[4];
+        std::memcpy(words, id.min_address.data(), id.min_address.size());
+        std::memcpy(words + 2, id.max_address.data(), id.max_address.size());
+        size_t output = (static_cast<size_t>(id.min_address_port) << 16) | 
+                        id.max_address_port;
+        for (size_t i = 0; i < 4; ++i) {
+            output ^= std::hash<uint64_t>()(words[i]) + 0x9e3779b9 + 
+                      (output << 6) + (output >> 2);
+        }
+        return output;
+    }
+};
+
+} // std
+
 #endif // TINS_HAVE_TCPIP
 #endif // TINS_TCP_IP_STREAM_ID_H
 
@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_TCP_IP_UDP_FLOW_H
+#define TINS_TCP_IP_UDP_FLOW_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <chrono>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/tcp_ip/stream_identifier.h>
+#ifdef TINS_HAVE_TCP_STREAM_CUSTOM_DATA
+    #include <boost/any.hpp>
+#endif
+
+namespace Tins {
+
+class PDU;
+class UDP;
+class IPv4Address;
+class IPv6Address;
+
+namespace TCPIP {
+
+/**
+ * \brief Represents a bidirectional UDP flow between 2 endpoints
+ *
+ * The endpoint that sent the first packet seen on the flow is considered to
+ * be the client, while the other one is the server.
+ *
+ * Since UDP has no notion of a connection, this class doesn't buffer any 
+ * data. Instead, it keeps packet and byte counters for each direction, 
+ * along with the timestamps of the first and last packets seen.
+ *
+ * UDP flows are normally created and tracked by a UDPFlowTracker.
+ *
+ * \sa UDPFlowTracker
+ */
+class TINS_API UDPFlow {
+public:
+    /** 
+     * The type used to represent timestamps
+     */
+    typedef std::chrono::microseconds timestamp_type;
+
+    /**
+     * The direction in which a packet was sent
+     */
+    enum Direction {
+        CLIENT_TO_SERVER,
+        SERVER_TO_CLIENT
+    };
+
+    /**
+     * \brief Constructs a UDP flow using the provided packet.
+     *
+     * The packet is only used to extract the flow's endpoints, so it's 
+     * not accounted for in any of the counters. 
+     * 
+     * \param initial_packet The first packet of the flow
+     * \param ts The first packet's timestamp
+     */
+    UDPFlow(const PDU& initial_packet, const timestamp_type& ts = timestamp_type());
+
+    /**
+     * \brief Processes a packet that belongs to this flow.
+     *
+     * This updates the counters for the direction in which the packet was
+     * sent along with the last seen timestamp.
+     *
+     * \param udp The UDP layer of the packet to be processed
+     * \param ts The packet's timestamp
+     * \return The direction in which the packet was sent
+     */
+    Direction process_packet(const UDP& udp, const timestamp_type& ts);
+
+    /**
+     * \brief Processes a packet that belongs to this flow.
+     *
+     * \param packet The packet to be processed
+     * \param ts The packet's timestamp
+     * \return The direction in which the packet was sent
+     */
+    Direction process_packet(const PDU& packet, const timestamp_type& ts);
+
+    /**
+     * Indicates whether this flow uses IPv6 addresses
+     */
+    bool is_v6() const;
+
+    /**
+     * \brief Retrieves the client's IPv4 address
+     *
+     * Note that it's only valid to call this method if is_v6() == false
+     */
+    IPv4Address client_addr_v4() const;
+
+    /**
+     * \brief Retrieves the client's IPv6 address
+     *
+     * Note that it's only valid to call this method if is_v6() == true
+     */
+    IPv6Address client_addr_v6() const;
+
+    /**
+     * \brief Retrieves the server's IPv4 address
+     *
+     * Note that it's only valid to call this method if is_v6() == false
+     */
+    IPv4Address server_addr_v4() const;
+
+    /**
+     * \brief Retrieves the server's IPv6 address
+     *
+     * Note that it's only valid to call this method if is_v6() == true
+     */
+    IPv6Address server_addr_v6() const;
+
+    /**
+     * Getter for the client's port
+     */
+    uint16_t client_port() const;
+
+    /**
+     * Getter for the server's port
+     */
+    uint16_t server_port() const;
+
+    /**
+     * Getter for the amount of packets sent by the client
+     */
+    uint64_t client_packets() const;
+
+    /**
+     * Getter for the amount of UDP payload bytes sent by the client
+     */
+    uint64_t client_bytes() const;
+
+    /**
+     * Getter for the amount of packets sent by the server
+     */
+    uint64_t server_packets() const;
+
+    /**
+     * Getter for the amount of UDP payload bytes sent by the server
+     */
+    uint64_t server_bytes() const;
+
+    /**
+     * Getter for the creation time of this flow
+     */
+    const timestamp_type& create_time() const;
+
+    /**
+     * Getter for the last seen time of this flow
+     */
+    const timestamp_type& last_seen() const;
+
+    #ifdef TINS_HAVE_TCP_STREAM_CUSTOM_DATA
+    /**
+     * \brief Create or retrieve an application-specific payload for this flow.
+     *
+     * The first call to this method will create user data as specified by the
+     * template parameter (using a mandatory default constructor). Subsequent calls
+     * have to be made with the same template parameter or the method will fail with
+     * boost::bad_any_cast. In any case, the method returns a reference to the user
+     * data.
+     *
+     * \return A reference to a user data block in the flow.
+     */
+    template<typename T>
+    T& user_data() {
+        if (user_data_.empty()) {
+            user_data_ = T();
+        };
+        return boost::any_cast<T&>(user_data_);
+    }
+    #endif // TINS_HAVE_TCP_STREAM_CUSTOM_DATA
+private:
+    typedef StreamIdentifier::address_type address_type;
+
+    bool sent_by_client(const UDP& udp) const;
+
+    address_type client_addr_;
+    address_type server_addr_;
+    uint16_t client_port_;
+    uint16_t server_port_;
+    bool is_v6_;
+    uint64_t client_packets_;
+    uint64_t client_bytes_;
+    uint64_t server_packets_;
+    uint64_t server_bytes_;
+    timestamp_type create_time_;
+    timestamp_type last_seen_;
+
+    #ifdef TINS_HAVE_TCP_STREAM_CUSTOM_DATA
+    boost::any user_data_;
+    #endif // TINS_HAVE_TCP_STREAM_CUSTOM_DATA
+};
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
+
+#endif // TINS_TCP_IP_UDP_FLOW_H
@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_TCP_IP_UDP_FLOW_TRACKER_H
+#define TINS_TCP_IP_UDP_FLOW_TRACKER_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <unordered_map>
+#include <functional>
+#include <tins/macros.h>
+#include <tins/tcp_ip/udp_flow.h>
+#include <tins/tcp_ip/stream_identifier.h>
+
+namespace Tins {
+
+class PDU;
+class UDP;
+class IPv4Address;
+class IPv6Address;
+class Packet;
+
+namespace TCPIP {
+
+/**
+ * \brief Tracks UDP flows and keeps per flow state
+ *
+ * This class is the UDP counterpart of StreamFollower. Whenever a packet 
+ * that doesn't belong to any known flow is processed, a new UDPFlow is
+ * created and the new flow callback is executed. Every packet (including
+ * the first one) then updates the flow's counters and triggers the data 
+ * callback.
+ *
+ * Flows are stored in a hash table and kept in a list sorted by the time in
+ * which they were last seen. Expiring idle flows is done incrementally: every
+ * processed packet expires at most a few of the least recently seen flows, so
+ * no packet has to pay for a full sweep over the table. The amount of flows
+ * tracked at any time can also be limited, in which case the least recently 
+ * seen flow is evicted when a new one needs to be created.
+ *
+ * \code
+ * UDPFlowTracker tracker;
+ * tracker.new_flow_callback([](UDPFlow& flow) {
+ *     // A new flow was seen
+ * });
+ * tracker.flow_termination_callback([](UDPFlow& flow, 
+ *                                      UDPFlowTracker::TerminationReason) {
+ *     // Export the flow's counters
+ * });
+ * \endcode
+ */
+class TINS_API UDPFlowTracker {
+public:
+    /**
+     * The type used to identify flows
+     */
+    typedef StreamIdentifier flow_id;
+
+    /**
+     * The type used to represent timestamps
+     */
+    typedef UDPFlow::timestamp_type timestamp_type;
+
+    /**
+     * Enum to indicate the reason why a flow was terminated
+     */
+    enum TerminationReason {
+        TIMEOUT, ///< The flow was terminated due to a timeout
+        MAX_FLOWS ///< The flow was evicted to make room for a new one
+    };
+
+    /**
+     * The type used for new flow callbacks
+     */
+    typedef std::function<void(UDPFlow&)> flow_callback_type;
+
+    /**
+     * \brief The type used for data callbacks
+     *
+     * The arguments are the flow, the direction in which the packet was sent
+     * and the packet's UDP layer.
+     */
+    typedef std::function<void(UDPFlow&, 
+                               UDPFlow::Direction, 
+                               const UDP&)> data_callback_type;
+
+    /**
+     * \brief The type used for flow termination callbacks
+     *
+     * \sa UDPFlowTracker::flow_termination_callback
+     */
+    typedef std::function<void(UDPFlow&, TerminationReason)> flow_termination_callback_type;
+
+    /**
+     * Default constructor
+     */
+    UDPFlowTracker();
+
+    /** 
+     * \brief Processes a packet
+     *
+     * The current time is used as the packet's timestamp.
+     *
+     * \param packet The packet to be processed
+     */
+    void process_packet(PDU& packet);
+
+    /** 
+     * \brief Processes a packet
+     *
+     * \param packet The packet to be processed
+     */
+    void process_packet(Packet& packet);
+
+    /**
+     * \brief Processes a packet using the given timestamp
+     *
+     * Packets that don't contain a UDP layer are ignored.
+     *
+     * \param packet The packet to be processed
+     * \param ts The packet's timestamp
+     */
+    void process_packet(PDU& packet, const timestamp_type& ts);
+
+    /**
+     * \brief Sets the callback to be executed when a new flow is seen
+     *
+     * \param callback The callback to be set
+     */
+    void new_flow_callback(const flow_callback_type& callback);
+
+    /**
+     * \brief Sets the callback to be executed for every packet in a flow
+     *
+     * \param callback The callback to be set
+     */
+    void data_callback(const data_callback_type& callback);
+
+    /**
+     * \brief Sets the flow termination callback
+     *
+     * A flow is terminated when either:
+     *
+     * * No packets have been seen for some time interval.
+     * * It had to be evicted as the maximum amount of flows was reached.
+     *
+     * \param callback The callback to be executed on flow termination
+     * \sa UDPFlowTracker::flow_keep_alive
+     * \sa UDPFlowTracker::max_flows
+     */
+    void flow_termination_callback(const flow_termination_callback_type& callback);
+
+    /**
+     * \brief Sets the maximum time a flow will be tracked without capturing
+     * packets that belong to it.
+     *
+     * The default keep alive is 30 seconds.
+     *
+     * \param keep_alive The maximum time to keep unseen flows
+     */
+    template <typename Rep, typename Period>
+    void flow_keep_alive(const std::chrono::duration<Rep, Period>& keep_alive) {
+        flow_keep_alive_ = keep_alive;
+    }
+
+    /**
+     * \brief Sets the maximum amount of flows to be tracked
+     *
+     * A value of 0 (the default) means there's no limit.
+     *
+     * \param value The maximum amount of flows
+     */
+    void max_flows(size_t value);
+
+    /**
+     * Retrieves the amount of flows being tracked
+     */
+    size_t flows_count() const;
+
+    /**
+     * \brief Terminates all flows that have expired at the given time
+     *
+     * Packet processing already expires flows incrementally, so this only
+     * needs to be called to flush flows once no more packets are captured.
+     *
+     * \param now The current time
+     */
+    void cleanup_flows(const timestamp_type& now);
+
+    /**
+     * \brief Finds the flow identified by the provided arguments.
+     *
+     * If no such flow exists, stream_not_found is thrown.
+     *
+     * \param client_addr The client's address
+     * \param client_port The client's port
+     * \param server_addr The server's address
+     * \param server_port The server's port
+     */
+    UDPFlow& find_flow(const IPv4Address& client_addr, uint16_t client_port,
+                       const IPv4Address& server_addr, uint16_t server_port);
+
+    /**
+     * \brief Finds the flow identified by the provided arguments.
+     *
+     * If no such flow exists, stream_not_found is thrown.
+     *
+     * \param client_addr The client's address
+     * \param client_port The client's port
+     * \param server_addr The server's address
+     * \param server_port The server's port
+     */
+    UDPFlow& find_flow(const IPv6Address& client_addr, uint16_t client_port,
+                       const IPv6Address& server_addr, uint16_t server_port);
+private:
+    // Flows are stored in an intrusive list sorted by last seen time
+    struct flow_entry {
+        flow_entry(const UDPFlow& flow)
+        : flow(flow), id(0), previous(0), next(0) {
+
+        }
+
+        UDPFlow flow;
+        const flow_id* id;
+        flow_entry* previous;
+        flow_entry* next;
+    };
+
+    typedef std::unordered_map<flow_id, flow_entry> flows_type;
+
+    static const timestamp_type DEFAULT_KEEP_ALIVE;
+    static const size_t MAX_EXPIRATIONS_PER_PACKET;
+
+    UDPFlowTracker(const UDPFlowTracker&);
+    UDPFlowTracker& operator=(const UDPFlowTracker&);
+
+    UDPFlow& find_flow(const flow_id& id);
+    void expire_flows(const timestamp_type& now, size_t max_expirations);
+    void terminate_flow(flow_entry* entry, TerminationReason reason);
+    void link_back(flow_entry* entry);
+    void unlink(flow_entry* entry);
+
+    flows_type flows_;
+    flow_entry* oldest_;
+    flow_entry* newest_;
+    flow_callback_type on_new_flow_;
+    data_callback_type on_data_;
+    flow_termination_callback_type on_flow_termination_;
+    timestamp_type flow_keep_alive_;
+    size_t max_flows_;
+};
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
+
+#endif // TINS_TCP_IP_UDP_FLOW_TRACKER_H
@@ -32,8 +32,12 @@
 
 #include <tins/dns.h>
 #include <tins/arp.h>
+#include <tins/async_packet_writer.h>
 #include <tins/bootp.h>
+#include <tins/buffered_packet_writer.h>
+#include <tins/capture_store.h>
 #include <tins/dhcp.h>
+#include <tins/dns_builder.h>
 #include <tins/eapol.h>
 #include <tins/ethernetII.h>
 #include <tins/ieee802_3.h>
@@ -48,7 +52,9 @@
 #include <tins/ip.h>
 #include <tins/ipv6.h>
 #include <tins/mpls.h>
+#include <tins/packet_replayer.h>
 #include <tins/packet_sender.h>
+#include <tins/packet_template.h>
 #include <tins/pdu.h>
 #include <tins/radiotap.h>
 #include <tins/rawpdu.h>
@@ -63,6 +69,7 @@
 #include <tins/tcp_stream.h>
 #endif
 #include <tins/crypto.h>
+#include <tins/decryption_pipeline.h>
 #include <tins/pdu_cacher.h>
 #include <tins/rsn_information.h>
 #include <tins/ipv6_address.h>
@@ -78,6 +85,8 @@
 #include <tins/pdu_allocator.h>
 #include <tins/ipsec.h>
 #include <tins/ip_reassembler.h>
+#include <tins/ipv6_reassembler.h>
+#include <tins/probe_engine.h>
 #include <tins/pdu_iterator.h>
 #include <tins/vxlan.h>
 #include <tins/rtp.h>
@@ -35,6 +35,7 @@
 #include <tins/utils/routing_utils.h>
 #include <tins/utils/resolve_utils.h>
 #include <tins/utils/pdu_utils.h>
+#include <tins/utils/radiotap_decoder.h>
 #include <tins/utils/radiotap_parser.h>
 #include <tins/utils/radiotap_writer.h>
  
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/config.h>
+
+#if !defined(TINS_RADIOTAP_DECODER_H) && defined(TINS_HAVE_DOT11)
+#define TINS_RADIOTAP_DECODER_H
+
+#include <vector>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/radiotap.h>
+
+namespace Tins {
+namespace Utils {
+
+/**
+ * \brief Decodes a fixed set of fields out of RadioTap headers
+ *
+ * This class is meant to read a few fields (e.g. TSFT, rate, channel and
+ * signal) out of lots of frames, without constructing RadioTap objects.
+ *
+ * The offset of every requested field only depends on the present flags
+ * bitmap, so it's computed the first time a bitmap is seen and cached.
+ * Frames having a bitmap that was already seen are decoded by reading the
+ * fields at those offsets.
+ *
+ * Only fields in the first present flags word are decoded.
+ *
+ * Note that the decoded buffer is not copied, hence it must be kept in
+ * scope while the decoded fields are being read.
+ *
+ * \code
+ * RadioTapDecoder decoder(RadioTap::TSFT | RadioTap::RATE | 
+ *                         RadioTap::CHANNEL | RadioTap::DBM_SIGNAL);
+ * decoder.decode(buffer, total_sz);
+ * if (decoder.has_field(RadioTap::DBM_SIGNAL)) {
+ *     int8_t signal = decoder.dbm_signal();
+ * }
+ * // The 802.11 frame starts at buffer + decoder.length()
+ * \endcode
+ */
+class TINS_API RadioTapDecoder {
+public:
+    /**
+     * The amount of present flags bitmaps that are cached
+     */
+    static const size_t MAX_LAYOUTS;
+
+    /**
+     * \brief Constructs a RadioTapDecoder
+     *
+     * \param fields The fields to be decoded, as a bitmask of 
+     * RadioTap::PresentFlags
+     */
+    RadioTapDecoder(uint32_t fields);
+
+    /**
+     * \brief Decodes a RadioTap header
+     *
+     * The buffer must start with a RadioTap header. If it's malformed or
+     * any of the requested fields doesn't fit in it, a malformed_packet
+     * exception is thrown.
+     *
+     * \param buffer The buffer to be decoded
+     * \param total_sz The size of the buffer
+     */
+    void decode(const uint8_t* buffer, uint32_t total_sz);
+
+    /**
+     * Gets the fields this decoder was constructed with
+     */
+    uint32_t fields() const {
+        return fields_;
+    }
+
+    /**
+     * Gets the requested fields present in the last decoded header
+     */
+    uint32_t present() const {
+        return present_;
+    }
+
+    /**
+     * \brief Indicates whether a field was found in the last decoded header
+     *
+     * Fields which were not requested are never found
+     */
+    bool has_field(RadioTap::PresentFlags flag) const {
+        return (present_ & flag) != 0;
+    }
+
+    /**
+     * Gets the length of the last decoded header
+     */
+    uint16_t length() const {
+        return length_;
+    }
+
+    /**
+     * Gets the amount of present flags bitmaps seen so far, up to MAX_LAYOUTS
+     */
+    size_t layout_count() const {
+        return layouts_.size();
+    }
+
+    /**
+     * \brief Getter for the TSFT field
+     */
+    uint64_t tsft() const;
+
+    /**
+     * \brief Getter for the flags field
+     */
+    RadioTap::FrameFlags flags() const;
+
+    /**
+     * \brief Getter for the rate field
+     */
+    uint8_t rate() const;
+
+    /**
+     * \brief Getter for the channel frequency field
+     */
+    uint16_t channel_freq() const;
+
+    /**
+     * \brief Getter for the channel type field
+     */
+    uint16_t channel_type() const;
+
+    /**
+     * \brief Getter for the dbm signal field
+     */
+    int8_t dbm_signal() const;
+
+    /**
+     * \brief Getter for the dbm noise field
+     */
+    int8_t dbm_noise() const;
+
+    /**
+     * \brief Getter for the antenna field
+     */
+    uint8_t antenna() const;
+
+    /**
+     * \brief Getter for the db signal field
+     */
+    uint8_t db_signal() const;
+
+    /**
+     * \brief Getter for the rx flags field
+     */
+    uint16_t rx_flags() const;
+
+    /**
+     * \brief Getter for the tx flags field
+     */
+    uint16_t tx_flags() const;
+
+    /**
+     * \brief Getter for the data retries field
+     */
+    uint8_t data_retries() const;
+
+    /**
+     * \brief Getter for the xchannel field
+     */
+    RadioTap::xchannel_type xchannel() const;
+
+    /**
+     * \brief Getter for the MCS field
+     */
+    RadioTap::mcs_type mcs() const;
+private:
+    // The offsets of the requested fields for a present flags bitmap
+    struct Layout {
+        uint32_t present_flags;
+        uint32_t word_count;
+        uint32_t found_fields;
+        uint32_t min_length;
+        uint16_t offsets[32];
+    };
+
+    const Layout& find_layout(uint32_t present_flags, uint32_t word_count);
+    void compute_layout(Layout& layout) const;
+    const uint8_t* field_ptr(RadioTap::PresentFlags flag) const;
+    template <typename T>
+    T read_field(RadioTap::PresentFlags flag) const;
+
+    uint32_t fields_;
+    std::vector<Layout> layouts_;
+    size_t last_layout_;
+    size_t next_replaced_;
+    const uint8_t* buffer_;
+    const uint16_t* offsets_;
+    uint32_t present_;
+    uint16_t length_;
+};
+
+} // Utils
+} // Tins
+
+#endif // TINS_RADIOTAP_DECODER_H
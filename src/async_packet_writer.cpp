@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/async_packet_writer.h>
+
+#if TINS_IS_CXX11 && !defined(_WIN32)
+
+#include <chrono>
+#include <tins/packet.h>
+#include <tins/pdu.h>
+#include <tins/exceptions.h>
+
+using std::string;
+using std::unique_ptr;
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_release;
+
+namespace Tins {
+
+namespace {
+
+// How long the I/O thread sleeps when there's nothing to write. Pending
+// records are flushed once the queue stays empty for this long.
+const std::chrono::milliseconds IDLE_WAIT_TIME(10);
+
+// How long a blocked producer waits before checking the queue again
+const std::chrono::microseconds BLOCK_WAIT_TIME(50);
+
+} // anonymous namespace
+
+const size_t AsyncPacketWriter::DEFAULT_QUEUE_SIZE = 4096;
+
+AsyncPacketWriter::AsyncPacketWriter(const string& file_name, int link_type,
+                                     size_t queue_size, OverflowPolicy policy)
+: writer_(new BufferedPacketWriter(file_name, link_type)) {
+    init(queue_size, policy);
+}
+
+AsyncPacketWriter::AsyncPacketWriter(unique_ptr<BufferedPacketWriter> writer,
+                                     size_t queue_size, OverflowPolicy policy)
+: writer_(std::move(writer)) {
+    init(queue_size, policy);
+}
+
+AsyncPacketWriter::~AsyncPacketWriter() {
+    if (thread_.joinable()) {
+        stop();
+    }
+}
+
+void AsyncPacketWriter::init(size_t queue_size, OverflowPolicy policy) {
+    size_t capacity = 2;
+    while (capacity < queue_size) {
+        capacity <<= 1;
+    }
+    slots_.resize(capacity);
+    mask_ = capacity - 1;
+    policy_ = policy;
+    head_.store(0);
+    tail_.store(0);
+    stopping_.store(false);
+    consumer_waiting_.store(false);
+    max_queue_depth_.store(0);
+    dropped_frames_.store(0);
+    frames_written_.store(0);
+    bytes_written_.store(0);
+    thread_ = std::thread(&AsyncPacketWriter::run, this);
+}
+
+bool AsyncPacketWriter::write(const uint8_t* buffer, uint32_t total_sz,
+                              const Timestamp& timestamp) {
+    return write(buffer, total_sz, total_sz, timestamp);
+}
+
+bool AsyncPacketWriter::write(const uint8_t* buffer, uint32_t total_sz, uint32_t original_sz,
+                              const Timestamp& timestamp) {
+    Slot* slot = acquire_slot();
+    if (!slot) {
+        return false;
+    }
+    slot->data.assign(buffer, buffer + total_sz);
+    slot->timestamp = timestamp;
+    slot->original_size = original_sz;
+    publish_slot();
+    return true;
+}
+
+bool AsyncPacketWriter::write(Packet& packet) {
+    // The const overload keeps the raw frame
+    if (!static_cast<const Packet&>(packet).pdu()) {
+        throw invalid_packet();
+    }
+    if (packet.has_raw_frame()) {
+        const Packet::raw_frame_type& frame = packet.raw_frame();
+        return write(&frame[0], static_cast<uint32_t>(frame.size()),
+                     packet.raw_frame_length(), packet.timestamp());
+    }
+    return write(*packet.pdu(), packet.timestamp());
+}
+
+bool AsyncPacketWriter::write(PDU& pdu, const Timestamp& timestamp) {
+    Slot* slot = acquire_slot();
+    if (!slot) {
+        return false;
+    }
+    // This reuses the slot's memory
+    pdu.serialize(slot->data);
+    slot->timestamp = timestamp;
+    slot->original_size = static_cast<uint32_t>(slot->data.size());
+    publish_slot();
+    return true;
+}
+
+bool AsyncPacketWriter::write(PDU& pdu) {
+    return write(pdu, Timestamp::current_time());
+}
+
+void AsyncPacketWriter::close() {
+    if (thread_.joinable()) {
+        stop();
+    }
+    if (error_) {
+        std::exception_ptr error = error_;
+        error_ = std::exception_ptr();
+        std::rethrow_exception(error);
+    }
+}
+
+size_t AsyncPacketWriter::queue_depth() const {
+    // Loading the head first guarantees it's not past the loaded tail
+    const size_t head = head_.load(memory_order_acquire);
+    return tail_.load(memory_order_acquire) - head;
+}
+
+AsyncPacketWriter::Slot* AsyncPacketWriter::acquire_slot() {
+    const size_t tail = tail_.load(memory_order_relaxed);
+    while (tail - head_.load(memory_order_acquire) >= slots_.size()) {
+        if (policy_ == DROP_NEWEST || stopping_.load(memory_order_relaxed)) {
+            dropped_frames_.fetch_add(1, memory_order_relaxed);
+            return 0;
+        }
+        std::this_thread::sleep_for(BLOCK_WAIT_TIME);
+    }
+    if (stopping_.load(memory_order_relaxed)) {
+        dropped_frames_.fetch_add(1, memory_order_relaxed);
+        return 0;
+    }
+    return &slots_[tail & mask_];
+}
+
+void AsyncPacketWriter::publish_slot() {
+    const size_t tail = tail_.load(memory_order_relaxed) + 1;
+    // Sequentially consistent, so that either this thread sees the I/O
+    // thread waiting or the I/O thread sees this slot before waiting
+    tail_.store(tail);
+    const size_t depth = tail - head_.load(memory_order_relaxed);
+    if (depth > max_queue_depth_.load(memory_order_relaxed)) {
+        max_queue_depth_.store(depth, memory_order_relaxed);
+    }
+    if (consumer_waiting_.load()) {
+        // The lock is only taken while the I/O thread is idle
+        std::lock_guard<std::mutex> lock(mutex_);
+        condition_.notify_one();
+    }
+}
+
+void AsyncPacketWriter::run() {
+    bool has_error = false;
+    bool pending_flush = false;
+    size_t head = head_.load(memory_order_relaxed);
+    while (true) {
+        const size_t tail = tail_.load(memory_order_acquire);
+        if (head == tail) {
+            if (stopping_.load()) {
+                // Packets published before stopping are visible at this point
+                if (tail_.load(memory_order_acquire) == head) {
+                    break;
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex_);
+            consumer_waiting_.store(true);
+            bool timed_out = false;
+            if (tail_.load() == head && !stopping_.load()) {
+                timed_out = condition_.wait_for(lock, IDLE_WAIT_TIME) ==
+                            std::cv_status::timeout;
+            }
+            consumer_waiting_.store(false);
+            lock.unlock();
+            if (timed_out && pending_flush) {
+                pending_flush = false;
+                try {
+                    writer_->flush();
+                }
+                catch (...) {
+                    error_ = std::current_exception();
+                    has_error = true;
+                }
+            }
+            continue;
+        }
+        while (head != tail) {
+            Slot& slot = slots_[head & mask_];
+            if (!has_error) {
+                try {
+                    const uint8_t* data = slot.data.empty() ? 0 : &slot.data[0];
+                    writer_->write(data, static_cast<uint32_t>(slot.data.size()),
+                                   slot.original_size, slot.timestamp);
+                    frames_written_.fetch_add(1, memory_order_relaxed);
+                    bytes_written_.fetch_add(slot.data.size(), memory_order_relaxed);
+                    pending_flush = true;
+                }
+                catch (...) {
+                    error_ = std::current_exception();
+                    has_error = true;
+                }
+            }
+            if (has_error) {
+                dropped_frames_.fetch_add(1, memory_order_relaxed);
+            }
+            // Release each slot right away so a blocked producer can go on
+            head_.store(++head, memory_order_release);
+        }
+    }
+    try {
+        writer_->close();
+    }
+    catch (...) {
+        if (!has_error) {
+            error_ = std::current_exception();
+        }
+    }
+}
+
+void AsyncPacketWriter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_.store(true);
+        condition_.notify_one();
+    }
+    thread_.join();
+}
+
+} // Tins
+
+#endif // TINS_IS_CXX11 && !_WIN32
@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/buffered_packet_writer.h>
+
+#if TINS_IS_CXX11 && !defined(_WIN32)
+
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <new>
+#include <sstream>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <tins/packet.h>
+#include <tins/exceptions.h>
+
+using std::string;
+using std::min;
+using std::max;
+using std::chrono::microseconds;
+
+namespace Tins {
+
+namespace {
+
+const uint32_t PCAP_MAGIC = 0xa1b2c3d4;
+const uint16_t PCAP_VERSION_MAJOR = 2;
+const uint16_t PCAP_VERSION_MINOR = 4;
+const uint32_t FILE_HEADER_SIZE = 24;
+const uint32_t RECORD_HEADER_SIZE = 16;
+const uint32_t BUFFER_ALIGNMENT = 4096;
+
+// Files are written in host byte order, as libpcap does
+struct pcap_file_header_t {
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t linktype;
+};
+
+struct pcap_record_header_t {
+    uint32_t ts_sec;
+    uint32_t ts_usec;
+    uint32_t caplen;
+    uint32_t len;
+};
+
+string make_error_string(const string& file_name) {
+    return file_name + ": " + strerror(errno);
+}
+
+// Writes every byte in the given buffers, retrying on short writes
+bool write_all(int fd, iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t written = ::writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        while (count > 0 && static_cast<size_t>(written) >= iov->iov_len) {
+            written -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<uint8_t*>(iov->iov_base) + written;
+            iov->iov_len -= written;
+        }
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+const uint32_t BufferedPacketWriter::DEFAULT_BUFFER_SIZE = 1024 * 1024;
+const uint32_t BufferedPacketWriter::SNAPSHOT_LENGTH = 262144;
+
+BufferedPacketWriter::BufferedPacketWriter(const string& file_name, int link_type,
+                                           uint32_t buffer_size)
+: buffer_(0) {
+    init(file_name, link_type, buffer_size);
+}
+
+BufferedPacketWriter::~BufferedPacketWriter() {
+    if (fd_ >= 0) {
+        try {
+            flush();
+        }
+        catch (file_write_error&) {
+
+        }
+        ::close(fd_);
+    }
+    free(buffer_);
+}
+
+void BufferedPacketWriter::init(const string& file_name, int link_type,
+                                uint32_t buffer_size) {
+    base_file_name_ = file_name;
+    link_type_ = link_type;
+    fd_ = -1;
+    buffer_used_ = 0;
+    file_index_ = 0;
+    file_size_ = 0;
+    file_packets_ = 0;
+    packets_written_ = 0;
+    max_file_size_ = 0;
+    max_file_packets_ = 0;
+    max_file_duration_ = microseconds(0);
+    file_start_ = microseconds(0);
+    // Round the buffer up to a whole amount of pages
+    buffer_size = std::max(buffer_size, BUFFER_ALIGNMENT);
+    buffer_size_ = (buffer_size + BUFFER_ALIGNMENT - 1) & ~(BUFFER_ALIGNMENT - 1);
+    void* buffer = 0;
+    if (posix_memalign(&buffer, BUFFER_ALIGNMENT, buffer_size_) != 0) {
+        throw std::bad_alloc();
+    }
+    buffer_ = static_cast<uint8_t*>(buffer);
+    try {
+        open_file();
+    }
+    catch (...) {
+        free(buffer_);
+        buffer_ = 0;
+        throw;
+    }
+}
+
+void BufferedPacketWriter::max_file_size(uint64_t value) {
+    max_file_size_ = value;
+}
+
+void BufferedPacketWriter::max_file_duration(microseconds value) {
+    max_file_duration_ = value;
+}
+
+void BufferedPacketWriter::max_file_packets(uint64_t value) {
+    max_file_packets_ = value;
+}
+
+void BufferedPacketWriter::rotation_callback(rotation_callback_type callback) {
+    rotation_callback_ = callback;
+}
+
+void BufferedPacketWriter::write(PDU& pdu) {
+    write(pdu, Timestamp::current_time());
+}
+
+void BufferedPacketWriter::write(PDU& pdu, const Timestamp& timestamp) {
+    pdu.serialize(serialization_buffer_);
+    const uint8_t* data = serialization_buffer_.empty() ? 0 : &serialization_buffer_[0];
+    const uint32_t size = static_cast<uint32_t>(serialization_buffer_.size());
+    write_record(data, size, size, timestamp);
+}
+
+void BufferedPacketWriter::write(Packet& packet) {
+    if (packet.has_raw_frame()) {
+        const Packet::raw_frame_type& frame = packet.raw_frame();
+        write_record(frame.empty() ? 0 : &frame[0], static_cast<uint32_t>(frame.size()),
+                     packet.raw_frame_length(), packet.timestamp());
+    }
+    else {
+        write(*packet.pdu(), packet.timestamp());
+    }
+}
+
+void BufferedPacketWriter::write(const uint8_t* buffer, uint32_t total_sz) {
+    write_record(buffer, total_sz, total_sz, Timestamp::current_time());
+}
+
+void BufferedPacketWriter::write(const uint8_t* buffer, uint32_t total_sz,
+                                 const Timestamp& timestamp) {
+    write_record(buffer, total_sz, total_sz, timestamp);
+}
+
+void BufferedPacketWriter::write(const uint8_t* buffer, uint32_t total_sz,
+                                 uint32_t original_sz, const Timestamp& timestamp) {
+    write_record(buffer, total_sz, original_sz, timestamp);
+}
+
+void BufferedPacketWriter::flush() {
+    if (buffer_used_ == 0) {
+        return;
+    }
+    iovec iov;
+    iov.iov_base = buffer_;
+    iov.iov_len = buffer_used_;
+    if (!write_all(fd_, &iov, 1)) {
+        throw file_write_error(make_error_string(current_file_name_));
+    }
+    buffer_used_ = 0;
+}
+
+void BufferedPacketWriter::rotate() {
+    if (fd_ < 0) {
+        throw file_write_error("The writer is closed");
+    }
+    const string completed_file = current_file_name_;
+    close_file();
+    file_index_++;
+    open_file();
+    if (rotation_callback_) {
+        rotation_callback_(completed_file);
+    }
+}
+
+void BufferedPacketWriter::close() {
+    if (fd_ < 0) {
+        return;
+    }
+    close_file();
+    if (rotation_callback_) {
+        rotation_callback_(current_file_name_);
+    }
+}
+
+void BufferedPacketWriter::open_file() {
+    current_file_name_ = file_name(base_file_name_, file_index_);
+    fd_ = ::open(current_file_name_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd_ < 0) {
+        throw file_open_error(make_error_string(current_file_name_));
+    }
+    pcap_file_header_t header;
+    header.magic = PCAP_MAGIC;
+    header.version_major = PCAP_VERSION_MAJOR;
+    header.version_minor = PCAP_VERSION_MINOR;
+    header.thiszone = 0;
+    header.sigfigs = 0;
+    header.snaplen = SNAPSHOT_LENGTH;
+    header.linktype = link_type_;
+    memcpy(buffer_, &header, FILE_HEADER_SIZE);
+    buffer_used_ = FILE_HEADER_SIZE;
+    file_size_ = FILE_HEADER_SIZE;
+    file_packets_ = 0;
+}
+
+void BufferedPacketWriter::close_file() {
+    // Close the file even if flushing fails, so no descriptors are leaked
+    const int fd = fd_;
+    try {
+        flush();
+    }
+    catch (...) {
+        fd_ = -1;
+        ::close(fd);
+        throw;
+    }
+    fd_ = -1;
+    if (::close(fd) != 0) {
+        throw file_write_error(make_error_string(current_file_name_));
+    }
+}
+
+void BufferedPacketWriter::write_record(const uint8_t* buffer, uint32_t total_sz,
+                                        uint32_t original_sz, const Timestamp& timestamp) {
+    if (fd_ < 0) {
+        throw file_write_error("The writer is closed");
+    }
+    const uint32_t caplen = min(total_sz, SNAPSHOT_LENGTH);
+    const uint32_t record_size = RECORD_HEADER_SIZE + caplen;
+    const microseconds packet_time = timestamp;
+    if (should_rotate(record_size, packet_time)) {
+        rotate();
+    }
+    if (file_packets_ == 0) {
+        file_start_ = packet_time;
+    }
+    pcap_record_header_t header;
+    header.ts_sec = static_cast<uint32_t>(timestamp.seconds());
+    header.ts_usec = static_cast<uint32_t>(timestamp.microseconds());
+    header.caplen = caplen;
+    header.len = max(total_sz, original_sz);
+    if (record_size > buffer_size_ - buffer_used_) {
+        if (record_size > buffer_size_) {
+            // Write the pending records and this one using a single call
+            iovec iov[3];
+            iov[0].iov_base = buffer_;
+            iov[0].iov_len = buffer_used_;
+            iov[1].iov_base = &header;
+            iov[1].iov_len = RECORD_HEADER_SIZE;
+            iov[2].iov_base = const_cast<uint8_t*>(buffer);
+            iov[2].iov_len = caplen;
+            if (!write_all(fd_, iov, 3)) {
+                throw file_write_error(make_error_string(current_file_name_));
+            }
+            buffer_used_ = 0;
+            record_written(record_size);
+            return;
+        }
+        flush();
+    }
+    memcpy(buffer_ + buffer_used_, &header, RECORD_HEADER_SIZE);
+    memcpy(buffer_ + buffer_used_ + RECORD_HEADER_SIZE, buffer, caplen);
+    buffer_used_ += record_size;
+    record_written(record_size);
+}
+
+void BufferedPacketWriter::record_written(uint32_t record_size) {
+    file_size_ += record_size;
+    file_packets_++;
+    packets_written_++;
+}
+
+bool BufferedPacketWriter::should_rotate(uint32_t record_size,
+                                         microseconds timestamp) const {
+    if (file_packets_ == 0) {
+        return false;
+    }
+    if (max_file_packets_ > 0 && file_packets_ >= max_file_packets_) {
+        return true;
+    }
+    if (max_file_size_ > 0 && file_size_ + record_size > max_file_size_) {
+        return true;
+    }
+    return max_file_duration_ > microseconds(0) &&
+           timestamp - file_start_ >= max_file_duration_;
+}
+
+string BufferedPacketWriter::file_name(const string& base_file_name, uint32_t index) {
+    if (index == 0) {
+        return base_file_name;
+    }
+    std::ostringstream oss;
+    const size_t slash = base_file_name.rfind('/');
+    const size_t dot = base_file_name.rfind('.');
+    // Only a dot within the last path component that doesn't start it
+    // marks an extension
+    if (dot != string::npos && dot > 0 &&
+        (slash == string::npos || dot > slash + 1)) {
+        oss << base_file_name.substr(0, dot) << "." << index
+            << base_file_name.substr(dot);
+    }
+    else {
+        oss << base_file_name << "." << index;
+    }
+    return oss.str();
+}
+
+} // Tins
+
+#endif // TINS_IS_CXX11 && !_WIN32
@@ -0,0 +1,810 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/capture_store.h>
+
+#if TINS_IS_CXX11 && !defined(_WIN32)
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <tins/ip_address.h>
+#include <tins/ipv6_address.h>
+#include <tins/packet.h>
+#include <tins/pdu.h>
+#include <tins/memory_helpers.h>
+#include <tins/exceptions.h>
+
+using std::string;
+using std::vector;
+using std::min;
+using std::max;
+using std::swap;
+using std::chrono::microseconds;
+
+using Tins::Memory::InputMemoryStream;
+using Tins::Memory::OutputMemoryStream;
+
+namespace Tins {
+
+namespace {
+
+const uint32_t INDEX_MAGIC = 0x58444954;
+const uint32_t INDEX_VERSION = 1;
+const uint32_t RECORD_HEADER_SIZE = 16;
+const size_t INDEX_HEADER_SIZE = 56;
+const size_t FLOW_ENTRY_SIZE = 56;
+const size_t INDEX_ENTRY_SIZE = 16;
+const size_t BUCKET_SIZE = 24;
+
+// pcap link types. These are defined here since the values used on files
+// don't always match the DLT_* macros, e.g. for raw IP
+const int LINK_TYPE_NULL = 0;
+const int LINK_TYPE_ETHERNET = 1;
+const int LINK_TYPE_DLT_RAW1 = 12;
+const int LINK_TYPE_DLT_RAW2 = 14;
+const int LINK_TYPE_RAW = 101;
+const int LINK_TYPE_LOOP = 108;
+const int LINK_TYPE_LINUX_SLL = 113;
+
+const uint16_t ETHERTYPE_IP = 0x0800;
+const uint16_t ETHERTYPE_IPV6 = 0x86dd;
+const uint16_t ETHERTYPE_VLAN = 0x8100;
+const uint16_t ETHERTYPE_QINQ = 0x88a8;
+
+const uint8_t PROTOCOL_TCP = 6;
+const uint8_t PROTOCOL_UDP = 17;
+const uint8_t PROTOCOL_SCTP = 132;
+const uint8_t PROTOCOL_UDPLITE = 136;
+
+const uint8_t IPV6_HOP_BY_HOP = 0;
+const uint8_t IPV6_ROUTING = 43;
+const uint8_t IPV6_FRAGMENT = 44;
+const uint8_t IPV6_AUTHENTICATION = 51;
+const uint8_t IPV6_DESTINATION = 60;
+
+uint64_t to_microseconds(const Timestamp& timestamp) {
+    const microseconds value = timestamp;
+    return static_cast<uint64_t>(value.count());
+}
+
+string make_error_string(const string& file_name) {
+    return file_name + ": " + strerror(errno);
+}
+
+void make_key(CaptureStore::FlowKey& key, const uint8_t* address1, uint16_t port1,
+              const uint8_t* address2, uint16_t port2, size_t address_size) {
+    key.min_address.fill(0);
+    key.max_address.fill(0);
+    const int comparison = memcmp(address1, address2, address_size);
+    if (comparison > 0 || (comparison == 0 && port1 > port2)) {
+        swap(address1, address2);
+        swap(port1, port2);
+    }
+    memcpy(key.min_address.data(), address1, address_size);
+    memcpy(key.max_address.data(), address2, address_size);
+    key.min_address_port = port1;
+    key.max_address_port = port2;
+}
+
+bool has_ports(uint8_t protocol) {
+    return protocol == PROTOCOL_TCP || protocol == PROTOCOL_UDP ||
+           protocol == PROTOCOL_SCTP || protocol == PROTOCOL_UDPLITE;
+}
+
+// Parses the IP layer and the transport ports, if any
+bool parse_ip(InputMemoryStream& stream, CaptureStore::FlowKey& key) {
+    if (!stream.can_read(1)) {
+        return false;
+    }
+    const uint8_t version = *stream.pointer() >> 4;
+    const uint8_t* addresses;
+    size_t address_size;
+    uint8_t protocol;
+    if (version == 4) {
+        const uint8_t* header = stream.pointer();
+        const size_t header_size = (header[0] & 0x0f) * 4;
+        if (header_size < 20 || !stream.can_read(header_size)) {
+            return false;
+        }
+        // Only the first fragment holds the transport header
+        const uint16_t fragment_offset = ((header[6] & 0x1f) << 8) | header[7];
+        if (fragment_offset != 0) {
+            return false;
+        }
+        protocol = header[9];
+        addresses = header + 12;
+        address_size = 4;
+        stream.skip(header_size);
+    }
+    else if (version == 6) {
+        const uint8_t* header = stream.pointer();
+        stream.skip(40);
+        protocol = header[6];
+        addresses = header + 8;
+        address_size = 16;
+        bool done = false;
+        while (!done) {
+            switch (protocol) {
+                case IPV6_HOP_BY_HOP:
+                case IPV6_ROUTING:
+                case IPV6_DESTINATION:
+                    {
+                        const uint8_t* extension = stream.pointer();
+                        stream.skip(2);
+                        protocol = extension[0];
+                        stream.skip((extension[1] + 1) * 8 - 2);
+                    }
+                    break;
+                case IPV6_AUTHENTICATION:
+                    {
+                        const uint8_t* extension = stream.pointer();
+                        stream.skip(2);
+                        protocol = extension[0];
+                        stream.skip((extension[1] + 2) * 4 - 2);
+                    }
+                    break;
+                case IPV6_FRAGMENT:
+                    {
+                        const uint8_t* extension = stream.pointer();
+                        stream.skip(8);
+                        protocol = extension[0];
+                        if ((((extension[2] << 8) | extension[3]) >> 3) != 0) {
+                            return false;
+                        }
+                    }
+                    break;
+                default:
+                    done = true;
+            }
+        }
+    }
+    else {
+        return false;
+    }
+    uint16_t source_port = 0;
+    uint16_t destination_port = 0;
+    if (has_ports(protocol) && stream.can_read(4)) {
+        source_port = stream.read_be<uint16_t>();
+        destination_port = stream.read_be<uint16_t>();
+    }
+    make_key(key, addresses, source_port, addresses + address_size, destination_port,
+             address_size);
+    key.protocol = protocol;
+    key.ip_version = version;
+    return true;
+}
+
+// Owns a file descriptor opened for reading
+class InputFile {
+public:
+    InputFile(const string& file_name)
+    : file_name_(file_name), fd_(::open(file_name.c_str(), O_RDONLY)) {
+        if (fd_ < 0) {
+            throw file_open_error(make_error_string(file_name));
+        }
+    }
+
+    ~InputFile() {
+        ::close(fd_);
+    }
+
+    void read(uint64_t offset, uint8_t* buffer, size_t size) {
+        while (size > 0) {
+            ssize_t result = ::pread(fd_, buffer, size, offset);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result <= 0) {
+                throw file_read_error(file_name_ + ": short read");
+            }
+            buffer += result;
+            size -= result;
+            offset += result;
+        }
+    }
+private:
+    InputFile(const InputFile&);
+    InputFile& operator=(const InputFile&);
+
+    string file_name_;
+    int fd_;
+};
+
+// Parses the pcap record at the start of the stream
+void read_record(InputMemoryStream& stream, CaptureStoreReader::Record& record) {
+    const uint32_t seconds = stream.read<uint32_t>();
+    const uint32_t useconds = stream.read<uint32_t>();
+    const uint32_t caplen = stream.read<uint32_t>();
+    record.original_size = stream.read<uint32_t>();
+    record.timestamp = Timestamp(std::chrono::seconds(seconds) + microseconds(useconds));
+    record.data.assign(stream.pointer(), stream.pointer() + min<size_t>(caplen, stream.size()));
+    stream.skip(caplen);
+}
+
+} // anonymous namespace
+
+// CaptureStore::FlowKey
+
+CaptureStore::FlowKey::FlowKey()
+: min_address_port(0), max_address_port(0), protocol(0), ip_version(0) {
+    min_address.fill(0);
+    max_address.fill(0);
+}
+
+CaptureStore::FlowKey::FlowKey(IPv4Address address1, uint16_t port1,
+                               IPv4Address address2, uint16_t port2,
+                               uint8_t protocol)
+: protocol(protocol), ip_version(4) {
+    uint8_t buffer[8];
+    OutputMemoryStream output(buffer, sizeof(buffer));
+    output.write(address1);
+    output.write(address2);
+    make_key(*this, buffer, port1, buffer + 4, port2, 4);
+}
+
+CaptureStore::FlowKey::FlowKey(const IPv6Address& address1, uint16_t port1,
+                               const IPv6Address& address2, uint16_t port2,
+                               uint8_t protocol)
+: protocol(protocol), ip_version(6) {
+    make_key(*this, address1.begin(), port1, address2.begin(), port2,
+             IPv6Address::address_size);
+}
+
+bool CaptureStore::FlowKey::from_frame(const uint8_t* buffer, uint32_t total_sz,
+                                       int link_type, FlowKey& key) {
+    InputMemoryStream stream(buffer, total_sz);
+    try {
+        switch (link_type) {
+            case LINK_TYPE_ETHERNET:
+                {
+                    stream.skip(12);
+                    uint16_t ether_type = stream.read_be<uint16_t>();
+                    while (ether_type == ETHERTYPE_VLAN || ether_type == ETHERTYPE_QINQ) {
+                        stream.skip(2);
+                        ether_type = stream.read_be<uint16_t>();
+                    }
+                    if (ether_type != ETHERTYPE_IP && ether_type != ETHERTYPE_IPV6) {
+                        return false;
+                    }
+                }
+                break;
+            case LINK_TYPE_LINUX_SLL:
+                {
+                    stream.skip(14);
+                    const uint16_t protocol = stream.read_be<uint16_t>();
+                    if (protocol != ETHERTYPE_IP && protocol != ETHERTYPE_IPV6) {
+                        return false;
+                    }
+                }
+                break;
+            case LINK_TYPE_NULL:
+            case LINK_TYPE_LOOP:
+                // The address family's value and byte order depend on the
+                // platform, so use the IP version instead
+                stream.skip(4);
+                break;
+            case LINK_TYPE_DLT_RAW1:
+            case LINK_TYPE_DLT_RAW2:
+            case LINK_TYPE_RAW:
+                break;
+            default:
+                return false;
+        }
+        return parse_ip(stream, key);
+    }
+    catch (malformed_packet&) {
+        return false;
+    }
+}
+
+uint64_t CaptureStore::FlowKey::hash() const {
+    // 64 bit FNV-1a
+    uint8_t buffer[36];
+    memcpy(buffer, min_address.data(), min_address.size());
+    memcpy(buffer + 16, max_address.data(), max_address.size());
+    buffer[32] = min_address_port >> 8;
+    buffer[33] = min_address_port & 0xff;
+    buffer[34] = max_address_port >> 8;
+    buffer[35] = max_address_port & 0xff;
+    uint64_t output = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < sizeof(buffer); ++i) {
+        output = (output ^ buffer[i]) * 0x100000001b3ULL;
+    }
+    output = (output ^ protocol) * 0x100000001b3ULL;
+    return (output ^ ip_version) * 0x100000001b3ULL;
+}
+
+bool CaptureStore::FlowKey::operator==(const FlowKey& rhs) const {
+    return min_address_port == rhs.min_address_port &&
+           max_address_port == rhs.max_address_port &&
+           protocol == rhs.protocol && ip_version == rhs.ip_version &&
+           min_address == rhs.min_address && max_address == rhs.max_address;
+}
+
+// CaptureStore
+
+const std::chrono::seconds CaptureStore::DEFAULT_BUCKET_DURATION(1);
+const string CaptureStore::INDEX_SUFFIX = ".idx";
+
+CaptureStore::CaptureStore(const string& file_name, int link_type)
+: writer_(file_name, link_type) {
+    init(file_name, link_type);
+}
+
+CaptureStore::~CaptureStore() {
+    try {
+        close();
+    }
+    catch (...) {
+
+    }
+}
+
+void CaptureStore::init(const string& file_name, int link_type) {
+    remove_stale_indexes(file_name);
+    link_type_ = link_type;
+    bucket_duration_ = to_microseconds(Timestamp(DEFAULT_BUCKET_DURATION));
+    file_bucket_duration_ = bucket_duration_;
+    first_timestamp_ = 0;
+    last_timestamp_ = 0;
+    entry_count_ = 0;
+    writer_.rotation_callback([this](const string& file_name) {
+        file_completed(file_name);
+    });
+}
+
+void CaptureStore::remove_stale_indexes(const string& file_name) {
+    // The capture files are truncated as they're reopened, so their old
+    // indexes would point to unrelated records
+    for (uint32_t index = 0; ; ++index) {
+        const string capture_file_name = BufferedPacketWriter::file_name(file_name, index);
+        const string index_file_name = capture_file_name + INDEX_SUFFIX;
+        const bool index_removed = std::remove(index_file_name.c_str()) == 0;
+        if (!index_removed && index > 0 &&
+            ::access(capture_file_name.c_str(), F_OK) != 0) {
+            break;
+        }
+    }
+}
+
+void CaptureStore::bucket_duration(std::chrono::seconds value) {
+    bucket_duration_ = to_microseconds(Timestamp(max(value, std::chrono::seconds(1))));
+    if (entry_count_ == 0) {
+        file_bucket_duration_ = bucket_duration_;
+    }
+}
+
+void CaptureStore::max_file_size(uint64_t value) {
+    writer_.max_file_size(value);
+}
+
+void CaptureStore::max_file_duration(microseconds value) {
+    writer_.max_file_duration(value);
+}
+
+void CaptureStore::max_file_packets(uint64_t value) {
+    writer_.max_file_packets(value);
+}
+
+void CaptureStore::rotation_callback(rotation_callback_type callback) {
+    rotation_callback_ = callback;
+}
+
+void CaptureStore::write(PDU& pdu, const Timestamp& timestamp) {
+    pdu.serialize(serialization_buffer_);
+    const uint8_t* data = serialization_buffer_.empty() ? 0 : &serialization_buffer_[0];
+    write(data, static_cast<uint32_t>(serialization_buffer_.size()), timestamp);
+}
+
+void CaptureStore::write(Packet& packet) {
+    if (packet.has_raw_frame()) {
+        const Packet::raw_frame_type& frame = packet.raw_frame();
+        write(frame.empty() ? 0 : &frame[0], static_cast<uint32_t>(frame.size()),
+              packet.raw_frame_length(), packet.timestamp());
+    }
+    else {
+        write(*packet.pdu(), packet.timestamp());
+    }
+}
+
+void CaptureStore::write(const uint8_t* buffer, uint32_t total_sz,
+                         const Timestamp& timestamp) {
+    write(buffer, total_sz, total_sz, timestamp);
+}
+
+void CaptureStore::write(const uint8_t* buffer, uint32_t total_sz, uint32_t original_sz,
+                         const Timestamp& timestamp) {
+    // This may complete the current file, so the record is indexed afterwards
+    writer_.write(buffer, total_sz, original_sz, timestamp);
+    index_record(buffer, total_sz, timestamp);
+}
+
+void CaptureStore::rotate() {
+    writer_.rotate();
+}
+
+void CaptureStore::close() {
+    writer_.close();
+}
+
+void CaptureStore::index_record(const uint8_t* buffer, uint32_t total_sz,
+                                const Timestamp& timestamp) {
+    const uint32_t record_size = RECORD_HEADER_SIZE +
+                                 min(total_sz, BufferedPacketWriter::SNAPSHOT_LENGTH);
+    IndexEntry entry;
+    entry.offset = writer_.file_size() - record_size;
+    entry.timestamp = to_microseconds(timestamp);
+    if (entry_count_ == 0) {
+        first_timestamp_ = entry.timestamp;
+        last_timestamp_ = entry.timestamp;
+    }
+    else {
+        first_timestamp_ = min(first_timestamp_, entry.timestamp);
+        last_timestamp_ = max(last_timestamp_, entry.timestamp);
+    }
+    entry_count_++;
+
+    const uint64_t bucket_index = entry.timestamp / file_bucket_duration_;
+    buckets_type::iterator iter = buckets_.lower_bound(bucket_index);
+    if (iter == buckets_.end() || iter->first != bucket_index) {
+        Bucket bucket;
+        bucket.start_offset = entry.offset;
+        bucket.end_offset = entry.offset + record_size;
+        buckets_.insert(iter, std::make_pair(bucket_index, bucket));
+    }
+    else {
+        iter->second.start_offset = min(iter->second.start_offset, entry.offset);
+        iter->second.end_offset = max(iter->second.end_offset, entry.offset + record_size);
+    }
+
+    FlowKey key;
+    if (FlowKey::from_frame(buffer, total_sz, link_type_, key)) {
+        flows_[key].push_back(entry);
+    }
+}
+
+void CaptureStore::file_completed(const string& file_name) {
+    // The writer has already moved on to the next file, so the entries
+    // must be dropped even if the index can't be written
+    try {
+        write_index(file_name);
+    }
+    catch (...) {
+        reset_index();
+        throw;
+    }
+    reset_index();
+    if (rotation_callback_) {
+        rotation_callback_(file_name);
+    }
+}
+
+void CaptureStore::reset_index() {
+    flows_.clear();
+    buckets_.clear();
+    entry_count_ = 0;
+    file_bucket_duration_ = bucket_duration_;
+}
+
+void CaptureStore::write_index(const string& file_name) {
+    // Sort flows by hash so readers can use a binary search
+    vector<std::pair<uint64_t, flows_type::const_iterator> > sorted_flows;
+    sorted_flows.reserve(flows_.size());
+    for (flows_type::const_iterator iter = flows_.begin(); iter != flows_.end(); ++iter) {
+        sorted_flows.push_back(std::make_pair(iter->first.hash(), iter));
+    }
+    std::sort(
+        sorted_flows.begin(),
+        sorted_flows.end(),
+        [](const std::pair<uint64_t, flows_type::const_iterator>& lhs,
+           const std::pair<uint64_t, flows_type::const_iterator>& rhs) {
+            return lhs.first < rhs.first;
+        }
+    );
+
+    vector<uint8_t> buffer(INDEX_HEADER_SIZE + sorted_flows.size() * FLOW_ENTRY_SIZE +
+                           entry_count_ * INDEX_ENTRY_SIZE + buckets_.size() * BUCKET_SIZE);
+    OutputMemoryStream output(buffer);
+    // Only records that belong to a flow have entries
+    uint64_t flow_entry_count = 0;
+    for (size_t i = 0; i < sorted_flows.size(); ++i) {
+        flow_entry_count += sorted_flows[i].second->second.size();
+    }
+    output.write(INDEX_MAGIC);
+    output.write(INDEX_VERSION);
+    output.write(static_cast<uint32_t>(link_type_));
+    output.write(static_cast<uint32_t>(sorted_flows.size()));
+    output.write(flow_entry_count);
+    output.write(static_cast<uint64_t>(buckets_.size()));
+    output.write(file_bucket_duration_);
+    output.write(first_timestamp_);
+    output.write(last_timestamp_);
+
+    uint32_t first_entry = 0;
+    for (size_t i = 0; i < sorted_flows.size(); ++i) {
+        const FlowKey& key = sorted_flows[i].second->first;
+        const uint32_t entry_count = static_cast<uint32_t>(sorted_flows[i].second->second.size());
+        output.write(sorted_flows[i].first);
+        output.write(key.min_address.begin(), key.min_address.end());
+        output.write(key.max_address.begin(), key.max_address.end());
+        output.write(key.min_address_port);
+        output.write(key.max_address_port);
+        output.write(key.protocol);
+        output.write(key.ip_version);
+        output.write<uint16_t>(0);
+        output.write(first_entry);
+        output.write(entry_count);
+        first_entry += entry_count;
+    }
+    for (size_t i = 0; i < sorted_flows.size(); ++i) {
+        const vector<IndexEntry>& entries = sorted_flows[i].second->second;
+        for (size_t j = 0; j < entries.size(); ++j) {
+            output.write(entries[j].offset);
+            output.write(entries[j].timestamp);
+        }
+    }
+    for (buckets_type::const_iterator iter = buckets_.begin(); iter != buckets_.end(); ++iter) {
+        output.write(iter->first);
+        output.write(iter->second.start_offset);
+        output.write(iter->second.end_offset);
+    }
+    buffer.resize(buffer.size() - output.size());
+
+    // Write to a temporary file first so readers never see a partial index
+    const string index_file_name = file_name + INDEX_SUFFIX;
+    const string temporary_file_name = index_file_name + ".tmp";
+    {
+        std::ofstream index_file(temporary_file_name.c_str(), std::ios::binary);
+        if (!index_file) {
+            throw file_open_error(make_error_string(temporary_file_name));
+        }
+        index_file.write((const char*)&buffer[0], buffer.size());
+        index_file.close();
+        if (!index_file) {
+            throw file_write_error(temporary_file_name + ": write failed");
+        }
+    }
+    if (std::rename(temporary_file_name.c_str(), index_file_name.c_str()) != 0) {
+        throw file_write_error(make_error_string(index_file_name));
+    }
+}
+
+// CaptureStoreReader
+
+CaptureStoreReader::CaptureStoreReader(const string& file_name)
+: link_type_(-1) {
+    for (uint32_t index = 0; ; ++index) {
+        const string capture_file_name = BufferedPacketWriter::file_name(file_name, index);
+        const string index_file_name = capture_file_name + CaptureStore::INDEX_SUFFIX;
+        if (::access(index_file_name.c_str(), F_OK) != 0) {
+            break;
+        }
+        load_index(capture_file_name, index_file_name);
+    }
+    if (files_.empty()) {
+        throw file_open_error(file_name + CaptureStore::INDEX_SUFFIX + ": index not found");
+    }
+}
+
+void CaptureStoreReader::load_index(const string& file_name, const string& index_file_name) {
+    std::ifstream input(index_file_name.c_str(), std::ios::binary);
+    if (!input) {
+        throw file_open_error(make_error_string(index_file_name));
+    }
+    const vector<uint8_t> contents((std::istreambuf_iterator<char>(input)),
+                                   std::istreambuf_iterator<char>());
+    IndexFile file;
+    file.file_name = file_name;
+    try {
+        InputMemoryStream stream(contents.data(), contents.size());
+        if (stream.read<uint32_t>() != INDEX_MAGIC ||
+            stream.read<uint32_t>() != INDEX_VERSION) {
+            throw file_read_error(index_file_name + ": not an index file");
+        }
+        const int link_type = static_cast<int>(stream.read<uint32_t>());
+        if (link_type_ != -1 && link_type != link_type_) {
+            throw file_read_error(index_file_name + ": link type mismatch");
+        }
+        link_type_ = link_type;
+        const uint32_t flow_count = stream.read<uint32_t>();
+        const uint64_t entry_count = stream.read<uint64_t>();
+        const uint64_t bucket_count = stream.read<uint64_t>();
+        file.bucket_duration = stream.read<uint64_t>();
+        file.first_timestamp = stream.read<uint64_t>();
+        file.last_timestamp = stream.read<uint64_t>();
+        // Make sure the counts are sane before allocating anything
+        if (file.bucket_duration == 0 ||
+            !stream.can_read(flow_count * FLOW_ENTRY_SIZE + entry_count * INDEX_ENTRY_SIZE +
+                             bucket_count * BUCKET_SIZE)) {
+            throw file_read_error(index_file_name + ": truncated index file");
+        }
+        file.flows.resize(flow_count);
+        for (size_t i = 0; i < file.flows.size(); ++i) {
+            FlowEntry& flow = file.flows[i];
+            flow.hash = stream.read<uint64_t>();
+            stream.read(flow.key.min_address.data(), flow.key.min_address.size());
+            stream.read(flow.key.max_address.data(), flow.key.max_address.size());
+            flow.key.min_address_port = stream.read<uint16_t>();
+            flow.key.max_address_port = stream.read<uint16_t>();
+            flow.key.protocol = stream.read<uint8_t>();
+            flow.key.ip_version = stream.read<uint8_t>();
+            stream.skip(sizeof(uint16_t));
+            flow.first_entry = stream.read<uint32_t>();
+            flow.entry_count = stream.read<uint32_t>();
+            if (flow.first_entry + static_cast<uint64_t>(flow.entry_count) > entry_count) {
+                throw file_read_error(index_file_name + ": invalid flow entry");
+            }
+        }
+        file.entries.resize(entry_count);
+        for (size_t i = 0; i < file.entries.size(); ++i) {
+            file.entries[i].offset = stream.read<uint64_t>();
+            file.entries[i].timestamp = stream.read<uint64_t>();
+        }
+        file.buckets.resize(bucket_count);
+        for (size_t i = 0; i < file.buckets.size(); ++i) {
+            file.buckets[i].bucket = stream.read<uint64_t>();
+            file.buckets[i].start_offset = stream.read<uint64_t>();
+            file.buckets[i].end_offset = stream.read<uint64_t>();
+        }
+    }
+    catch (malformed_packet&) {
+        throw file_read_error(index_file_name + ": truncated index file");
+    }
+    files_.push_back(std::move(file));
+}
+
+vector<CaptureStoreReader::FlowInfo> CaptureStoreReader::flows() const {
+    // Flows can span several files
+    std::unordered_map<FlowKey, size_t, FlowKey::Hasher> positions;
+    vector<FlowInfo> output;
+    for (size_t i = 0; i < files_.size(); ++i) {
+        const vector<FlowEntry>& flows = files_[i].flows;
+        for (size_t j = 0; j < flows.size(); ++j) {
+            std::pair<std::unordered_map<FlowKey, size_t, FlowKey::Hasher>::iterator, bool> result =
+                positions.insert(std::make_pair(flows[j].key, output.size()));
+            if (result.second) {
+                FlowInfo info;
+                info.key = flows[j].key;
+                info.packets = 0;
+                output.push_back(info);
+            }
+            output[result.first->second].packets += flows[j].entry_count;
+        }
+    }
+    return output;
+}
+
+vector<CaptureStoreReader::Record> CaptureStoreReader::read_flow(const FlowKey& key) const {
+    const uint64_t hash = key.hash();
+    vector<Record> output;
+    vector<uint8_t> buffer;
+    for (size_t i = 0; i < files_.size(); ++i) {
+        const IndexFile& file = files_[i];
+        vector<FlowEntry>::const_iterator iter = std::lower_bound(
+            file.flows.begin(),
+            file.flows.end(),
+            hash,
+            [](const FlowEntry& entry, uint64_t value) {
+                return entry.hash < value;
+            }
+        );
+        // Different flows may share the same hash
+        while (iter != file.flows.end() && iter->hash == hash && iter->key != key) {
+            ++iter;
+        }
+        if (iter == file.flows.end() || iter->hash != hash) {
+            continue;
+        }
+        InputFile input(file.file_name);
+        for (uint32_t j = 0; j < iter->entry_count; ++j) {
+            const IndexEntry& entry = file.entries[iter->first_entry + j];
+            uint8_t header[RECORD_HEADER_SIZE];
+            input.read(entry.offset, header, sizeof(header));
+            uint32_t caplen;
+            memcpy(&caplen, header + 8, sizeof(caplen));
+            buffer.resize(RECORD_HEADER_SIZE + caplen);
+            memcpy(&buffer[0], header, sizeof(header));
+            if (caplen > 0) {
+                input.read(entry.offset + RECORD_HEADER_SIZE, &buffer[RECORD_HEADER_SIZE],
+                           caplen);
+            }
+            InputMemoryStream stream(&buffer[0], buffer.size());
+            output.push_back(Record());
+            read_record(stream, output.back());
+        }
+    }
+    return output;
+}
+
+vector<CaptureStoreReader::Record> CaptureStoreReader::read_time_range(
+    const Timestamp& start,
+    const Timestamp& end) const {
+    const uint64_t start_time = to_microseconds(start);
+    const uint64_t end_time = to_microseconds(end);
+    vector<Record> output;
+    if (start_time >= end_time) {
+        return output;
+    }
+    vector<uint8_t> buffer;
+    for (size_t i = 0; i < files_.size(); ++i) {
+        const IndexFile& file = files_[i];
+        if (file.buckets.empty() || file.last_timestamp < start_time ||
+            file.first_timestamp >= end_time) {
+            continue;
+        }
+        const uint64_t first_bucket = start_time / file.bucket_duration;
+        const uint64_t last_bucket = (end_time - 1) / file.bucket_duration;
+        vector<Bucket>::const_iterator iter = std::lower_bound(
+            file.buckets.begin(),
+            file.buckets.end(),
+            first_bucket,
+            [](const Bucket& bucket, uint64_t value) {
+                return bucket.bucket < value;
+            }
+        );
+        if (iter == file.buckets.end() || iter->bucket > last_bucket) {
+            continue;
+        }
+        // Read the whole region spanned by the matching buckets at once
+        uint64_t start_offset = iter->start_offset;
+        uint64_t end_offset = iter->end_offset;
+        for (; iter != file.buckets.end() && iter->bucket <= last_bucket; ++iter) {
+            start_offset = min(start_offset, iter->start_offset);
+            end_offset = max(end_offset, iter->end_offset);
+        }
+        buffer.resize(end_offset - start_offset);
+        InputFile input(file.file_name);
+        input.read(start_offset, &buffer[0], buffer.size());
+        try {
+            InputMemoryStream stream(&buffer[0], buffer.size());
+            Record record;
+            while (stream) {
+                read_record(stream, record);
+                const uint64_t timestamp = to_microseconds(record.timestamp);
+                if (timestamp >= start_time && timestamp < end_time) {
+                    output.push_back(record);
+                }
+            }
+        }
+        catch (malformed_packet&) {
+            throw file_read_error(file.file_name + ": invalid record");
+        }
+    }
+    return output;
+}
+
+} // Tins
+
+#endif // TINS_IS_CXX11 && !_WIN32
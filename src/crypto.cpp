@@ -32,18 +32,36 @@
 #ifdef TINS_HAVE_DOT11
 
 #include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <tins/cxxstd.h>
+#if TINS_IS_CXX11
+    #include <atomic>
+    #include <thread>
+#endif // TINS_IS_CXX11
 #ifdef TINS_HAVE_WPA2_DECRYPTION
     #include <openssl/evp.h>
     #include <openssl/hmac.h>
-    #include <openssl/aes.h>
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #ifdef _WIN32
+        #include <io.h>
+    #else
+        #include <unistd.h>
+    #endif // _WIN32
 #endif // TINS_HAVE_WPA2_DECRYPTION
 #include <tins/snap.h>
 #include <tins/rawpdu.h>
 #include <tins/dot11/dot11_data.h>
 #include <tins/dot11/dot11_beacon.h>
 #include <tins/exceptions.h>
+#include <tins/memory_helpers.h>
 #include <tins/utils/checksum_utils.h>
 #include <tins/detail/type_traits.h>
+#include <tins/detail/smart_ptr.h>
 
 using std::string;
 using std::vector;
@@ -56,6 +74,9 @@ using std::lexicographical_compare;
 using std::fill;
 using std::runtime_error;
 
+using Tins::Memory::InputMemoryStream;
+using Tins::Memory::OutputMemoryStream;
+
 namespace Tins {
 namespace Internals {
 
@@ -209,29 +230,37 @@ uint16_t lower_byte(uint16_t value) {
 struct RC4Key {
     static const size_t data_size = 256;
 
-    template<typename ForwardIterator>
-    RC4Key(ForwardIterator start, ForwardIterator end) {
+    RC4Key(const uint8_t* key, size_t key_size) {
+        // Repeat the key over a whole state's worth of bytes, so the key
+        // schedule below doesn't need to wrap around it
+        uint8_t expanded_key[data_size];
+        for (size_t i = 0; i < data_size; i += key_size) {
+            std::memcpy(expanded_key + i, key, min(key_size, data_size - i));
+        }
         for (size_t i = 0; i < data_size; ++i) {
             data[i] = static_cast<uint8_t>(i);
         }
-        size_t j = 0;
-        ForwardIterator iter = start;
-        for (size_t i = 0; i < data_size; ++i) {
-            j = (j + data[i] + *iter++) % 256;
-            if(iter == end) {
-                iter = start;
-            }
+        // Indexes are kept in uint8_t so they wrap around for free
+        uint8_t j = 0;
+        for (size_t i = 0; i < data_size; i += 4) {
+            j += data[i] + expanded_key[i];
             std::swap(data[i], data[j]);
+            j += data[i + 1] + expanded_key[i + 1];
+            std::swap(data[i + 1], data[j]);
+            j += data[i + 2] + expanded_key[i + 2];
+            std::swap(data[i + 2], data[j]);
+            j += data[i + 3] + expanded_key[i + 3];
+            std::swap(data[i + 3], data[j]);
         }
     }
 
-    static RC4Key from_packet(const Dot11Data& dot11, const RawPDU& raw,
+    // The payload starts at the TKIP header
+    static RC4Key from_packet(const uint8_t* transmitter_addr, const uint8_t* pload,
                               const vector<uint8_t>& ptk) { 
-        const RawPDU::payload_type& pload = raw.payload();
         const uint8_t* tk = &ptk[0] + 32;
         Internals::byte_array<16> rc4_key;
         uint16_t ppk[6];
-        const Dot11::address_type addr = dot11.addr2();
+        const uint8_t* addr = transmitter_addr;
         // Phase 1
         ppk[0] = join_bytes(pload[4], pload[5]);
         ppk[1] = join_bytes(pload[6], pload[7]);
@@ -287,20 +316,44 @@ struct RC4Key {
         rc4_key[13] = upper_byte(ppk[4]);
         rc4_key[14] = lower_byte(ppk[5]);
         rc4_key[15] = upper_byte(ppk[5]);
-        return RC4Key(rc4_key.begin(), rc4_key.end());
+        return RC4Key(rc4_key.begin(), rc4_key.size());
     }
 
     uint8_t data[data_size];
 };
 
-template<typename ForwardIterator, typename OutputIterator>
-void rc4(ForwardIterator start, ForwardIterator end, RC4Key& key, OutputIterator output) {
-    size_t i = 0, j = 0;
-    while (start != end) {
-        i = (i + 1) % RC4Key::data_size;
-        j = (j + key.data[i]) % RC4Key::data_size;
-        std::swap(key.data[i], key.data[j]);
-        *output++ = *start++ ^ key.data[(key.data[i] + key.data[j]) % RC4Key::data_size];
+// Generates the next keystream byte
+uint8_t rc4_next(uint8_t* state, uint8_t& i, uint8_t& j) {
+    const uint8_t x = state[++i];
+    j += x;
+    const uint8_t y = state[j];
+    state[i] = y;
+    state[j] = x;
+    return state[static_cast<uint8_t>(x + y)];
+}
+
+// Decrypts size bytes from input into output. Output can overlap with input
+// as long as it doesn't start after it.
+void rc4(const uint8_t* input, size_t size, RC4Key& key, uint8_t* output) {
+    uint8_t* state = key.data;
+    uint8_t i = 0, j = 0;
+    // Every keystream byte depends on the previous swap, so this only
+    // saves the loop overhead
+    while (size >= 4) {
+        const uint8_t k0 = rc4_next(state, i, j);
+        const uint8_t k1 = rc4_next(state, i, j);
+        const uint8_t k2 = rc4_next(state, i, j);
+        const uint8_t k3 = rc4_next(state, i, j);
+        output[0] = input[0] ^ k0;
+        output[1] = input[1] ^ k1;
+        output[2] = input[2] ^ k2;
+        output[3] = input[3] ^ k3;
+        input += 4;
+        output += 4;
+        size -= 4;
+    }
+    while (size--) {
+        *output++ = *input++ ^ rc4_next(state, i, j);
     }
 }
 
@@ -356,22 +409,9 @@ bool WEPDecrypter::decrypt(PDU& pdu) {
 
 PDU* WEPDecrypter::decrypt(RawPDU& raw, const string& password) {
     RawPDU::payload_type& pload = raw.payload();
-    // We require at least the IV, the encrypted checksum and something to decrypt
-    if (pload.size() <= 8) {
-        return 0;
-    }
-    copy(pload.begin(), pload.begin() + 3, key_buffer_.begin());
-    copy(password.begin(), password.end(), key_buffer_.begin() + 3);
-
-    // Generate the key
-    RC4Key key(key_buffer_.begin(), key_buffer_.begin() + password.size() + 3);
-    rc4(pload.begin() + 4, pload.end(), key, pload.begin());
-    uint32_t payload_size = static_cast<uint32_t>(pload.size() - 8);
-    uint32_t crc = Utils::crc32(&pload[0], payload_size);
-    if (pload[pload.size() - 8] != (crc & 0xff) ||
-        pload[pload.size() - 7] != ((crc >> 8) & 0xff) ||
-        pload[pload.size() - 6] != ((crc >> 16) & 0xff) ||
-        pload[pload.size() - 5] != ((crc >> 24) & 0xff)) {
+    uint32_t payload_size;
+    if (pload.empty() || !decrypt_payload(&pload[0], static_cast<uint32_t>(pload.size()),
+                                          password, payload_size)) {
         return 0;
     }
 
@@ -383,10 +423,123 @@ PDU* WEPDecrypter::decrypt(RawPDU& raw, const string& password) {
     }
 }
 
+// The password found for the last frame in a batch
+struct WEPDecrypter::password_cache {
+    password_cache()
+    : password(0), valid(false) {
+
+    }
+
+    uint8_t bssid[address_type::address_size];
+    const string* password;
+    bool valid;
+};
+
+bool WEPDecrypter::decrypt_in_place(uint8_t* buffer, uint32_t total_sz, uint8_t*& plaintext,
+                                    uint32_t& plaintext_size) {
+    return do_decrypt_in_place(buffer, total_sz, plaintext, plaintext_size, 0);
+}
+
+bool WEPDecrypter::do_decrypt_in_place(uint8_t* buffer, uint32_t total_sz,
+                                       uint8_t*& plaintext, uint32_t& plaintext_size,
+                                       password_cache* cache) {
+    // Frame control, duration, 3 addresses and sequence control
+    static const uint32_t data_header_size = 24;
+    if (total_sz < data_header_size) {
+        return false;
+    }
+    const uint8_t type = (buffer[0] >> 2) & 0x03;
+    const uint8_t to_ds = buffer[1] & 0x01;
+    const uint8_t from_ds = (buffer[1] >> 1) & 0x01;
+    const bool is_protected = (buffer[1] & 0x40) != 0;
+    if (type != Dot11::DATA || !is_protected) {
+        return false;
+    }
+    uint32_t header_size = data_header_size;
+    if (to_ds && from_ds) {
+        header_size += address_type::address_size;
+    }
+    if ((buffer[0] & 0xf0) == (Dot11::QOS_DATA_DATA << 4)) {
+        header_size += sizeof(uint16_t);
+    }
+    if (total_sz <= header_size) {
+        return false;
+    }
+    // Same as in decrypt(PDU&): addr1 if only to_ds is set, addr2 if only 
+    // from_ds is, addr3 otherwise
+    const uint8_t* addr = buffer + 16;
+    if (to_ds != from_ds) {
+        addr = to_ds ? buffer + 4 : buffer + 10;
+    }
+    const string* password = 0;
+    if (cache && cache->valid &&
+        equal(addr, addr + address_type::address_size, cache->bssid)) {
+        password = cache->password;
+    }
+    else {
+        passwords_type::const_iterator iter = passwords_.find(address_type(addr));
+        password = (iter != passwords_.end()) ? &iter->second : 0;
+        if (cache) {
+            copy(addr, addr + address_type::address_size, cache->bssid);
+            cache->password = password;
+            cache->valid = true;
+        }
+    }
+    if (!password ||
+        !decrypt_payload(buffer + header_size, total_sz - header_size, *password,
+                         plaintext_size)) {
+        return false;
+    }
+    // Clear the protected flag
+    buffer[1] &= ~0x40;
+    plaintext = buffer + header_size;
+    return true;
+}
+
+size_t WEPDecrypter::decrypt_in_place(InPlaceFrame* frames, size_t count) {
+    password_cache cache;
+    size_t decrypted = 0;
+    for (size_t i = 0; i < count; ++i) {
+        InPlaceFrame& frame = frames[i];
+        frame.plaintext = 0;
+        frame.plaintext_size = 0;
+        if (do_decrypt_in_place(frame.buffer, frame.size, frame.plaintext,
+                                frame.plaintext_size, &cache)) {
+            ++decrypted;
+        }
+    }
+    return decrypted;
+}
+
+bool WEPDecrypter::decrypt_payload(uint8_t* payload, uint32_t payload_size,
+                                   const string& password, uint32_t& plaintext_size) {
+    // We require at least the IV, the encrypted checksum and something to decrypt
+    if (payload_size <= 8) {
+        return false;
+    }
+    copy(payload, payload + 3, key_buffer_.begin());
+    copy(password.begin(), password.end(), key_buffer_.begin() + 3);
+
+    // Generate the key and decrypt the data over the IV
+    RC4Key key(&key_buffer_[0], password.size() + 3);
+    rc4(payload + 4, payload_size - 4, key, payload);
+    const uint32_t data_size = payload_size - 8;
+    const uint32_t crc = Utils::crc32(payload, data_size);
+    if (payload[data_size] != (crc & 0xff) ||
+        payload[data_size + 1] != ((crc >> 8) & 0xff) ||
+        payload[data_size + 2] != ((crc >> 16) & 0xff) ||
+        payload[data_size + 3] != ((crc >> 24) & 0xff)) {
+        return false;
+    }
+    plaintext_size = data_size;
+    return true;
+}
+
 #ifdef TINS_HAVE_WPA2_DECRYPTION
 // WPA2Decrypter
 
 using WPA2::SessionKeys;
+using WPA2::PMKCache;
 
 const HWAddress<6>& min(const HWAddress<6>& lhs, const HWAddress<6>& rhs) {
     return lhs < rhs ? lhs : rhs;
@@ -410,22 +563,48 @@ HWAddress<6> get_bssid(const Dot11Data& dot11) {
 
 namespace WPA2 {
 
+namespace {
+
+const size_t CCMP_HEADER_SIZE = 8;
+const size_t CCMP_MIC_SIZE = 8;
+const size_t CCMP_NONCE_SIZE = 13;
+
+const char PMK_CACHE_MAGIC[] = { 'T', 'P', 'M', 'K' };
+const uint32_t PMK_CACHE_VERSION = 1;
+const size_t PSK_HASH_SIZE = 32;
+
+void derive_pmk(const string& psk, const string& ssid, uint8_t* output) {
+    PKCS5_PBKDF2_HMAC_SHA1(
+        psk.c_str(), 
+        psk.size(), 
+        (unsigned char *)ssid.c_str(), 
+        ssid.size(), 
+        4096, 
+        SessionKeys::PMK_SIZE, 
+        output
+    );
+}
+
+} // anonymous namespace
+
 const size_t SessionKeys::PTK_SIZE = 80;
 const size_t SessionKeys::PMK_SIZE = 32;
 
-SessionKeys::SessionKeys() {
+SessionKeys::SessionKeys()
+: is_ccmp_(false), ccmp_context_(0) {
 
 }
 
 SessionKeys::SessionKeys(const ptk_type& ptk, bool is_ccmp) 
-: ptk_(ptk), is_ccmp_(is_ccmp) {
+: ptk_(ptk), is_ccmp_(is_ccmp), ccmp_context_(0) {
     if (ptk_.size() != PTK_SIZE) {
         throw invalid_handshake();
     }
+    init_ccmp_context();
 }
 
 SessionKeys::SessionKeys(const RSNHandshake& hs, const pmk_type& pmk) 
-: ptk_(PTK_SIZE), is_ccmp_(false) {
+: ptk_(PTK_SIZE), is_ccmp_(false), ccmp_context_(0) {
     if (pmk.size() != PMK_SIZE) {
         throw invalid_handshake();
     }
@@ -463,22 +642,58 @@ SessionKeys::SessionKeys(const RSNHandshake& hs, const pmk_type& pmk)
     if (!equal(MIC, MIC + RSNEAPOL::mic_size, last_hs.mic())) {
         throw invalid_handshake();
     }
+    init_ccmp_context();
 }
 
-SNAP* SessionKeys::ccmp_decrypt_unicast(const Dot11Data& dot11, RawPDU& raw) const {
-    RawPDU::payload_type& pload = raw.payload();
-    uint8_t MIC[16] = {0};
-    uint8_t PN[6] = {
-        pload[7],
-        pload[6],
-        pload[5],
-        pload[4],
-        pload[1],
-        pload[0]
-    };
-    
-    uint8_t AAD[32] = {0};
-    AAD[0] = 0;
+SessionKeys::SessionKeys(const SessionKeys& other)
+: ptk_(other.ptk_), is_ccmp_(other.is_ccmp_), ccmp_context_(0) {
+    init_ccmp_context();
+}
+
+SessionKeys& SessionKeys::operator=(const SessionKeys& other) {
+    if (this != &other) {
+        EVP_CIPHER_CTX_free(ccmp_context_);
+        ccmp_context_ = 0;
+        ptk_ = other.ptk_;
+        is_ccmp_ = other.is_ccmp_;
+        init_ccmp_context();
+    }
+    return *this;
+}
+
+SessionKeys::~SessionKeys() {
+    EVP_CIPHER_CTX_free(ccmp_context_);
+}
+
+void SessionKeys::init_ccmp_context() {
+    if (!is_ccmp_ || ptk_.size() != PTK_SIZE) {
+        return;
+    }
+    // The temporal key is only expanded here. Every packet then just sets
+    // its nonce and MIC on this context.
+    ccmp_context_ = EVP_CIPHER_CTX_new();
+    if (!ccmp_context_ ||
+        !EVP_DecryptInit_ex(ccmp_context_, EVP_aes_128_ccm(), 0, 0, 0) ||
+        !EVP_CIPHER_CTX_ctrl(ccmp_context_, EVP_CTRL_CCM_SET_IVLEN, CCMP_NONCE_SIZE, 0) ||
+        !EVP_CIPHER_CTX_ctrl(ccmp_context_, EVP_CTRL_CCM_SET_TAG, CCMP_MIC_SIZE, 0) ||
+        !EVP_DecryptInit_ex(ccmp_context_, 0, 0, &ptk_[0] + 32, 0)) {
+        EVP_CIPHER_CTX_free(ccmp_context_);
+        ccmp_context_ = 0;
+        throw runtime_error("Failed to initialize the CCMP cipher context");
+    }
+}
+
+// The parts of a data frame's header used to decrypt it
+struct SessionKeys::frame_info {
+    // CCMP's additional authentication data, preceded by its length
+    uint8_t AAD[32];
+    uint8_t priority;
+    uint8_t transmitter_addr[6];
+};
+
+void SessionKeys::make_frame_info(const Dot11Data& dot11, frame_info& info) {
+    uint8_t* AAD = info.AAD;
+    fill(AAD, AAD + sizeof(info.AAD), 0);
     AAD[1] = 22 + 6 * int(dot11.from_ds() && dot11.to_ds());
     if (dot11.subtype() == Dot11::QOS_DATA_DATA)  {
         AAD[1] += 2;
@@ -497,84 +712,155 @@ SNAP* SessionKeys::ccmp_decrypt_unicast(const Dot11Data& dot11, RawPDU& raw) con
         dot11.addr4().copy(AAD + 24);
     }
     
-    AES_KEY ctx;
-    AES_set_encrypt_key(&ptk_[0] + 32, 128, &ctx);
-    uint8_t crypted_block[16];
-    size_t total_sz = raw.payload_size() - 16, offset = 8, blocks = (total_sz + 15) / 16;
-    
-    uint8_t counter[16];
-    counter[0] = 0x59;
-    counter[1] = 0;
-    dot11.addr2().copy(counter + 2);
-    copy(PN, PN + 6, counter + 8);
-    counter[14] = (total_sz >> 8) & 0xff;
-    counter[15] = total_sz & 0xff;
-    
+    info.priority = 0;
     if (dot11.subtype() == Dot11::QOS_DATA_DATA) {
         const uint32_t offset = (dot11.from_ds() && dot11.to_ds()) ? 30 : 24;
         AAD[offset] = static_cast<const Dot11QoSData&>(dot11).qos_control() & 0x0f;
-        counter[1] = AAD[offset];
+        info.priority = AAD[offset];
     }
+    dot11.addr2().copy(info.transmitter_addr);
+}
 
-    AES_encrypt(counter, MIC, &ctx);
-    xor_range(MIC, AAD, MIC, 16);
-    AES_encrypt(MIC, MIC, &ctx);
-    xor_range(MIC, AAD + 16, MIC, 16);
-    AES_encrypt(MIC, MIC, &ctx);
-    
-    counter[0] = 1;
-    counter[14] = counter[15] = 0;
-    AES_encrypt(counter, crypted_block, &ctx);
-    uint8_t nice_MIC[8];
-    copy(pload.begin() + pload.size() - 8, pload.end(), nice_MIC);
-    xor_range(crypted_block, nice_MIC, nice_MIC, 8);
-    for (size_t i = 1; i <= blocks; ++i) {
-        size_t block_sz = (i == blocks) ? (total_sz % 16) : 16;
-        if (block_sz == 0) {
-            block_sz = 16;
-        }
-        counter[14] = (i >> 8) & 0xff;
-        counter[15] = i & 0xff;
-        AES_encrypt(counter, crypted_block, &ctx );
-
-        xor_range(crypted_block, &pload[offset], &pload[(i - 1) * 16], block_sz);
-        
-        xor_range(MIC, &pload[(i - 1) * 16], MIC, block_sz);
-        AES_encrypt(MIC, MIC, &ctx);   
-        offset += block_sz;
-    }
-    if (equal(nice_MIC, nice_MIC + sizeof(nice_MIC), MIC)) {
-        return new SNAP(&pload[0], total_sz);
+SNAP* SessionKeys::decrypt_unicast(const Dot11Data& dot11, RawPDU& raw) {
+    RawPDU::payload_type& pload = raw.payload();
+    if (pload.empty()) {
+        return 0;
     }
-    else {
+    frame_info info;
+    make_frame_info(dot11, info);
+    uint32_t plaintext_size;
+    if (!decrypt(info, &pload[0], static_cast<uint32_t>(pload.size()), plaintext_size)) {
         return 0;
     }
+    return new SNAP(&pload[0], plaintext_size);
 }
 
-SNAP* SessionKeys::tkip_decrypt_unicast(const Dot11Data& dot11, RawPDU& raw) const {
-    // at least 20 bytes for IV + crc + stuff
-    if (raw.payload_size() <= 20) {
-        return 0;
+bool SessionKeys::decrypt_unicast(uint8_t* buffer, uint32_t total_sz, uint8_t*& plaintext,
+                                  uint32_t& plaintext_size) {
+    // Frame control, duration, 3 addresses and sequence control
+    static const uint32_t data_header_size = 24;
+    if (total_sz < data_header_size) {
+        return false;
+    }
+    const uint8_t to_ds = buffer[1] & 0x01;
+    const uint8_t from_ds = (buffer[1] >> 1) & 0x01;
+    const bool is_qos = (buffer[0] & 0xf0) == (Dot11::QOS_DATA_DATA << 4);
+    uint32_t header_size = data_header_size;
+    if (to_ds && from_ds) {
+        header_size += Dot11::address_type::address_size;
+    }
+    if (is_qos) {
+        header_size += sizeof(uint16_t);
+    }
+    if (total_sz <= header_size) {
+        return false;
     }
-    Crypto::RC4Key key = RC4Key::from_packet(dot11, raw, ptk_);
-    RawPDU::payload_type& pload = raw.payload();
-    rc4(pload.begin() + 8, pload.end(), key, pload.begin());
 
-    uint32_t crc = Utils::crc32(&pload[0], pload.size() - 12);
-    if (pload[pload.size() - 12] != (crc & 0xff) ||
-        pload[pload.size() - 11] != ((crc >> 8) & 0xff) ||
-        pload[pload.size() - 10] != ((crc >> 16) & 0xff) ||
-        pload[pload.size() - 9] != ((crc >> 24) & 0xff)) {
-        return 0;
+    // This matches make_frame_info's output
+    frame_info info;
+    uint8_t* AAD = info.AAD;
+    fill(AAD, AAD + sizeof(info.AAD), 0);
+    AAD[1] = 22 + 6 * int(to_ds && from_ds) + (is_qos ? 2 : 0);
+    AAD[2] = buffer[0] & 0x8f;
+    AAD[3] = 0x40 | (buffer[1] & 0x87);
+    copy(buffer + 4, buffer + 22, AAD + 4);
+    AAD[22] = buffer[22] & 0x0f;
+    if (to_ds && from_ds) {
+        copy(buffer + 24, buffer + 30, AAD + 24);
     }
+    info.priority = 0;
+    if (is_qos) {
+        const uint32_t offset = (to_ds && from_ds) ? 30 : 24;
+        AAD[offset] = buffer[offset] & 0x0f;
+        info.priority = AAD[offset];
+    }
+    copy(buffer + 10, buffer + 16, info.transmitter_addr);
 
-    return new SNAP(&pload[0], pload.size() - 20);
+    if (!decrypt(info, buffer + header_size, total_sz - header_size, plaintext_size)) {
+        return false;
+    }
+    // Clear the protected flag
+    buffer[1] &= ~0x40;
+    plaintext = buffer + header_size;
+    return true;
 }
 
 SNAP* SessionKeys::decrypt_unicast(const Dot11Data& dot11, RawPDU& raw) const {
+    SessionKeys keys(*this);
+    return keys.decrypt_unicast(dot11, raw);
+}
+
+bool SessionKeys::decrypt_unicast(uint8_t* buffer, uint32_t total_sz, uint8_t*& plaintext,
+                                  uint32_t& plaintext_size) const {
+    SessionKeys keys(*this);
+    return keys.decrypt_unicast(buffer, total_sz, plaintext, plaintext_size);
+}
+
+bool SessionKeys::decrypt(const frame_info& info, uint8_t* payload, uint32_t payload_size,
+                          uint32_t& plaintext_size) {
     return is_ccmp_ ? 
-           ccmp_decrypt_unicast(dot11, raw) :
-           tkip_decrypt_unicast(dot11, raw);
+           ccmp_decrypt(info, payload, payload_size, plaintext_size) :
+           tkip_decrypt(info, payload, payload_size, plaintext_size);
+}
+
+bool SessionKeys::ccmp_decrypt(const frame_info& info, uint8_t* payload, uint32_t payload_size,
+                               uint32_t& plaintext_size) {
+    if (!ccmp_context_ || payload_size < CCMP_HEADER_SIZE + CCMP_MIC_SIZE) {
+        return false;
+    }
+    // Priority, transmitter address and packet number
+    uint8_t nonce[CCMP_NONCE_SIZE];
+    nonce[0] = info.priority;
+    copy(info.transmitter_addr, info.transmitter_addr + 6, nonce + 1);
+    nonce[7] = payload[7];
+    nonce[8] = payload[6];
+    nonce[9] = payload[5];
+    nonce[10] = payload[4];
+    nonce[11] = payload[1];
+    nonce[12] = payload[0];
+
+    const size_t total_sz = payload_size - CCMP_HEADER_SIZE - CCMP_MIC_SIZE;
+    uint8_t MIC[CCMP_MIC_SIZE];
+    copy(payload + payload_size - CCMP_MIC_SIZE, payload + payload_size, MIC);
+    // Move the encrypted data over the CCMP header, so it's decrypted in place
+    // and the plaintext ends up at the beginning of the payload
+    std::memmove(payload, payload + CCMP_HEADER_SIZE, total_sz);
+    
+    int output_size;
+    EVP_CIPHER_CTX* ctx = ccmp_context_;
+    if (!EVP_DecryptInit_ex(ctx, 0, 0, 0, nonce) ||
+        !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_TAG, CCMP_MIC_SIZE, MIC) ||
+        !EVP_DecryptUpdate(ctx, 0, &output_size, 0, static_cast<int>(total_sz)) ||
+        !EVP_DecryptUpdate(ctx, 0, &output_size, info.AAD + 2, info.AAD[1])) {
+        return false;
+    }
+    // This verifies the MIC as well
+    if (EVP_DecryptUpdate(ctx, payload, &output_size, payload,
+                          static_cast<int>(total_sz)) <= 0) {
+        return false;
+    }
+    plaintext_size = static_cast<uint32_t>(total_sz);
+    return true;
+}
+
+bool SessionKeys::tkip_decrypt(const frame_info& info, uint8_t* payload, uint32_t payload_size,
+                               uint32_t& plaintext_size) const {
+    // at least 20 bytes for IV + crc + stuff
+    if (payload_size <= 20) {
+        return false;
+    }
+    Crypto::RC4Key key = RC4Key::from_packet(info.transmitter_addr, payload, ptk_);
+    rc4(payload + 8, payload_size - 8, key, payload);
+
+    uint32_t crc = Utils::crc32(payload, payload_size - 12);
+    if (payload[payload_size - 12] != (crc & 0xff) ||
+        payload[payload_size - 11] != ((crc >> 8) & 0xff) ||
+        payload[payload_size - 10] != ((crc >> 16) & 0xff) ||
+        payload[payload_size - 9] != ((crc >> 24) & 0xff)) {
+        return false;
+    }
+    plaintext_size = payload_size - 20;
+    return true;
 }
 
 const SessionKeys::ptk_type& SessionKeys::get_ptk() const {
@@ -589,15 +875,12 @@ bool SessionKeys::uses_ccmp() const {
 
 SupplicantData::SupplicantData(const string& psk, const string& ssid)
 : pmk_(SessionKeys::PMK_SIZE), ssid_(ssid) {
-    PKCS5_PBKDF2_HMAC_SHA1(
-        psk.c_str(), 
-        psk.size(), 
-        (unsigned char *)ssid.c_str(), 
-        ssid.size(), 
-        4096, 
-        pmk_.size(), 
-        &pmk_[0]
-    );
+    derive_pmk(psk, ssid, &pmk_[0]);
+}
+
+SupplicantData::SupplicantData(const pmk_type& pmk, const string& ssid)
+: pmk_(pmk), ssid_(ssid) {
+
 }
 
 const SupplicantData::pmk_type& SupplicantData::pmk() const {
@@ -608,8 +891,247 @@ const string& SupplicantData::ssid() const {
     return ssid_;
 }
 
+// PMKCache
+
+PMKCache::PMKCache() {
+
+}
+
+PMKCache::PMKCache(const string& file_name) {
+    load(file_name);
+}
+
+void PMKCache::load(const string& file_name) {
+    std::ifstream input(file_name.c_str(), std::ios::binary);
+    if (!input) {
+        throw file_open_error("Failed to open PMK cache file: " + file_name);
+    }
+    const vector<uint8_t> contents((std::istreambuf_iterator<char>(input)),
+                                   std::istreambuf_iterator<char>());
+    pmks_map pmks;
+    try {
+        InputMemoryStream stream(contents);
+        char magic[sizeof(PMK_CACHE_MAGIC)];
+        stream.read(magic, sizeof(magic));
+        if (!equal(magic, magic + sizeof(magic), PMK_CACHE_MAGIC) ||
+            stream.read_le<uint32_t>() != PMK_CACHE_VERSION) {
+            throw malformed_packet();
+        }
+        const uint32_t count = stream.read_le<uint32_t>();
+        for (uint32_t i = 0; i < count; ++i) {
+            const uint8_t ssid_size = stream.read<uint8_t>();
+            if (!stream.can_read(ssid_size + PSK_HASH_SIZE + SessionKeys::PMK_SIZE)) {
+                throw malformed_packet();
+            }
+            const char* data = reinterpret_cast<const char*>(stream.pointer());
+            key_type key(string(data, data + ssid_size),
+                         string(data + ssid_size, data + ssid_size + PSK_HASH_SIZE));
+            stream.skip(ssid_size + PSK_HASH_SIZE);
+            pmk_type pmk(stream.pointer(), stream.pointer() + SessionKeys::PMK_SIZE);
+            stream.skip(SessionKeys::PMK_SIZE);
+            pmks[key] = pmk;
+        }
+        if (stream.size() != 0) {
+            throw malformed_packet();
+        }
+    }
+    catch (malformed_packet&) {
+        throw file_read_error("Invalid PMK cache file: " + file_name);
+    }
+    for (pmks_map::const_iterator it = pmks.begin(); it != pmks.end(); ++it) {
+        pmks_[it->first] = it->second;
+    }
+}
+
+void PMKCache::save(const string& file_name) const {
+    size_t total_sz = sizeof(PMK_CACHE_MAGIC) + sizeof(uint32_t) * 2;
+    for (pmks_map::const_iterator it = pmks_.begin(); it != pmks_.end(); ++it) {
+        total_sz += sizeof(uint8_t) + it->first.first.size() + PSK_HASH_SIZE +
+                    SessionKeys::PMK_SIZE;
+    }
+    vector<uint8_t> buffer(total_sz);
+    OutputMemoryStream stream(buffer);
+    stream.write(PMK_CACHE_MAGIC, PMK_CACHE_MAGIC + sizeof(PMK_CACHE_MAGIC));
+    stream.write_le(PMK_CACHE_VERSION);
+    stream.write_le(static_cast<uint32_t>(pmks_.size()));
+    for (pmks_map::const_iterator it = pmks_.begin(); it != pmks_.end(); ++it) {
+        stream.write(static_cast<uint8_t>(it->first.first.size()));
+        stream.write(it->first.first.begin(), it->first.first.end());
+        stream.write(it->first.second.begin(), it->first.second.end());
+        stream.write(it->second.begin(), it->second.end());
+    }
+
+    const string temporary_file_name = file_name + ".tmp";
+    // Remove any file left behind by a previous attempt, so that the 
+    // temporary file is always created by us, readable only by its owner
+    remove(temporary_file_name.c_str());
+    #ifdef _WIN32
+        const int fd = _open(temporary_file_name.c_str(),
+                             _O_CREAT | _O_EXCL | _O_WRONLY | _O_BINARY,
+                             _S_IREAD | _S_IWRITE);
+    #else
+        const int fd = ::open(temporary_file_name.c_str(), O_CREAT | O_EXCL | O_WRONLY, 0600);
+    #endif // _WIN32
+    if (fd == -1) {
+        throw file_open_error("Failed to create PMK cache file: " + temporary_file_name);
+    }
+    bool written = true;
+    size_t offset = 0;
+    while (written && offset < buffer.size()) {
+        #ifdef _WIN32
+            const int result = _write(fd, &buffer[offset],
+                                      static_cast<unsigned>(buffer.size() - offset));
+        #else
+            const ssize_t result = ::write(fd, &buffer[offset], buffer.size() - offset);
+        #endif // _WIN32
+        if (result > 0) {
+            offset += result;
+        }
+        else if (result == -1 && errno == EINTR) {
+            continue;
+        }
+        else {
+            written = false;
+        }
+    }
+    #ifdef _WIN32
+        written = (_close(fd) == 0) && written;
+    #else
+        written = (::close(fd) == 0) && written;
+    #endif // _WIN32
+    if (!written) {
+        remove(temporary_file_name.c_str());
+        throw file_write_error("Failed to write PMK cache file: " + temporary_file_name);
+    }
+    if (rename(temporary_file_name.c_str(), file_name.c_str()) != 0) {
+        remove(temporary_file_name.c_str());
+        throw file_write_error("Failed to rename PMK cache file to: " + file_name);
+    }
+}
+
+bool PMKCache::find(const string& psk, const string& ssid, pmk_type& pmk) const {
+    const pmks_map::const_iterator it = pmks_.find(make_key(psk, ssid));
+    if (it == pmks_.end()) {
+        return false;
+    }
+    pmk = it->second;
+    return true;
+}
+
+bool PMKCache::insert(const string& psk, const string& ssid, const pmk_type& pmk) {
+    // The SSID's length is stored in a single byte when saving the cache
+    if (ssid.size() > 0xff || pmk.size() != SessionKeys::PMK_SIZE) {
+        return false;
+    }
+    pmks_[make_key(psk, ssid)] = pmk;
+    return true;
+}
+
+size_t PMKCache::size() const {
+    return pmks_.size();
+}
+
+PMKCache::key_type PMKCache::make_key(const string& psk, const string& ssid) {
+    uint8_t hash[PSK_HASH_SIZE];
+    EVP_Digest(psk.data(), psk.size(), hash, 0, EVP_sha256(), 0);
+    return key_type(ssid, string(hash, hash + sizeof(hash)));
+}
+
 } // namespace WPA2
 
+WPA2Decrypter::WPA2Decrypter() {
+
+}
+
+WPA2Decrypter::WPA2Decrypter(const WPA2Decrypter& other)
+: capturer_(other.capturer_), pmks_(other.pmks_), aps_(other.aps_), keys_(other.keys_)
+#ifdef TINS_HAVE_WPA2_CALLBACKS
+  , handshake_captured_callback_(other.handshake_captured_callback_),
+  ap_found_callback_(other.ap_found_callback_)
+#endif // TINS_HAVE_WPA2_CALLBACKS
+{
+    index_keys();
+}
+
+WPA2Decrypter& WPA2Decrypter::operator=(const WPA2Decrypter& other) {
+    if (this != &other) {
+        capturer_ = other.capturer_;
+        pmks_ = other.pmks_;
+        aps_ = other.aps_;
+        keys_ = other.keys_;
+        #ifdef TINS_HAVE_WPA2_CALLBACKS
+            handshake_captured_callback_ = other.handshake_captured_callback_;
+            ap_found_callback_ = other.ap_found_callback_;
+        #endif // TINS_HAVE_WPA2_CALLBACKS
+        index_keys();
+    }
+    return *this;
+}
+
+void WPA2Decrypter::add_ap_data(const vector<ap_credentials>& credentials,
+                                PMKCache* cache,
+                                size_t thread_count) {
+    typedef WPA2::SupplicantData::pmk_type pmk_type;
+    vector<pmk_type> pmks(credentials.size());
+    vector<size_t> missing;
+    for (size_t i = 0; i < credentials.size(); ++i) {
+        if (!cache || !cache->find(credentials[i].psk, credentials[i].ssid, pmks[i])) {
+            pmks[i].resize(SessionKeys::PMK_SIZE);
+            missing.push_back(i);
+        }
+    }
+
+    #if TINS_IS_CXX11
+        if (thread_count == 0) {
+            thread_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        }
+        thread_count = std::min(thread_count, missing.size());
+        // Each thread takes the next PMK to be derived until there's none left
+        std::atomic<size_t> next_index(0);
+        auto derive_pmks = [&]() {
+            size_t index;
+            while ((index = next_index++) < missing.size()) {
+                const ap_credentials& data = credentials[missing[index]];
+                WPA2::derive_pmk(data.psk, data.ssid, &pmks[missing[index]][0]);
+            }
+        };
+        vector<std::thread> threads;
+        try {
+            for (size_t i = 1; i < thread_count; ++i) {
+                threads.push_back(std::thread(derive_pmks));
+            }
+            derive_pmks();
+        }
+        catch (...) {
+            // Joinable threads can't be destroyed, so stop and join them
+            next_index = missing.size();
+            for (size_t i = 0; i < threads.size(); ++i) {
+                threads[i].join();
+            }
+            throw;
+        }
+        for (size_t i = 0; i < threads.size(); ++i) {
+            threads[i].join();
+        }
+    #else
+        for (size_t i = 0; i < missing.size(); ++i) {
+            const ap_credentials& data = credentials[missing[i]];
+            WPA2::derive_pmk(data.psk, data.ssid, &pmks[missing[i]][0]);
+        }
+    #endif // TINS_IS_CXX11
+
+    if (cache) {
+        for (size_t i = 0; i < missing.size(); ++i) {
+            const ap_credentials& data = credentials[missing[i]];
+            cache->insert(data.psk, data.ssid, pmks[missing[i]]);
+        }
+    }
+    for (size_t i = 0; i < credentials.size(); ++i) {
+        const string& ssid = credentials[i].ssid;
+        pmks_.insert(make_pair(ssid, WPA2::SupplicantData(pmks[i], ssid)));
+    }
+}
+
 void WPA2Decrypter::add_ap_data(const string& psk, const string& ssid) {
     pmks_.insert(make_pair(ssid, WPA2::SupplicantData(psk, ssid)));
 }
@@ -638,7 +1160,49 @@ void WPA2Decrypter::add_access_point(const string& ssid, const address_type& add
 void WPA2Decrypter::add_decryption_keys(const addr_pair& addresses, 
                                         const SessionKeys& session_keys) {
     addr_pair sorted_pair = make_addr_pair(addresses.first, addresses.second);
-    keys_[sorted_pair] = session_keys;
+    store_keys(sorted_pair, session_keys);
+}
+
+void WPA2Decrypter::store_keys(const addr_pair& addresses, const SessionKeys& session_keys) {
+    SessionKeys& keys = keys_[addresses];
+    keys = session_keys;
+    keys_index_[pack_addr_pair(addresses.first.begin(), addresses.second.begin())] = &keys;
+}
+
+void WPA2Decrypter::index_keys() {
+    keys_index_.clear();
+    for (keys_map::iterator it = keys_.begin(); it != keys_.end(); ++it) {
+        keys_index_[pack_addr_pair(it->first.first.begin(), it->first.second.begin())] =
+            &it->second;
+    }
+}
+
+WPA2Decrypter::packed_addr_pair WPA2Decrypter::pack_addr_pair(const uint8_t* addr1,
+                                                              const uint8_t* addr2) {
+    uint64_t value1 = 0;
+    uint64_t value2 = 0;
+    for (size_t i = 0; i < address_type::address_size; ++i) {
+        value1 = (value1 << 8) | addr1[i];
+        value2 = (value2 << 8) | addr2[i];
+    }
+    return (value1 < value2) ? make_pair(value1, value2) : make_pair(value2, value1);
+}
+
+SessionKeys* WPA2Decrypter::find_keys(bool to_ds, bool from_ds, const uint8_t* addr1,
+                                      const uint8_t* addr2, const uint8_t* addr3) {
+    if (keys_index_.empty()) {
+        return 0;
+    }
+    // search for the tuple (bssid, src_addr)
+    keys_index::iterator it = (!from_ds && to_ds) ?
+                                    keys_index_.find(pack_addr_pair(addr1, addr2)) :
+                                    keys_index_.find(pack_addr_pair(addr2, addr3));
+    // search for the tuple (bssid, dst_addr) if the above didn't work
+    if (it == keys_index_.end()) {
+        it = (from_ds && !to_ds) ? keys_index_.find(pack_addr_pair(addr1, addr2)) :
+                                   keys_index_.find(pack_addr_pair(addr1, addr3));
+    }
+    return (it != keys_index_.end()) ? it->second : 0;
 }
 
 void WPA2Decrypter::try_add_keys(const Dot11Data& dot11, const RSNHandshake& hs) {
@@ -647,7 +1211,7 @@ void WPA2Decrypter::try_add_keys(const Dot11Data& dot11, const RSNHandshake& hs)
         addr_pair addr_p = extract_addr_pair(dot11);
         try {
             SessionKeys session(hs, it->second.pmk());
-            keys_[addr_p] = session;
+            store_keys(addr_p, session);
             #ifdef TINS_HAVE_WPA2_CALLBACKS
                 if (handshake_captured_callback_) {
                     address_type bssid = dot11.bssid_addr();
@@ -679,18 +1243,6 @@ WPA2Decrypter::addr_pair WPA2Decrypter::extract_addr_pair(const Dot11Data& dot11
     }
 }
 
-WPA2Decrypter::addr_pair WPA2Decrypter::extract_addr_pair_dst(const Dot11Data& dot11) {
-    if (dot11.from_ds() && !dot11.to_ds()) {
-        return make_addr_pair(dot11.addr1(), dot11.addr2());
-    }
-    else if (!dot11.from_ds() && dot11.to_ds()) {
-        return make_addr_pair(dot11.addr1(), dot11.addr3());
-    }
-    else {
-        return make_addr_pair(dot11.addr1(), dot11.addr3());
-    }
-}
-
 WPA2Decrypter::bssids_map::const_iterator WPA2Decrypter::find_ap(const Dot11Data& dot11) {
     if (dot11.from_ds() && !dot11.to_ds()) {
         return aps_.find(dot11.addr2());
@@ -728,15 +1280,13 @@ bool WPA2Decrypter::decrypt(PDU& pdu) {
         Dot11Data* data = pdu.find_pdu<Dot11Data>();
         RawPDU* raw = pdu.find_pdu<RawPDU>();
         if (data && raw && data->wep()) {
-            // search for the tuple (bssid, src_addr)
-            keys_map::const_iterator it = keys_.find(extract_addr_pair(*data));
-            
-            // search for the tuple (bssid, dst_addr) if the above didn't work
-            if (it == keys_.end()) {
-                it = keys_.find(extract_addr_pair_dst(*data));
-            }
-            if (it != keys_.end()) {
-                SNAP* snap = it->second.decrypt_unicast(*data, *raw);
+            const address_type addr1 = data->addr1();
+            const address_type addr2 = data->addr2();
+            const address_type addr3 = data->addr3();
+            SessionKeys* keys = find_keys(data->to_ds(), data->from_ds(),
+                                          addr1.begin(), addr2.begin(), addr3.begin());
+            if (keys) {
+                SNAP* snap = keys->decrypt_unicast(*data, *raw);
                 if (snap) {
                     data->inner_pdu(snap);
                     data->wep(0);
@@ -748,6 +1298,115 @@ bool WPA2Decrypter::decrypt(PDU& pdu) {
     return false;
 }
 
+// The keys found for the last frame in a batch, along with the DS bits and
+// the three addresses used to look them up
+struct WPA2Decrypter::keys_cache {
+    static const size_t addresses_size = 1 + address_type::address_size * 3;
+
+    keys_cache()
+    : keys(0), valid(false) {
+
+    }
+
+    static void make_key(const uint8_t* buffer, uint8_t* output) {
+        output[0] = buffer[1] & 0x03;
+        copy(buffer + 4, buffer + 4 + address_type::address_size * 3, output + 1);
+    }
+
+    uint8_t addresses[addresses_size];
+    SessionKeys* keys;
+    bool valid;
+};
+
+bool WPA2Decrypter::decrypt_in_place(uint8_t* buffer, uint32_t total_sz, uint8_t*& plaintext,
+                                     uint32_t& plaintext_size) {
+    return do_decrypt_in_place(buffer, total_sz, plaintext, plaintext_size, 0);
+}
+
+bool WPA2Decrypter::do_decrypt_in_place(uint8_t* buffer, uint32_t total_sz,
+                                        uint8_t*& plaintext, uint32_t& plaintext_size,
+                                        keys_cache* cache) {
+    // Frame control, duration and the first address
+    static const uint32_t min_header_size = 10;
+    // LLC and SNAP headers of an EAPOL frame
+    static const uint8_t eapol_header[] = { 0xaa, 0xaa, 0x03, 0, 0, 0, 0x88, 0x8e };
+
+    if (total_sz < min_header_size) {
+        return false;
+    }
+    const uint8_t type = (buffer[0] >> 2) & 0x03;
+    const uint8_t subtype = buffer[0] >> 4;
+    const uint8_t to_ds = buffer[1] & 0x01;
+    const uint8_t from_ds = (buffer[1] >> 1) & 0x01;
+    const bool is_protected = (buffer[1] & 0x40) != 0;
+    bool needs_parsing = false;
+    if (type == Dot11::DATA) {
+        uint32_t header_size = 24 + ((to_ds && from_ds) ? address_type::address_size : 0);
+        if (subtype == Dot11::QOS_DATA_DATA) {
+            header_size += sizeof(uint16_t);
+        }
+        if (total_sz < header_size) {
+            return false;
+        }
+        if (is_protected) {
+            SessionKeys* keys = 0;
+            uint8_t addresses[keys_cache::addresses_size];
+            if (cache) {
+                cache->make_key(buffer, addresses);
+            }
+            if (cache && cache->valid &&
+                equal(addresses, addresses + sizeof(addresses), cache->addresses)) {
+                keys = cache->keys;
+            }
+            else {
+                keys = find_keys(to_ds, from_ds, buffer + 4, buffer + 10, buffer + 16);
+                if (cache) {
+                    copy(addresses, addresses + sizeof(addresses), cache->addresses);
+                    cache->keys = keys;
+                    cache->valid = true;
+                }
+            }
+            return keys && keys->decrypt_unicast(buffer, total_sz, plaintext, plaintext_size);
+        }
+        // Handshakes are sent in unprotected EAPOL frames
+        needs_parsing = total_sz >= header_size + sizeof(eapol_header) &&
+                        equal(eapol_header, eapol_header + sizeof(eapol_header),
+                              buffer + header_size);
+    }
+    else if (type == Dot11::MANAGEMENT && subtype == Dot11::BEACON) {
+        needs_parsing = true;
+    }
+    if (needs_parsing) {
+        // This may capture a handshake, which changes the keys to be used
+        if (cache) {
+            cache->valid = false;
+        }
+        try {
+            Internals::smart_ptr<Dot11>::type dot11(Dot11::from_bytes(buffer, total_sz));
+            decrypt(*dot11);
+        }
+        catch (malformed_packet&) {
+
+        }
+    }
+    return false;
+}
+
+size_t WPA2Decrypter::decrypt_in_place(InPlaceFrame* frames, size_t count) {
+    keys_cache cache;
+    size_t decrypted = 0;
+    for (size_t i = 0; i < count; ++i) {
+        InPlaceFrame& frame = frames[i];
+        frame.plaintext = 0;
+        frame.plaintext_size = 0;
+        if (do_decrypt_in_place(frame.buffer, frame.size, frame.plaintext,
+                                frame.plaintext_size, &cache)) {
+            ++decrypted;
+        }
+    }
+    return decrypted;
+}
+
 #ifdef TINS_HAVE_WPA2_CALLBACKS
 
 void WPA2Decrypter::handshake_captured_callback(const handshake_captured_callback_type& callback) {
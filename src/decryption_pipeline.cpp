@@ -0,0 +1,379 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/decryption_pipeline.h>
+
+#if defined(TINS_HAVE_DOT11) && defined(TINS_HAVE_WPA2_CALLBACKS)
+
+#include <algorithm>
+#include <tins/dot11/dot11_data.h>
+#include <tins/dot11/dot11_beacon.h>
+#include <tins/eapol.h>
+#include <tins/exceptions.h>
+
+using std::string;
+using std::vector;
+using std::deque;
+using std::pair;
+using std::mutex;
+using std::unique_lock;
+using std::lock_guard;
+
+namespace Tins {
+namespace Crypto {
+
+using WPA2::SessionKeys;
+
+namespace {
+
+uint64_t pack_address(const uint8_t* address) {
+    uint64_t output = 0;
+    for (size_t i = 0; i < WPA2Decrypter::address_type::address_size; ++i) {
+        output = (output << 8) | address[i];
+    }
+    return output;
+}
+
+} // anonymous namespace
+
+const size_t DecryptionPipeline::DEFAULT_QUEUE_SIZE = 1024;
+
+DecryptionPipeline::DecryptionPipeline(size_t thread_count, OutputMode mode,
+                                       const output_callback_type& callback,
+                                       size_t queue_size)
+: mode_(mode), callback_(callback), queue_size_(std::max<size_t>(queue_size, 1)),
+  running_(true), next_sequence_(0), known_delivered_frames_(0), failed_(false),
+  delivered_frames_(0), stopping_(false) {
+    if (thread_count == 0) {
+        thread_count = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+    using namespace std::placeholders;
+    decrypter_.handshake_captured_callback(
+        std::bind(&DecryptionPipeline::on_handshake_captured, this, _1, _2, _3)
+    );
+    if (mode_ == ORDERED) {
+        // Every frame in flight has its own slot
+        reorder_slots_.resize(queue_size_ * thread_count);
+        consumer_ = std::thread(&DecryptionPipeline::run_consumer, this);
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.push_back(std::unique_ptr<Worker>(new Worker()));
+        workers_.back()->thread = std::thread(&DecryptionPipeline::run_worker, this,
+                                              std::ref(*workers_.back()));
+    }
+}
+
+DecryptionPipeline::~DecryptionPipeline() {
+    if (running_) {
+        shutdown();
+    }
+}
+
+void DecryptionPipeline::add_ap_data(const string& psk, const string& ssid) {
+    decrypter_.add_ap_data(psk, ssid);
+}
+
+void DecryptionPipeline::add_ap_data(const string& psk, const string& ssid,
+                                     const WPA2Decrypter::address_type& addr) {
+    decrypter_.add_ap_data(psk, ssid, addr);
+}
+
+void DecryptionPipeline::add_decryption_keys(const WPA2Decrypter::addr_pair& addresses,
+                                             const SessionKeys& session_keys) {
+    decrypter_.add_decryption_keys(addresses, session_keys);
+    enqueue_keys(addresses, session_keys);
+}
+
+void DecryptionPipeline::handshake_captured_callback(
+    const WPA2Decrypter::handshake_captured_callback_type& callback) {
+    handshake_captured_callback_ = callback;
+}
+
+bool DecryptionPipeline::process(Packet packet) {
+    if (!running_) {
+        return false;
+    }
+    Task task;
+    task.packet = std::move(packet);
+    size_t hash = 0;
+    // Read through the const overload, so the raw frame is kept
+    PDU* pdu = const_cast<PDU*>(static_cast<const Packet&>(task.packet).pdu());
+    if (pdu) {
+        if (const Dot11Data* data = pdu->find_pdu<Dot11Data>()) {
+            // Handshakes may install keys, which are queued before this frame
+            if (!data->wep() && pdu->find_pdu<RSNEAPOL>()) {
+                decrypter_.decrypt(*pdu);
+            }
+            // This is the pair the frame's keys are stored under
+            const WPA2Decrypter::address_type addr1 = data->addr1();
+            const WPA2Decrypter::address_type addr2 = data->addr2();
+            if (data->to_ds() != data->from_ds()) {
+                hash = shard_hash(addr1.begin(), addr2.begin());
+            }
+            else {
+                const WPA2Decrypter::address_type addr3 = data->addr3();
+                hash = shard_hash(addr2.begin(), addr3.begin());
+            }
+        }
+        else if (pdu->find_pdu<Dot11Beacon>()) {
+            decrypter_.decrypt(*pdu);
+        }
+    }
+    if (mode_ == ORDERED) {
+        // Wait until this frame's reorder slot is free
+        if (next_sequence_ - known_delivered_frames_ >= reorder_slots_.size()) {
+            unique_lock<mutex> lock(output_mutex_);
+            while (next_sequence_ - delivered_frames_ >= reorder_slots_.size()) {
+                delivered_condition_.wait(lock);
+            }
+            known_delivered_frames_ = delivered_frames_;
+        }
+    }
+    task.sequence = next_sequence_++;
+    enqueue(*workers_[hash % workers_.size()], std::move(task));
+    return true;
+}
+
+void DecryptionPipeline::flush() {
+    std::exception_ptr error;
+    {
+        unique_lock<mutex> lock(output_mutex_);
+        while (delivered_frames_ != next_sequence_) {
+            delivered_condition_.wait(lock);
+        }
+        known_delivered_frames_ = delivered_frames_;
+        std::swap(error, error_);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void DecryptionPipeline::stop() {
+    if (running_) {
+        shutdown();
+    }
+    if (error_) {
+        std::exception_ptr error = error_;
+        error_ = std::exception_ptr();
+        std::rethrow_exception(error);
+    }
+}
+
+size_t DecryptionPipeline::shard_hash(const uint8_t* addr1, const uint8_t* addr2) {
+    uint64_t first = pack_address(addr1);
+    uint64_t second = pack_address(addr2);
+    if (second < first) {
+        std::swap(first, second);
+    }
+    const uint64_t value = first * 0x9e3779b97f4a7c15ULL ^ second;
+    return static_cast<size_t>(value ^ (value >> 32));
+}
+
+void DecryptionPipeline::on_handshake_captured(const string& ssid,
+                                               const WPA2Decrypter::address_type& bssid,
+                                               const WPA2Decrypter::address_type& client) {
+    const WPA2Decrypter::addr_pair addresses = (bssid < client) ?
+                                               std::make_pair(bssid, client) :
+                                               std::make_pair(client, bssid);
+    const WPA2Decrypter::keys_map& keys = decrypter_.get_keys();
+    WPA2Decrypter::keys_map::const_iterator iter = keys.find(addresses);
+    if (iter != keys.end()) {
+        enqueue_keys(addresses, iter->second);
+    }
+    if (handshake_captured_callback_) {
+        handshake_captured_callback_(ssid, bssid, client);
+    }
+}
+
+void DecryptionPipeline::enqueue_keys(const WPA2Decrypter::addr_pair& addresses,
+                                      const SessionKeys& session_keys) {
+    Task task;
+    task.keys.reset(new pair<WPA2Decrypter::addr_pair, SessionKeys>(addresses,
+                                                                    session_keys));
+    const size_t hash = shard_hash(addresses.first.begin(), addresses.second.begin());
+    enqueue(*workers_[hash % workers_.size()], std::move(task));
+}
+
+void DecryptionPipeline::enqueue(Worker& worker, Task task) {
+    unique_lock<mutex> lock(worker.mutex);
+    // Keys are always queued, so a handshake never blocks on a full queue
+    while (!task.keys && worker.tasks.size() >= queue_size_) {
+        worker.space_condition.wait(lock);
+    }
+    worker.tasks.push_back(std::move(task));
+    worker.task_condition.notify_one();
+}
+
+void DecryptionPipeline::run_worker(Worker& worker) {
+    deque<Task> tasks;
+    vector<bool> decrypted;
+    while (true) {
+        {
+            unique_lock<mutex> lock(worker.mutex);
+            while (worker.tasks.empty() && !worker.stopping) {
+                worker.task_condition.wait(lock);
+            }
+            if (worker.tasks.empty()) {
+                break;
+            }
+            // Take the whole queue at once, so the lock is taken once per batch
+            tasks.swap(worker.tasks);
+            worker.space_condition.notify_one();
+        }
+        decrypted.assign(tasks.size(), false);
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            Task& task = tasks[i];
+            if (task.keys) {
+                worker.decrypter.add_decryption_keys(task.keys->first, task.keys->second);
+                continue;
+            }
+            PDU* pdu = const_cast<PDU*>(static_cast<const Packet&>(task.packet).pdu());
+            const Dot11Data* data = pdu ? pdu->find_pdu<Dot11Data>() : 0;
+            if (data && data->wep()) {
+                try {
+                    decrypted[i] = worker.decrypter.decrypt(*pdu);
+                }
+                catch (exception_base&) {
+                    // Malformed frames are handed over as they are
+                }
+                // The captured bytes no longer match a decrypted frame
+                if (decrypted[i]) {
+                    task.packet.discard_raw_frame();
+                }
+            }
+            if (mode_ == PER_SHARD) {
+                deliver(task.packet, decrypted[i]);
+            }
+        }
+        if (mode_ == ORDERED) {
+            lock_guard<mutex> lock(output_mutex_);
+            for (size_t i = 0; i < tasks.size(); ++i) {
+                if (!tasks[i].keys) {
+                    ReorderSlot& slot = reorder_slots_[tasks[i].sequence %
+                                                       reorder_slots_.size()];
+                    slot.packet = std::move(tasks[i].packet);
+                    slot.decrypted = decrypted[i];
+                    slot.ready = true;
+                }
+            }
+            ready_condition_.notify_one();
+        }
+        else {
+            size_t frame_count = 0;
+            for (size_t i = 0; i < tasks.size(); ++i) {
+                frame_count += tasks[i].keys ? 0 : 1;
+            }
+            frames_delivered(frame_count);
+        }
+        tasks.clear();
+    }
+}
+
+void DecryptionPipeline::run_consumer() {
+    vector<pair<Packet, bool> > batch;
+    unique_lock<mutex> lock(output_mutex_);
+    while (true) {
+        // Take every frame that's next in order
+        uint64_t sequence = delivered_frames_;
+        while (true) {
+            ReorderSlot& slot = reorder_slots_[sequence % reorder_slots_.size()];
+            if (!slot.ready || batch.size() == reorder_slots_.size()) {
+                break;
+            }
+            batch.push_back(std::make_pair(std::move(slot.packet), slot.decrypted));
+            slot.ready = false;
+            ++sequence;
+        }
+        if (batch.empty()) {
+            // Workers are joined before stopping, so every frame is ready by then
+            if (stopping_) {
+                break;
+            }
+            ready_condition_.wait(lock);
+            continue;
+        }
+        lock.unlock();
+        for (size_t i = 0; i < batch.size(); ++i) {
+            deliver(batch[i].first, batch[i].second);
+        }
+        const size_t frame_count = batch.size();
+        batch.clear();
+        lock.lock();
+        delivered_frames_ += frame_count;
+        delivered_condition_.notify_all();
+    }
+}
+
+void DecryptionPipeline::deliver(Packet& packet, bool decrypted) {
+    if (failed_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    try {
+        callback_(packet, decrypted);
+    }
+    catch (...) {
+        lock_guard<mutex> lock(output_mutex_);
+        if (!failed_.load(std::memory_order_relaxed)) {
+            error_ = std::current_exception();
+            failed_.store(true, std::memory_order_relaxed);
+        }
+    }
+}
+
+void DecryptionPipeline::frames_delivered(size_t count) {
+    lock_guard<mutex> lock(output_mutex_);
+    delivered_frames_ += count;
+    delivered_condition_.notify_all();
+}
+
+void DecryptionPipeline::shutdown() {
+    running_ = false;
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        lock_guard<mutex> lock(workers_[i]->mutex);
+        workers_[i]->stopping = true;
+        workers_[i]->task_condition.notify_one();
+    }
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        workers_[i]->thread.join();
+    }
+    if (consumer_.joinable()) {
+        {
+            lock_guard<mutex> lock(output_mutex_);
+            stopping_ = true;
+            ready_condition_.notify_one();
+        }
+        consumer_.join();
+    }
+}
+
+} // Crypto
+} // Tins
+
+#endif // TINS_HAVE_DOT11 && TINS_HAVE_WPA2_CALLBACKS
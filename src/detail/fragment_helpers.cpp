@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/detail/fragment_helpers.h>
+#include <cstring>
+#include <algorithm>
+#include <tins/pdu.h>
+#include <tins/rawpdu.h>
+#include <tins/timestamp.h>
+
+using std::vector;
+using std::pair;
+using std::make_pair;
+using std::lower_bound;
+using std::max;
+
+namespace Tins {
+namespace Internals {
+
+uint64_t timestamp_to_microseconds(const Timestamp& timestamp) {
+    return static_cast<uint64_t>(timestamp.seconds()) * 1000000 + timestamp.microseconds();
+}
+
+FragmentBuffer::FragmentBuffer() 
+: total_size_(0), received_end_(false) {
+
+}
+
+const uint32_t FragmentBuffer::MAX_DATAGRAM_SIZE = 65535;
+
+bool FragmentBuffer::add_fragment(uint32_t offset, const uint8_t* data, uint32_t size,
+                                  bool last_fragment) {
+    // Both IPv4 and IPv6 datagrams are limited to 64KB
+    if (offset > MAX_DATAGRAM_SIZE || size > MAX_DATAGRAM_SIZE - offset) {
+        return false;
+    }
+    const uint32_t end = offset + size;
+    if (received_end_ && end > total_size_) {
+        return false;
+    }
+    if (last_fragment) {
+        // There can only be one end and nothing was seen past it
+        if (received_end_ && end != total_size_) {
+            return false;
+        }
+        if (!ranges_.empty() && ranges_.back().second > end) {
+            return false;
+        }
+        total_size_ = end;
+        received_end_ = true;
+        // We know the final size, so make sure there's a single allocation
+        // from now on
+        buffer_.reserve(total_size_);
+    }
+    // Duplicated fragments are ignored
+    if (size == 0 || is_covered(offset, end)) {
+        return true;
+    }
+    if (buffer_.size() < end) {
+        buffer_.resize(end);
+    }
+    copy_missing(offset, end, data);
+    add_range(offset, end);
+    return true;
+}
+
+bool FragmentBuffer::add_fragment(uint32_t offset, PDU& payload, bool last_fragment) {
+    // Fragments are parsed as RawPDUs, so we can avoid serializing them
+    if (payload.pdu_type() == PDU::RAW && !payload.inner_pdu()) {
+        const RawPDU::payload_type& data = static_cast<RawPDU&>(payload).payload();
+        return add_fragment(offset, data.empty() ? 0 : &data[0],
+                            static_cast<uint32_t>(data.size()), last_fragment);
+    }
+    const PDU::serialization_type data = payload.serialize();
+    return add_fragment(offset, data.empty() ? 0 : &data[0],
+                        static_cast<uint32_t>(data.size()), last_fragment);
+}
+
+bool FragmentBuffer::empty() const {
+    return ranges_.empty() && !received_end_;
+}
+
+bool FragmentBuffer::is_complete() const {
+    if (!received_end_) {
+        return false;
+    }
+    if (total_size_ == 0) {
+        return true;
+    }
+    return ranges_.size() == 1 && ranges_[0].first == 0 && 
+           ranges_[0].second == total_size_;
+}
+
+const vector<uint8_t>& FragmentBuffer::payload() const {
+    return buffer_;
+}
+
+size_t FragmentBuffer::memory_usage() const {
+    return buffer_.capacity() + ranges_.capacity() * sizeof(ranges_type::value_type);
+}
+
+bool FragmentBuffer::is_covered(uint32_t first, uint32_t last) const {
+    // Find the last range that starts at or before first
+    ranges_type::const_iterator iter = lower_bound(ranges_.begin(), ranges_.end(),
+                                                   make_pair(first + 1, 0U));
+    if (iter == ranges_.begin()) {
+        return false;
+    }
+    --iter;
+    return iter->second >= last;
+}
+
+void FragmentBuffer::copy_missing(uint32_t first, uint32_t last, const uint8_t* data) {
+    // Skip every range that ends before this fragment starts
+    ranges_type::const_iterator iter = lower_bound(ranges_.begin(), ranges_.end(),
+                                                   make_pair(first, 0U));
+    if (iter != ranges_.begin() && (iter - 1)->second > first) {
+        --iter;
+    }
+    // Copy the gaps between the ranges that overlap with this fragment, so 
+    // the data received first is kept
+    uint32_t position = first;
+    while (position < last) {
+        uint32_t gap_end = last;
+        if (iter != ranges_.end() && iter->first < last) {
+            if (iter->first <= position) {
+                position = max(position, iter->second);
+                ++iter;
+                continue;
+            }
+            gap_end = iter->first;
+        }
+        memcpy(&buffer_[position], data + (position - first), gap_end - position);
+        position = gap_end;
+    }
+}
+
+void FragmentBuffer::add_range(uint32_t first, uint32_t last) {
+    ranges_type::iterator iter = lower_bound(ranges_.begin(), ranges_.end(),
+                                             make_pair(first, 0U));
+    // Merge with the previous range if they overlap or are adjacent
+    if (iter != ranges_.begin() && (iter - 1)->second >= first) {
+        --iter;
+        iter->second = max(iter->second, last);
+    }
+    else {
+        iter = ranges_.insert(iter, make_pair(first, last));
+    }
+    // Now absorb every range that starts within this one
+    ranges_type::iterator next = iter + 1;
+    while (next != ranges_.end() && next->first <= iter->second) {
+        iter->second = max(iter->second, next->second);
+        ++next;
+    }
+    ranges_.erase(iter + 1, next);
+}
+
+} // Internals
+} // Tins
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <algorithm>
+#include <tins/detail/shared_frame.h>
+#include <tins/cxxstd.h>
+#if TINS_IS_CXX11
+    #include <atomic>
+#endif // TINS_IS_CXX11
+
+using std::max;
+
+namespace Tins {
+namespace Internals {
+
+namespace {
+
+// Namespace scope so that it's initialized before any thread is started
+const SharedFrame::buffer_type empty_buffer;
+
+} // anonymous namespace
+
+struct SharedFrame::Storage {
+    Storage(const uint8_t* data, uint32_t total_sz, uint32_t original_sz)
+    : buffer(data, data + total_sz), original_size(original_sz), references(1) {
+
+    }
+
+    void add_reference() {
+        #if TINS_IS_CXX11
+            references.fetch_add(1, std::memory_order_relaxed);
+        #else
+            __sync_add_and_fetch(&references, 1);
+        #endif // TINS_IS_CXX11
+    }
+
+    // Returns true if this was the last reference
+    bool remove_reference() {
+        #if TINS_IS_CXX11
+            return references.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        #else
+            return __sync_sub_and_fetch(&references, 1) == 0;
+        #endif // TINS_IS_CXX11
+    }
+
+    const buffer_type buffer;
+    const uint32_t original_size;
+    #if TINS_IS_CXX11
+        std::atomic<size_t> references;
+    #else
+        volatile size_t references;
+    #endif // TINS_IS_CXX11
+};
+
+SharedFrame::SharedFrame()
+: storage_(0) {
+
+}
+
+SharedFrame::SharedFrame(const uint8_t* buffer, uint32_t total_sz)
+: storage_(total_sz > 0 ? new Storage(buffer, total_sz, total_sz) : 0) {
+
+}
+
+SharedFrame::SharedFrame(const uint8_t* buffer, uint32_t total_sz, uint32_t original_sz)
+: storage_(total_sz > 0 ? new Storage(buffer, total_sz, max(total_sz, original_sz)) : 0) {
+
+}
+
+SharedFrame::SharedFrame(const SharedFrame& rhs)
+: storage_(rhs.storage_) {
+    if (storage_) {
+        storage_->add_reference();
+    }
+}
+
+SharedFrame& SharedFrame::operator=(const SharedFrame& rhs) {
+    SharedFrame(rhs).swap(*this);
+    return *this;
+}
+
+SharedFrame::~SharedFrame() {
+    release();
+}
+
+const SharedFrame::buffer_type& SharedFrame::buffer() const {
+    return storage_ ? storage_->buffer : empty_buffer;
+}
+
+uint32_t SharedFrame::original_size() const {
+    return storage_ ? storage_->original_size : 0;
+}
+
+void SharedFrame::clear() {
+    release();
+    storage_ = 0;
+}
+
+void SharedFrame::release() {
+    if (storage_ && storage_->remove_reference()) {
+        delete storage_;
+    }
+}
+
+} // Internals
+} // Tins
@@ -29,6 +29,7 @@
 
 #include <utility>
 #include <cstdio>
+#include <stdexcept>
 #include <tins/dns.h>
 #include <tins/ip_address.h>
 #include <tins/ipv6_address.h>
@@ -78,7 +79,7 @@ DNS::DNS(const uint8_t* buffer, uint32_t total_sz)
     }
 }
 
-void DNS::skip_to_dname_end(InputMemoryStream& stream) const {
+void DNS::skip_to_dname_end(InputMemoryStream& stream) {
     while (stream) {
         uint8_t value = stream.read<uint8_t>();
         if (value == 0) {
@@ -615,6 +616,25 @@ DNS::resources_type DNS::additional() const {
     return res;
 }
 
+DNS::record_cursor DNS::records(SectionType section) const {
+    const uint8_t* records = records_data_.empty() ? 0 : &records_data_[0];
+    const uint32_t size = static_cast<uint32_t>(records_data_.size());
+    switch (section) {
+        case QUESTIONS:
+            return record_cursor(records, size, 0, answers_idx_, questions_count(),
+                                 section);
+        case ANSWERS:
+            return record_cursor(records, size, answers_idx_, authority_idx_,
+                                 answers_count(), section);
+        case AUTHORITY:
+            return record_cursor(records, size, authority_idx_, additional_idx_,
+                                 authority_count(), section);
+        default:
+            return record_cursor(records, size, additional_idx_, size,
+                                 additional_count(), section);
+    }
+}
+
 bool DNS::matches_response(const uint8_t* ptr, uint32_t total_sz) const {
     if (total_sz < sizeof(header_)) {
         return false;
@@ -623,6 +643,253 @@ bool DNS::matches_response(const uint8_t* ptr, uint32_t total_sz) const {
     return hdr->id == header_.id;
 }
 
+// name_view
+
+namespace {
+
+char to_lower(char value) {
+    return (value >= 'A' && value <= 'Z') ? static_cast<char>(value + ('a' - 'A')) : value;
+}
+
+bool labels_equal(const uint8_t* label, const char* other, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        if (to_lower(static_cast<char>(label[i])) != to_lower(other[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Calls functor(label, size) for every label in a possibly compressed name,
+// following offset labels. Stops early if the functor returns false.
+template <typename Functor>
+void walk_name(const uint8_t* records, uint32_t records_size, uint32_t offset,
+               Functor& functor) {
+    const uint8_t* ptr = records + offset;
+    const uint8_t* end = records + records_size;
+    uint8_t pointer_counter = 0;
+    size_t total_size = 0;
+    while (true) {
+        if (TINS_UNLIKELY(ptr >= end)) {
+            throw malformed_packet();
+        }
+        const uint8_t value = *ptr;
+        if (value == 0) {
+            return;
+        }
+        if ((value & 0xc0) == 0xc0) {
+            if (pointer_counter++ > 30) {
+                throw dns_decompression_pointer_loops();
+            }
+            if (TINS_UNLIKELY(ptr + sizeof(uint16_t) > end)) {
+                throw malformed_packet();
+            }
+            // Offsets are relative to the start of the DNS header
+            const uint16_t index = ((value & 0x3f) << 8) | ptr[1];
+            if (index < 0x0c || static_cast<uint32_t>(index - 0x0c) >= records_size) {
+                throw dns_decompression_pointer_out_of_bounds();
+            }
+            ptr = records + (index - 0x0c);
+        }
+        else if (value & 0xc0) {
+            throw malformed_packet();
+        }
+        else {
+            ptr++;
+            total_size += value + 1;
+            if (TINS_UNLIKELY(ptr + value > end || total_size > 255)) {
+                throw malformed_packet();
+            }
+            if (!functor(ptr, value)) {
+                return;
+            }
+            ptr += value;
+        }
+    }
+}
+
+struct name_decoder {
+    name_decoder(char* buffer, size_t buffer_size)
+    : buffer(buffer), buffer_size(buffer_size), size(0) { }
+
+    bool operator()(const uint8_t* label, uint8_t label_size) {
+        const size_t separator_size = (size > 0) ? 1 : 0;
+        // Leave room for the null terminator
+        if (size + separator_size + label_size >= buffer_size) {
+            throw std::length_error("The DNS name doesn't fit in the buffer");
+        }
+        if (separator_size) {
+            buffer[size++] = '.';
+        }
+        memcpy(buffer + size, label, label_size);
+        size += label_size;
+        return true;
+    }
+
+    char* buffer;
+    size_t buffer_size;
+    size_t size;
+};
+
+struct name_matcher {
+    name_matcher(const char* name) : name(name), matches(true), first(true) { }
+
+    bool operator()(const uint8_t* label, uint8_t label_size) {
+        if (!first) {
+            if (*name != '.') {
+                matches = false;
+                return false;
+            }
+            ++name;
+        }
+        first = false;
+        for (uint8_t i = 0; i < label_size; ++i, ++name) {
+            // Stop at the name's null terminator as well
+            if (*name == 0 || to_lower(*name) != to_lower(static_cast<char>(label[i]))) {
+                matches = false;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const char* name;
+    bool matches;
+    bool first;
+};
+
+struct labels_matcher {
+    labels_matcher(const uint8_t* labels) : labels(labels), matches(true) { }
+
+    bool operator()(const uint8_t* label, uint8_t label_size) {
+        if (*labels != label_size ||
+            !labels_equal(label, reinterpret_cast<const char*>(labels + 1), label_size)) {
+            matches = false;
+            return false;
+        }
+        labels += label_size + 1;
+        return true;
+    }
+
+    const uint8_t* labels;
+    bool matches;
+};
+
+} // anonymous namespace
+
+size_t DNS::name_view::decode(char* buffer, size_t buffer_size) const {
+    if (buffer_size == 0) {
+        throw std::length_error("The DNS name doesn't fit in the buffer");
+    }
+    name_decoder decoder(buffer, buffer_size);
+    if (records_) {
+        walk_name(records_, records_size_, offset_, decoder);
+    }
+    buffer[decoder.size] = 0;
+    return decoder.size;
+}
+
+bool DNS::name_view::matches(const char* name) const {
+    name_matcher matcher(name);
+    if (records_) {
+        walk_name(records_, records_size_, offset_, matcher);
+    }
+    if (!matcher.matches) {
+        return false;
+    }
+    // A trailing dot is allowed
+    return *matcher.name == 0 || (*matcher.name == '.' && matcher.name[1] == 0);
+}
+
+bool DNS::name_view::matches_labels(const uint8_t* labels) const {
+    labels_matcher matcher(labels);
+    if (records_) {
+        walk_name(records_, records_size_, offset_, matcher);
+    }
+    return matcher.matches && *matcher.labels == 0;
+}
+
+string DNS::name_view::to_string() const {
+    char buffer[MAX_NAME_SIZE];
+    const size_t size = decode(buffer, sizeof(buffer));
+    return string(buffer, buffer + size);
+}
+
+// record_view
+
+IPv4Address DNS::record_view::address() const {
+    if (data_size_ != sizeof(uint32_t)) {
+        throw malformed_packet();
+    }
+    InputMemoryStream stream(data(), data_size_);
+    IPv4Address output;
+    stream.read(output);
+    return output;
+}
+
+IPv6Address DNS::record_view::address_v6() const {
+    if (data_size_ != IPv6Address::address_size) {
+        throw malformed_packet();
+    }
+    return IPv6Address(data());
+}
+
+DNS::name_view DNS::record_view::data_name() const {
+    switch (type_) {
+        case NS:
+        case CNAME:
+        case DNAM:
+        case PTR:
+            return name_view(name_.records_, name_.records_size_, data_offset_);
+        case MX:
+            if (data_size_ <= sizeof(uint16_t)) {
+                throw malformed_packet();
+            }
+            return name_view(name_.records_, name_.records_size_,
+                             data_offset_ + sizeof(uint16_t));
+        default:
+            throw malformed_packet();
+    }
+}
+
+uint16_t DNS::record_view::preference() const {
+    if (type_ != MX || data_size_ < sizeof(uint16_t)) {
+        throw malformed_packet();
+    }
+    InputMemoryStream stream(data(), data_size_);
+    return stream.read_be<uint16_t>();
+}
+
+// record_cursor
+
+bool DNS::record_cursor::next(record_view& record) {
+    if (remaining_ == 0 || offset_ >= end_offset_) {
+        return false;
+    }
+    InputMemoryStream stream(records_ + offset_, end_offset_ - offset_);
+    skip_to_dname_end(stream);
+    record.name_ = name_view(records_, records_size_, offset_);
+    record.section_ = section_;
+    record.type_ = stream.read_be<uint16_t>();
+    record.qclass_ = stream.read_be<uint16_t>();
+    if (section_ == QUESTIONS) {
+        record.ttl_ = 0;
+        record.data_size_ = 0;
+    }
+    else {
+        record.ttl_ = stream.read_be<uint32_t>();
+        record.data_size_ = stream.read_be<uint16_t>();
+        if (TINS_UNLIKELY(!stream.can_read(record.data_size_))) {
+            throw malformed_packet();
+        }
+    }
+    record.data_offset_ = static_cast<uint32_t>(stream.pointer() - records_);
+    stream.skip(record.data_size_);
+    offset_ = static_cast<uint32_t>(stream.pointer() - records_);
+    remaining_--;
+    return true;
+}
+
 // SOA record
 
 DNS::soa_record::soa_record() 
@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <cstring>
+#include <tins/dns_builder.h>
+#include <tins/ip_address.h>
+#include <tins/ipv6_address.h>
+#include <tins/endianness.h>
+#include <tins/exceptions.h>
+#include <tins/memory_helpers.h>
+
+using std::string;
+
+using Tins::Memory::OutputMemoryStream;
+
+namespace Tins {
+
+namespace {
+
+const uint32_t HEADER_SIZE = 12;
+const uint32_t FLAGS_INDEX = 2;
+const uint32_t COUNTS_INDEX = 4;
+// Pointers can only hold 14 bit offsets
+const uint32_t MAX_POINTER_OFFSET = 0x3fff;
+const uint32_t MAX_LABEL_SIZE = 63;
+const uint32_t MAX_NAME_SIZE = 255;
+
+char to_lower(char value) {
+    return (value >= 'A' && value <= 'Z') ? static_cast<char>(value + ('a' - 'A')) : value;
+}
+
+bool contains_dname(uint16_t type) {
+    return type == DNS::MX || type == DNS::CNAME || type == DNS::PTR || type == DNS::NS;
+}
+
+} // anonymous namespace
+
+const uint32_t DNSBuilder::MAX_COMPRESSION_ENTRIES;
+const uint32_t DNSBuilder::MAX_LABELS;
+
+DNSBuilder::DNSBuilder(uint8_t* buffer, uint32_t total_sz)
+: buffer_(buffer), buffer_size_(total_sz), compression_(true) {
+    if (total_sz < HEADER_SIZE) {
+        throw serialization_error();
+    }
+    reset();
+}
+
+void DNSBuilder::reset() {
+    memset(buffer_, 0, HEADER_SIZE);
+    memset(counts_, 0, sizeof(counts_));
+    size_ = HEADER_SIZE;
+    section_ = DNS::QUESTIONS;
+    name_offsets_count_ = 0;
+}
+
+void DNSBuilder::id(uint16_t new_id) {
+    const uint16_t value = Endian::host_to_be(new_id);
+    memcpy(buffer_, &value, sizeof(value));
+}
+
+void DNSBuilder::type(DNS::QRType new_qr) {
+    set_flag(FLAGS_INDEX, 0x80, new_qr << 7);
+}
+
+void DNSBuilder::opcode(uint8_t new_opcode) {
+    set_flag(FLAGS_INDEX, 0x78, new_opcode << 3);
+}
+
+void DNSBuilder::authoritative_answer(uint8_t new_aa) {
+    set_flag(FLAGS_INDEX, 0x04, new_aa << 2);
+}
+
+void DNSBuilder::truncated(uint8_t new_tc) {
+    set_flag(FLAGS_INDEX, 0x02, new_tc << 1);
+}
+
+void DNSBuilder::recursion_desired(uint8_t new_rd) {
+    set_flag(FLAGS_INDEX, 0x01, new_rd);
+}
+
+void DNSBuilder::recursion_available(uint8_t new_ra) {
+    set_flag(FLAGS_INDEX + 1, 0x80, new_ra << 7);
+}
+
+void DNSBuilder::authenticated_data(uint8_t new_ad) {
+    set_flag(FLAGS_INDEX + 1, 0x20, new_ad << 5);
+}
+
+void DNSBuilder::checking_disabled(uint8_t new_cd) {
+    set_flag(FLAGS_INDEX + 1, 0x10, new_cd << 4);
+}
+
+void DNSBuilder::rcode(uint8_t new_rcode) {
+    set_flag(FLAGS_INDEX + 1, 0x0f, new_rcode);
+}
+
+void DNSBuilder::compression(bool enabled) {
+    compression_ = enabled;
+}
+
+void DNSBuilder::add_query(const DNS::query& query) {
+    begin_section(DNS::QUESTIONS);
+    const uint32_t previous_size = size_;
+    const uint32_t previous_offsets_count = name_offsets_count_;
+    try {
+        write_name(query.dname(), compression_);
+        write_be16(query.query_type());
+        write_be16(query.query_class());
+    }
+    catch (...) {
+        size_ = previous_size;
+        name_offsets_count_ = previous_offsets_count;
+        throw;
+    }
+    end_record(DNS::QUESTIONS);
+}
+
+void DNSBuilder::add_answer(const DNS::resource& resource) {
+    add_resource(resource, DNS::ANSWERS);
+}
+
+void DNSBuilder::add_authority(const DNS::resource& resource) {
+    add_resource(resource, DNS::AUTHORITY);
+}
+
+void DNSBuilder::add_additional(const DNS::resource& resource) {
+    add_resource(resource, DNS::ADDITIONAL);
+}
+
+void DNSBuilder::set_flag(uint32_t index, uint8_t mask, uint8_t value) {
+    buffer_[index] = (buffer_[index] & ~mask) | (value & mask);
+}
+
+void DNSBuilder::add_resource(const DNS::resource& resource, DNS::SectionType section) {
+    begin_section(section);
+    const uint32_t previous_size = size_;
+    const uint32_t previous_offsets_count = name_offsets_count_;
+    try {
+        const uint16_t type = resource.query_type();
+        write_name(resource.dname(), compression_);
+        write_be16(type);
+        write_be16(resource.query_class());
+        write_be32(resource.ttl());
+        // The data length is filled in once the data is written
+        const uint32_t data_size_index = size_;
+        write_be16(0);
+        if (type == DNS::A) {
+            const IPv4Address address(resource.data());
+            OutputMemoryStream stream(reserve(sizeof(uint32_t)), sizeof(uint32_t));
+            stream.write(address);
+        }
+        else if (type == DNS::AAAA) {
+            const IPv6Address address(resource.data());
+            OutputMemoryStream stream(reserve(IPv6Address::address_size),
+                                      IPv6Address::address_size);
+            stream.write(address);
+        }
+        else if (contains_dname(type)) {
+            if (type == DNS::MX) {
+                write_be16(resource.preference());
+            }
+            write_name(resource.data(), compression_);
+        }
+        else if (!resource.data().empty()) {
+            write(resource.data().data(), static_cast<uint32_t>(resource.data().size()));
+        }
+        const uint16_t data_size = Endian::host_to_be<uint16_t>(
+            size_ - data_size_index - sizeof(uint16_t)
+        );
+        memcpy(buffer_ + data_size_index, &data_size, sizeof(data_size));
+    }
+    catch (...) {
+        size_ = previous_size;
+        name_offsets_count_ = previous_offsets_count;
+        throw;
+    }
+    end_record(section);
+}
+
+void DNSBuilder::begin_section(DNS::SectionType section) {
+    if (section < section_) {
+        throw dns_section_out_of_order();
+    }
+    section_ = section;
+}
+
+void DNSBuilder::end_record(DNS::SectionType section) {
+    const uint16_t count = Endian::host_to_be<uint16_t>(++counts_[section]);
+    memcpy(buffer_ + COUNTS_INDEX + section * sizeof(uint16_t), &count, sizeof(count));
+}
+
+uint8_t* DNSBuilder::reserve(uint32_t size) {
+    if (TINS_UNLIKELY(buffer_size_ - size_ < size)) {
+        throw serialization_error();
+    }
+    uint8_t* output = buffer_ + size_;
+    size_ += size;
+    return output;
+}
+
+void DNSBuilder::write(const void* data, uint32_t size) {
+    memcpy(reserve(size), data, size);
+}
+
+void DNSBuilder::write_be16(uint16_t value) {
+    value = Endian::host_to_be(value);
+    write(&value, sizeof(value));
+}
+
+void DNSBuilder::write_be32(uint32_t value) {
+    value = Endian::host_to_be(value);
+    write(&value, sizeof(value));
+}
+
+void DNSBuilder::write_name(const string& name, bool compress) {
+    label labels[MAX_LABELS];
+    uint32_t count = 0;
+    uint32_t encoded_size = 1;
+    size_t last_index = 0;
+    // A trailing dot is ignored
+    const size_t name_size = (!name.empty() && name[name.size() - 1] == '.') ?
+                             name.size() - 1 : name.size();
+    while (last_index < name_size) {
+        size_t index = name.find('.', last_index);
+        if (index == string::npos || index > name_size) {
+            index = name_size;
+        }
+        const size_t size = index - last_index;
+        if (size == 0 || size > MAX_LABEL_SIZE || count == MAX_LABELS) {
+            throw invalid_domain_name();
+        }
+        encoded_size += static_cast<uint32_t>(size) + 1;
+        if (encoded_size > MAX_NAME_SIZE) {
+            throw invalid_domain_name();
+        }
+        labels[count].data = name.data() + last_index;
+        labels[count].size = static_cast<uint8_t>(size);
+        ++count;
+        last_index = index + 1;
+    }
+    uint32_t pointer = 0;
+    const uint32_t compressed_index = compress ? find_suffix(labels, count, pointer) : count;
+    for (uint32_t i = 0; i < compressed_index; ++i) {
+        if (compress && size_ <= MAX_POINTER_OFFSET &&
+            name_offsets_count_ < MAX_COMPRESSION_ENTRIES) {
+            name_offsets_[name_offsets_count_++] = static_cast<uint16_t>(size_);
+        }
+        write(&labels[i].size, sizeof(uint8_t));
+        write(labels[i].data, labels[i].size);
+    }
+    if (compressed_index < count) {
+        write_be16(static_cast<uint16_t>(0xc000 | pointer));
+    }
+    else {
+        const uint8_t terminator = 0;
+        write(&terminator, sizeof(terminator));
+    }
+}
+
+bool DNSBuilder::suffix_matches(uint32_t offset, const label* labels, uint32_t count) const {
+    for (uint32_t i = 0; i <= count; ++i) {
+        // Names in the buffer were written by this object, so pointers
+        // always point backwards and can't loop
+        while ((buffer_[offset] & 0xc0) == 0xc0) {
+            offset = ((buffer_[offset] & 0x3f) << 8) | buffer_[offset + 1];
+        }
+        const uint8_t size = buffer_[offset];
+        if (i == count) {
+            return size == 0;
+        }
+        if (size != labels[i].size) {
+            return false;
+        }
+        const uint8_t* data = buffer_ + offset + 1;
+        for (uint8_t j = 0; j < size; ++j) {
+            if (to_lower(static_cast<char>(data[j])) != to_lower(labels[i].data[j])) {
+                return false;
+            }
+        }
+        offset += size + 1;
+    }
+    return false;
+}
+
+uint32_t DNSBuilder::find_suffix(const label* labels, uint32_t count, uint32_t& pointer) const {
+    // The first match is the longest one
+    for (uint32_t i = 0; i < count; ++i) {
+        for (uint32_t j = 0; j < name_offsets_count_; ++j) {
+            if (suffix_matches(name_offsets_[j], labels + i, count - i)) {
+                pointer = name_offsets_[j];
+                return i;
+            }
+        }
+    }
+    return count;
+}
+
+} // Tins
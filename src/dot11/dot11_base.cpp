@@ -57,6 +57,11 @@ using Tins::Memory::OutputMemoryStream;
 namespace Tins {
 
 const Dot11::address_type Dot11::BROADCAST = "ff:ff:ff:ff:ff:ff";
+#ifdef TINS_HAVE_CXX11
+    std::atomic<bool> Dot11::lazy_tagged_parameters_(false);
+#else
+    bool Dot11::lazy_tagged_parameters_ = false;
+#endif // TINS_HAVE_CXX11
 
 Dot11::Dot11(const address_type& dst_hw_addr) 
 : header_(), options_size_(0) {
@@ -79,8 +84,24 @@ void Dot11::write_ext_header(Memory::OutputMemoryStream& /*stream*/) {
 void Dot11::write_fixed_parameters(Memory::OutputMemoryStream& /*stream*/) {
 }
 
+void Dot11::lazy_tagged_parameters(bool value) {
+    #ifdef TINS_HAVE_CXX11
+        lazy_tagged_parameters_.store(value, std::memory_order_relaxed);
+    #else
+        lazy_tagged_parameters_ = value;
+    #endif // TINS_HAVE_CXX11
+}
+
+bool Dot11::lazy_tagged_parameters() {
+    #ifdef TINS_HAVE_CXX11
+        return lazy_tagged_parameters_.load(std::memory_order_relaxed);
+    #else
+        return lazy_tagged_parameters_;
+    #endif // TINS_HAVE_CXX11
+}
+
 void Dot11::parse_tagged_parameters(InputMemoryStream& stream) {
-    if (stream) {
+    if (!lazy_tagged_parameters()) {
         while (stream.size() >= 2) {
             OptionTypes opcode = static_cast<OptionTypes>(stream.read<uint8_t>());
             uint8_t length = stream.read<uint8_t>();
@@ -91,9 +112,27 @@ void Dot11::parse_tagged_parameters(InputMemoryStream& stream) {
             stream.skip(length);
         }
     }
+    else if (stream) {
+        // Tags are only validated and indexed here. Option objects are created
+        // once they're looked up
+        const uint8_t* start = stream.pointer();
+        tag_offsets_.reserve(stream.size() / 8 + 1);
+        while (stream.size() >= 2) {
+            tag_offsets_.push_back(static_cast<uint32_t>(stream.pointer() - start));
+            stream.skip(sizeof(uint8_t));
+            uint8_t length = stream.read<uint8_t>();
+            if (!stream.can_read(length)) {
+                throw malformed_packet();
+            }
+            stream.skip(length);
+        }
+        tagged_parameters_.assign(start, stream.pointer());
+        options_size_ += static_cast<uint32_t>(tagged_parameters_.size());
+    }
 }
 
 void Dot11::add_tagged_option(OptionTypes opt, uint8_t len, const uint8_t* val) {
+    materialize_options();
     uint32_t opt_size = len + sizeof(uint8_t) * 2;
     options_.push_back(option((uint8_t)opt, val, val + len));
     options_size_ += opt_size;
@@ -104,6 +143,7 @@ void Dot11::internal_add_option(const option& opt) {
 }
 
 bool Dot11::remove_option(OptionTypes type) {
+    materialize_options();
     options_type::iterator iter = search_option_iterator(type);
     if (iter == options_.end()) {
         return false;
@@ -114,11 +154,13 @@ bool Dot11::remove_option(OptionTypes type) {
 }
 
 void Dot11::add_option(const option& opt) {
+    materialize_options();
     internal_add_option(opt);
     options_.push_back(opt);
 }
 
 const Dot11::option* Dot11::search_option(OptionTypes type) const {
+    materialize_options();
     // Search for the iterator. If we found something, return it, otherwise return nullptr.
     options_type::const_iterator iter = search_option_iterator(type);
     return (iter != options_.end()) ? &*iter : 0;
@@ -132,6 +174,34 @@ Dot11::options_type::iterator Dot11::search_option_iterator(OptionTypes type) {
     return Internals::find_option<option>(options_, type);
 }
 
+const Dot11::option* Dot11::lookup_option(OptionTypes type, option& storage) const {
+    if (tagged_parameters_.empty()) {
+        return search_option(type);
+    }
+    // Only create the option being looked up
+    for (size_t i = 0; i < tag_offsets_.size(); ++i) {
+        const uint8_t* tag = &tagged_parameters_[tag_offsets_[i]];
+        if (tag[0] == type) {
+            storage = option(tag[0], tag + 2, tag + 2 + tag[1]);
+            return &storage;
+        }
+    }
+    return 0;
+}
+
+void Dot11::materialize_options() const {
+    if (tagged_parameters_.empty()) {
+        return;
+    }
+    options_.reserve(options_.size() + tag_offsets_.size());
+    for (size_t i = 0; i < tag_offsets_.size(); ++i) {
+        const uint8_t* tag = &tagged_parameters_[tag_offsets_[i]];
+        options_.push_back(option(tag[0], tag + 2, tag + 2 + tag[1]));
+    }
+    vector<uint8_t>().swap(tagged_parameters_);
+    vector<uint32_t>().swap(tag_offsets_);
+}
+
 void Dot11::protocol(small_uint<2> new_proto) {
     header_.control.protocol = new_proto;
 }
@@ -216,6 +286,9 @@ void Dot11::write_serialization(uint8_t* buffer, uint32_t total_sz) {
     stream.write(header_);
     write_ext_header(stream);
     write_fixed_parameters(stream);
+    if (!tagged_parameters_.empty()) {
+        stream.write(&tagged_parameters_[0], tagged_parameters_.size());
+    }
     for (vector<option>::const_iterator it = options_.begin(); it != options_.end(); ++it) {
         stream.write<uint8_t>(it->option());
         stream.write<uint8_t>(it->length_field());
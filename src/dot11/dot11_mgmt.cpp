@@ -379,7 +379,8 @@ RSNInformation Dot11ManagementFrame::rsn_information() const {
 }
 
 string Dot11ManagementFrame::ssid() const {
-    const Dot11::option* option = search_option(SSID);
+    Dot11::option storage;
+    const Dot11::option* option = lookup_option(SSID, storage);
     if (!option) {
         throw option_not_found();
     }
@@ -475,7 +476,8 @@ string Dot11ManagementFrame::challenge_text() const {
 }
 
 Dot11ManagementFrame::vendor_specific_type Dot11ManagementFrame::vendor_specific() const {
-    const Dot11::option* option = search_option(VENDOR_SPECIFIC);
+    Dot11::option storage;
+    const Dot11::option* option = lookup_option(VENDOR_SPECIFIC, storage);
     if (!option || option->data_size() < 3) {
         throw option_not_found();
     }
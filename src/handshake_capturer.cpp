@@ -32,16 +32,117 @@
 #ifdef TINS_HAVE_DOT11
 
 #include <algorithm>
+#include <limits>
 #include <tins/dot11/dot11_data.h>
+#include <tins/packet.h>
 
 using std::max_element;
 using std::max;
 using std::min;
 using std::pair;
+using std::make_pair;
+using std::numeric_limits;
 
 namespace Tins {
 
+// 60 seconds, in microseconds
+const uint64_t RSNHandshakeCapturer::DEFAULT_KEEP_ALIVE = 60000000;
+const size_t RSNHandshakeCapturer::MAX_EXPIRATIONS_PER_PACKET = 4;
+const size_t RSNHandshakeCapturer::DEFAULT_MAX_PARTIAL_HANDSHAKES = 4096;
+
+size_t RSNHandshakeCapturer::addr_pair_hash::operator()(const addr_pair& addresses) const {
+    // Each address fits in 48 bits, so just pack and mix them
+    uint64_t first = 0;
+    uint64_t second = 0;
+    for (size_t i = 0; i < address_type::address_size; ++i) {
+        first = (first << 8) | addresses.first[i];
+        second = (second << 8) | addresses.second[i];
+    }
+    const uint64_t output = (first * 0x9e3779b97f4a7c15ULL) ^ (second + (first >> 17));
+    return static_cast<size_t>(output ^ (output >> 29));
+}
+
+RSNHandshakeCapturer::RSNHandshakeCapturer()
+: oldest_(0), newest_(0), latest_timestamp_(0), keep_alive_(DEFAULT_KEEP_ALIVE),
+  max_partial_handshakes_(DEFAULT_MAX_PARTIAL_HANDSHAKES) {
+
+}
+
+RSNHandshakeCapturer::RSNHandshakeCapturer(const RSNHandshakeCapturer& other)
+: oldest_(0), newest_(0) {
+    *this = other;
+}
+
+RSNHandshakeCapturer& RSNHandshakeCapturer::operator=(const RSNHandshakeCapturer& other) {
+    if (this == &other) {
+        return *this;
+    }
+    handshakes_ = other.handshakes_;
+    completed_handshakes_ = other.completed_handshakes_;
+    latest_timestamp_ = other.latest_timestamp_;
+    keep_alive_ = other.keep_alive_;
+    max_partial_handshakes_ = other.max_partial_handshakes_;
+    #ifdef TINS_HAVE_CXX11
+        on_handshake_ = other.on_handshake_;
+    #endif // TINS_HAVE_CXX11
+    // The copied entries still point to the other object's ones, so rebuild 
+    // the list following the same order
+    oldest_ = 0;
+    newest_ = 0;
+    for (const partial_handshake* entry = other.oldest_; entry; entry = entry->next) {
+        handshake_map::iterator iter = handshakes_.find(*entry->key);
+        iter->second.key = &iter->first;
+        link_back(&iter->second);
+    }
+    return *this;
+}
+
 bool RSNHandshakeCapturer::process_packet(const PDU& pdu) {
+    return do_process(pdu);
+}
+
+#if TINS_IS_CXX11
+
+bool RSNHandshakeCapturer::process_packet(const PDU& pdu, const timestamp_type& ts) {
+    const uint64_t now = ts.count();
+    // Expire a few of the least recently seen handshakes before doing anything else
+    expire_handshakes(now, MAX_EXPIRATIONS_PER_PACKET);
+    latest_timestamp_ = max(latest_timestamp_, now);
+    return do_process(pdu);
+}
+
+bool RSNHandshakeCapturer::process_packet(const Packet& packet) {
+    if (!packet.pdu()) {
+        return false;
+    }
+    const timestamp_type ts = packet.timestamp();
+    return process_packet(*packet.pdu(), ts);
+}
+
+void RSNHandshakeCapturer::cleanup_handshakes(const timestamp_type& now) {
+    expire_handshakes(now.count(), numeric_limits<size_t>::max());
+}
+
+#endif // TINS_IS_CXX11
+
+#ifdef TINS_HAVE_CXX11
+
+void RSNHandshakeCapturer::handshake_callback(const handshake_callback_type& callback) {
+    on_handshake_ = callback;
+}
+
+#endif // TINS_HAVE_CXX11
+
+void RSNHandshakeCapturer::max_partial_handshakes(size_t value) {
+    max_partial_handshakes_ = value;
+    if (max_partial_handshakes_ != 0) {
+        while (handshakes_.size() > max_partial_handshakes_) {
+            erase(oldest_);
+        }
+    }
+}
+
+bool RSNHandshakeCapturer::do_process(const PDU& pdu) {
     const RSNEAPOL* eapol = pdu.find_pdu<RSNEAPOL>();
     const Dot11Data* dot11 = pdu.find_pdu<Dot11Data>();
     if (!eapol || !dot11) {
@@ -49,13 +150,15 @@ bool RSNHandshakeCapturer::process_packet(const PDU& pdu) {
     }
     
     // Use this to identify each flow, regardless of the direction
-    pair<address_type, address_type> addresses;
+    addr_pair addresses;
     addresses.first  = min(dot11->src_addr(), dot11->dst_addr());
     addresses.second = max(dot11->src_addr(), dot11->dst_addr());
         
     // 1st packet
     if (eapol->key_t() && eapol->key_ack() && !eapol->key_mic() && !eapol->install()) {
-        handshakes_[addresses].assign(eapol, eapol + 1);
+        partial_handshake& entry = find_or_create(addresses);
+        entry.packets.assign(eapol, eapol + 1);
+        entry.last_seen = latest_timestamp_;
     }
     // 2nd and 4th packets
     else if (eapol->key_t() && !eapol->key_ack() && eapol->key_mic() && !eapol->install()) {
@@ -65,14 +168,7 @@ bool RSNHandshakeCapturer::process_packet(const PDU& pdu) {
         }
         // Otherwise, this should be the 4th and last packet
         else if (do_insert(addresses, eapol, 3)) {
-            completed_handshakes_.push_back(
-                handshake_type(
-                    addresses.first,
-                    addresses.second,
-                    handshakes_[addresses]
-                )
-            );
-            handshakes_.erase(addresses);
+            complete_handshake(addresses);
             return true;
         }
     }
@@ -83,25 +179,105 @@ bool RSNHandshakeCapturer::process_packet(const PDU& pdu) {
     return false;
 }
 
-bool RSNHandshakeCapturer::do_insert(const handshake_map::key_type& key,
+RSNHandshakeCapturer::partial_handshake&
+RSNHandshakeCapturer::find_or_create(const addr_pair& key) {
+    handshake_map::iterator iter = handshakes_.find(key);
+    if (iter == handshakes_.end()) {
+        if (max_partial_handshakes_ != 0 && handshakes_.size() >= max_partial_handshakes_) {
+            erase(oldest_);
+        }
+        iter = handshakes_.insert(make_pair(key, partial_handshake())).first;
+        iter->second.key = &iter->first;
+    }
+    else {
+        unlink(&iter->second);
+    }
+    // Either way, this is now the most recently seen one
+    link_back(&iter->second);
+    return iter->second;
+}
+
+bool RSNHandshakeCapturer::do_insert(const addr_pair& key,
                                      const RSNEAPOL* eapol,
                                      size_t expected) {
     handshake_map::iterator iter = handshakes_.find(key);
     if (iter != handshakes_.end()) {
-        if (iter->second.size() != expected) {
+        eapol_list& packets = iter->second.packets;
+        if (packets.size() != expected) {
             // skip repeated
-            if (iter->second.size() != expected + 1) {
-                iter->second.clear();
+            if (packets.size() != expected + 1) {
+                packets.clear();
             }
         }
         else {
-            iter->second.push_back(*eapol);
+            packets.push_back(*eapol);
+            partial_handshake* entry = &iter->second;
+            entry->last_seen = latest_timestamp_;
+            unlink(entry);
+            link_back(entry);
             return true;
         }
     }
     return false;
 }
 
+void RSNHandshakeCapturer::complete_handshake(const addr_pair& key) {
+    handshake_map::iterator iter = handshakes_.find(key);
+    handshake_type handshake(key.first, key.second, iter->second.packets);
+    erase(&iter->second);
+    #ifdef TINS_HAVE_CXX11
+        if (on_handshake_) {
+            on_handshake_(handshake);
+            return;
+        }
+    #endif // TINS_HAVE_CXX11
+    completed_handshakes_.push_back(handshake);
+}
+
+void RSNHandshakeCapturer::expire_handshakes(uint64_t now, size_t max_expirations) {
+    size_t expired = 0;
+    while (oldest_ && expired < max_expirations && oldest_->last_seen + keep_alive_ <= now) {
+        erase(oldest_);
+        ++expired;
+    }
+}
+
+void RSNHandshakeCapturer::erase(partial_handshake* entry) {
+    unlink(entry);
+    // Copy the key, as it lives inside the entry being erased
+    const addr_pair key = *entry->key;
+    handshakes_.erase(key);
+}
+
+void RSNHandshakeCapturer::link_back(partial_handshake* entry) {
+    entry->previous = newest_;
+    entry->next = 0;
+    if (newest_) {
+        newest_->next = entry;
+    }
+    else {
+        oldest_ = entry;
+    }
+    newest_ = entry;
+}
+
+void RSNHandshakeCapturer::unlink(partial_handshake* entry) {
+    if (entry->previous) {
+        entry->previous->next = entry->next;
+    }
+    else {
+        oldest_ = entry->next;
+    }
+    if (entry->next) {
+        entry->next->previous = entry->previous;
+    }
+    else {
+        newest_ = entry->previous;
+    }
+    entry->previous = 0;
+    entry->next = 0;
+}
+
 } // namespace Tins;
 
 #endif // TINS_HAVE_DOT11
@@ -37,27 +37,15 @@ using std::make_pair;
 namespace Tins {
 namespace Internals {
 
-IPv4Stream::IPv4Stream() 
-: received_size_(), total_size_(), received_end_(false) {
+IPv4Stream::IPv4Stream() {
 
 }
 
-void IPv4Stream::add_fragment(IP* ip) {
+bool IPv4Stream::add_fragment(IP* ip) {
     const uint16_t offset = extract_offset(ip);
-    fragments_type::iterator it = fragments_.begin();
-    while (it != fragments_.end() && offset > it->offset()) {
-        ++it;
-    }
-    // No duplicates plx
-    if (it != fragments_.end() && it->offset() == offset) {
-        return;
-    }
-    fragments_.insert(it, IPv4Fragment(ip->inner_pdu(), offset));
-    received_size_ += ip->inner_pdu()->size();
-    // If the MF flag is off
-    if ((ip->flags() & IP::MORE_FRAGMENTS) == 0) {
-        total_size_ = offset + ip->inner_pdu()->size();
-        received_end_ = true;
+    const bool last_fragment = (ip->flags() & IP::MORE_FRAGMENTS) == 0;
+    if (!buffer_.add_fragment(offset, *ip->inner_pdu(), last_fragment)) {
+        return false;
     }
     if (offset == 0) {
         // Release the inner PDU, store this first fragment and restore the inner PDU
@@ -65,30 +53,19 @@ void IPv4Stream::add_fragment(IP* ip) {
         first_fragment_ = *ip;
         ip->inner_pdu(inner_pdu);
     }
+    return true;
+}
+
+bool IPv4Stream::empty() const {
+    return buffer_.empty();
 }
 
 bool IPv4Stream::is_complete() const {
-    // If we haven't received the last chunk of we haven't received all the data,
-    // then we're not complete
-    if (!received_end_ || received_size_ != total_size_) {
-        return false;
-    }
-    // Make sure the first fragment has offset 0
-    return fragments_.begin()->offset() == 0;
+    return buffer_.is_complete();
 }
 
 PDU* IPv4Stream::allocate_pdu() const {
-    PDU::serialization_type buffer;
-    buffer.reserve(total_size_);
-    // Check if we actually have all the data we need. Otherwise return nullptr;
-    size_t expected = 0;
-    for (fragments_type::const_iterator it = fragments_.begin(); it != fragments_.end(); ++it) {
-        if (expected != it->offset()) {
-            return 0;
-        }
-        expected = it->offset() + it->payload().size();
-        buffer.insert(buffer.end(), it->payload().begin(), it->payload().end());
-    }
+    const PDU::serialization_type& buffer = buffer_.payload();
     return Internals::pdu_from_flag(
         static_cast<Constants::IP::e>(first_fragment_.protocol()),
         buffer.empty() ? 0 :& buffer[0],
@@ -100,38 +77,60 @@ const IP& IPv4Stream::first_fragment() const {
     return first_fragment_;
 }
 
+size_t IPv4Stream::memory_usage() const {
+    return sizeof(IPv4Stream) + buffer_.memory_usage();
+}
+
 uint16_t IPv4Stream::extract_offset(const IP* ip) {
     return ip->fragment_offset() * 8;
 }
 
 } // Internals
 
+const uint32_t IPv4Reassembler::DEFAULT_FRAGMENT_TIMEOUT = 30;
+const size_t IPv4Reassembler::DEFAULT_MAX_BUFFERED_BYTES = 4 * 1024 * 1024;
+
 IPv4Reassembler::IPv4Reassembler()
-: technique_(NONE) {
+: streams_(DEFAULT_FRAGMENT_TIMEOUT * 1000000ULL, 0, DEFAULT_MAX_BUFFERED_BYTES),
+  technique_(NONE) {
 
 }
 
 IPv4Reassembler::IPv4Reassembler(OverlappingTechnique technique)
-: technique_(technique) {
+: streams_(DEFAULT_FRAGMENT_TIMEOUT * 1000000ULL, 0, DEFAULT_MAX_BUFFERED_BYTES),
+  technique_(technique) {
 
 }
 
 IPv4Reassembler::PacketStatus IPv4Reassembler::process(PDU& pdu) {
+    return process(pdu, Timestamp::current_time());
+}
+
+IPv4Reassembler::PacketStatus IPv4Reassembler::process(PDU& pdu, 
+                                                       const Timestamp& timestamp) {
     IP* ip = pdu.find_pdu<IP>();
     if (ip && ip->inner_pdu()) {
         // There's fragmentation
         if (ip->is_fragmented()) {
-            key_type key = make_key(ip);
+            const uint64_t now = Internals::timestamp_to_microseconds(timestamp);
+            streams_.expire(now);
             // Create it or look it up, it's the same
-            Internals::IPv4Stream& stream = streams_[key];
-            stream.add_fragment(ip);
+            streams_type::iterator iter = streams_.find_or_insert(make_key(ip), now);
+            Internals::IPv4Stream& stream = iter->second.datagram;
+            // The fragment is corrupt, so only this fragment is dropped
+            if (!stream.add_fragment(ip)) {
+                if (stream.empty()) {
+                    streams_.erase(iter);
+                }
+                return FRAGMENTED;
+            }
             if (stream.is_complete()) {
                 PDU* pdu = stream.allocate_pdu();
                 // Use all field values from the first fragment
                 *ip = stream.first_fragment();
 
                 // Erase this stream, since it's already assembled
-                streams_.erase(key);
+                streams_.erase(iter);
                 // The packet is corrupt
                 if (!pdu) {
                     return FRAGMENTED;
@@ -141,9 +140,9 @@ IPv4Reassembler::PacketStatus IPv4Reassembler::process(PDU& pdu) {
                 ip->flags(static_cast<IP::Flags>(0));
                 return REASSEMBLED;
             }
-            else {
-                return FRAGMENTED;
-            }
+            // This may evict this same stream if it's too large
+            streams_.update_memory_usage(iter);
+            return FRAGMENTED;
         }
     }
     return NOT_FRAGMENTED;
@@ -178,4 +177,44 @@ void IPv4Reassembler::remove_stream(uint16_t id, IPv4Address addr1, IPv4Address
     );
 }
 
+void IPv4Reassembler::fragment_timeout(uint32_t seconds) {
+    streams_.timeout(seconds * 1000000ULL);
+}
+
+uint32_t IPv4Reassembler::fragment_timeout() const {
+    return static_cast<uint32_t>(streams_.timeout() / 1000000);
+}
+
+void IPv4Reassembler::max_datagrams(size_t value) {
+    streams_.max_datagrams(value);
+}
+
+size_t IPv4Reassembler::max_datagrams() const {
+    return streams_.max_datagrams();
+}
+
+void IPv4Reassembler::max_buffered_bytes(size_t value) {
+    streams_.max_memory(value);
+}
+
+size_t IPv4Reassembler::max_buffered_bytes() const {
+    return streams_.max_memory();
+}
+
+size_t IPv4Reassembler::datagram_count() const {
+    return streams_.size();
+}
+
+size_t IPv4Reassembler::buffered_bytes() const {
+    return streams_.memory_usage();
+}
+
+uint64_t IPv4Reassembler::expired_datagrams() const {
+    return streams_.expired_datagrams();
+}
+
+uint64_t IPv4Reassembler::evicted_datagrams() const {
+    return streams_.evicted_datagrams();
+}
+
 } // Tins
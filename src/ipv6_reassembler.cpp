@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/ipv6_reassembler.h>
+#include <tins/ipv6.h>
+#include <tins/rawpdu.h>
+#include <tins/constants.h>
+#include <tins/exceptions.h>
+#include <tins/pdu_allocator.h>
+#include <tins/detail/pdu_helpers.h>
+
+using std::make_pair;
+
+namespace Tins {
+namespace Internals {
+
+IPv6Stream::IPv6Stream() 
+: next_header_(0) {
+
+}
+
+bool IPv6Stream::add_fragment(IPv6* ipv6, const IPv6::fragment_header& header) {
+    const uint32_t offset = static_cast<uint32_t>(header.fragment_offset) * 8;
+    if (!buffer_.add_fragment(offset, *ipv6->inner_pdu(), !header.more_fragments)) {
+        return false;
+    }
+    if (offset == 0) {
+        // Keep everything but the payload and the fragment header, which is
+        // the last extension header
+        PDU* inner_pdu = ipv6->release_inner_pdu();
+        first_fragment_ = *ipv6;
+        ipv6->inner_pdu(inner_pdu);
+        first_fragment_.ext_headers_.pop_back();
+        next_header_ = ipv6->next_header_;
+        // If the fragment header was the only one, the payload follows the
+        // fixed header directly
+        if (first_fragment_.ext_headers_.empty()) {
+            first_fragment_.header_.next_header = next_header_;
+        }
+    }
+    return true;
+}
+
+bool IPv6Stream::is_complete() const {
+    return buffer_.is_complete();
+}
+
+PDU* IPv6Stream::allocate_pdu() const {
+    const PDU::serialization_type& buffer = buffer_.payload();
+    const uint8_t* data = buffer.empty() ? 0 : &buffer[0];
+    const uint32_t size = static_cast<uint32_t>(buffer.size());
+    // Same as what IPv6 does when parsing its payload
+    PDU* pdu = Internals::pdu_from_flag(
+        static_cast<Constants::IP::e>(next_header_),
+        data,
+        size,
+        false
+    );
+    if (!pdu) {
+        pdu = Internals::allocate<IPv6>(next_header_, data, size);
+    }
+    if (!pdu) {
+        pdu = new RawPDU(data, size);
+    }
+    return pdu;
+}
+
+const IPv6& IPv6Stream::first_fragment() const {
+    return first_fragment_;
+}
+
+size_t IPv6Stream::memory_usage() const {
+    return sizeof(IPv6Stream) + buffer_.memory_usage();
+}
+
+} // Internals
+
+const uint32_t IPv6Reassembler::DEFAULT_FRAGMENT_TIMEOUT = 30;
+const size_t IPv6Reassembler::DEFAULT_MAX_BUFFERED_BYTES = 4 * 1024 * 1024;
+
+IPv6Reassembler::IPv6Reassembler()
+: streams_(DEFAULT_FRAGMENT_TIMEOUT * 1000000ULL, 0, DEFAULT_MAX_BUFFERED_BYTES) {
+
+}
+
+IPv6Reassembler::PacketStatus IPv6Reassembler::process(PDU& pdu) {
+    return process(pdu, Timestamp::current_time());
+}
+
+IPv6Reassembler::PacketStatus IPv6Reassembler::process(PDU& pdu, 
+                                                       const Timestamp& timestamp) {
+    IPv6* ipv6 = pdu.find_pdu<IPv6>();
+    if (!ipv6 || !ipv6->inner_pdu()) {
+        return NOT_FRAGMENTED;
+    }
+    const IPv6::ext_header* fragment = ipv6->search_header(IPv6::FRAGMENT);
+    if (!fragment) {
+        return NOT_FRAGMENTED;
+    }
+    IPv6::fragment_header header;
+    try {
+        header = IPv6::fragment_header::from_extension_header(*fragment);
+    }
+    catch (const malformed_packet&) {
+        return FRAGMENTED;
+    }
+    // Atomic fragments (RFC 6946) are processed as they are
+    if (header.fragment_offset == 0 && !header.more_fragments) {
+        return NOT_FRAGMENTED;
+    }
+    // The payload is only known to start right after the fragment header if
+    // it's the last extension header
+    if (fragment != &ipv6->headers().back()) {
+        return FRAGMENTED;
+    }
+    const uint64_t now = Internals::timestamp_to_microseconds(timestamp);
+    streams_.expire(now);
+    const key_type key = make_pair(
+        header.identification,
+        make_pair(ipv6->src_addr(), ipv6->dst_addr())
+    );
+    streams_type::iterator iter = streams_.find_or_insert(key, now);
+    Internals::IPv6Stream& stream = iter->second.datagram;
+    // The packet is corrupt
+    if (!stream.add_fragment(ipv6, header)) {
+        streams_.erase(iter);
+        return FRAGMENTED;
+    }
+    if (stream.is_complete()) {
+        PDU* inner_pdu = stream.allocate_pdu();
+        // Use all field values from the first fragment
+        *ipv6 = stream.first_fragment();
+        streams_.erase(iter);
+        ipv6->inner_pdu(inner_pdu);
+        ipv6->payload_length(static_cast<uint16_t>(ipv6->size() - 40));
+        return REASSEMBLED;
+    }
+    // This may evict this same stream if it's too large
+    streams_.update_memory_usage(iter);
+    return FRAGMENTED;
+}
+
+void IPv6Reassembler::clear_streams() {
+    streams_.clear();
+}
+
+void IPv6Reassembler::remove_stream(uint32_t id, const IPv6Address& src_addr,
+                                    const IPv6Address& dst_addr) {
+    streams_.erase(make_pair(id, make_pair(src_addr, dst_addr)));
+}
+
+void IPv6Reassembler::fragment_timeout(uint32_t seconds) {
+    streams_.timeout(seconds * 1000000ULL);
+}
+
+uint32_t IPv6Reassembler::fragment_timeout() const {
+    return static_cast<uint32_t>(streams_.timeout() / 1000000);
+}
+
+void IPv6Reassembler::max_datagrams(size_t value) {
+    streams_.max_datagrams(value);
+}
+
+size_t IPv6Reassembler::max_datagrams() const {
+    return streams_.max_datagrams();
+}
+
+void IPv6Reassembler::max_buffered_bytes(size_t value) {
+    streams_.max_memory(value);
+}
+
+size_t IPv6Reassembler::max_buffered_bytes() const {
+    return streams_.max_memory();
+}
+
+size_t IPv6Reassembler::datagram_count() const {
+    return streams_.size();
+}
+
+size_t IPv6Reassembler::buffered_bytes() const {
+    return streams_.memory_usage();
+}
+
+uint64_t IPv6Reassembler::expired_datagrams() const {
+    return streams_.expired_datagrams();
+}
+
+uint64_t IPv6Reassembler::evicted_datagrams() const {
+    return streams_.evicted_datagrams();
+}
+
+} // Tins
@@ -30,6 +30,7 @@
 #include <string.h>
 #include <tins/offline_packet_filter.h>
 #include <tins/pdu.h>
+#include <tins/packet.h>
 #include <tins/exceptions.h>
 
 using std::string;
@@ -85,4 +86,12 @@ bool OfflinePacketFilter::matches_filter(PDU& pdu) const {
     return matches_filter(&buffer[0], static_cast<uint32_t>(buffer.size()));
 }
 
+bool OfflinePacketFilter::matches_filter(Packet& packet) const {
+    if (packet.has_raw_frame()) {
+        const Packet::raw_frame_type& frame = packet.raw_frame();
+        return matches_filter(&frame[0], static_cast<uint32_t>(frame.size()));
+    }
+    return matches_filter(*packet.pdu());
+}
+
 } // Tins
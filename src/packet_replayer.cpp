@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/packet_replayer.h>
+
+#if TINS_IS_CXX11
+
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#ifndef _WIN32
+    #if defined(BSD) || defined(__FreeBSD_kernel__)
+        #include <net/if_dl.h>
+    #else
+        #include <netpacket/packet.h>
+    #endif
+    #include <sys/socket.h>
+    #include <net/ethernet.h>
+#endif
+#include <tins/packet_sender.h>
+#include <tins/pdu.h>
+#include <tins/endianness.h>
+#include <tins/exceptions.h>
+
+using std::min;
+using std::max;
+using std::chrono::duration;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+
+namespace Tins {
+
+const PacketReplayer::duration_type PacketReplayer::DEFAULT_SPIN_THRESHOLD =
+    std::chrono::microseconds(200);
+
+// Statistics
+
+double PacketReplayer::Statistics::packets_per_second() const {
+    double seconds = duration_cast<duration<double> >(elapsed).count();
+    return seconds > 0 ? packets_sent / seconds : 0;
+}
+
+double PacketReplayer::Statistics::bits_per_second() const {
+    double seconds = duration_cast<duration<double> >(elapsed).count();
+    return seconds > 0 ? bytes_sent * 8 / seconds : 0;
+}
+
+PacketReplayer::duration_type PacketReplayer::Statistics::mean_jitter() const {
+    const duration_type::rep count = packets_sent + send_errors;
+    return count > 0 ? total_jitter / count : duration_type(0);
+}
+
+// PacketReplayer
+
+PacketReplayer::PacketReplayer(PacketSender& sender, const NetworkInterface& iface)
+: sender_(&sender), iface_(iface), mode_(ORIGINAL_TIMING), multiplier_(1.0),
+rate_(0), bucket_depth_(0), tokens_(0), spin_threshold_(DEFAULT_SPIN_THRESHOLD),
+started_(false), first_timestamp_(0) {
+
+}
+
+void PacketReplayer::pace_original(double multiplier) {
+    if (!(multiplier > 0)) {
+        throw std::invalid_argument("Speed multiplier must be positive");
+    }
+    mode_ = ORIGINAL_TIMING;
+    multiplier_ = multiplier;
+}
+
+void PacketReplayer::pace_packets_per_second(double rate, uint32_t burst_size) {
+    if (!(rate > 0)) {
+        throw std::invalid_argument("Packet rate must be positive");
+    }
+    mode_ = PACKETS_PER_SECOND;
+    rate_ = rate;
+    bucket_depth_ = max<uint32_t>(burst_size, 1);
+    tokens_ = bucket_depth_;
+}
+
+void PacketReplayer::pace_bits_per_second(double rate, uint32_t burst_size) {
+    if (!(rate > 0)) {
+        throw std::invalid_argument("Bit rate must be positive");
+    }
+    mode_ = BITS_PER_SECOND;
+    rate_ = rate;
+    bucket_depth_ = static_cast<double>(burst_size) * 8;
+    tokens_ = bucket_depth_;
+}
+
+void PacketReplayer::pace_top_speed() {
+    mode_ = TOP_SPEED;
+}
+
+void PacketReplayer::spin_threshold(duration_type value) {
+    spin_threshold_ = max(value, duration_type(0));
+}
+
+void PacketReplayer::send(PDU& pdu, const Timestamp& timestamp) {
+    const uint32_t size = pdu.size();
+    const time_point scheduled = schedule(size, timestamp);
+    const time_point handoff = wait_until(scheduled);
+    try {
+        if (iface_) {
+            sender_->send(pdu, iface_);
+        }
+        else {
+            sender_->send(pdu);
+        }
+    }
+    catch (socket_write_error&) {
+        sent(scheduled, handoff, size, false);
+        return;
+    }
+    sent(scheduled, handoff, size, true);
+}
+
+void PacketReplayer::send(Packet& packet) {
+    if (!packet.pdu()) {
+        throw invalid_packet();
+    }
+    send(*packet.pdu(), packet.timestamp());
+}
+
+void PacketReplayer::send(const uint8_t* buffer, uint32_t total_sz,
+                          const Timestamp& timestamp) {
+    const time_point scheduled = schedule(total_sz, timestamp);
+    const time_point handoff = wait_until(scheduled);
+    try {
+        send_frame(buffer, total_sz);
+    }
+    catch (socket_write_error&) {
+        sent(scheduled, handoff, total_sz, false);
+        return;
+    }
+    sent(scheduled, handoff, total_sz, true);
+}
+
+void PacketReplayer::reset() {
+    started_ = false;
+    tokens_ = bucket_depth_;
+    stats_ = Statistics();
+}
+
+PacketReplayer::time_point PacketReplayer::schedule(uint32_t size,
+                                                    const Timestamp& timestamp) {
+    const time_point now = clock_type::now();
+    const microseconds packet_time = timestamp;
+    if (!started_) {
+        started_ = true;
+        first_send_time_ = now;
+        last_refill_time_ = now;
+        first_timestamp_ = packet_time;
+    }
+    switch (mode_) {
+        case ORIGINAL_TIMING:
+            {
+                // Packets with timestamps before the first one are sent right away
+                if (packet_time <= first_timestamp_) {
+                    return first_send_time_;
+                }
+                duration<double, std::micro> offset(packet_time - first_timestamp_);
+                return first_send_time_ +
+                       duration_cast<duration_type>(offset / multiplier_);
+            }
+        case PACKETS_PER_SECOND:
+        case BITS_PER_SECOND:
+            {
+                const double cost = (mode_ == PACKETS_PER_SECOND) ? 1.0 : size * 8.0;
+                // A packet larger than the bucket is sent once the bucket is full
+                const double depth = max(bucket_depth_, cost);
+                const double elapsed = duration_cast<duration<double> >(
+                    now - last_refill_time_
+                ).count();
+                tokens_ = min(depth, tokens_ + max(elapsed, 0.0) * rate_);
+                last_refill_time_ = now;
+                if (tokens_ >= cost) {
+                    tokens_ -= cost;
+                    return now;
+                }
+                // The bucket will hold exactly enough tokens at this point. Refilling
+                // from it rather than from the actual send time keeps the long term
+                // rate unaffected by the wake up jitter.
+                const duration<double> wait((cost - tokens_) / rate_);
+                // Round up, otherwise the truncation would slowly exceed the rate
+                duration_type wait_time = duration_cast<duration_type>(wait);
+                if (wait_time < wait) {
+                    wait_time += duration_type(1);
+                }
+                tokens_ = 0;
+                last_refill_time_ = now + wait_time;
+                return last_refill_time_;
+            }
+        default:
+            return now;
+    }
+}
+
+PacketReplayer::time_point PacketReplayer::wait_until(time_point deadline) {
+    time_point now = clock_type::now();
+    while (now < deadline) {
+        const duration_type remaining = deadline - now;
+        if (remaining > spin_threshold_) {
+            std::this_thread::sleep_for(remaining - spin_threshold_);
+        }
+        now = clock_type::now();
+    }
+    return now;
+}
+
+void PacketReplayer::sent(time_point scheduled, time_point handoff, uint32_t size,
+                          bool success) {
+    if (success) {
+        stats_.packets_sent++;
+        stats_.bytes_sent += size;
+    }
+    else {
+        stats_.send_errors++;
+    }
+    const duration_type jitter = max(duration_type(handoff - scheduled), duration_type(0));
+    stats_.total_jitter += jitter;
+    stats_.max_jitter = max(stats_.max_jitter, jitter);
+    stats_.elapsed = handoff - first_send_time_;
+}
+
+void PacketReplayer::send_frame(const uint8_t* buffer, uint32_t total_sz) {
+    const NetworkInterface& iface = iface_ ? iface_ : sender_->default_interface();
+    if (!iface) {
+        throw invalid_interface();
+    }
+    #if defined(TINS_HAVE_PACKET_SENDER_PCAP_SENDPACKET) || defined(BSD) || defined(__FreeBSD_kernel__)
+        sender_->send_l2(buffer, total_sz, 0, 0, iface);
+    #elif defined(_WIN32)
+        throw feature_disabled();
+    #else
+        struct sockaddr_ll addr;
+        memset(&addr, 0, sizeof(struct sockaddr_ll));
+        addr.sll_family = Endian::host_to_be<uint16_t>(PF_PACKET);
+        addr.sll_protocol = Endian::host_to_be<uint16_t>(ETH_P_ALL);
+        addr.sll_ifindex = iface.id();
+        sender_->send_l2(buffer, total_sz, (struct sockaddr*)&addr,
+                         (uint32_t)sizeof(addr), iface);
+    #endif
+}
+
+} // Tins
+
+#endif // TINS_IS_CXX11
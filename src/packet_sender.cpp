@@ -44,6 +44,10 @@
     #else
         #include <linux/if_ether.h>
         #include <linux/if_packet.h>
+        #ifdef TINS_HAVE_PACKET_TX_RING
+            #include <sys/mman.h>
+            #include <poll.h>
+        #endif // TINS_HAVE_PACKET_TX_RING
     #endif
     #include <netdb.h>
     #include <netinet/in.h>
@@ -56,6 +60,7 @@
 #include <ctime>
 #include <sstream>
 #include <tins/pdu.h>
+#include <tins/packet_template.h>
 #include <tins/macros.h>
 // PDUs required by PacketSender::send(PDU&, NetworkInterface)
 #include <tins/ethernetII.h>
@@ -74,11 +79,16 @@ using std::ostringstream;
 using std::make_pair;
 using std::vector;
 using std::runtime_error;
+using std::min;
 
 namespace Tins {
 
 const int PacketSender::INVALID_RAW_SOCKET = -1;
 const uint32_t PacketSender::DEFAULT_TIMEOUT = 2;
+#ifdef TINS_HAVE_PACKET_TX_RING
+const uint32_t PacketSender::DEFAULT_TX_RING_FRAMES = 256;
+const uint32_t PacketSender::DEFAULT_TX_RING_FRAME_SIZE = 2048;
+#endif // TINS_HAVE_PACKET_TX_RING
 
 #ifndef _WIN32
     typedef int socket_type;
@@ -95,6 +105,111 @@ const uint32_t PacketSender::DEFAULT_TIMEOUT = 2;
     }
 #endif
 
+#ifdef TINS_HAVE_PACKET_TX_RING
+
+// A TPACKET_V2 transmission ring, bound to a single interface
+struct PacketSender::TxRing {
+    // Frame payloads start right after the frame header
+    static const uint32_t DATA_OFFSET = TPACKET2_HDRLEN - sizeof(sockaddr_ll);
+
+    TxRing(const NetworkInterface& iface, uint32_t frame_count, uint32_t frame_size)
+    : iface(iface), socket(INVALID_RAW_SOCKET), ring(0), ring_size(0),
+      frame_size(frame_size), frames_per_block(0), block_size(0), frame_count(0),
+      current_frame(0) {
+        if (frame_size <= DATA_OFFSET || frame_size % TPACKET_ALIGNMENT != 0 ||
+            frame_count == 0) {
+            throw socket_open_error("Invalid TX ring size");
+        }
+        const uint32_t page_size = static_cast<uint32_t>(sysconf(_SC_PAGESIZE));
+        block_size = (frame_size + page_size - 1) / page_size * page_size;
+        frames_per_block = block_size / frame_size;
+        const uint32_t block_count = (frame_count + frames_per_block - 1) / frames_per_block;
+        this->frame_count = block_count * frames_per_block;
+        ring_size = static_cast<size_t>(block_count) * block_size;
+
+        // Use protocol 0 so that this socket doesn't receive any packets
+        socket = ::socket(PF_PACKET, SOCK_RAW, 0);
+        if (socket == -1) {
+            throw socket_open_error(make_error_string());
+        }
+        const int version = TPACKET_V2;
+        // Skip malformed frames rather than aborting the whole batch. The
+        // kernel hands those back as available, same as the ones it sent
+        const int discard = 1;
+        tpacket_req request;
+        memset(&request, 0, sizeof(request));
+        request.tp_block_size = block_size;
+        request.tp_block_nr = block_count;
+        request.tp_frame_size = frame_size;
+        request.tp_frame_nr = this->frame_count;
+        sockaddr_ll address;
+        memset(&address, 0, sizeof(address));
+        address.sll_family = AF_PACKET;
+        address.sll_ifindex = iface.id();
+        if (setsockopt(socket, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) != 0 ||
+            setsockopt(socket, SOL_PACKET, PACKET_LOSS, &discard, sizeof(discard)) != 0 ||
+            setsockopt(socket, SOL_PACKET, PACKET_TX_RING, &request, sizeof(request)) != 0) {
+            const string error = make_error_string();
+            ::close(socket);
+            throw socket_open_error(error);
+        }
+        void* mapping = mmap(0, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, socket, 0);
+        if (mapping == MAP_FAILED) {
+            const string error = make_error_string();
+            ::close(socket);
+            throw socket_open_error(error);
+        }
+        ring = static_cast<uint8_t*>(mapping);
+        if (bind(socket, (const sockaddr*)&address, sizeof(address)) != 0) {
+            const string error = make_error_string();
+            munmap(ring, ring_size);
+            ::close(socket);
+            throw socket_open_error(error);
+        }
+    }
+
+    ~TxRing() {
+        munmap(ring, ring_size);
+        ::close(socket);
+    }
+
+    tpacket2_hdr* frame(uint32_t index) {
+        const size_t offset = static_cast<size_t>(index / frames_per_block) * block_size +
+                              (index % frames_per_block) * frame_size;
+        return reinterpret_cast<tpacket2_hdr*>(ring + offset);
+    }
+
+    uint32_t max_payload_size() const {
+        return frame_size - DATA_OFFSET;
+    }
+
+    // Waits until the kernel is done with the given frame
+    void wait_for_frame(tpacket2_hdr* header) {
+        while (*(volatile uint32_t*)&header->tp_status == TP_STATUS_SENDING) {
+            pollfd descriptor;
+            descriptor.fd = socket;
+            descriptor.events = POLLOUT;
+            descriptor.revents = 0;
+            poll(&descriptor, 1, 1);
+        }
+    }
+
+    NetworkInterface iface;
+    int socket;
+    uint8_t* ring;
+    size_t ring_size;
+    uint32_t frame_size;
+    uint32_t frames_per_block;
+    uint32_t block_size;
+    uint32_t frame_count;
+    uint32_t current_frame;
+private:
+    TxRing(const TxRing&);
+    TxRing& operator=(const TxRing&);
+};
+
+#endif // TINS_HAVE_PACKET_TX_RING
+
 PacketSender::PacketSender(const NetworkInterface& iface, 
                            uint32_t recv_timeout, 
                            uint32_t usec) 
@@ -102,7 +217,8 @@ PacketSender::PacketSender(const NetworkInterface& iface,
 #if !defined(BSD) && !defined(_WIN32) && !defined(__FreeBSD_kernel__)
   ether_socket_(INVALID_RAW_SOCKET),
 #endif
-  _timeout(recv_timeout), timeout_usec_(usec), default_iface_(iface) {
+  _timeout(recv_timeout), timeout_usec_(usec), default_iface_(iface),
+  queued_frames_(0), batching_(false), tx_ring_(0) {
     types_[IP_TCP_SOCKET] = IPPROTO_TCP;
     types_[IP_UDP_SOCKET] = IPPROTO_UDP;
     types_[IP_RAW_SOCKET] = IPPROTO_RAW;
@@ -112,6 +228,9 @@ PacketSender::PacketSender(const NetworkInterface& iface,
 }
 
 PacketSender::~PacketSender() {
+    #ifdef TINS_HAVE_PACKET_TX_RING
+        delete tx_ring_;
+    #endif // TINS_HAVE_PACKET_TX_RING
     for (unsigned i(0); i < sockets_.size(); ++i) {
         if (sockets_[i] != INVALID_RAW_SOCKET)  {
             #ifndef _WIN32
@@ -341,6 +460,260 @@ void PacketSender::send(PDU& pdu, const NetworkInterface& iface) {
     }
 }
 
+void PacketSender::queue(PDU& pdu) {
+    queue(pdu, default_iface_);
+}
+
+void PacketSender::queue(PDU& pdu, const NetworkInterface& iface) {
+    // send_l2 and send_l3 will queue the serialized PDU rather than sending it
+    batching_ = true;
+    try {
+        send(pdu, iface);
+    }
+    catch (...) {
+        batching_ = false;
+        throw;
+    }
+    batching_ = false;
+}
+
+void PacketSender::queue(const PacketTemplate& packet) {
+    queue(packet, default_iface_);
+}
+
+void PacketSender::queue(const PacketTemplate& packet, const NetworkInterface& iface) {
+    batching_ = true;
+    try {
+        packet.send(*this, iface);
+    }
+    catch (...) {
+        batching_ = false;
+        throw;
+    }
+    batching_ = false;
+}
+
+PacketSender::BatchResult PacketSender::flush() {
+    BatchResult result;
+    size_t index = 0;
+    while (index < queued_frames_) {
+        // There's nothing to send for packets that serialized to no bytes
+        if (batch_frames_[index].buffer.empty()) {
+            ++result.failed;
+            ++index;
+            continue;
+        }
+        size_t end = index + 1;
+        #ifdef TINS_HAVE_PACKET_TX_RING
+        if (fits_tx_ring(batch_frames_[index])) {
+            while (end < queued_frames_ && !batch_frames_[end].buffer.empty() &&
+                   fits_tx_ring(batch_frames_[end])) {
+                ++end;
+            }
+            send_tx_ring_frames(index, end, result);
+            index = end;
+            continue;
+        }
+        #endif // TINS_HAVE_PACKET_TX_RING
+        // Group consecutive frames that go through the same socket
+        while (end < queued_frames_ && 
+               !batch_frames_[end].buffer.empty() &&
+               batch_frames_[end].socket == batch_frames_[index].socket &&
+               batch_frames_[end].is_layer_2 == batch_frames_[index].is_layer_2 &&
+               batch_frames_[end].iface == batch_frames_[index].iface
+               #ifdef TINS_HAVE_PACKET_TX_RING
+               && !fits_tx_ring(batch_frames_[end])
+               #endif // TINS_HAVE_PACKET_TX_RING
+               ) {
+            ++end;
+        }
+        send_frames(index, end, result);
+        index = end;
+    }
+    queued_frames_ = 0;
+    return result;
+}
+
+size_t PacketSender::queued_packets() const {
+    return queued_frames_;
+}
+
+void PacketSender::clear_queue() {
+    queued_frames_ = 0;
+}
+
+#ifdef TINS_HAVE_PACKET_TX_RING
+
+void PacketSender::enable_tx_ring(const NetworkInterface& iface,
+                                  uint32_t frame_count,
+                                  uint32_t frame_size) {
+    TxRing* ring = new TxRing(iface, frame_count, frame_size);
+    delete tx_ring_;
+    tx_ring_ = ring;
+}
+
+void PacketSender::disable_tx_ring() {
+    delete tx_ring_;
+    tx_ring_ = 0;
+}
+
+bool PacketSender::fits_tx_ring(const BatchFrame& frame) const {
+    return tx_ring_ && frame.is_layer_2 && frame.iface == tx_ring_->iface &&
+           frame.buffer.size() <= tx_ring_->max_payload_size();
+}
+
+void PacketSender::send_tx_ring_frames(size_t start, size_t end, BatchResult& result) {
+    TxRing& ring = *tx_ring_;
+    while (start < end) {
+        const size_t count = min(end - start, static_cast<size_t>(ring.frame_count));
+        const uint32_t first_frame = ring.current_frame;
+        for (size_t i = 0; i < count; ++i) {
+            const BatchFrame& frame = batch_frames_[start + i];
+            tpacket2_hdr* header = ring.frame(ring.current_frame);
+            ring.wait_for_frame(header);
+            uint8_t* data = reinterpret_cast<uint8_t*>(header) + TxRing::DATA_OFFSET;
+            memcpy(data, &frame.buffer[0], frame.buffer.size());
+            header->tp_len = static_cast<uint32_t>(frame.buffer.size());
+            // Make sure the frame is written before handing it to the kernel
+            __sync_synchronize();
+            header->tp_status = TP_STATUS_SEND_REQUEST;
+            ring.current_frame = (ring.current_frame + 1) % ring.frame_count;
+        }
+        // A blocking send only returns once every requested frame is processed
+        int sent = -1;
+        do {
+            sent = ::send(ring.socket, 0, 0, 0);
+        } while (sent == -1 && errno == EINTR);
+        bool rewound = false;
+        for (size_t i = 0; i < count; ++i) {
+            const uint32_t index = (first_frame + i) % ring.frame_count;
+            tpacket2_hdr* header = ring.frame(index);
+            ring.wait_for_frame(header);
+            const uint32_t status = *(volatile uint32_t*)&header->tp_status;
+            if (status == TP_STATUS_AVAILABLE) {
+                ++result.sent;
+            }
+            else {
+                // Left pending because the send failed. The kernel didn't 
+                // move past this frame, so the next batch has to start here
+                header->tp_status = TP_STATUS_AVAILABLE;
+                ++result.failed;
+                if (!rewound) {
+                    ring.current_frame = index;
+                    rewound = true;
+                }
+            }
+        }
+        start += count;
+    }
+}
+
+#endif // TINS_HAVE_PACKET_TX_RING
+
+void PacketSender::queue_frame(PDU* pdu,
+                               const uint8_t* buffer,
+                               uint32_t total_sz,
+                               struct sockaddr* link_addr,
+                               uint32_t len_addr,
+                               int sock,
+                               const NetworkInterface& iface,
+                               bool is_layer_2) {
+    if (len_addr > sizeof(BatchFrame().address)) {
+        throw invalid_address();
+    }
+    if (queued_frames_ == batch_frames_.size()) {
+        batch_frames_.push_back(BatchFrame());
+    }
+    BatchFrame& frame = batch_frames_[queued_frames_];
+    if (pdu) {
+        pdu->serialize(frame.buffer);
+    }
+    else {
+        frame.buffer.assign(buffer, buffer + total_sz);
+    }
+    if (link_addr) {
+        memcpy(frame.address, link_addr, len_addr);
+    }
+    frame.address_length = link_addr ? len_addr : 0;
+    frame.socket = sock;
+    frame.iface = iface;
+    frame.is_layer_2 = is_layer_2;
+    ++queued_frames_;
+}
+
+bool PacketSender::send_frame(BatchFrame& frame) {
+    #ifdef TINS_HAVE_PACKET_SENDER_PCAP_SENDPACKET
+    if (frame.is_layer_2) {
+        pcap_t* handle = pcap_handles_[frame.iface];
+        const int buf_size = static_cast<int>(frame.buffer.size());
+        return pcap_sendpacket(handle, (u_char*)&frame.buffer[0], buf_size) == 0;
+    }
+    #elif defined(BSD) || defined(__FreeBSD_kernel__)
+    if (frame.is_layer_2) {
+        return ::write(frame.socket, &frame.buffer[0], frame.buffer.size()) != -1;
+    }
+    #endif // TINS_HAVE_PACKET_SENDER_PCAP_SENDPACKET
+    const int buf_size = static_cast<int>(frame.buffer.size());
+    sockaddr* address = frame.address_length ? (sockaddr*)frame.address : 0;
+    return sendto(frame.socket, (const char*)&frame.buffer[0], buf_size, 0,
+                  address, frame.address_length) != -1;
+}
+
+void PacketSender::send_frames(size_t start, size_t end, BatchResult& result) {
+    #if defined(TINS_HAVE_SENDMMSG) && !defined(TINS_HAVE_PACKET_SENDER_PCAP_SENDPACKET)
+        // The amount of messages submitted on each sendmmsg call
+        const size_t max_messages = 64;
+        mmsghdr headers[max_messages];
+        iovec vectors[max_messages];
+        const int sock = batch_frames_[start].socket;
+        while (start < end) {
+            const size_t count = min(end - start, max_messages);
+            memset(headers, 0, sizeof(mmsghdr) * count);
+            for (size_t i = 0; i < count; ++i) {
+                BatchFrame& frame = batch_frames_[start + i];
+                vectors[i].iov_base = &frame.buffer[0];
+                vectors[i].iov_len = frame.buffer.size();
+                headers[i].msg_hdr.msg_iov = &vectors[i];
+                headers[i].msg_hdr.msg_iovlen = 1;
+                if (frame.address_length) {
+                    headers[i].msg_hdr.msg_name = frame.address;
+                    headers[i].msg_hdr.msg_namelen = frame.address_length;
+                }
+            }
+            const int sent = sendmmsg(sock, headers, static_cast<unsigned>(count), 0);
+            if (sent > 0) {
+                result.sent += sent;
+                start += sent;
+            }
+            else if (sent == -1 && errno == EINTR) {
+                continue;
+            }
+            else {
+                // The first message in this chunk failed, skip it
+                ++result.failed;
+                ++start;
+            }
+        }
+    #else
+        for (; start < end; ++start) {
+            if (send_frame(batch_frames_[start])) {
+                ++result.sent;
+            }
+            else {
+                ++result.failed;
+            }
+        }
+    #endif
+}
+
+void PacketSender::send(const PacketTemplate& packet) {
+    packet.send(*this, default_iface_);
+}
+
+void PacketSender::send(const PacketTemplate& packet, const NetworkInterface& iface) {
+    packet.send(*this, iface);
+}
+
 PDU* PacketSender::send_recv(PDU& pdu) {
     return send_recv(pdu, default_iface_);
 }
@@ -360,26 +733,53 @@ void PacketSender::send_l2(PDU& pdu,
                            struct sockaddr* link_addr, 
                            uint32_t len_addr,
                            const NetworkInterface& iface) {
+    if (batching_) {
+        #ifdef TINS_HAVE_PACKET_SENDER_PCAP_SENDPACKET
+            open_l2_socket(iface);
+            queue_frame(&pdu, 0, 0, link_addr, len_addr, INVALID_RAW_SOCKET, iface, true);
+        #else
+            queue_frame(&pdu, 0, 0, link_addr, len_addr, get_ether_socket(iface), iface, true);
+        #endif // TINS_HAVE_PACKET_SENDER_PCAP_SENDPACKET
+        return;
+    }
     PDU::serialization_type buffer = pdu.serialize();
+    if (!buffer.empty()) {
+        send_l2(&buffer[0], static_cast<uint32_t>(buffer.size()), link_addr, len_addr, iface);
+    }
+}
 
+void PacketSender::send_l2(const uint8_t* buffer,
+                           uint32_t total_sz,
+                           struct sockaddr* link_addr, 
+                           uint32_t len_addr,
+                           const NetworkInterface& iface) {
     #ifdef TINS_HAVE_PACKET_SENDER_PCAP_SENDPACKET
+        if (batching_) {
+            open_l2_socket(iface);
+            queue_frame(0, buffer, total_sz, link_addr, len_addr, INVALID_RAW_SOCKET, iface, true);
+            return;
+        }
         Internals::unused(len_addr);
         Internals::unused(link_addr);
         open_l2_socket(iface);
         pcap_t* handle = pcap_handles_[iface];
-        const int buf_size = static_cast<int>(buffer.size());
-        if (pcap_sendpacket(handle, (u_char*)&buffer[0], buf_size) != 0) {
+        const int buf_size = static_cast<int>(total_sz);
+        if (pcap_sendpacket(handle, (u_char*)buffer, buf_size) != 0) {
             throw pcap_error("Failed to send packet: " + string(pcap_geterr(handle)));
         }
     #else // TINS_HAVE_PACKET_SENDER_PCAP_SENDPACKET
         int sock = get_ether_socket(iface);
-        if (!buffer.empty()) {
+        if (batching_) {
+            queue_frame(0, buffer, total_sz, link_addr, len_addr, sock, iface, true);
+            return;
+        }
+        if (total_sz > 0) {
             #if defined(BSD) || defined(__FreeBSD_kernel__)
             Internals::unused(len_addr);
             Internals::unused(link_addr);
-            if (::write(sock, &buffer[0], buffer.size()) == -1) {
+            if (::write(sock, buffer, total_sz) == -1) {
             #else
-            if (::sendto(sock, &buffer[0], buffer.size(), 0, link_addr, len_addr) == -1) {
+            if (::sendto(sock, buffer, total_sz, 0, link_addr, len_addr) == -1) {
             #endif
                 throw socket_write_error(make_error_string());
             }
@@ -420,11 +820,28 @@ void PacketSender::send_l3(PDU& pdu,
                            struct sockaddr* link_addr,
                            uint32_t len_addr,
                            SocketType type) {
+    if (batching_) {
+        open_l3_socket(type);
+        queue_frame(&pdu, 0, 0, link_addr, len_addr, sockets_[type], NetworkInterface(), false);
+        return;
+    }
+    PDU::serialization_type buffer = pdu.serialize();
+    send_l3(&buffer[0], static_cast<uint32_t>(buffer.size()), link_addr, len_addr, type);
+}
+
+void PacketSender::send_l3(const uint8_t* buffer,
+                           uint32_t total_sz,
+                           struct sockaddr* link_addr,
+                           uint32_t len_addr,
+                           SocketType type) {
     open_l3_socket(type);
     int sock = sockets_[type];
-    PDU::serialization_type buffer = pdu.serialize();
-    const int buf_size = static_cast<int>(buffer.size());
-    if (sendto(sock, (const char*)&buffer[0], buf_size, 0, link_addr, len_addr) == -1) {
+    if (batching_) {
+        queue_frame(0, buffer, total_sz, link_addr, len_addr, sock, NetworkInterface(), false);
+        return;
+    }
+    const int buf_size = static_cast<int>(total_sz);
+    if (sendto(sock, (const char*)buffer, buf_size, 0, link_addr, len_addr) == -1) {
         throw socket_write_error(make_error_string());
     }
 }
@@ -0,0 +1,436 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <cstring>
+#include <tins/macros.h>
+#ifndef _WIN32
+    #if defined(BSD) || defined(__FreeBSD_kernel__)
+        #include <net/if_dl.h>
+    #else
+        #include <netpacket/packet.h>
+    #endif
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <net/ethernet.h>
+#else
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#endif
+#include <tins/packet_template.h>
+#include <tins/packet_sender.h>
+#include <tins/pdu.h>
+#include <tins/endianness.h>
+#include <tins/exceptions.h>
+
+namespace Tins {
+
+namespace {
+
+void write_be16(uint8_t* ptr, uint16_t value) {
+    ptr[0] = static_cast<uint8_t>(value >> 8);
+    ptr[1] = static_cast<uint8_t>(value);
+}
+
+void write_be32(uint8_t* ptr, uint32_t value) {
+    ptr[0] = static_cast<uint8_t>(value >> 24);
+    ptr[1] = static_cast<uint8_t>(value >> 16);
+    ptr[2] = static_cast<uint8_t>(value >> 8);
+    ptr[3] = static_cast<uint8_t>(value);
+}
+
+// One's complement sum of the given bytes, given whether the first one
+// is the high order byte of a 16 bit word
+uint32_t partial_checksum(const uint8_t* data, uint32_t size, bool starts_aligned) {
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+        const bool is_high_byte = ((i % 2) == 0) == starts_aligned;
+        sum += is_high_byte ? (data[i] << 8) : data[i];
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return sum;
+}
+
+} // anonymous namespace
+
+PacketTemplate::PacketTemplate(PDU& pdu)
+: network_type_(NO_NETWORK), transport_type_(NO_TRANSPORT),
+  starts_at_network_layer_(false), network_offset_(0), transport_offset_(0),
+  payload_offset_(0), payload_size_(0) {
+    for (unsigned i = 0; i < FIELD_COUNT; ++i) {
+        field_offsets_[i] = NOT_PRESENT;
+        field_sizes_[i] = 0;
+    }
+    pdu.serialize(buffer_);
+
+    const PDU* network_pdu = 0;
+    const PDU* payload_layer = &pdu;
+    uint32_t payload_layer_offset = 0;
+    uint32_t offset = 0;
+    for (const PDU* current = &pdu; current; current = current->inner_pdu()) {
+        const PDU::PDUType type = current->pdu_type();
+        if (type == PDU::ETHERNET_II && !network_pdu && !has_field(ETH_DST_ADDR)) {
+            record_field(ETH_DST_ADDR, offset, 6);
+            record_field(ETH_SRC_ADDR, offset + 6, 6);
+        }
+        else if (type == PDU::IP && !network_pdu) {
+            network_pdu = current;
+            network_type_ = NETWORK_IPV4;
+            network_offset_ = offset;
+            record_field(IPV4_ID, offset + 4, 2);
+            record_field(IPV4_TTL, offset + 8, 1);
+            record_field(IPV4_SRC_ADDR, offset + 12, 4);
+            record_field(IPV4_DST_ADDR, offset + 16, 4);
+        }
+        else if (type == PDU::IPv6 && !network_pdu) {
+            network_pdu = current;
+            network_type_ = NETWORK_IPV6;
+            network_offset_ = offset;
+            record_field(IPV6_HOP_LIMIT, offset + 7, 1);
+            record_field(IPV6_SRC_ADDR, offset + 8, 16);
+            record_field(IPV6_DST_ADDR, offset + 24, 16);
+        }
+        // The transport layer has to be right on top of the network layer,
+        // otherwise its pseudo header wouldn't use the same addresses
+        else if (network_pdu && current->parent_pdu() == network_pdu) {
+            transport_offset_ = offset;
+            if (type == PDU::TCP) {
+                transport_type_ = TRANSPORT_TCP;
+                record_field(SPORT, offset, 2);
+                record_field(DPORT, offset + 2, 2);
+                record_field(TCP_SEQ, offset + 4, 4);
+                record_field(TCP_ACK_SEQ, offset + 8, 4);
+                record_field(TCP_WINDOW, offset + 14, 2);
+            }
+            else if (type == PDU::UDP) {
+                transport_type_ = TRANSPORT_UDP;
+                record_field(SPORT, offset, 2);
+                record_field(DPORT, offset + 2, 2);
+            }
+            else if (type == PDU::ICMP || type == PDU::ICMPv6) {
+                transport_type_ = (type == PDU::ICMP) ? TRANSPORT_ICMP : TRANSPORT_ICMPV6;
+                const uint8_t icmp_type = buffer_[offset];
+                // Echo, timestamp, information and address mask requests/replies
+                // or ICMPv6 echo request/reply
+                const bool has_identifier = (type == PDU::ICMP) ?
+                    (icmp_type == 0 || icmp_type == 8 || (icmp_type >= 13 && icmp_type <= 18)) :
+                    (icmp_type == 128 || icmp_type == 129);
+                if (has_identifier) {
+                    record_field(ICMP_ID, offset + 4, 2);
+                    record_field(ICMP_SEQUENCE, offset + 6, 2);
+                }
+            }
+            if (transport_type_ != NO_TRANSPORT) {
+                payload_layer = current;
+                payload_layer_offset = offset;
+                break;
+            }
+        }
+        if (current == network_pdu) {
+            payload_layer = current;
+            payload_layer_offset = offset;
+        }
+        offset += current->header_size();
+    }
+    starts_at_network_layer_ = network_pdu == &pdu;
+    payload_offset_ = payload_layer_offset + payload_layer->header_size();
+    payload_size_ = payload_layer->size() - payload_layer->header_size() -
+                    payload_layer->trailer_size();
+}
+
+bool PacketTemplate::has_field(Field field) const {
+    return field_offsets_[field] != NOT_PRESENT;
+}
+
+uint32_t PacketTemplate::field_offset(Field field) const {
+    if (!has_field(field)) {
+        throw field_not_present();
+    }
+    return field_offsets_[field];
+}
+
+uint32_t PacketTemplate::field_size(Field field) const {
+    if (!has_field(field)) {
+        throw field_not_present();
+    }
+    return field_sizes_[field];
+}
+
+void PacketTemplate::patch(Field field, const uint8_t* data) {
+    const uint32_t offset = field_offset(field);
+    const uint32_t size = field_sizes_[field];
+    switch (field) {
+        case IPV4_ID:
+        case IPV4_TTL:
+            write(offset, data, size, true, NOT_PRESENT);
+            break;
+        case IPV4_SRC_ADDR:
+        case IPV4_DST_ADDR:
+            // Addresses are part of the transport layer's pseudo header
+            write(offset, data, size, true, has_pseudo_header() ? offset : NOT_PRESENT);
+            break;
+        case IPV6_SRC_ADDR:
+        case IPV6_DST_ADDR:
+            write(offset, data, size, false, has_pseudo_header() ? offset : NOT_PRESENT);
+            break;
+        case SPORT:
+        case DPORT:
+        case TCP_SEQ:
+        case TCP_ACK_SEQ:
+        case TCP_WINDOW:
+        case ICMP_ID:
+        case ICMP_SEQUENCE:
+            write(offset, data, size, false, transport_offset_);
+            break;
+        default:
+            write(offset, data, size, false, NOT_PRESENT);
+            break;
+    };
+}
+
+void PacketTemplate::write_payload(uint32_t offset, const uint8_t* data, uint32_t size) {
+    if (offset > payload_size_ || size > payload_size_ - offset) {
+        throw serialization_error();
+    }
+    const uint32_t transport_region = (transport_type_ != NO_TRANSPORT) ?
+                                      transport_offset_ : NOT_PRESENT;
+    write(payload_offset_ + offset, data, size, false, transport_region);
+}
+
+void PacketTemplate::eth_dst_addr(const HWAddress<6>& value) {
+    patch(ETH_DST_ADDR, value.begin());
+}
+
+void PacketTemplate::eth_src_addr(const HWAddress<6>& value) {
+    patch(ETH_SRC_ADDR, value.begin());
+}
+
+void PacketTemplate::ip_id(uint16_t value) {
+    uint8_t data[2];
+    write_be16(data, value);
+    patch(IPV4_ID, data);
+}
+
+void PacketTemplate::ip_ttl(uint8_t value) {
+    patch(IPV4_TTL, &value);
+}
+
+void PacketTemplate::ip_src_addr(IPv4Address value) {
+    // IPv4Address converts to an integer in network byte order
+    const uint32_t address = value;
+    patch(IPV4_SRC_ADDR, (const uint8_t*)&address);
+}
+
+void PacketTemplate::ip_dst_addr(IPv4Address value) {
+    const uint32_t address = value;
+    patch(IPV4_DST_ADDR, (const uint8_t*)&address);
+}
+
+void PacketTemplate::ipv6_hop_limit(uint8_t value) {
+    patch(IPV6_HOP_LIMIT, &value);
+}
+
+void PacketTemplate::ipv6_src_addr(const IPv6Address& value) {
+    patch(IPV6_SRC_ADDR, value.begin());
+}
+
+void PacketTemplate::ipv6_dst_addr(const IPv6Address& value) {
+    patch(IPV6_DST_ADDR, value.begin());
+}
+
+void PacketTemplate::sport(uint16_t value) {
+    uint8_t data[2];
+    write_be16(data, value);
+    patch(SPORT, data);
+}
+
+void PacketTemplate::dport(uint16_t value) {
+    uint8_t data[2];
+    write_be16(data, value);
+    patch(DPORT, data);
+}
+
+void PacketTemplate::seq(uint32_t value) {
+    uint8_t data[4];
+    write_be32(data, value);
+    patch(TCP_SEQ, data);
+}
+
+void PacketTemplate::ack_seq(uint32_t value) {
+    uint8_t data[4];
+    write_be32(data, value);
+    patch(TCP_ACK_SEQ, data);
+}
+
+void PacketTemplate::window(uint16_t value) {
+    uint8_t data[2];
+    write_be16(data, value);
+    patch(TCP_WINDOW, data);
+}
+
+void PacketTemplate::icmp_id(uint16_t value) {
+    uint8_t data[2];
+    write_be16(data, value);
+    patch(ICMP_ID, data);
+}
+
+void PacketTemplate::icmp_sequence(uint16_t value) {
+    uint8_t data[2];
+    write_be16(data, value);
+    patch(ICMP_SEQUENCE, data);
+}
+
+void PacketTemplate::send(PacketSender& sender, const NetworkInterface& iface) const {
+    if (starts_at_network_layer_ && network_type_ == NETWORK_IPV4) {
+        sockaddr_in link_addr;
+        memset(&link_addr, 0, sizeof(link_addr));
+        link_addr.sin_family = AF_INET;
+        memcpy(&link_addr.sin_addr, &buffer_[field_offsets_[IPV4_DST_ADDR]], 4);
+        PacketSender::SocketType type = PacketSender::IP_RAW_SOCKET;
+        if (transport_type_ == TRANSPORT_TCP) {
+            type = PacketSender::IP_TCP_SOCKET;
+        }
+        else if (transport_type_ == TRANSPORT_UDP) {
+            type = PacketSender::IP_UDP_SOCKET;
+        }
+        else if (transport_type_ == TRANSPORT_ICMP) {
+            type = PacketSender::ICMP_SOCKET;
+        }
+        sender.send_l3(data(), size(), (struct sockaddr*)&link_addr, sizeof(link_addr), type);
+    }
+    else if (starts_at_network_layer_ && network_type_ == NETWORK_IPV6) {
+        sockaddr_in6 link_addr;
+        memset(&link_addr, 0, sizeof(link_addr));
+        link_addr.sin6_family = AF_INET6;
+        const uint8_t* dst_addr = &buffer_[field_offsets_[IPV6_DST_ADDR]];
+        // Required to set sin6_scope_id to interface index as stated in RFC2553.
+        if (IPv6Address(dst_addr).is_local_unicast()) {
+            link_addr.sin6_scope_id = iface.id();
+        }
+        memcpy(&link_addr.sin6_addr, dst_addr, IPv6Address::address_size);
+        sender.send_l3(data(), size(), (struct sockaddr*)&link_addr, sizeof(link_addr),
+                       PacketSender::IPV6_SOCKET);
+    }
+    else {
+        if (!iface) {
+            throw invalid_interface();
+        }
+        #if defined(TINS_HAVE_PACKET_SENDER_PCAP_SENDPACKET) || defined(BSD) || defined(__FreeBSD_kernel__)
+            sender.send_l2(data(), size(), 0, 0, iface);
+        #elif defined(_WIN32)
+            throw feature_disabled();
+        #else
+            struct sockaddr_ll addr;
+            memset(&addr, 0, sizeof(struct sockaddr_ll));
+            addr.sll_family = Endian::host_to_be<uint16_t>(PF_PACKET);
+            addr.sll_protocol = Endian::host_to_be<uint16_t>(ETH_P_ALL);
+            addr.sll_ifindex = iface.id();
+            if (has_field(ETH_DST_ADDR)) {
+                addr.sll_halen = 6;
+                memcpy(&(addr.sll_addr), &buffer_[field_offsets_[ETH_DST_ADDR]], 6);
+            }
+            sender.send_l2(data(), size(), (struct sockaddr*)&addr, (uint32_t)sizeof(addr), iface);
+        #endif
+    }
+}
+
+void PacketTemplate::record_field(Field field, uint32_t offset, uint32_t size) {
+    // Fields truncated by the serialization (e.g. a malformed header) are skipped
+    if (offset + size <= buffer_.size()) {
+        field_offsets_[field] = offset;
+        field_sizes_[field] = static_cast<uint8_t>(size);
+    }
+}
+
+void PacketTemplate::update_checksum(uint32_t checksum_offset, uint32_t region_offset,
+                                     uint32_t offset, const uint8_t* data, uint32_t size,
+                                     bool is_udp) {
+    if (checksum_offset + 2 > buffer_.size()) {
+        return;
+    }
+    uint8_t* checksum_ptr = &buffer_[checksum_offset];
+    const uint16_t checksum = static_cast<uint16_t>((checksum_ptr[0] << 8) | checksum_ptr[1]);
+    // A zero UDP checksum means no checksum was computed
+    if (is_udp && checksum == 0) {
+        return;
+    }
+    const bool starts_aligned = ((offset - region_offset) % 2) == 0;
+    const uint32_t old_sum = partial_checksum(&buffer_[offset], size, starts_aligned);
+    const uint32_t new_sum = partial_checksum(data, size, starts_aligned);
+    // RFC 1624: HC' = ~(~HC + ~m + m')
+    uint32_t sum = (~checksum & 0xffff) + (~old_sum & 0xffff) + new_sum;
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    uint16_t result = static_cast<uint16_t>(~sum);
+    if (is_udp && result == 0) {
+        result = 0xffff;
+    }
+    write_be16(checksum_ptr, result);
+}
+
+void PacketTemplate::write(uint32_t offset, const uint8_t* data, uint32_t size,
+                           bool ip_checksum, uint32_t transport_region_offset) {
+    if (size == 0) {
+        return;
+    }
+    if (ip_checksum && network_type_ == NETWORK_IPV4) {
+        update_checksum(network_offset_ + 10, network_offset_, offset, data, size, false);
+    }
+    if (transport_region_offset != NOT_PRESENT) {
+        uint32_t checksum_offset = transport_offset_;
+        switch (transport_type_) {
+            case TRANSPORT_TCP:
+                checksum_offset += 16;
+                break;
+            case TRANSPORT_UDP:
+                checksum_offset += 6;
+                break;
+            case TRANSPORT_ICMP:
+            case TRANSPORT_ICMPV6:
+                checksum_offset += 2;
+                break;
+            default:
+                checksum_offset = NOT_PRESENT;
+        };
+        if (checksum_offset != NOT_PRESENT) {
+            update_checksum(checksum_offset, transport_region_offset, offset, data, size,
+                            transport_type_ == TRANSPORT_UDP);
+        }
+    }
+    memcpy(&buffer_[offset], data, size);
+}
+
+bool PacketTemplate::has_pseudo_header() const {
+    return transport_type_ == TRANSPORT_TCP || transport_type_ == TRANSPORT_UDP ||
+           transport_type_ == TRANSPORT_ICMPV6;
+}
+
+} // Tins
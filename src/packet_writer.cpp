@@ -31,12 +31,15 @@
     #include <sys/time.h>
 #endif
 #include <string.h>
+#include <algorithm>
 #include <tins/packet_writer.h>
 #include <tins/packet.h>
 #include <tins/pdu.h>
+#include <tins/timestamp.h>
 #include <tins/exceptions.h>
 
 using std::string;
+using std::max;
 
 namespace Tins {
 
@@ -66,7 +69,46 @@ void PacketWriter::write(Packet& packet) {
     timeval tv;
     tv.tv_sec = packet.timestamp().seconds();
     tv.tv_usec = packet.timestamp().microseconds();
-    write(*packet.pdu(), tv);
+    if (packet.has_raw_frame()) {
+        const Packet::raw_frame_type& frame = packet.raw_frame();
+        write(&frame[0], static_cast<uint32_t>(frame.size()), packet.raw_frame_length(), tv);
+    }
+    else {
+        write(*packet.pdu(), tv);
+    }
+}
+
+void PacketWriter::write(const uint8_t* buffer, uint32_t total_sz) {
+    timeval tv;
+    #ifndef _WIN32
+        gettimeofday(&tv, 0);
+    #else
+        // fixme
+        tv = timeval();
+    #endif
+    write(buffer, total_sz, total_sz, tv);
+}
+
+void PacketWriter::write(const uint8_t* buffer, uint32_t total_sz, const Timestamp& timestamp) {
+    write(buffer, total_sz, total_sz, timestamp);
+}
+
+void PacketWriter::write(const uint8_t* buffer, uint32_t total_sz, uint32_t original_sz,
+                         const Timestamp& timestamp) {
+    timeval tv;
+    tv.tv_sec = timestamp.seconds();
+    tv.tv_usec = timestamp.microseconds();
+    write(buffer, total_sz, original_sz, tv);
+}
+
+void PacketWriter::write(const uint8_t* buffer, uint32_t total_sz, uint32_t original_sz,
+                         const struct timeval& tv) {
+    struct pcap_pkthdr header;
+    memset(&header, 0, sizeof(header));
+    header.ts = tv;
+    header.len = static_cast<bpf_u_int32>(max(total_sz, original_sz));
+    header.caplen = static_cast<bpf_u_int32>(total_sz);
+    pcap_dump((u_char*)dumper_, &header, buffer);
 }
 
 void PacketWriter::write(PDU& pdu, const struct timeval& tv) {
@@ -132,6 +132,13 @@ PDU::serialization_type PDU::serialize() {
     return buffer;
 }
 
+void PDU::serialize(serialization_type& buffer) {
+    buffer.resize(size());
+    if (!buffer.empty()) {
+        serialize(&buffer[0], static_cast<uint32_t>(buffer.size()));
+    }
+}
+
 void PDU::serialize(uint8_t* buffer, uint32_t total_sz) {
     uint32_t sz = header_size() + trailer_size();
     // Must not happen...
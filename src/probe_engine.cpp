@@ -0,0 +1,710 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/probe_engine.h>
+
+#if defined(TINS_HAVE_EPOLL) && TINS_IS_CXX11
+
+#include <cstring>
+#include <algorithm>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <tins/packet_sender.h>
+#include <tins/pdu.h>
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/arp.h>
+#include <tins/tcp.h>
+#include <tins/udp.h>
+#include <tins/icmp.h>
+#include <tins/icmpv6.h>
+#include <tins/exceptions.h>
+#include <tins/constants.h>
+
+using std::unique_ptr;
+using std::vector;
+using std::min;
+using std::chrono::duration_cast;
+
+namespace Tins {
+
+namespace {
+
+const uint16_t ETHER_TYPE_IP = Constants::Ethernet::IP;
+const uint16_t ETHER_TYPE_IPV6 = Constants::Ethernet::IPV6;
+const uint16_t ETHER_TYPE_ARP = Constants::Ethernet::ARP;
+
+const uint8_t PROTO_ICMP = 1;
+const uint8_t PROTO_TCP = 6;
+const uint8_t PROTO_UDP = 17;
+const uint8_t PROTO_ICMPV6 = 58;
+
+// Size of the ICMP and ICMPv6 header that precedes the original datagram
+const uint32_t ICMP_HEADER_SIZE = 8;
+
+// The maximum amount of packets read on each call to poll
+const size_t MAX_READS_PER_POLL = 1024;
+
+uint16_t read_u16(const uint8_t* ptr) {
+    return static_cast<uint16_t>((ptr[0] << 8) | ptr[1]);
+}
+
+bool is_icmp_error(uint8_t type) {
+    // Destination unreachable, source quench, redirect, time exceeded
+    // and parameter problem
+    return type == 3 || type == 4 || type == 5 || type == 11 || type == 12;
+}
+
+bool is_icmp_reply(uint8_t type) {
+    // Echo, timestamp and address mask replies
+    return type == 0 || type == 14 || type == 18;
+}
+
+bool is_icmpv6_error(uint8_t type) {
+    return type >= 1 && type <= 4;
+}
+
+const uint8_t ICMPV6_ECHO_REPLY = 129;
+const uint8_t ICMPV6_ROUTER_SOLICIT = 133;
+const uint8_t ICMPV6_NEIGHBOUR_SOLICIT = 135;
+
+// Skips IPv6 extension headers. Returns false if they're truncated
+bool skip_ipv6_extensions(const uint8_t*& ptr, uint32_t& total_sz, uint8_t& next_header) {
+    while (next_header == 0 || next_header == 43 || next_header == 44 || next_header == 60) {
+        if (total_sz < 8) {
+            return false;
+        }
+        const uint32_t size = (next_header == 44) ? 8 : (ptr[1] + 1) * 8;
+        if (size > total_sz) {
+            return false;
+        }
+        next_header = ptr[0];
+        ptr += size;
+        total_sz -= size;
+    }
+    return true;
+}
+
+void copy_address(uint8_t* output, IPv4Address address) {
+    const uint32_t value = address;
+    memcpy(output, &value, sizeof(value));
+}
+
+PDU* find_network_pdu(PDU* pdu, uint16_t& ether_type) {
+    for (; pdu; pdu = pdu->inner_pdu()) {
+        if (pdu->pdu_type() == PDU::IP) {
+            ether_type = ETHER_TYPE_IP;
+            return pdu;
+        }
+        else if (pdu->pdu_type() == PDU::IPv6) {
+            ether_type = ETHER_TYPE_IPV6;
+            return pdu;
+        }
+        else if (pdu->pdu_type() == PDU::ARP) {
+            ether_type = ETHER_TYPE_ARP;
+            return pdu;
+        }
+    }
+    return 0;
+}
+
+} // anonymous namespace
+
+const ProbeEngine::duration_type ProbeEngine::DEFAULT_TIMEOUT = duration_type(2000);
+
+// ResponseKey
+
+ProbeEngine::ResponseKey::ResponseKey()
+: ether_type(0), protocol(0), first_id(0), second_id(0) {
+    memset(src_addr, 0, sizeof(src_addr));
+    memset(dst_addr, 0, sizeof(dst_addr));
+}
+
+bool ProbeEngine::ResponseKey::operator==(const ResponseKey& rhs) const {
+    return ether_type == rhs.ether_type && protocol == rhs.protocol &&
+           first_id == rhs.first_id && second_id == rhs.second_id &&
+           memcmp(src_addr, rhs.src_addr, sizeof(src_addr)) == 0 &&
+           memcmp(dst_addr, rhs.dst_addr, sizeof(dst_addr)) == 0;
+}
+
+size_t ProbeEngine::ResponseKeyHasher::operator()(const ResponseKey& key) const {
+    // FNV-1a over every field
+    uint64_t output = 14695981039346656037ULL;
+    const uint64_t prime = 1099511628211ULL;
+    const uint8_t header[] = {
+        static_cast<uint8_t>(key.ether_type >> 8), static_cast<uint8_t>(key.ether_type),
+        key.protocol,
+        static_cast<uint8_t>(key.first_id >> 8), static_cast<uint8_t>(key.first_id),
+        static_cast<uint8_t>(key.second_id >> 8), static_cast<uint8_t>(key.second_id)
+    };
+    for (size_t i = 0; i < sizeof(header); ++i) {
+        output = (output ^ header[i]) * prime;
+    }
+    for (size_t i = 0; i < sizeof(key.src_addr); ++i) {
+        output = (output ^ key.src_addr[i]) * prime;
+        output = (output ^ key.dst_addr[i]) * prime;
+    }
+    return static_cast<size_t>(output);
+}
+
+// ProbeEngine
+
+ProbeEngine::ProbeEngine(PacketSender& sender, const NetworkInterface& iface)
+: sender_(&sender), iface_(iface), socket_(-1), epoll_fd_(-1), next_id_(0),
+  completed_(0), buffer_(65536) {
+
+}
+
+ProbeEngine::~ProbeEngine() {
+    if (epoll_fd_ != -1) {
+        ::close(epoll_fd_);
+    }
+    if (socket_ != -1) {
+        ::close(socket_);
+    }
+}
+
+ProbeEngine::probe_id ProbeEngine::send(PDU& probe, callback_type callback,
+                                        duration_type timeout) {
+    return send(probe, sender_->default_interface(), callback, timeout);
+}
+
+ProbeEngine::probe_id ProbeEngine::send(PDU& probe, const NetworkInterface& iface,
+                                        callback_type callback, duration_type timeout) {
+    // Responses that arrive before the socket is open would be lost
+    open_socket();
+    sender_->send(probe, iface);
+    return expect(probe, callback, timeout);
+}
+
+ProbeEngine::probe_id ProbeEngine::expect(const PDU& probe, callback_type callback,
+                                          duration_type timeout) {
+    return track(unique_ptr<PDU>(probe.clone()), callback, timeout);
+}
+
+ProbeEngine::probe_id ProbeEngine::track(unique_ptr<PDU> pdu, callback_type callback,
+                                         duration_type timeout) {
+    uint16_t ether_type = 0;
+    PDU* network_pdu = find_network_pdu(pdu.get(), ether_type);
+    if (!network_pdu) {
+        throw pdu_not_found();
+    }
+    // This fills in fields that are only set when serializing, like the 
+    // protocol numbers
+    network_pdu->serialize();
+    Probe probe;
+    probe.network_pdu = network_pdu;
+    probe.callback = callback;
+    probe.ip_id = 0;
+    probe.keyed = make_request_key(*network_pdu, probe.key, probe.ip_id);
+    probe.pdu = std::move(pdu);
+
+    const probe_id id = next_id_++;
+    if (probe.keyed) {
+        index_.insert(std::make_pair(probe.key, id));
+    }
+    else {
+        unkeyed_probes_.push_back(id);
+    }
+    probes_.insert(std::make_pair(id, std::move(probe)));
+    deadlines_.push(std::make_pair(clock_type::now() + timeout, id));
+    return id;
+}
+
+bool ProbeEngine::cancel(probe_id id) {
+    ProbeMap::iterator iter = probes_.find(id);
+    if (iter == probes_.end()) {
+        return false;
+    }
+    unindex(iter);
+    probes_.erase(iter);
+    return true;
+}
+
+size_t ProbeEngine::poll(duration_type max_wait) {
+    open_socket();
+    const size_t completed_before = completed_;
+    time_point now = clock_type::now();
+    expire(now);
+    duration_type wait = max_wait;
+    if (!deadlines_.empty()) {
+        // Round up so that we don't wake up right before the deadline
+        const duration_type until_deadline = duration_cast<duration_type>(
+            deadlines_.top().first - now + duration_type(1) - clock_type::duration(1)
+        );
+        wait = min(wait, until_deadline);
+    }
+    epoll_event event;
+    const int timeout_ms = static_cast<int>(std::max<duration_type::rep>(wait.count(), 0));
+    if (epoll_wait(epoll_fd_, &event, 1, timeout_ms) > 0) {
+        read_responses();
+    }
+    expire(clock_type::now());
+    return completed_ - completed_before;
+}
+
+void ProbeEngine::run() {
+    while (!probes_.empty()) {
+        poll(duration_type(1000));
+    }
+}
+
+bool ProbeEngine::process_packet(const uint8_t* buffer, uint32_t total_sz,
+                                 uint16_t ether_type) {
+    if (probes_.empty()) {
+        return false;
+    }
+    ResponseKey key;
+    bool is_error = false;
+    uint16_t ip_id = 0;
+    if (make_response_key(buffer, total_sz, ether_type, key, is_error, ip_id)) {
+        typedef ProbeIndex::iterator index_iterator;
+        std::pair<index_iterator, index_iterator> range = index_.equal_range(key);
+        for (index_iterator it = range.first; it != range.second; ++it) {
+            ProbeMap::iterator iter = probes_.find(it->second);
+            const Probe& probe = iter->second;
+            bool matches = false;
+            if (is_error) {
+                // The error carries the probe's header, so the IP identifier 
+                // must match. PDU::matches_response doesn't handle errors
+                matches = probe.ip_id == ip_id;
+            }
+            else {
+                // The key only narrows down the candidates
+                matches = probe.network_pdu->matches_response(buffer, total_sz);
+            }
+            if (matches) {
+                complete(iter, buffer, total_sz, ether_type);
+                return true;
+            }
+        }
+    }
+    // Probes which can't be keyed are checked one by one
+    for (size_t i = 0; i < unkeyed_probes_.size(); ++i) {
+        ProbeMap::iterator iter = probes_.find(unkeyed_probes_[i]);
+        if (iter->second.network_pdu->matches_response(buffer, total_sz)) {
+            complete(iter, buffer, total_sz, ether_type);
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t ProbeEngine::expire(time_point now) {
+    size_t expired = 0;
+    while (!deadlines_.empty() && deadlines_.top().first <= now) {
+        const probe_id id = deadlines_.top().second;
+        deadlines_.pop();
+        ProbeMap::iterator iter = probes_.find(id);
+        // Completed probes are left in the heap until their deadline
+        if (iter == probes_.end()) {
+            continue;
+        }
+        unindex(iter);
+        Probe probe = std::move(iter->second);
+        probes_.erase(iter);
+        ++completed_;
+        ++expired;
+        probe.callback(id, *probe.pdu, 0);
+    }
+    return expired;
+}
+
+size_t ProbeEngine::outstanding_probes() const {
+    return probes_.size();
+}
+
+int ProbeEngine::file_descriptor() {
+    open_socket();
+    return epoll_fd_;
+}
+
+void ProbeEngine::open_socket() {
+    if (socket_ != -1) {
+        return;
+    }
+    // Datagram packet sockets strip the link layer header, so responses
+    // always start at the network layer
+    int sock = ::socket(PF_PACKET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, htons(ETH_P_ALL));
+    if (sock == -1) {
+        throw socket_open_error(strerror(errno));
+    }
+    if (iface_) {
+        sockaddr_ll address;
+        memset(&address, 0, sizeof(address));
+        address.sll_family = AF_PACKET;
+        address.sll_protocol = htons(ETH_P_ALL);
+        address.sll_ifindex = iface_.id();
+        if (bind(sock, (const sockaddr*)&address, sizeof(address)) != 0) {
+            const std::string error = strerror(errno);
+            ::close(sock);
+            throw socket_open_error(error);
+        }
+    }
+    // Make room for bursts of responses. Failing to do so is not fatal
+    const int buffer_size = 4 * 1024 * 1024;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+        const std::string error = strerror(errno);
+        ::close(sock);
+        throw socket_open_error(error);
+    }
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = sock;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sock, &event) != 0) {
+        const std::string error = strerror(errno);
+        ::close(epoll_fd);
+        ::close(sock);
+        throw socket_open_error(error);
+    }
+    socket_ = sock;
+    epoll_fd_ = epoll_fd;
+}
+
+void ProbeEngine::read_responses() {
+    for (size_t i = 0; i < MAX_READS_PER_POLL; ++i) {
+        sockaddr_ll address;
+        socklen_t address_length = sizeof(address);
+        const ssize_t size = recvfrom(socket_, &buffer_[0], buffer_.size(), 0,
+                                      (sockaddr*)&address, &address_length);
+        if (size < 0) {
+            break;
+        }
+        // Skip the probes we sent ourselves
+        if (address.sll_pkttype == PACKET_OUTGOING) {
+            continue;
+        }
+        process_packet(&buffer_[0], static_cast<uint32_t>(size), ntohs(address.sll_protocol));
+    }
+}
+
+void ProbeEngine::complete(ProbeMap::iterator iter, const uint8_t* buffer,
+                           uint32_t total_sz, uint16_t ether_type) {
+    unique_ptr<PDU> response;
+    try {
+        if (ether_type == ETHER_TYPE_IP) {
+            response.reset(new IP(buffer, total_sz));
+        }
+        else if (ether_type == ETHER_TYPE_IPV6) {
+            response.reset(new IPv6(buffer, total_sz));
+        }
+        else {
+            response.reset(new ARP(buffer, total_sz));
+        }
+    }
+    catch (malformed_packet&) {
+        // The probe is completed anyway, since its response did arrive
+    }
+    const probe_id id = iter->first;
+    unindex(iter);
+    Probe probe = std::move(iter->second);
+    probes_.erase(iter);
+    ++completed_;
+    probe.callback(id, *probe.pdu, response.get());
+}
+
+void ProbeEngine::unindex(ProbeMap::iterator iter) {
+    const probe_id id = iter->first;
+    if (iter->second.keyed) {
+        typedef ProbeIndex::iterator index_iterator;
+        std::pair<index_iterator, index_iterator> range = index_.equal_range(iter->second.key);
+        for (index_iterator it = range.first; it != range.second; ++it) {
+            if (it->second == id) {
+                index_.erase(it);
+                break;
+            }
+        }
+    }
+    else {
+        unkeyed_probes_.erase(std::find(unkeyed_probes_.begin(), unkeyed_probes_.end(), id));
+    }
+}
+
+bool ProbeEngine::make_request_key(const PDU& network_pdu, ResponseKey& key,
+                                   uint16_t& ip_id) {
+    key = ResponseKey();
+    const PDU* transport = network_pdu.inner_pdu();
+    if (network_pdu.pdu_type() == PDU::IP) {
+        const IP& ip = static_cast<const IP&>(network_pdu);
+        // Responses to broadcasts come from any address
+        if (ip.dst_addr().is_broadcast()) {
+            return false;
+        }
+        key.ether_type = ETHER_TYPE_IP;
+        key.protocol = ip.protocol();
+        copy_address(key.src_addr, ip.src_addr());
+        copy_address(key.dst_addr, ip.dst_addr());
+        ip_id = ip.id();
+        // Non first fragments don't contain the transport header
+        if (ip.fragment_offset() != 0) {
+            transport = 0;
+        }
+    }
+    else if (network_pdu.pdu_type() == PDU::IPv6) {
+        const IPv6& ipv6 = static_cast<const IPv6&>(network_pdu);
+        // Responses to link local multicast come from any address
+        if (ipv6.dst_addr().begin()[0] == 0xff && ipv6.dst_addr().begin()[1] == 0x02) {
+            return false;
+        }
+        key.ether_type = ETHER_TYPE_IPV6;
+        ipv6.src_addr().copy(key.src_addr);
+        ipv6.dst_addr().copy(key.dst_addr);
+        if (!transport) {
+            key.protocol = ipv6.next_header();
+        }
+        else if (transport->pdu_type() == PDU::TCP) {
+            key.protocol = PROTO_TCP;
+        }
+        else if (transport->pdu_type() == PDU::UDP) {
+            key.protocol = PROTO_UDP;
+        }
+        else if (transport->pdu_type() == PDU::ICMPv6) {
+            key.protocol = PROTO_ICMPV6;
+        }
+        else {
+            // Extension headers may be in the way of the protocol number
+            return false;
+        }
+    }
+    else {
+        const ARP& arp = static_cast<const ARP&>(network_pdu);
+        // Only IPv4 over Ethernet is supported
+        if (arp.prot_addr_format() != ETHER_TYPE_IP || arp.hw_addr_length() != 6 ||
+            arp.prot_addr_length() != 4) {
+            return false;
+        }
+        key.ether_type = ETHER_TYPE_ARP;
+        copy_address(key.src_addr, arp.sender_ip_addr());
+        copy_address(key.dst_addr, arp.target_ip_addr());
+        return true;
+    }
+    if (!transport) {
+        return true;
+    }
+    if (transport->pdu_type() == PDU::TCP) {
+        const TCP& tcp = static_cast<const TCP&>(*transport);
+        key.first_id = tcp.sport();
+        key.second_id = tcp.dport();
+    }
+    else if (transport->pdu_type() == PDU::UDP) {
+        const UDP& udp = static_cast<const UDP&>(*transport);
+        key.first_id = udp.sport();
+        key.second_id = udp.dport();
+    }
+    else if (transport->pdu_type() == PDU::ICMP) {
+        const ICMP& icmp = static_cast<const ICMP&>(*transport);
+        key.first_id = icmp.id();
+        key.second_id = icmp.sequence();
+    }
+    else if (transport->pdu_type() == PDU::ICMPv6) {
+        const ICMPv6& icmp = static_cast<const ICMPv6&>(*transport);
+        // Neighbour discovery replies come from an address we don't know
+        if (icmp.type() == ICMPv6::ROUTER_SOLICIT || icmp.type() == ICMPv6::NEIGHBOUR_SOLICIT) {
+            return false;
+        }
+        key.first_id = icmp.identifier();
+        key.second_id = icmp.sequence();
+    }
+    return true;
+}
+
+bool ProbeEngine::make_embedded_key(const uint8_t* buffer, uint32_t total_sz,
+                                    uint16_t ether_type, ResponseKey& key,
+                                    uint16_t& ip_id) {
+    key = ResponseKey();
+    key.ether_type = ether_type;
+    const uint8_t* transport = 0;
+    uint32_t transport_sz = 0;
+    if (ether_type == ETHER_TYPE_IP) {
+        if (total_sz < 20 || (buffer[0] >> 4) != 4) {
+            return false;
+        }
+        const uint32_t header_size = (buffer[0] & 0x0f) * 4;
+        if (header_size < 20 || header_size > total_sz) {
+            return false;
+        }
+        key.protocol = buffer[9];
+        memcpy(key.src_addr, buffer + 12, 4);
+        memcpy(key.dst_addr, buffer + 16, 4);
+        ip_id = read_u16(buffer + 4);
+        // Responses to broadcasts come from any address
+        if (memcmp(key.dst_addr, "\xff\xff\xff\xff", 4) == 0) {
+            return false;
+        }
+        // Non first fragments don't contain the transport header
+        if ((read_u16(buffer + 6) & 0x1fff) == 0) {
+            transport = buffer + header_size;
+            transport_sz = total_sz - header_size;
+        }
+    }
+    else if (ether_type == ETHER_TYPE_IPV6) {
+        if (total_sz < 40 || (buffer[0] >> 4) != 6) {
+            return false;
+        }
+        memcpy(key.src_addr, buffer + 8, 16);
+        memcpy(key.dst_addr, buffer + 24, 16);
+        // Responses to link local multicast come from any address
+        if (key.dst_addr[0] == 0xff && key.dst_addr[1] == 0x02) {
+            return false;
+        }
+        uint8_t next_header = buffer[6];
+        transport = buffer + 40;
+        transport_sz = total_sz - 40;
+        if (!skip_ipv6_extensions(transport, transport_sz, next_header)) {
+            return false;
+        }
+        key.protocol = next_header;
+    }
+    else if (ether_type == ETHER_TYPE_ARP) {
+        // Only IPv4 over Ethernet is supported
+        if (total_sz < 28 || read_u16(buffer + 2) != ETHER_TYPE_IP ||
+            buffer[4] != 6 || buffer[5] != 4) {
+            return false;
+        }
+        memcpy(key.src_addr, buffer + 14, 4);
+        memcpy(key.dst_addr, buffer + 24, 4);
+        return true;
+    }
+    else {
+        return false;
+    }
+    if (!transport) {
+        return true;
+    }
+    if ((key.protocol == PROTO_TCP || key.protocol == PROTO_UDP) && transport_sz >= 4) {
+        key.first_id = read_u16(transport);
+        key.second_id = read_u16(transport + 2);
+    }
+    else if ((key.protocol == PROTO_ICMP || key.protocol == PROTO_ICMPV6) && transport_sz >= 8) {
+        // Neighbour discovery replies come from an address we don't know
+        if (key.protocol == PROTO_ICMPV6 && (transport[0] == ICMPV6_ROUTER_SOLICIT ||
+                                             transport[0] == ICMPV6_NEIGHBOUR_SOLICIT)) {
+            return false;
+        }
+        key.first_id = read_u16(transport + 4);
+        key.second_id = read_u16(transport + 6);
+    }
+    return true;
+}
+
+bool ProbeEngine::make_response_key(const uint8_t* buffer, uint32_t total_sz,
+                                    uint16_t ether_type, ResponseKey& key,
+                                    bool& is_error, uint16_t& ip_id) {
+    is_error = false;
+    ip_id = 0;
+    key = ResponseKey();
+    key.ether_type = ether_type;
+    const uint8_t* transport = 0;
+    uint32_t transport_sz = 0;
+    if (ether_type == ETHER_TYPE_IP) {
+        if (total_sz < 20 || (buffer[0] >> 4) != 4) {
+            return false;
+        }
+        const uint32_t header_size = (buffer[0] & 0x0f) * 4;
+        if (header_size < 20 || header_size > total_sz ||
+            (read_u16(buffer + 6) & 0x1fff) != 0) {
+            return false;
+        }
+        key.protocol = buffer[9];
+        memcpy(key.src_addr, buffer + 16, 4);
+        memcpy(key.dst_addr, buffer + 12, 4);
+        transport = buffer + header_size;
+        transport_sz = total_sz - header_size;
+        if (key.protocol == PROTO_ICMP && transport_sz >= ICMP_HEADER_SIZE) {
+            if (is_icmp_error(transport[0])) {
+                is_error = true;
+                return make_embedded_key(transport + ICMP_HEADER_SIZE,
+                                         transport_sz - ICMP_HEADER_SIZE,
+                                         ETHER_TYPE_IP, key, ip_id);
+            }
+            else if (!is_icmp_reply(transport[0])) {
+                return false;
+            }
+        }
+    }
+    else if (ether_type == ETHER_TYPE_IPV6) {
+        if (total_sz < 40 || (buffer[0] >> 4) != 6) {
+            return false;
+        }
+        memcpy(key.src_addr, buffer + 24, 16);
+        memcpy(key.dst_addr, buffer + 8, 16);
+        uint8_t next_header = buffer[6];
+        transport = buffer + 40;
+        transport_sz = total_sz - 40;
+        if (!skip_ipv6_extensions(transport, transport_sz, next_header)) {
+            return false;
+        }
+        key.protocol = next_header;
+        if (key.protocol == PROTO_ICMPV6 && transport_sz >= ICMP_HEADER_SIZE) {
+            if (is_icmpv6_error(transport[0])) {
+                is_error = true;
+                return make_embedded_key(transport + ICMP_HEADER_SIZE,
+                                         transport_sz - ICMP_HEADER_SIZE,
+                                         ETHER_TYPE_IPV6, key, ip_id);
+            }
+            else if (transport[0] != ICMPV6_ECHO_REPLY) {
+                return false;
+            }
+        }
+    }
+    else if (ether_type == ETHER_TYPE_ARP) {
+        if (total_sz < 28 || read_u16(buffer + 2) != ETHER_TYPE_IP ||
+            buffer[4] != 6 || buffer[5] != 4) {
+            return false;
+        }
+        memcpy(key.src_addr, buffer + 24, 4);
+        memcpy(key.dst_addr, buffer + 14, 4);
+        return true;
+    }
+    else {
+        return false;
+    }
+    if ((key.protocol == PROTO_TCP || key.protocol == PROTO_UDP) && transport_sz >= 4) {
+        key.first_id = read_u16(transport + 2);
+        key.second_id = read_u16(transport);
+    }
+    else if ((key.protocol == PROTO_ICMP || key.protocol == PROTO_ICMPV6) && transport_sz >= 8) {
+        key.first_id = read_u16(transport + 4);
+        key.second_id = read_u16(transport + 6);
+    }
+    return true;
+}
+
+} // Tins
+
+#endif // TINS_HAVE_EPOLL && TINS_IS_CXX11
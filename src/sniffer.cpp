@@ -48,11 +48,12 @@
 #include <tins/detail/pdu_helpers.h>
 
 using std::string;
+using std::vector;
 
 namespace Tins {
 
 BaseSniffer::BaseSniffer() 
-: handle_(0), mask_(0), extract_raw_(false) {
+: handle_(0), mask_(0), extract_raw_(false), retain_raw_frames_(false) {
     
 }
     
@@ -85,11 +86,21 @@ bpf_u_int32 BaseSniffer::get_if_mask() const {
 struct sniff_data {
     struct timeval tv;
     PDU* pdu;
+    Internals::SharedFrame* raw_frame;
     bool packet_processed;
 
-sniff_data() : tv(), pdu(0), packet_processed(true) { }
+sniff_data() : tv(), pdu(0), raw_frame(0), packet_processed(true) { }
 };
 
+void store_packet_info(sniff_data* data, const struct pcap_pkthdr* h, const u_char* bytes) {
+    data->packet_processed = true;
+    data->tv = h->ts;
+    // The bytes are only valid during the callback, so they're copied
+    if (data->raw_frame) {
+        *data->raw_frame = Internals::SharedFrame(bytes, h->caplen, h->len);
+    }
+}
+
 template<typename T>
 T* safe_alloc(const u_char* bytes, bpf_u_int32 len) {
     try {
@@ -103,15 +114,13 @@ T* safe_alloc(const u_char* bytes, bpf_u_int32 len) {
 template<typename T>
 void sniff_loop_handler(u_char* user, const struct pcap_pkthdr* h, const u_char* bytes) {
     sniff_data* data = (sniff_data*)user;
-    data->packet_processed = true;
-    data->tv = h->ts;
+    store_packet_info(data, h, bytes);
     data->pdu = safe_alloc<T>(bytes, h->caplen);
 }
 
 void sniff_loop_eth_handler(u_char* user, const struct pcap_pkthdr* h, const u_char* bytes) {
     sniff_data* data = (sniff_data*)user;
-    data->packet_processed = true;
-    data->tv = h->ts;
+    store_packet_info(data, h, bytes);
     if (Internals::is_dot3((const uint8_t*)bytes, h->caplen)) {
         data->pdu = safe_alloc<Dot3>((const uint8_t*)bytes, h->caplen);
     }
@@ -134,8 +143,7 @@ void sniff_loop_raw_handler(u_char* user, const struct pcap_pkthdr* h, const u_c
 
     sniff_data* data = (sniff_data*)user;
     const base_ip_header* header = (const base_ip_header*)bytes;
-    data->packet_processed = true;
-    data->tv = h->ts;
+    store_packet_info(data, h, bytes);
     switch (header->version) {
         case 4:
             data->pdu = safe_alloc<IP>((const uint8_t*)bytes, h->caplen);
@@ -149,8 +157,7 @@ void sniff_loop_raw_handler(u_char* user, const struct pcap_pkthdr* h, const u_c
 #ifdef TINS_HAVE_DOT11
 void sniff_loop_dot11_handler(u_char* user, const struct pcap_pkthdr* h, const u_char* bytes) {
     sniff_data* data = (sniff_data*)user;
-    data->packet_processed = true;
-    data->tv = h->ts;
+    store_packet_info(data, h, bytes);
     try {
         data->pdu = Dot11::from_bytes(bytes, h->caplen);
     }
@@ -162,6 +169,9 @@ void sniff_loop_dot11_handler(u_char* user, const struct pcap_pkthdr* h, const u
 
 PtrPacket BaseSniffer::next_packet() {
     sniff_data data;
+    if (retain_raw_frames_) {
+        data.raw_frame = &raw_frame_;
+    }
     const int iface_type = pcap_datalink(handle_);
     pcap_handler handler = 0;
     if (extract_raw_) {
@@ -216,13 +226,20 @@ PtrPacket BaseSniffer::next_packet() {
             return PtrPacket(0, Timestamp());
         }
     }
-    return PtrPacket(data.pdu, data.tv);
+    return PtrPacket(data.pdu, data.tv, data.raw_frame);
 }
 
 void BaseSniffer::set_extract_raw_pdus(bool value) {
     extract_raw_ = value;
 }
 
+void BaseSniffer::set_retain_raw_frames(bool value) {
+    retain_raw_frames_ = value;
+    if (!value) {
+        raw_frame_.clear();
+    }
+}
+
 void BaseSniffer::set_pcap_sniffing_method(PcapSniffingMethod method) {
     if (method == 0) {
         throw std::runtime_error("Sniffing method cannot be null");
@@ -459,7 +476,7 @@ SnifferConfiguration::SnifferConfiguration()
 : flags_(0), snap_len_(DEFAULT_SNAP_LEN), buffer_size_(0),
   pcap_sniffing_method_(pcap_loop), timeout_(DEFAULT_TIMEOUT), promisc_(false),
   rfmon_(false), immediate_mode_(false), direction_(PCAP_D_INOUT),
-  timestamp_precision_(0) {
+  timestamp_precision_(0), retain_raw_frames_(false) {
 
 }
 
@@ -482,6 +499,9 @@ void SnifferConfiguration::configure_sniffer_pre_activation(Sniffer& sniffer) co
     if ((flags_ & TIMESTAMP_PRECISION) != 0) {
         sniffer.set_timestamp_precision(timestamp_precision_);
     }
+    if ((flags_ & RETAIN_RAW_FRAMES) != 0) {
+        sniffer.set_retain_raw_frames(retain_raw_frames_);
+    }
 }
 
 void SnifferConfiguration::configure_sniffer_pre_activation(FileSniffer& sniffer) const {
@@ -491,6 +511,9 @@ void SnifferConfiguration::configure_sniffer_pre_activation(FileSniffer& sniffer
         }
     }
     sniffer.set_pcap_sniffing_method(pcap_sniffing_method_);
+    if ((flags_ & RETAIN_RAW_FRAMES) != 0) {
+        sniffer.set_retain_raw_frames(retain_raw_frames_);
+    }
 }
 
 void SnifferConfiguration::configure_sniffer_post_activation(Sniffer& sniffer) const {
@@ -552,6 +575,11 @@ void SnifferConfiguration::set_timestamp_precision(int value) {
     timestamp_precision_ = value;
 }
 
+void SnifferConfiguration::set_retain_raw_frames(bool enabled) {
+    flags_ |= RETAIN_RAW_FRAMES;
+    retain_raw_frames_ = enabled;
+}
+
 void SnifferConfiguration::set_direction(pcap_direction_t direction) {
     direction_ =  direction;
     flags_ |= DIRECTION;
@@ -38,32 +38,11 @@
 using std::vector;
 using std::numeric_limits;
 
-using boost::icl::interval_bounds;
-using boost::icl::contains;
-
 using Tins::Internals::seq_compare;
 
 namespace Tins {
 namespace TCPIP {
 
-uint32_t interval_start(const AckedRange::interval_type& interval) {
-    if (interval.bounds() == interval_bounds::left_open()) {
-        return interval.lower() + 1;
-    }
-    else {
-        return interval.lower();
-    }
-}
-
-uint32_t interval_end(const AckedRange::interval_type& interval) {
-    if (interval.bounds() == interval_bounds::right_open()) {
-        return interval.upper() - 1;
-    }
-    else {
-        return interval.upper();
-    }
-}
-
 // AckedRange
 
 AckedRange::AckedRange(uint32_t first, uint32_t last) 
@@ -115,7 +94,7 @@ void AckTracker::process_packet(const PDU& packet) {
         return;
     }
     if (seq_compare(tcp->ack_seq(), ack_number_) > 0) {
-        cleanup_sacked_intervals(ack_number_, tcp->ack_seq());
+        cleanup_sacked_intervals(tcp->ack_seq());
         ack_number_ = tcp->ack_seq();
     }
     if (use_sack_) {
@@ -129,35 +108,29 @@ void AckTracker::process_packet(const PDU& packet) {
 
 void AckTracker::process_sack(const vector<uint32_t>& sack) {
     for (size_t i = 1; i < sack.size(); i += 2) {
-        // Left edge must be lower than right edge
-        if (seq_compare(sack[i - 1], sack[i]) < 0) {
-            AckedRange range(sack[i - 1], sack[i] - 1);
-            // If this range ends after our current ack number
-            if (seq_compare(range.last(), ack_number_) > 0) {
-                while (range.has_next()) {
-                    AckedRange::interval_type next = range.next();
-                    uint32_t start = interval_start(next);
-                    if (seq_compare(start, ack_number_) <= 0) {
-                        // If this interval starts before or at our ACK number
-                        // then we need to update our ACK number to the end of 
-                        // this interval
-                        ack_number_ = interval_end(next);
-                    }
-                    else {
-                        // Otherwise, push the interval into the ACK set
-                        acked_intervals_.insert(next);
-                    }
-                }
-            }
+        const uint32_t first = sack[i - 1];
+        const uint32_t last = sack[i] - 1;
+        // Left edge must be lower than right edge and the range must end 
+        // after our current ack number
+        if (seq_compare(first, sack[i]) >= 0 || seq_compare(last, ack_number_) <= 0) {
+            continue;
+        }
+        if (seq_compare(first, ack_number_) <= 0) {
+            // If this interval starts before or at our ACK number
+            // then we need to update our ACK number to the end of 
+            // this interval
+            cleanup_sacked_intervals(last);
+            ack_number_ = last;
+        }
+        else {
+            // Otherwise, push the interval into the ACK set
+            acked_intervals_.insert(first, last);
         }
     }
 }
 
-void AckTracker::cleanup_sacked_intervals(uint32_t old_ack, uint32_t new_ack) {
-    AckedRange range(old_ack, new_ack);
-    while (range.has_next()) {
-        acked_intervals_.erase(range.next());
-    }
+void AckTracker::cleanup_sacked_intervals(uint32_t new_ack) {
+    acked_intervals_.erase_until(new_ack);
 }
 
 void AckTracker::use_sack() {
@@ -176,16 +149,16 @@ bool AckTracker::is_segment_acked(uint32_t sequence_number, uint32_t length) con
     if (length == 0) {
         return true;
     }
-    AckedRange range(sequence_number, sequence_number + length - 1);
-    while (range.has_next()) {
-        AckedRange::interval_type interval = range.next();
-        const int comparison = seq_compare(interval_end(interval), ack_number_);
-        // Only check for SACKed intervals if the segment finishes after our ACK number
-        if (comparison >= 0 && !contains(acked_intervals_, interval)) {
-            return false;
-        }
+    const uint32_t last = sequence_number + length - 1;
+    // Everything before our ACK number has been acknowledged
+    if (seq_compare(last, ack_number_) < 0) {
+        return true;
+    }
+    // Otherwise, the rest of the segment must have been SACKed
+    if (seq_compare(sequence_number, ack_number_) < 0) {
+        sequence_number = ack_number_;
     }
-    return true;
+    return acked_intervals_.contains(sequence_number, last);
 }
 
 } // TCPIP
@@ -72,6 +72,37 @@ Flow::Flow(const IPv6Address& dest_address, uint16_t dest_port,
     initialize();
 }
 
+Flow::Flow(const Flow& other)
+: data_tracker_(other.data_tracker_), dest_address_(other.dest_address_),
+  dest_port_(other.dest_port_), on_data_callback_(other.on_data_callback_),
+  on_out_of_order_callback_(other.on_out_of_order_callback_), state_(other.state_),
+  mss_(other.mss_), flags_(other.flags_),
+  metrics_(other.metrics_ ? new FlowMetrics(*other.metrics_) : 0)
+  #ifdef TINS_HAVE_ACK_TRACKER
+  , ack_tracker_(other.ack_tracker_)
+  #endif // TINS_HAVE_ACK_TRACKER
+{
+
+}
+
+Flow& Flow::operator=(const Flow& other) {
+    if (this != &other) {
+        data_tracker_ = other.data_tracker_;
+        dest_address_ = other.dest_address_;
+        dest_port_ = other.dest_port_;
+        on_data_callback_ = other.on_data_callback_;
+        on_out_of_order_callback_ = other.on_out_of_order_callback_;
+        state_ = other.state_;
+        mss_ = other.mss_;
+        flags_ = other.flags_;
+        metrics_.reset(other.metrics_ ? new FlowMetrics(*other.metrics_) : 0);
+        #ifdef TINS_HAVE_ACK_TRACKER
+        ack_tracker_ = other.ack_tracker_;
+        #endif // TINS_HAVE_ACK_TRACKER
+    }
+    return *this;
+}
+
 void Flow::initialize() {
     state_ = UNKNOWN;
     mss_ = -1;
@@ -86,10 +117,24 @@ void Flow::out_of_order_callback(const flow_packet_callback_type& callback) {
 }
 
 void Flow::process_packet(PDU& pdu) {
+    process_packet(pdu, 0);
+}
+
+void Flow::process_packet(PDU& pdu, const timestamp_type& ts) {
+    process_packet(pdu, &ts);
+}
+
+void Flow::process_packet(PDU& pdu, const timestamp_type* ts) {
     TCP* tcp = pdu.find_pdu<TCP>();
     RawPDU* raw = pdu.find_pdu<RawPDU>(); 
     // Update the internal state first
     if (tcp) {
+        // Metrics can only be updated if we know when this packet was seen
+        if (metrics_ && ts) {
+            // This needs to see the data tracker before it processes the payload
+            const DataTracker* tracker = flags_.ignore_data_packets ? 0 : &data_tracker_;
+            metrics_->process_segment(*tcp, raw ? raw->payload_size() : 0, tracker, *ts);
+        }
         update_state(*tcp);
         #ifdef TINS_HAVE_ACK_TRACKER
         if (flags_.ack_tracking) {
@@ -122,6 +167,16 @@ void Flow::process_packet(PDU& pdu) {
     }
 }
 
+void Flow::process_peer_packet(const PDU& pdu, const timestamp_type& ts) {
+    if (!metrics_) {
+        return;
+    }
+    const TCP* tcp = pdu.find_pdu<TCP>();
+    if (tcp) {
+        metrics_->process_ack(*tcp, ts);
+    }
+}
+
 void Flow::advance_sequence(uint32_t seq) {
     data_tracker_.advance_sequence(seq);
 }
@@ -249,6 +304,21 @@ bool Flow::ack_tracking_enabled() const {
     return flags_.ack_tracking;
 }
 
+void Flow::enable_metrics() {
+    if (!metrics_) {
+        metrics_.reset(new FlowMetrics());
+    }
+}
+
+bool Flow::metrics_enabled() const {
+    return metrics_ != 0;
+}
+
+const FlowMetrics& Flow::metrics() const {
+    static const FlowMetrics empty_metrics;
+    return metrics_ ? *metrics_ : empty_metrics;
+}
+
 #ifdef TINS_HAVE_ACK_TRACKER
 const AckTracker& Flow::ack_tracker() const {
     return ack_tracker_;
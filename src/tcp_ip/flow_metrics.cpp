@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/tcp_ip/flow_metrics.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <tins/tcp.h>
+#include <tins/tcp_ip/data_tracker.h>
+#include <tins/detail/sequence_number_helpers.h>
+
+using Tins::Internals::seq_compare;
+
+namespace Tins {
+namespace TCPIP {
+
+FlowMetrics::FlowMetrics()
+: syn_time_(0), handshake_rtt_(0), timed_segment_time_(0), last_rtt_(0), min_rtt_(0),
+  max_rtt_(0), smoothed_rtt_(0), syn_seq_(0), next_seq_(0), ack_number_(0),
+  timed_segment_end_(0), rtt_samples_(0), retransmitted_segments_(0),
+  out_of_order_segments_(0), zero_window_events_(0), bytes_in_flight_(0),
+  max_bytes_in_flight_(0) {
+
+}
+
+void FlowMetrics::process_segment(const TCP& tcp, uint32_t payload_size,
+                                  const DataTracker* tracker, const timestamp_type& ts) {
+    const uint32_t seq = tcp.seq();
+    const bool is_syn = tcp.has_flags(TCP::SYN);
+    if (is_syn) {
+        // A SYN using the same sequence number is a retransmission
+        if (flags_.syn_seen && seq == syn_seq_) {
+            ++retransmitted_segments_;
+        }
+        flags_.syn_seen = 1;
+        syn_seq_ = seq;
+        syn_time_ = ts;
+    }
+    if (!tcp.has_flags(TCP::RST)) {
+        if (tcp.window() == 0) {
+            if (!flags_.zero_window) {
+                ++zero_window_events_;
+                flags_.zero_window = 1;
+            }
+        }
+        else {
+            flags_.zero_window = 0;
+        }
+    }
+    // SYN and FIN consume one sequence number each
+    uint32_t segment_end = seq + payload_size;
+    if (is_syn) {
+        ++segment_end;
+    }
+    if (tcp.has_flags(TCP::FIN)) {
+        ++segment_end;
+    }
+    const bool is_new_data = !flags_.next_seq_known || seq_compare(segment_end, next_seq_) > 0;
+    if (payload_size > 0) {
+        if (tracker) {
+            classify_segment(seq, payload_size, *tracker);
+        }
+        if (is_new_data) {
+            // Start timing this segment unless we're already timing one
+            if (!flags_.timing) {
+                flags_.timing = 1;
+                timed_segment_end_ = segment_end;
+                timed_segment_time_ = ts;
+            }
+        }
+        else if (flags_.timing && seq_compare(seq, timed_segment_end_) < 0) {
+            // Karn's algorithm: the timed data was retransmitted, so whatever
+            // ACK comes next is ambiguous
+            flags_.timing = 0;
+        }
+    }
+    if (is_new_data) {
+        next_seq_ = segment_end;
+        flags_.next_seq_known = 1;
+    }
+    update_bytes_in_flight();
+}
+
+void FlowMetrics::process_ack(const TCP& tcp, const timestamp_type& ts) {
+    if (!tcp.has_flags(TCP::ACK)) {
+        return;
+    }
+    const uint32_t ack = tcp.ack_seq();
+    if (flags_.syn_seen && !flags_.handshake_done && ack == syn_seq_ + 1) {
+        handshake_rtt_ = ts - syn_time_;
+        flags_.handshake_done = 1;
+    }
+    if (!flags_.ack_known || seq_compare(ack, ack_number_) > 0) {
+        ack_number_ = ack;
+        flags_.ack_known = 1;
+    }
+    if (flags_.timing && seq_compare(ack, timed_segment_end_) >= 0) {
+        const timestamp_type sample = ts - timed_segment_time_;
+        if (rtt_samples_ == 0) {
+            min_rtt_ = max_rtt_ = smoothed_rtt_ = sample;
+        }
+        else {
+            if (sample < min_rtt_) {
+                min_rtt_ = sample;
+            }
+            if (sample > max_rtt_) {
+                max_rtt_ = sample;
+            }
+            // SRTT = 7/8 * SRTT + 1/8 * R'
+            smoothed_rtt_ = (smoothed_rtt_ * 7 + sample) / 8;
+        }
+        last_rtt_ = sample;
+        ++rtt_samples_;
+        flags_.timing = 0;
+    }
+    update_bytes_in_flight();
+}
+
+void FlowMetrics::classify_segment(uint32_t seq, uint32_t payload_size,
+                                   const DataTracker& tracker) {
+    const uint32_t current_seq = tracker.sequence_number();
+    // All of this data was already seen
+    if (seq_compare(seq + payload_size, current_seq) <= 0) {
+        ++retransmitted_segments_;
+    }
+    else if (seq_compare(seq, current_seq) > 0) {
+        // If there's already a buffered chunk starting here, this is a retransmission
+        if (tracker.buffered_payload().count(seq)) {
+            ++retransmitted_segments_;
+        }
+        else {
+            ++out_of_order_segments_;
+        }
+    }
+}
+
+void FlowMetrics::update_bytes_in_flight() {
+    if (flags_.next_seq_known && flags_.ack_known && 
+        seq_compare(next_seq_, ack_number_) > 0) {
+        bytes_in_flight_ = next_seq_ - ack_number_;
+        if (bytes_in_flight_ > max_bytes_in_flight_) {
+            max_bytes_in_flight_ = bytes_in_flight_;
+        }
+    }
+    else {
+        bytes_in_flight_ = 0;
+    }
+}
+
+bool FlowMetrics::has_handshake_rtt() const {
+    return flags_.handshake_done;
+}
+
+const FlowMetrics::timestamp_type& FlowMetrics::handshake_rtt() const {
+    return handshake_rtt_;
+}
+
+uint32_t FlowMetrics::rtt_samples() const {
+    return rtt_samples_;
+}
+
+const FlowMetrics::timestamp_type& FlowMetrics::last_rtt() const {
+    return last_rtt_;
+}
+
+const FlowMetrics::timestamp_type& FlowMetrics::min_rtt() const {
+    return min_rtt_;
+}
+
+const FlowMetrics::timestamp_type& FlowMetrics::max_rtt() const {
+    return max_rtt_;
+}
+
+const FlowMetrics::timestamp_type& FlowMetrics::smoothed_rtt() const {
+    return smoothed_rtt_;
+}
+
+uint32_t FlowMetrics::retransmitted_segments() const {
+    return retransmitted_segments_;
+}
+
+uint32_t FlowMetrics::out_of_order_segments() const {
+    return out_of_order_segments_;
+}
+
+uint32_t FlowMetrics::zero_window_events() const {
+    return zero_window_events_;
+}
+
+uint32_t FlowMetrics::bytes_in_flight() const {
+    return bytes_in_flight_;
+}
+
+uint32_t FlowMetrics::max_bytes_in_flight() const {
+    return max_bytes_in_flight_;
+}
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
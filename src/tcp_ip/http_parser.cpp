@@ -0,0 +1,537 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/tcp_ip/http_parser.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <cstring>
+#include <limits>
+
+using std::numeric_limits;
+
+namespace Tins {
+namespace TCPIP {
+
+namespace {
+
+char to_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+bool is_whitespace(char c) {
+    return c == ' ' || c == '\t';
+}
+
+bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+int hex_value(char c) {
+    if (is_digit(c)) {
+        return c - '0';
+    }
+    c = to_lower(c);
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+HTTPParser::Slice trim(const char* data, size_t size) {
+    while (size > 0 && is_whitespace(*data)) {
+        ++data;
+        --size;
+    }
+    while (size > 0 && is_whitespace(data[size - 1])) {
+        --size;
+    }
+    return HTTPParser::Slice(data, size);
+}
+
+// Parses "HTTP/x.y"
+bool parse_version(const char* data, size_t size, uint8_t& major, uint8_t& minor) {
+    if (size != 8 || memcmp(data, "HTTP/", 5) != 0 || !is_digit(data[5]) ||
+        data[6] != '.' || !is_digit(data[7])) {
+        return false;
+    }
+    major = data[5] - '0';
+    minor = data[7] - '0';
+    return true;
+}
+
+bool ends_with_chunked(const HTTPParser::Slice& value) {
+    static const char chunked[] = "chunked";
+    const size_t chunked_size = sizeof(chunked) - 1;
+    if (value.size < chunked_size) {
+        return false;
+    }
+    HTTPParser::Slice suffix(value.data + value.size - chunked_size, chunked_size);
+    if (!suffix.iequals(chunked)) {
+        return false;
+    }
+    // Make sure this is a whole coding and not a suffix of another one
+    if (value.size > chunked_size) {
+        const char previous = value.data[value.size - chunked_size - 1];
+        return previous == ',' || is_whitespace(previous);
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+const size_t HTTPParser::DEFAULT_MAX_LINE_SIZE = 8192;
+
+bool HTTPParser::Slice::iequals(const char* str) const {
+    for (size_t i = 0; i < size; ++i) {
+        if (str[i] == 0 || to_lower(data[i]) != to_lower(str[i])) {
+            return false;
+        }
+    }
+    return str[size] == 0;
+}
+
+HTTPParser::HTTPParser(Type type)
+: response_parser_(0), max_line_size_(DEFAULT_MAX_LINE_SIZE), type_(type) {
+    reset();
+}
+
+void HTTPParser::reset() {
+    remaining_ = 0;
+    content_length_ = 0;
+    messages_parsed_ = 0;
+    pending_head_requests_ = 0;
+    pending_connect_requests_ = 0;
+    pending_requests_ = 0;
+    status_code_ = 0;
+    state_ = START_LINE;
+    request_kind_ = REGULAR_REQUEST;
+    has_content_length_ = false;
+    is_chunked_ = false;
+    has_transfer_encoding_ = false;
+}
+
+size_t HTTPParser::parse(const uint8_t* data, size_t size) {
+    const char* begin = reinterpret_cast<const char*>(data);
+    const char* ptr = begin;
+    const char* end = begin + size;
+    while (ptr != end) {
+        switch (state_) {
+            case BODY:
+            case CHUNK_DATA:
+                {
+                    const size_t available = end - ptr;
+                    const size_t chunk_size = remaining_ < available ? 
+                                              static_cast<size_t>(remaining_) : 
+                                              available;
+                    on_body_data(ptr, chunk_size);
+                    ptr += chunk_size;
+                    remaining_ -= chunk_size;
+                    if (remaining_ == 0) {
+                        if (state_ == BODY) {
+                            on_message_complete();
+                        }
+                        else {
+                            state_ = CHUNK_END;
+                        }
+                    }
+                }
+                break;
+            case BODY_UNTIL_CLOSE:
+                on_body_data(ptr, end - ptr);
+                ptr = end;
+                break;
+            case UPGRADED:
+            case PARSE_ERROR:
+                return ptr - begin;
+            default:
+                {
+                    const char* line_end = static_cast<const char*>(
+                        memchr(ptr, '\n', end - ptr)
+                    );
+                    if (!line_end) {
+                        // Incomplete line. Leave it for the next call unless it's
+                        // already too long
+                        if (static_cast<size_t>(end - ptr) > max_line_size_) {
+                            state_ = PARSE_ERROR;
+                        }
+                        return ptr - begin;
+                    }
+                    size_t line_size = line_end - ptr;
+                    if (line_size > max_line_size_) {
+                        state_ = PARSE_ERROR;
+                        return ptr - begin;
+                    }
+                    if (line_size > 0 && ptr[line_size - 1] == '\r') {
+                        --line_size;
+                    }
+                    if (!process_line(ptr, line_size)) {
+                        state_ = PARSE_ERROR;
+                        return ptr - begin;
+                    }
+                    ptr = line_end + 1;
+                }
+                break;
+        }
+    }
+    return ptr - begin;
+}
+
+void HTTPParser::finish() {
+    if (state_ == BODY_UNTIL_CLOSE) {
+        on_message_complete();
+    }
+}
+
+void HTTPParser::link_response_parser(HTTPParser* parser) {
+    response_parser_ = parser;
+}
+
+void HTTPParser::max_line_size(size_t value) {
+    max_line_size_ = value;
+}
+
+size_t HTTPParser::max_line_size() const {
+    return max_line_size_;
+}
+
+HTTPParser::Type HTTPParser::type() const {
+    return type_;
+}
+
+bool HTTPParser::has_error() const {
+    return state_ == PARSE_ERROR;
+}
+
+bool HTTPParser::is_upgraded() const {
+    return state_ == UPGRADED;
+}
+
+bool HTTPParser::is_message_in_progress() const {
+    return state_ != START_LINE && state_ != UPGRADED && state_ != PARSE_ERROR;
+}
+
+uint64_t HTTPParser::messages_parsed() const {
+    return messages_parsed_;
+}
+
+void HTTPParser::request_line_callback(const request_line_callback_type& callback) {
+    request_line_callback_ = callback;
+}
+
+void HTTPParser::status_line_callback(const status_line_callback_type& callback) {
+    status_line_callback_ = callback;
+}
+
+void HTTPParser::header_callback(const header_callback_type& callback) {
+    header_callback_ = callback;
+}
+
+void HTTPParser::headers_complete_callback(const event_callback_type& callback) {
+    headers_complete_callback_ = callback;
+}
+
+void HTTPParser::body_callback(const body_callback_type& callback) {
+    body_callback_ = callback;
+}
+
+void HTTPParser::message_complete_callback(const event_callback_type& callback) {
+    message_complete_callback_ = callback;
+}
+
+bool HTTPParser::process_line(const char* data, size_t size) {
+    switch (state_) {
+        case START_LINE:
+            // Empty lines before a message are allowed
+            return size == 0 || process_start_line(data, size);
+        case HEADERS:
+            if (size == 0) {
+                return on_headers_complete();
+            }
+            return process_header(data, size);
+        case CHUNK_SIZE:
+            return process_chunk_size(data, size);
+        case CHUNK_END:
+            state_ = CHUNK_SIZE;
+            return size == 0;
+        case TRAILERS:
+            // Trailer fields are skipped
+            if (size == 0) {
+                on_message_complete();
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool HTTPParser::process_start_line(const char* data, size_t size) {
+    const char* end = data + size;
+    const char* first_space = static_cast<const char*>(memchr(data, ' ', size));
+    if (!first_space || first_space == data) {
+        return false;
+    }
+    has_content_length_ = false;
+    is_chunked_ = false;
+    has_transfer_encoding_ = false;
+    content_length_ = 0;
+    if (type_ == REQUEST) {
+        // method SP request-target SP HTTP-version
+        const char* target = first_space + 1;
+        const char* second_space = static_cast<const char*>(
+            memchr(target, ' ', end - target)
+        );
+        if (!second_space || second_space == target) {
+            return false;
+        }
+        RequestLine line;
+        line.method = Slice(data, first_space - data);
+        line.target = Slice(target, second_space - target);
+        if (!parse_version(second_space + 1, end - second_space - 1,
+                           line.version_major, line.version_minor)) {
+            return false;
+        }
+        if (line.method.iequals("HEAD")) {
+            request_kind_ = HEAD_REQUEST;
+        }
+        else if (line.method.iequals("CONNECT")) {
+            request_kind_ = CONNECT_REQUEST;
+        }
+        else {
+            request_kind_ = REGULAR_REQUEST;
+        }
+        if (response_parser_) {
+            response_parser_->push_request(request_kind_);
+        }
+        if (request_line_callback_) {
+            request_line_callback_(line);
+        }
+    }
+    else {
+        // HTTP-version SP status-code SP [ reason-phrase ]
+        StatusLine line;
+        if (!parse_version(data, first_space - data, line.version_major,
+                           line.version_minor)) {
+            return false;
+        }
+        const char* code = first_space + 1;
+        if (end - code < 3 || !is_digit(code[0]) || !is_digit(code[1]) ||
+            !is_digit(code[2])) {
+            return false;
+        }
+        line.status_code = (code[0] - '0') * 100 + (code[1] - '0') * 10 + (code[2] - '0');
+        if (end - code > 3) {
+            if (code[3] != ' ') {
+                return false;
+            }
+            line.reason = Slice(code + 4, end - code - 4);
+        }
+        status_code_ = line.status_code;
+        if (status_line_callback_) {
+            status_line_callback_(line);
+        }
+    }
+    state_ = HEADERS;
+    return true;
+}
+
+bool HTTPParser::process_header(const char* data, size_t size) {
+    // Obsolete line folding. The continuation is skipped
+    if (is_whitespace(data[0])) {
+        return true;
+    }
+    const char* colon = static_cast<const char*>(memchr(data, ':', size));
+    if (!colon || colon == data || is_whitespace(colon[-1])) {
+        return false;
+    }
+    const Slice name(data, colon - data);
+    const Slice value = trim(colon + 1, data + size - colon - 1);
+    if (name.iequals("Content-Length")) {
+        if (value.size == 0) {
+            return false;
+        }
+        uint64_t length = 0;
+        for (size_t i = 0; i < value.size; ++i) {
+            if (!is_digit(value.data[i]) || 
+                length > (numeric_limits<uint64_t>::max() - 9) / 10) {
+                return false;
+            }
+            length = length * 10 + (value.data[i] - '0');
+        }
+        if (has_content_length_ && length != content_length_) {
+            return false;
+        }
+        has_content_length_ = true;
+        content_length_ = length;
+    }
+    else if (name.iequals("Transfer-Encoding")) {
+        has_transfer_encoding_ = true;
+        is_chunked_ = ends_with_chunked(value);
+    }
+    if (header_callback_) {
+        header_callback_(name, value);
+    }
+    return true;
+}
+
+bool HTTPParser::process_chunk_size(const char* data, size_t size) {
+    uint64_t chunk_size = 0;
+    size_t i = 0;
+    for (; i < size; ++i) {
+        const int value = hex_value(data[i]);
+        if (value < 0) {
+            break;
+        }
+        if (chunk_size > (numeric_limits<uint64_t>::max() >> 4)) {
+            return false;
+        }
+        chunk_size = (chunk_size << 4) | value;
+    }
+    // There has to be at least one digit, optionally followed by extensions
+    if (i == 0 || (i < size && data[i] != ';' && !is_whitespace(data[i]))) {
+        return false;
+    }
+    if (chunk_size == 0) {
+        state_ = TRAILERS;
+    }
+    else {
+        remaining_ = chunk_size;
+        state_ = CHUNK_DATA;
+    }
+    return true;
+}
+
+bool HTTPParser::on_headers_complete() {
+    if (headers_complete_callback_) {
+        headers_complete_callback_();
+    }
+    if (type_ == REQUEST) {
+        // A request with a transfer coding other than chunked can't be delimited
+        if (has_transfer_encoding_ && !is_chunked_) {
+            return false;
+        }
+    }
+    else {
+        // Interim responses don't answer any request
+        if (status_code_ >= 100 && status_code_ < 200 && status_code_ != 101) {
+            on_message_complete();
+            return true;
+        }
+        const RequestKind kind = pop_request();
+        const bool upgrade = status_code_ == 101 || 
+                             (kind == CONNECT_REQUEST && status_code_ >= 200 && 
+                              status_code_ < 300);
+        if (upgrade || kind == HEAD_REQUEST || status_code_ == 204 ||
+            status_code_ == 304) {
+            on_message_complete();
+            if (upgrade) {
+                state_ = UPGRADED;
+            }
+            return true;
+        }
+        if (has_transfer_encoding_ && !is_chunked_) {
+            state_ = BODY_UNTIL_CLOSE;
+            return true;
+        }
+    }
+    if (is_chunked_) {
+        state_ = CHUNK_SIZE;
+    }
+    else if (has_content_length_) {
+        if (content_length_ == 0) {
+            on_message_complete();
+        }
+        else {
+            remaining_ = content_length_;
+            state_ = BODY;
+        }
+    }
+    else if (type_ == REQUEST) {
+        on_message_complete();
+    }
+    else {
+        state_ = BODY_UNTIL_CLOSE;
+    }
+    return true;
+}
+
+void HTTPParser::on_message_complete() {
+    ++messages_parsed_;
+    state_ = START_LINE;
+    // The client starts speaking a different protocol right after a CONNECT
+    if (type_ == REQUEST && request_kind_ == CONNECT_REQUEST) {
+        state_ = UPGRADED;
+    }
+    if (message_complete_callback_) {
+        message_complete_callback_();
+    }
+}
+
+void HTTPParser::on_body_data(const char* data, size_t size) {
+    if (body_callback_) {
+        body_callback_(Slice(data, size));
+    }
+}
+
+void HTTPParser::push_request(RequestKind kind) {
+    // Requests beyond the ones we can track will be treated as regular ones
+    if (pending_requests_ == MAX_PENDING_REQUESTS) {
+        return;
+    }
+    const uint64_t bit = static_cast<uint64_t>(1) << pending_requests_;
+    if (kind == HEAD_REQUEST) {
+        pending_head_requests_ |= bit;
+    }
+    else if (kind == CONNECT_REQUEST) {
+        pending_connect_requests_ |= bit;
+    }
+    ++pending_requests_;
+}
+
+HTTPParser::RequestKind HTTPParser::pop_request() {
+    if (pending_requests_ == 0) {
+        return REGULAR_REQUEST;
+    }
+    RequestKind kind = REGULAR_REQUEST;
+    if (pending_head_requests_ & 1) {
+        kind = HEAD_REQUEST;
+    }
+    else if (pending_connect_requests_ & 1) {
+        kind = CONNECT_REQUEST;
+    }
+    pending_head_requests_ >>= 1;
+    pending_connect_requests_ >>= 1;
+    --pending_requests_;
+    return kind;
+}
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
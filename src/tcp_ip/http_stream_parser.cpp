@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/tcp_ip/http_stream_parser.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <tins/tcp_ip/stream.h>
+
+using std::bind;
+
+using namespace std::placeholders;
+
+namespace Tins {
+namespace TCPIP {
+
+HTTPStreamParser::HTTPStreamParser()
+: request_parser_(HTTPParser::REQUEST), response_parser_(HTTPParser::RESPONSE) {
+    request_parser_.link_response_parser(&response_parser_);
+}
+
+void HTTPStreamParser::attach(Stream& stream) {
+    stream.auto_cleanup_payloads(false);
+    stream.client_data_callback(bind(&HTTPStreamParser::on_client_data, this, _1));
+    stream.server_data_callback(bind(&HTTPStreamParser::on_server_data, this, _1));
+}
+
+void HTTPStreamParser::finish() {
+    request_parser_.finish();
+    response_parser_.finish();
+}
+
+HTTPParser& HTTPStreamParser::request_parser() {
+    return request_parser_;
+}
+
+const HTTPParser& HTTPStreamParser::request_parser() const {
+    return request_parser_;
+}
+
+HTTPParser& HTTPStreamParser::response_parser() {
+    return response_parser_;
+}
+
+const HTTPParser& HTTPStreamParser::response_parser() const {
+    return response_parser_;
+}
+
+bool HTTPStreamParser::parse_payload(HTTPParser& parser, Flow::payload_type& payload) {
+    const size_t consumed = parser.parse(payload.data(), payload.size());
+    if (parser.has_error() || parser.is_upgraded()) {
+        payload.clear();
+        return false;
+    }
+    // Only an incomplete line can be left, so this is a small move
+    payload.erase(payload.begin(), payload.begin() + consumed);
+    return true;
+}
+
+void HTTPStreamParser::on_client_data(Stream& stream) {
+    if (!parse_payload(request_parser_, stream.client_payload())) {
+        stream.ignore_client_data();
+    }
+}
+
+void HTTPStreamParser::on_server_data(Stream& stream) {
+    if (!parse_payload(response_parser_, stream.server_payload())) {
+        stream.ignore_server_data();
+    }
+}
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/tcp_ip/sack_scoreboard.h>
+
+#ifdef TINS_HAVE_ACK_TRACKER
+
+#include <algorithm>
+#include <tins/detail/sequence_number_helpers.h>
+
+using std::copy;
+using std::copy_backward;
+
+using Tins::Internals::seq_compare;
+
+namespace Tins {
+namespace TCPIP {
+
+const size_t SackScoreboard::MAX_INTERVALS;
+
+SackScoreboard::SackScoreboard()
+: count_(0), dropped_intervals_(0) {
+
+}
+
+void SackScoreboard::insert(uint32_t first, uint32_t last) {
+    // Find the first interval that overlaps or is adjacent to this one
+    const size_t start = lower_bound(first - 1);
+    size_t end = start;
+    while (end < count_ && seq_compare(intervals_[end].first(), last + 1) <= 0) {
+        ++end;
+    }
+    if (start != end) {
+        // Merge all of the intervals in [start, end) into a single one
+        if (seq_compare(intervals_[start].first(), first) < 0) {
+            first = intervals_[start].first();
+        }
+        if (seq_compare(intervals_[end - 1].last(), last) > 0) {
+            last = intervals_[end - 1].last();
+        }
+        intervals_[start] = interval_type(first, last);
+        erase_intervals(start + 1, end);
+        return;
+    }
+    if (count_ == MAX_INTERVALS) {
+        ++dropped_intervals_;
+        // If this is the furthest interval, drop it. Otherwise drop the last one
+        if (start == count_) {
+            return;
+        }
+        --count_;
+    }
+    copy_backward(intervals_ + start, intervals_ + count_, intervals_ + count_ + 1);
+    intervals_[start] = interval_type(first, last);
+    ++count_;
+}
+
+void SackScoreboard::erase_until(uint32_t last) {
+    // The first interval that ends after the given sequence number
+    const size_t index = lower_bound(last + 1);
+    if (index < count_ && seq_compare(intervals_[index].first(), last) <= 0) {
+        intervals_[index] = interval_type(last + 1, intervals_[index].last());
+    }
+    erase_intervals(0, index);
+    // Intervals dropped before the cumulative ACK advanced no longer matter
+    dropped_intervals_ = 0;
+}
+
+bool SackScoreboard::contains(uint32_t first, uint32_t last) const {
+    const size_t index = lower_bound(first);
+    if (index == count_) {
+        return false;
+    }
+    const interval_type& interval = intervals_[index];
+    return seq_compare(interval.first(), first) <= 0 &&
+           seq_compare(last, interval.last()) <= 0;
+}
+
+void SackScoreboard::clear() {
+    count_ = 0;
+    dropped_intervals_ = 0;
+}
+
+uint64_t SackScoreboard::size() const {
+    uint64_t output = 0;
+    for (const_iterator iter = begin(); iter != end(); ++iter) {
+        output += iter->length();
+    }
+    return output;
+}
+
+// Finds the first interval that ends at or after the given sequence number
+size_t SackScoreboard::lower_bound(uint32_t sequence_number) const {
+    size_t low = 0;
+    size_t high = count_;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (seq_compare(intervals_[middle].last(), sequence_number) < 0) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+void SackScoreboard::erase_intervals(size_t start, size_t end) {
+    if (start == end) {
+        return;
+    }
+    copy(intervals_ + end, intervals_ + count_, intervals_ + start);
+    count_ -= end - start;
+}
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_ACK_TRACKER
@@ -69,10 +69,12 @@ Stream::Stream(PDU& packet, const timestamp_type& ts)
 void Stream::process_packet(PDU& packet, const timestamp_type& ts) {
     last_seen_ = ts;
     if (client_flow_.packet_belongs(packet)) {
-        client_flow_.process_packet(packet);
+        client_flow_.process_packet(packet, ts);
+        server_flow_.process_peer_packet(packet, ts);
     }
     else if (server_flow_.packet_belongs(packet)) {
-        server_flow_.process_packet(packet);
+        server_flow_.process_packet(packet, ts);
+        client_flow_.process_peer_packet(packet, ts);
     }
     if (is_finished() && on_stream_closed_) {
         on_stream_closed_(*this);
@@ -80,7 +82,17 @@ void Stream::process_packet(PDU& packet, const timestamp_type& ts) {
 }
 
 void Stream::process_packet(PDU& packet) {
-    return process_packet(packet, timestamp_type(0));
+    // Without a timestamp, metrics are left untouched
+    last_seen_ = timestamp_type(0);
+    if (client_flow_.packet_belongs(packet)) {
+        client_flow_.process_packet(packet);
+    }
+    else if (server_flow_.packet_belongs(packet)) {
+        server_flow_.process_packet(packet);
+    }
+    if (is_finished() && on_stream_closed_) {
+        on_stream_closed_(*this);
+    }
 }
 
 Flow& Stream::client_flow() {
@@ -265,6 +277,15 @@ bool Stream::ack_tracking_enabled() const {
     return client_flow().ack_tracking_enabled() && server_flow().ack_tracking_enabled();
 }
 
+void Stream::enable_metrics() {
+    client_flow().enable_metrics();
+    server_flow().enable_metrics();
+}
+
+bool Stream::metrics_enabled() const {
+    return client_flow().metrics_enabled() && server_flow().metrics_enabled();
+}
+
 bool Stream::is_partial_stream() const {
     return is_partial_stream_;
 }
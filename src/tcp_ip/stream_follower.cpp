@@ -53,13 +53,14 @@ namespace Tins {
 namespace TCPIP {
 
 const size_t StreamFollower::DEFAULT_MAX_BUFFERED_CHUNKS = 512;
-const size_t StreamFollower::DEFAULT_MAX_SACKED_INTERVALS = 1024;
 const uint32_t StreamFollower::DEFAULT_MAX_BUFFERED_BYTES = 3 * 1024 * 1024; // 3MB
+const uint32_t StreamFollower::DEFAULT_MAX_DROPPED_SACKED_INTERVALS = 1024;
 const StreamFollower::timestamp_type StreamFollower::DEFAULT_KEEP_ALIVE = minutes(5);
 
 StreamFollower::StreamFollower() 
 : max_buffered_chunks_(DEFAULT_MAX_BUFFERED_CHUNKS),
-  max_buffered_bytes_(DEFAULT_MAX_BUFFERED_BYTES), last_cleanup_(0),
+  max_buffered_bytes_(DEFAULT_MAX_BUFFERED_BYTES),
+  max_dropped_sacked_intervals_(DEFAULT_MAX_DROPPED_SACKED_INTERVALS), last_cleanup_(0),
   stream_keep_alive_(DEFAULT_KEEP_ALIVE), attach_to_flows_(false) {
 
 }
@@ -123,10 +124,14 @@ void StreamFollower::process_packet(PDU& packet, const timestamp_type& ts) {
     TerminationReason reason = BUFFERED_DATA;
     #ifdef TINS_HAVE_ACK_TRACKER
     if (!terminate_stream) {
-        uint32_t count = 0;
-        count += stream.client_flow().ack_tracker().acked_intervals().iterative_size();
-        count += stream.server_flow().ack_tracker().acked_intervals().iterative_size();
-        terminate_stream = count > DEFAULT_MAX_SACKED_INTERVALS;
+        // Dropping a few SACKed intervals is fine, but if either flow keeps 
+        // doing so, SACKs are not being tracked in any useful way
+        const uint32_t client_dropped =
+            stream.client_flow().ack_tracker().acked_intervals().dropped_intervals();
+        const uint32_t server_dropped =
+            stream.server_flow().ack_tracker().acked_intervals().dropped_intervals();
+        terminate_stream = client_dropped > max_dropped_sacked_intervals_ ||
+                           server_dropped > max_dropped_sacked_intervals_;
         reason = SACKED_SEGMENTS;
     }
     #endif // TINS_HAVE_ACK_TRACKER
@@ -179,6 +184,10 @@ void StreamFollower::follow_partial_streams(bool value) {
     attach_to_flows_ = value;
 }
 
+void StreamFollower::max_dropped_sacked_intervals(uint32_t value) {
+    max_dropped_sacked_intervals_ = value;
+}
+
 void StreamFollower::cleanup_streams(const timestamp_type& now) {
     streams_type::iterator iter = streams_.begin();
     while (iter != streams_.end()) {
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/tcp_ip/udp_flow.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <tins/ip_address.h>
+#include <tins/ipv6_address.h>
+#include <tins/udp.h>
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/exceptions.h>
+#include <tins/memory_helpers.h>
+
+using Tins::Memory::InputMemoryStream;
+
+namespace Tins {
+namespace TCPIP {
+
+UDPFlow::UDPFlow(const PDU& packet, const timestamp_type& ts)
+: is_v6_(false), client_packets_(0), client_bytes_(0), server_packets_(0), 
+  server_bytes_(0), create_time_(ts), last_seen_(ts) {
+    const UDP& udp = packet.rfind_pdu<UDP>();
+    if (const IP* ip = packet.find_pdu<IP>()) {
+        client_addr_ = StreamIdentifier::serialize(ip->src_addr());
+        server_addr_ = StreamIdentifier::serialize(ip->dst_addr());
+    }
+    else if (const IPv6* ip = packet.find_pdu<IPv6>()) {
+        client_addr_ = StreamIdentifier::serialize(ip->src_addr());
+        server_addr_ = StreamIdentifier::serialize(ip->dst_addr());
+        is_v6_ = true;
+    }
+    else {
+        throw invalid_packet();
+    }
+    client_port_ = udp.sport();
+    server_port_ = udp.dport();
+}
+
+UDPFlow::Direction UDPFlow::process_packet(const UDP& udp, const timestamp_type& ts) {
+    const uint32_t payload_size = udp.size() - udp.header_size();
+    last_seen_ = ts;
+    if (sent_by_client(udp)) {
+        ++client_packets_;
+        client_bytes_ += payload_size;
+        return CLIENT_TO_SERVER;
+    }
+    else {
+        ++server_packets_;
+        server_bytes_ += payload_size;
+        return SERVER_TO_CLIENT;
+    }
+}
+
+UDPFlow::Direction UDPFlow::process_packet(const PDU& packet, const timestamp_type& ts) {
+    return process_packet(packet.rfind_pdu<UDP>(), ts);
+}
+
+bool UDPFlow::sent_by_client(const UDP& udp) const {
+    // Ports are enough to tell the direction unless both are the same
+    if (client_port_ != server_port_) {
+        return udp.sport() == client_port_;
+    }
+    // Otherwise use the source address in the closest IP layer
+    for (const PDU* pdu = udp.parent_pdu(); pdu; pdu = pdu->parent_pdu()) {
+        if (pdu->pdu_type() == PDU::IP) {
+            const IP* ip = static_cast<const IP*>(pdu);
+            return StreamIdentifier::serialize(ip->src_addr()) == client_addr_;
+        }
+        else if (pdu->pdu_type() == PDU::IPv6) {
+            const IPv6* ip = static_cast<const IPv6*>(pdu);
+            return StreamIdentifier::serialize(ip->src_addr()) == client_addr_;
+        }
+    }
+    return true;
+}
+
+bool UDPFlow::is_v6() const {
+    return is_v6_;
+}
+
+IPv4Address UDPFlow::client_addr_v4() const {
+    InputMemoryStream stream(client_addr_.data(), client_addr_.size());
+    return stream.read<IPv4Address>();
+}
+
+IPv6Address UDPFlow::client_addr_v6() const {
+    InputMemoryStream stream(client_addr_.data(), client_addr_.size());
+    return stream.read<IPv6Address>();
+}
+
+IPv4Address UDPFlow::server_addr_v4() const {
+    InputMemoryStream stream(server_addr_.data(), server_addr_.size());
+    return stream.read<IPv4Address>();
+}
+
+IPv6Address UDPFlow::server_addr_v6() const {
+    InputMemoryStream stream(server_addr_.data(), server_addr_.size());
+    return stream.read<IPv6Address>();
+}
+
+uint16_t UDPFlow::client_port() const {
+    return client_port_;
+}
+
+uint16_t UDPFlow::server_port() const {
+    return server_port_;
+}
+
+uint64_t UDPFlow::client_packets() const {
+    return client_packets_;
+}
+
+uint64_t UDPFlow::client_bytes() const {
+    return client_bytes_;
+}
+
+uint64_t UDPFlow::server_packets() const {
+    return server_packets_;
+}
+
+uint64_t UDPFlow::server_bytes() const {
+    return server_bytes_;
+}
+
+const UDPFlow::timestamp_type& UDPFlow::create_time() const {
+    return create_time_;
+}
+
+const UDPFlow::timestamp_type& UDPFlow::last_seen() const {
+    return last_seen_;
+}
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
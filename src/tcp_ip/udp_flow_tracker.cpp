@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/tcp_ip/udp_flow_tracker.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <limits>
+#include <tins/ip_address.h>
+#include <tins/ipv6_address.h>
+#include <tins/udp.h>
+#include <tins/packet.h>
+#include <tins/exceptions.h>
+
+using std::make_pair;
+using std::numeric_limits;
+using std::chrono::system_clock;
+using std::chrono::seconds;
+using std::chrono::duration_cast;
+
+namespace Tins {
+namespace TCPIP {
+
+const UDPFlowTracker::timestamp_type UDPFlowTracker::DEFAULT_KEEP_ALIVE = seconds(30);
+const size_t UDPFlowTracker::MAX_EXPIRATIONS_PER_PACKET = 4;
+
+UDPFlowTracker::UDPFlowTracker()
+: oldest_(0), newest_(0), flow_keep_alive_(DEFAULT_KEEP_ALIVE), max_flows_(0) {
+
+}
+
+void UDPFlowTracker::process_packet(PDU& packet) {
+    // Use current time
+    const system_clock::duration ts = system_clock::now().time_since_epoch();
+    process_packet(packet, duration_cast<timestamp_type>(ts));
+}
+
+void UDPFlowTracker::process_packet(Packet& packet) {
+    process_packet(*packet.pdu(), packet.timestamp());
+}
+
+void UDPFlowTracker::process_packet(PDU& packet, const timestamp_type& ts) {
+    const UDP* udp = packet.find_pdu<UDP>();
+    if (!udp) {
+        return;
+    }
+    // Expire a few of the least recently seen flows before doing anything else
+    expire_flows(ts, MAX_EXPIRATIONS_PER_PACKET);
+
+    const flow_id identifier = flow_id::make_identifier(packet);
+    flows_type::iterator iter = flows_.find(identifier);
+    flow_entry* entry = 0;
+    if (iter == flows_.end()) {
+        if (max_flows_ != 0 && flows_.size() >= max_flows_) {
+            terminate_flow(oldest_, MAX_FLOWS);
+        }
+        iter = flows_.insert(make_pair(identifier, flow_entry(UDPFlow(packet, ts)))).first;
+        entry = &iter->second;
+        entry->id = &iter->first;
+        link_back(entry);
+        if (on_new_flow_) {
+            on_new_flow_(entry->flow);
+        }
+    }
+    else {
+        // Move it to the back of the list, as it's now the most recently seen one
+        entry = &iter->second;
+        unlink(entry);
+        link_back(entry);
+    }
+    const UDPFlow::Direction direction = entry->flow.process_packet(*udp, ts);
+    if (on_data_) {
+        on_data_(entry->flow, direction, *udp);
+    }
+}
+
+void UDPFlowTracker::new_flow_callback(const flow_callback_type& callback) {
+    on_new_flow_ = callback;
+}
+
+void UDPFlowTracker::data_callback(const data_callback_type& callback) {
+    on_data_ = callback;
+}
+
+void UDPFlowTracker::flow_termination_callback(const flow_termination_callback_type& callback) {
+    on_flow_termination_ = callback;
+}
+
+void UDPFlowTracker::max_flows(size_t value) {
+    max_flows_ = value;
+    if (max_flows_ != 0) {
+        flows_.reserve(max_flows_);
+        while (flows_.size() > max_flows_) {
+            terminate_flow(oldest_, MAX_FLOWS);
+        }
+    }
+}
+
+size_t UDPFlowTracker::flows_count() const {
+    return flows_.size();
+}
+
+void UDPFlowTracker::cleanup_flows(const timestamp_type& now) {
+    expire_flows(now, numeric_limits<size_t>::max());
+}
+
+UDPFlow& UDPFlowTracker::find_flow(const IPv4Address& client_addr, uint16_t client_port,
+                                   const IPv4Address& server_addr, uint16_t server_port) {
+    flow_id identifier(flow_id::serialize(client_addr), client_port,
+                       flow_id::serialize(server_addr), server_port);
+    return find_flow(identifier);
+}
+
+UDPFlow& UDPFlowTracker::find_flow(const IPv6Address& client_addr, uint16_t client_port,
+                                   const IPv6Address& server_addr, uint16_t server_port) {
+    flow_id identifier(flow_id::serialize(client_addr), client_port,
+                       flow_id::serialize(server_addr), server_port);
+    return find_flow(identifier);
+}
+
+UDPFlow& UDPFlowTracker::find_flow(const flow_id& id) {
+    flows_type::iterator iter = flows_.find(id);
+    if (iter == flows_.end()) {
+        throw stream_not_found();
+    }
+    else {
+        return iter->second.flow;
+    }
+}
+
+void UDPFlowTracker::expire_flows(const timestamp_type& now, size_t max_expirations) {
+    size_t expired = 0;
+    while (oldest_ && expired < max_expirations &&
+           oldest_->flow.last_seen() + flow_keep_alive_ <= now) {
+        terminate_flow(oldest_, TIMEOUT);
+        ++expired;
+    }
+}
+
+void UDPFlowTracker::terminate_flow(flow_entry* entry, TerminationReason reason) {
+    if (on_flow_termination_) {
+        on_flow_termination_(entry->flow, reason);
+    }
+    unlink(entry);
+    // Copy the identifier, as it lives inside the entry being erased
+    const flow_id identifier = *entry->id;
+    flows_.erase(identifier);
+}
+
+void UDPFlowTracker::link_back(flow_entry* entry) {
+    entry->previous = newest_;
+    entry->next = 0;
+    if (newest_) {
+        newest_->next = entry;
+    }
+    else {
+        oldest_ = entry;
+    }
+    newest_ = entry;
+}
+
+void UDPFlowTracker::unlink(flow_entry* entry) {
+    if (entry->previous) {
+        entry->previous->next = entry->next;
+    }
+    else {
+        oldest_ = entry->next;
+    }
+    if (entry->next) {
+        entry->next->previous = entry->previous;
+    }
+    else {
+        newest_ = entry->previous;
+    }
+    entry->previous = 0;
+    entry->next = 0;
+}
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
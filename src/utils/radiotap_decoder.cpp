@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/utils/radiotap_decoder.h>
+
+#ifdef TINS_HAVE_DOT11
+
+#include <cstring>
+#include <tins/endianness.h>
+#include <tins/exceptions.h>
+#include <tins/utils/radiotap_parser.h>
+
+using std::memcpy;
+
+namespace Tins {
+namespace Utils {
+
+namespace {
+
+// version, padding and length
+const uint32_t HEADER_SIZE = 4;
+const uint32_t EXT_BIT = 1U << 31;
+
+uint32_t read_le32(const uint8_t* buffer) {
+    uint32_t output;
+    memcpy(&output, buffer, sizeof(output));
+    return Endian::le_to_host(output);
+}
+
+} // anonymous namespace
+
+const size_t RadioTapDecoder::MAX_LAYOUTS = 16;
+
+RadioTapDecoder::RadioTapDecoder(uint32_t fields)
+: fields_(fields), last_layout_(0), next_replaced_(0), buffer_(0), offsets_(0),
+  present_(0), length_(0) {
+    layouts_.reserve(MAX_LAYOUTS);
+}
+
+void RadioTapDecoder::decode(const uint8_t* buffer, uint32_t total_sz) {
+    if (TINS_UNLIKELY(total_sz < HEADER_SIZE + sizeof(uint32_t))) {
+        throw malformed_packet();
+    }
+    uint16_t length;
+    memcpy(&length, buffer + 2, sizeof(length));
+    length = Endian::le_to_host(length);
+    if (TINS_UNLIKELY(length < HEADER_SIZE + sizeof(uint32_t) || length > total_sz)) {
+        throw malformed_packet();
+    }
+    const uint32_t present_flags = read_le32(buffer + HEADER_SIZE);
+    // Extended bitmaps don't affect the fields in the first one, other than
+    // by moving them forward
+    uint32_t word_count = 1;
+    uint32_t flags = present_flags;
+    while ((flags & EXT_BIT) != 0) {
+        const uint32_t offset = HEADER_SIZE + word_count * sizeof(uint32_t);
+        if (TINS_UNLIKELY(offset + sizeof(uint32_t) > length)) {
+            throw malformed_packet();
+        }
+        flags = read_le32(buffer + offset);
+        ++word_count;
+    }
+    const Layout& layout = find_layout(present_flags, word_count);
+    if (TINS_UNLIKELY(layout.min_length > length)) {
+        throw malformed_packet();
+    }
+    buffer_ = buffer;
+    offsets_ = layout.offsets;
+    present_ = layout.found_fields;
+    length_ = length;
+}
+
+const RadioTapDecoder::Layout& RadioTapDecoder::find_layout(uint32_t present_flags,
+                                                            uint32_t word_count) {
+    // Captures usually have a single layout, or a few of them
+    if (last_layout_ < layouts_.size()) {
+        const Layout& layout = layouts_[last_layout_];
+        if (layout.present_flags == present_flags && layout.word_count == word_count) {
+            return layout;
+        }
+    }
+    for (size_t i = 0; i < layouts_.size(); ++i) {
+        if (layouts_[i].present_flags == present_flags &&
+            layouts_[i].word_count == word_count) {
+            last_layout_ = i;
+            return layouts_[i];
+        }
+    }
+    if (layouts_.size() < MAX_LAYOUTS) {
+        last_layout_ = layouts_.size();
+        layouts_.push_back(Layout());
+    }
+    else {
+        last_layout_ = next_replaced_;
+        next_replaced_ = (next_replaced_ + 1) % MAX_LAYOUTS;
+    }
+    Layout& layout = layouts_[last_layout_];
+    layout.present_flags = present_flags;
+    layout.word_count = word_count;
+    compute_layout(layout);
+    return layout;
+}
+
+void RadioTapDecoder::compute_layout(Layout& layout) const {
+    layout.found_fields = 0;
+    layout.min_length = 0;
+    std::memset(layout.offsets, 0, sizeof(layout.offsets));
+    // Alignment is relative to the start of the header
+    uint32_t offset = HEADER_SIZE + layout.word_count * sizeof(uint32_t);
+    // Fields after the last requested one don't need to be looked at
+    for (uint32_t bit = 0; bit < RadioTapParser::MAX_RADIOTAP_FIELD &&
+                           (fields_ >> bit) != 0; ++bit) {
+        const uint32_t flag = 1U << bit;
+        if ((layout.present_flags & flag) == 0) {
+            continue;
+        }
+        const RadioTapParser::FieldMetadata& metadata = 
+            RadioTapParser::RADIOTAP_METADATA[bit];
+        offset = (offset + metadata.alignment - 1) & ~(metadata.alignment - 1);
+        if ((fields_ & flag) != 0) {
+            layout.offsets[bit] = static_cast<uint16_t>(offset);
+            layout.found_fields |= flag;
+            layout.min_length = offset + metadata.size;
+        }
+        offset += metadata.size;
+    }
+}
+
+const uint8_t* RadioTapDecoder::field_ptr(RadioTap::PresentFlags flag) const {
+    if (!has_field(flag)) {
+        throw field_not_present();
+    }
+    uint32_t bit = 0;
+    while ((1U << bit) != static_cast<uint32_t>(flag)) {
+        ++bit;
+    }
+    return buffer_ + offsets_[bit];
+}
+
+template <typename T>
+T RadioTapDecoder::read_field(RadioTap::PresentFlags flag) const {
+    T output;
+    memcpy(&output, field_ptr(flag), sizeof(output));
+    return Endian::le_to_host(output);
+}
+
+uint64_t RadioTapDecoder::tsft() const {
+    return read_field<uint64_t>(RadioTap::TSFT);
+}
+
+RadioTap::FrameFlags RadioTapDecoder::flags() const {
+    return static_cast<RadioTap::FrameFlags>(read_field<uint8_t>(RadioTap::FLAGS));
+}
+
+uint8_t RadioTapDecoder::rate() const {
+    return read_field<uint8_t>(RadioTap::RATE);
+}
+
+uint16_t RadioTapDecoder::channel_freq() const {
+    return read_field<uint16_t>(RadioTap::CHANNEL);
+}
+
+uint16_t RadioTapDecoder::channel_type() const {
+    uint16_t output;
+    memcpy(&output, field_ptr(RadioTap::CHANNEL) + sizeof(uint16_t), sizeof(output));
+    return Endian::le_to_host(output);
+}
+
+int8_t RadioTapDecoder::dbm_signal() const {
+    return static_cast<int8_t>(read_field<uint8_t>(RadioTap::DBM_SIGNAL));
+}
+
+int8_t RadioTapDecoder::dbm_noise() const {
+    return static_cast<int8_t>(read_field<uint8_t>(RadioTap::DBM_NOISE));
+}
+
+uint8_t RadioTapDecoder::antenna() const {
+    return read_field<uint8_t>(RadioTap::ANTENNA);
+}
+
+uint8_t RadioTapDecoder::db_signal() const {
+    return read_field<uint8_t>(RadioTap::DB_SIGNAL);
+}
+
+uint16_t RadioTapDecoder::rx_flags() const {
+    return read_field<uint16_t>(RadioTap::RX_FLAGS);
+}
+
+uint16_t RadioTapDecoder::tx_flags() const {
+    return read_field<uint16_t>(RadioTap::TX_FLAGS);
+}
+
+uint8_t RadioTapDecoder::data_retries() const {
+    return read_field<uint8_t>(RadioTap::DATA_RETRIES);
+}
+
+RadioTap::xchannel_type RadioTapDecoder::xchannel() const {
+    RadioTap::xchannel_type output;
+    memcpy(&output, field_ptr(RadioTap::XCHANNEL), sizeof(output));
+    output.flags = Endian::le_to_host(output.flags);
+    output.frequency = Endian::le_to_host(output.frequency);
+    return output;
+}
+
+RadioTap::mcs_type RadioTapDecoder::mcs() const {
+    RadioTap::mcs_type output;
+    memcpy(&output, field_ptr(RadioTap::MCS), sizeof(output));
+    return output;
+}
+
+} // Utils
+} // Tins
+
+#endif // TINS_HAVE_DOT11
@@ -0,0 +1,204 @@
+#include <tins/cxxstd.h>
+
+#if TINS_IS_CXX11 && !defined(_WIN32)
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <tins/async_packet_writer.h>
+#include <tins/buffered_packet_writer.h>
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/udp.h>
+#include <tins/rawpdu.h>
+#include <tins/packet.h>
+#include <tins/exceptions.h>
+
+using std::string;
+using std::vector;
+using std::chrono::seconds;
+
+using namespace Tins;
+
+class AsyncPacketWriterTest : public testing::Test {
+public:
+    static const int LINK_TYPE_ETHERNET = 1;
+    static const string FILE_NAME;
+
+    ~AsyncPacketWriterTest();
+
+    static vector<vector<uint8_t> > read_records(const string& file_name);
+    EthernetII make_packet(size_t payload_size);
+
+    vector<string> created_files;
+};
+
+const int AsyncPacketWriterTest::LINK_TYPE_ETHERNET;
+const string AsyncPacketWriterTest::FILE_NAME = "async_packet_writer_test.pcap";
+
+AsyncPacketWriterTest::~AsyncPacketWriterTest() {
+    remove(FILE_NAME.c_str());
+    for (size_t i = 0; i < created_files.size(); ++i) {
+        remove(created_files[i].c_str());
+    }
+}
+
+vector<vector<uint8_t> > AsyncPacketWriterTest::read_records(const string& file_name) {
+    std::ifstream input(file_name.c_str(), std::ios::binary);
+    vector<uint8_t> contents((std::istreambuf_iterator<char>(input)),
+                             std::istreambuf_iterator<char>());
+    vector<vector<uint8_t> > records;
+    size_t index = 24;
+    while (index + 16 <= contents.size()) {
+        uint32_t caplen;
+        memcpy(&caplen, &contents[index + 8], sizeof(caplen));
+        index += 16;
+        EXPECT_LE(index + caplen, contents.size());
+        records.push_back(vector<uint8_t>(contents.begin() + index,
+                                          contents.begin() + index + caplen));
+        index += caplen;
+    }
+    EXPECT_EQ(contents.size(), index);
+    return records;
+}
+
+EthernetII AsyncPacketWriterTest::make_packet(size_t payload_size) {
+    return EthernetII() / IP("1.2.3.4", "4.3.2.1") / UDP(53, 1337) /
+           RawPDU(string(payload_size, 'a'));
+}
+
+TEST_F(AsyncPacketWriterTest, WritePackets) {
+    vector<PDU::serialization_type> expected;
+    {
+        AsyncPacketWriter writer(FILE_NAME, LINK_TYPE_ETHERNET, 16,
+                                 AsyncPacketWriter::BLOCK);
+        EXPECT_EQ(16U, writer.queue_capacity());
+        EXPECT_EQ(AsyncPacketWriter::BLOCK, writer.overflow_policy());
+        for (size_t i = 0; i < 1000; ++i) {
+            EthernetII packet = make_packet(i % 100);
+            expected.push_back(packet.serialize());
+            if (i % 2 == 0) {
+                EXPECT_TRUE(writer.write(packet, Timestamp(seconds(i))));
+            }
+            else {
+                Packet wrapped(packet, Timestamp(seconds(i)));
+                EXPECT_TRUE(writer.write(wrapped));
+            }
+        }
+        writer.close();
+        EXPECT_EQ(1000ULL, writer.frames_written());
+        EXPECT_EQ(0ULL, writer.dropped_frames());
+        EXPECT_EQ(0U, writer.queue_depth());
+        EXPECT_GE(writer.max_queue_depth(), 1U);
+        EXPECT_LE(writer.max_queue_depth(), 16U);
+    }
+    EXPECT_EQ(expected, read_records(FILE_NAME));
+}
+
+TEST_F(AsyncPacketWriterTest, WriteRawFrames) {
+    EthernetII packet = make_packet(10);
+    PDU::serialization_type buffer = packet.serialize();
+    buffer.insert(buffer.end(), 4, 0);
+    Packet wrapped(packet, Timestamp(seconds(1)));
+    wrapped.raw_frame(&buffer[0], buffer.size());
+    {
+        AsyncPacketWriter writer(FILE_NAME, LINK_TYPE_ETHERNET);
+        EXPECT_TRUE(writer.write(wrapped));
+        EXPECT_TRUE(writer.write(&buffer[0], buffer.size(), Timestamp(seconds(2))));
+        writer.close();
+        EXPECT_EQ(2 * buffer.size(), writer.bytes_written());
+    }
+    vector<vector<uint8_t> > records = read_records(FILE_NAME);
+    ASSERT_EQ(2U, records.size());
+    EXPECT_EQ(buffer, records[0]);
+    EXPECT_EQ(buffer, records[1]);
+}
+
+TEST_F(AsyncPacketWriterTest, PacketWithoutPDU) {
+    AsyncPacketWriter writer(FILE_NAME, LINK_TYPE_ETHERNET);
+    Packet empty;
+    EXPECT_THROW(writer.write(empty), invalid_packet);
+    writer.close();
+    EXPECT_EQ(0ULL, writer.frames_written());
+}
+
+TEST_F(AsyncPacketWriterTest, DestructorWritesQueuedPackets) {
+    EthernetII packet = make_packet(10);
+    {
+        AsyncPacketWriter writer(FILE_NAME, LINK_TYPE_ETHERNET, 64,
+                                 AsyncPacketWriter::BLOCK);
+        for (size_t i = 0; i < 100; ++i) {
+            writer.write(packet);
+        }
+    }
+    EXPECT_EQ(100U, read_records(FILE_NAME).size());
+}
+
+TEST_F(AsyncPacketWriterTest, DropNewestWhenFull) {
+    std::atomic<bool> stalled(false);
+    std::atomic<bool> resume(false);
+    std::unique_ptr<BufferedPacketWriter> file_writer(
+        new BufferedPacketWriter(FILE_NAME, LINK_TYPE_ETHERNET)
+    );
+    // Stall the I/O thread while it writes the second packet
+    file_writer->max_file_packets(1);
+    file_writer->rotation_callback([&](const string& file_name) {
+        created_files.push_back(file_name);
+        stalled = true;
+        while (!resume) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    AsyncPacketWriter writer(std::move(file_writer), 2);
+    EXPECT_EQ(AsyncPacketWriter::DROP_NEWEST, writer.overflow_policy());
+    EthernetII packet = make_packet(10);
+    EXPECT_TRUE(writer.write(packet));
+    EXPECT_TRUE(writer.write(packet));
+    while (!stalled) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // The slot being written is still in use
+    EXPECT_EQ(1U, writer.queue_depth());
+    EXPECT_TRUE(writer.write(packet));
+    EXPECT_FALSE(writer.write(packet));
+    EXPECT_FALSE(writer.write(packet));
+    EXPECT_EQ(2ULL, writer.dropped_frames());
+    EXPECT_EQ(2U, writer.max_queue_depth());
+    resume = true;
+    writer.close();
+    EXPECT_EQ(3ULL, writer.frames_written());
+    EXPECT_FALSE(writer.write(packet));
+    EXPECT_EQ(3ULL, writer.dropped_frames());
+}
+
+TEST_F(AsyncPacketWriterTest, WriteErrorIsRethrownOnClose) {
+    if (access("/dev/full", W_OK) != 0) {
+        return;
+    }
+    std::unique_ptr<BufferedPacketWriter> file_writer(
+        new BufferedPacketWriter("/dev/full", LINK_TYPE_ETHERNET, 4096)
+    );
+    AsyncPacketWriter writer(std::move(file_writer), 8, AsyncPacketWriter::BLOCK);
+    // Only the first frame fits in the file writer's buffer; writing the
+    // second one flushes it, which fails
+    vector<uint8_t> frame(3000);
+    for (size_t i = 0; i < 10; ++i) {
+        writer.write(&frame[0], frame.size(), Timestamp(seconds(1)));
+    }
+    EXPECT_THROW(writer.close(), file_write_error);
+    EXPECT_EQ(1ULL, writer.frames_written());
+    EXPECT_EQ(9ULL, writer.dropped_frames());
+    // The error is only reported once
+    writer.close();
+}
+
+#endif // TINS_IS_CXX11 && !_WIN32
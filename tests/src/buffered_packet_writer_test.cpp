@@ -0,0 +1,292 @@
+#include <tins/config.h>
+#include <tins/cxxstd.h>
+
+#if TINS_IS_CXX11 && !defined(_WIN32)
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <tins/buffered_packet_writer.h>
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/udp.h>
+#include <tins/rawpdu.h>
+#include <tins/packet.h>
+#include <tins/sniffer.h>
+#include <tins/exceptions.h>
+
+using std::string;
+using std::vector;
+using std::chrono::seconds;
+
+using namespace Tins;
+
+class BufferedPacketWriterTest : public testing::Test {
+public:
+    struct Record {
+        uint32_t ts_sec;
+        uint32_t ts_usec;
+        uint32_t len;
+        vector<uint8_t> data;
+    };
+
+    static const int LINK_TYPE_ETHERNET = 1;
+    static const string FILE_NAME;
+
+    ~BufferedPacketWriterTest();
+
+    static vector<uint8_t> read_file(const string& file_name);
+    static vector<Record> read_records(const string& file_name);
+    static uint32_t read_u32(const uint8_t* ptr);
+    EthernetII make_packet(size_t payload_size);
+
+    vector<string> created_files;
+};
+
+const int BufferedPacketWriterTest::LINK_TYPE_ETHERNET;
+const string BufferedPacketWriterTest::FILE_NAME = "buffered_packet_writer_test.pcap";
+
+BufferedPacketWriterTest::~BufferedPacketWriterTest() {
+    remove(FILE_NAME.c_str());
+    for (size_t i = 0; i < created_files.size(); ++i) {
+        remove(created_files[i].c_str());
+    }
+}
+
+vector<uint8_t> BufferedPacketWriterTest::read_file(const string& file_name) {
+    std::ifstream input(file_name.c_str(), std::ios::binary);
+    return vector<uint8_t>(std::istreambuf_iterator<char>(input),
+                           std::istreambuf_iterator<char>());
+}
+
+uint32_t BufferedPacketWriterTest::read_u32(const uint8_t* ptr) {
+    uint32_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+vector<BufferedPacketWriterTest::Record>
+BufferedPacketWriterTest::read_records(const string& file_name) {
+    vector<uint8_t> contents = read_file(file_name);
+    vector<Record> records;
+    EXPECT_GE(contents.size(), 24U);
+    if (contents.size() < 24) {
+        return records;
+    }
+    EXPECT_EQ(0xa1b2c3d4U, read_u32(&contents[0]));
+    EXPECT_EQ(LINK_TYPE_ETHERNET, (int)read_u32(&contents[20]));
+    size_t index = 24;
+    while (index + 16 <= contents.size()) {
+        Record record;
+        record.ts_sec = read_u32(&contents[index]);
+        record.ts_usec = read_u32(&contents[index + 4]);
+        uint32_t caplen = read_u32(&contents[index + 8]);
+        record.len = read_u32(&contents[index + 12]);
+        index += 16;
+        EXPECT_LE(index + caplen, contents.size());
+        record.data.assign(contents.begin() + index, contents.begin() + index + caplen);
+        index += caplen;
+        records.push_back(record);
+    }
+    EXPECT_EQ(contents.size(), index);
+    return records;
+}
+
+EthernetII BufferedPacketWriterTest::make_packet(size_t payload_size) {
+    return EthernetII() / IP("1.2.3.4", "4.3.2.1") / UDP(53, 1337) /
+           RawPDU(string(payload_size, 'a'));
+}
+
+TEST_F(BufferedPacketWriterTest, WriteRecords) {
+    EthernetII packet = make_packet(10);
+    PDU::serialization_type buffer = packet.serialize();
+    {
+        BufferedPacketWriter writer(FILE_NAME, LINK_TYPE_ETHERNET);
+        writer.write(packet, Timestamp(std::chrono::microseconds(1500001)));
+        writer.write(&buffer[0], buffer.size(), Timestamp(seconds(2)));
+        Packet wrapped(packet, Timestamp(seconds(3)));
+        writer.write(wrapped);
+        EXPECT_EQ(3ULL, writer.packets_written());
+        EXPECT_EQ(24ULL + 3 * (16 + buffer.size()), writer.file_size());
+        // Nothing is written until the writer is flushed
+        EXPECT_EQ(0U, read_file(FILE_NAME).size());
+    }
+    vector<Record> records = read_records(FILE_NAME);
+    ASSERT_EQ(3U, records.size());
+    EXPECT_EQ(1U, records[0].ts_sec);
+    EXPECT_EQ(500001U, records[0].ts_usec);
+    EXPECT_EQ(2U, records[1].ts_sec);
+    EXPECT_EQ(3U, records[2].ts_sec);
+    for (size_t i = 0; i < records.size(); ++i) {
+        EXPECT_EQ(buffer.size(), records[i].len);
+        EXPECT_EQ(buffer, records[i].data);
+    }
+}
+
+TEST_F(BufferedPacketWriterTest, WriteRawFrame) {
+    EthernetII packet = make_packet(10);
+    PDU::serialization_type buffer = packet.serialize();
+    // Trailing bytes the PDU doesn't represent are kept
+    buffer.insert(buffer.end(), 8, 0);
+    Packet wrapped(packet, Timestamp(seconds(1)));
+    wrapped.raw_frame(&buffer[0], buffer.size());
+    {
+        BufferedPacketWriter writer(FILE_NAME, LINK_TYPE_ETHERNET);
+        writer.write(wrapped);
+    }
+    vector<Record> records = read_records(FILE_NAME);
+    ASSERT_EQ(1U, records.size());
+    EXPECT_EQ(buffer, records[0].data);
+}
+
+TEST_F(BufferedPacketWriterTest, WriteTruncatedRawFrame) {
+    EthernetII packet = make_packet(100);
+    PDU::serialization_type buffer = packet.serialize();
+    const uint32_t caplen = 60;
+    Packet wrapped(EthernetII(&buffer[0], caplen), Timestamp(seconds(1)));
+    wrapped.raw_frame(&buffer[0], caplen, buffer.size());
+    EXPECT_EQ(buffer.size(), wrapped.raw_frame_length());
+    {
+        BufferedPacketWriter writer(FILE_NAME, LINK_TYPE_ETHERNET);
+        writer.write(wrapped);
+    }
+    vector<Record> records = read_records(FILE_NAME);
+    ASSERT_EQ(1U, records.size());
+    EXPECT_EQ(buffer.size(), records[0].len);
+    EXPECT_EQ(vector<uint8_t>(buffer.begin(), buffer.begin() + caplen), records[0].data);
+
+    #ifdef TINS_HAVE_PCAP
+    // Sniffed frames keep the original length
+    SnifferConfiguration config;
+    config.set_retain_raw_frames(true);
+    FileSniffer sniffer(FILE_NAME, config);
+    Packet sniffed = sniffer.next_packet();
+    const Packet& const_sniffed = sniffed;
+    ASSERT_TRUE(const_sniffed.pdu() != 0);
+    EXPECT_EQ(caplen, sniffed.raw_frame().size());
+    EXPECT_EQ(buffer.size(), sniffed.raw_frame_length());
+    #endif // TINS_HAVE_PCAP
+}
+
+TEST_F(BufferedPacketWriterTest, WriteEmptyPDU) {
+    RawPDU packet((const uint8_t*)0, 0);
+    {
+        BufferedPacketWriter writer(FILE_NAME, LINK_TYPE_ETHERNET);
+        writer.write(packet, Timestamp(seconds(1)));
+    }
+    vector<Record> records = read_records(FILE_NAME);
+    ASSERT_EQ(1U, records.size());
+    EXPECT_EQ(0U, records[0].len);
+    EXPECT_TRUE(records[0].data.empty());
+}
+
+TEST_F(BufferedPacketWriterTest, Flush) {
+    EthernetII packet = make_packet(10);
+    BufferedPacketWriter writer(FILE_NAME, LINK_TYPE_ETHERNET);
+    writer.write(packet);
+    writer.flush();
+    EXPECT_EQ(writer.file_size(), read_file(FILE_NAME).size());
+    EXPECT_EQ(1U, read_records(FILE_NAME).size());
+}
+
+TEST_F(BufferedPacketWriterTest, PacketsLargerThanBuffer) {
+    EthernetII small_packet = make_packet(10);
+    EthernetII large_packet = make_packet(10000);
+    {
+        BufferedPacketWriter writer(FILE_NAME, LINK_TYPE_ETHERNET, 4096);
+        for (size_t i = 0; i < 100; ++i) {
+            writer.write(small_packet);
+            if (i % 10 == 0) {
+                writer.write(large_packet);
+            }
+        }
+    }
+    vector<Record> records = read_records(FILE_NAME);
+    ASSERT_EQ(110U, records.size());
+    EXPECT_EQ(large_packet.serialize(), records[1].data);
+    EXPECT_EQ(small_packet.serialize(), records[2].data);
+    EXPECT_EQ(large_packet.serialize(), records[100].data);
+    EXPECT_EQ(small_packet.serialize(), records[109].data);
+}
+
+TEST_F(BufferedPacketWriterTest, RotateByPacketCount) {
+    vector<string> completed;
+    EthernetII packet = make_packet(10);
+    BufferedPacketWriter writer(FILE_NAME, LINK_TYPE_ETHERNET);
+    writer.max_file_packets(2);
+    writer.rotation_callback([&](const string& file_name) {
+        completed.push_back(file_name);
+    });
+    for (size_t i = 0; i < 5; ++i) {
+        writer.write(packet);
+    }
+    EXPECT_EQ(2U, writer.file_index());
+    writer.close();
+    created_files = completed;
+
+    ASSERT_EQ(3U, completed.size());
+    EXPECT_EQ(FILE_NAME, completed[0]);
+    EXPECT_EQ("buffered_packet_writer_test.1.pcap", completed[1]);
+    EXPECT_EQ("buffered_packet_writer_test.2.pcap", completed[2]);
+    EXPECT_EQ(2U, read_records(completed[0]).size());
+    EXPECT_EQ(2U, read_records(completed[1]).size());
+    EXPECT_EQ(1U, read_records(completed[2]).size());
+    EXPECT_THROW(writer.write(packet), file_write_error);
+}
+
+TEST_F(BufferedPacketWriterTest, RotateBySize) {
+    EthernetII packet = make_packet(100);
+    const uint32_t record_size = 16 + packet.size();
+    BufferedPacketWriter writer(FILE_NAME, LINK_TYPE_ETHERNET);
+    writer.max_file_size(24 + record_size * 3);
+    for (size_t i = 0; i < 7; ++i) {
+        writer.write(packet);
+    }
+    EXPECT_EQ(2U, writer.file_index());
+    EXPECT_EQ(1ULL, writer.file_packets());
+    created_files.push_back("buffered_packet_writer_test.1.pcap");
+    created_files.push_back("buffered_packet_writer_test.2.pcap");
+    writer.close();
+    EXPECT_EQ(3U, read_records(created_files[0]).size());
+    EXPECT_EQ(1U, read_records(created_files[1]).size());
+}
+
+TEST_F(BufferedPacketWriterTest, RotateByDuration) {
+    EthernetII packet = make_packet(10);
+    BufferedPacketWriter writer(FILE_NAME, LINK_TYPE_ETHERNET);
+    writer.max_file_duration(seconds(60));
+    writer.write(packet, Timestamp(seconds(1000)));
+    writer.write(packet, Timestamp(seconds(1059)));
+    EXPECT_EQ(0U, writer.file_index());
+    writer.write(packet, Timestamp(seconds(1060)));
+    EXPECT_EQ(1U, writer.file_index());
+    writer.write(packet, Timestamp(seconds(1119)));
+    EXPECT_EQ(1U, writer.file_index());
+    created_files.push_back(writer.current_file_name());
+    writer.close();
+    EXPECT_EQ(2U, read_records(FILE_NAME).size());
+    EXPECT_EQ(2U, read_records(created_files[0]).size());
+}
+
+TEST_F(BufferedPacketWriterTest, FileNamesWithoutExtension) {
+    const string file_name = "buffered_packet_writer_test";
+    created_files.push_back(file_name);
+    created_files.push_back(file_name + ".1");
+    BufferedPacketWriter writer(file_name, LINK_TYPE_ETHERNET);
+    writer.rotate();
+    EXPECT_EQ(file_name + ".1", writer.current_file_name());
+}
+
+TEST_F(BufferedPacketWriterTest, OpenError) {
+    EXPECT_THROW(
+        BufferedPacketWriter("non_existent_directory/file.pcap", LINK_TYPE_ETHERNET),
+        file_open_error
+    );
+}
+
+#endif // TINS_IS_CXX11 && !_WIN32
@@ -0,0 +1,330 @@
+#include <tins/cxxstd.h>
+
+#if TINS_IS_CXX11 && !defined(_WIN32)
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <tins/capture_store.h>
+#include <tins/buffered_packet_writer.h>
+#include <tins/ethernetII.h>
+#include <tins/dot1q.h>
+#include <tins/arp.h>
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/tcp.h>
+#include <tins/udp.h>
+#include <tins/rawpdu.h>
+#include <tins/packet.h>
+#include <tins/exceptions.h>
+
+using std::string;
+using std::vector;
+using std::chrono::seconds;
+using std::chrono::milliseconds;
+
+using namespace Tins;
+
+class CaptureStoreTest : public testing::Test {
+public:
+    typedef CaptureStore::FlowKey FlowKey;
+
+    static const int LINK_TYPE_ETHERNET = 1;
+    static const int LINK_TYPE_RAW = 101;
+    static const string FILE_NAME;
+
+    ~CaptureStoreTest();
+
+    static FlowKey key_for(PDU& pdu, int link_type = LINK_TYPE_ETHERNET);
+    static vector<PDU::serialization_type> to_buffers(const vector<CaptureStoreReader::Record>& records);
+};
+
+const int CaptureStoreTest::LINK_TYPE_ETHERNET;
+const int CaptureStoreTest::LINK_TYPE_RAW;
+const string CaptureStoreTest::FILE_NAME = "capture_store_test.pcap";
+
+CaptureStoreTest::~CaptureStoreTest() {
+    for (uint32_t i = 0; i < 32; ++i) {
+        const string file_name = BufferedPacketWriter::file_name(FILE_NAME, i);
+        remove(file_name.c_str());
+        remove((file_name + CaptureStore::INDEX_SUFFIX).c_str());
+    }
+}
+
+CaptureStore::FlowKey CaptureStoreTest::key_for(PDU& pdu, int link_type) {
+    PDU::serialization_type buffer = pdu.serialize();
+    FlowKey key;
+    EXPECT_TRUE(FlowKey::from_frame(&buffer[0], buffer.size(), link_type, key));
+    return key;
+}
+
+vector<PDU::serialization_type> CaptureStoreTest::to_buffers(
+    const vector<CaptureStoreReader::Record>& records) {
+    vector<PDU::serialization_type> output;
+    for (size_t i = 0; i < records.size(); ++i) {
+        output.push_back(records[i].data);
+    }
+    return output;
+}
+
+TEST_F(CaptureStoreTest, FlowKeyIgnoresDirection) {
+    EthernetII request = EthernetII() / IP("10.0.0.1", "10.0.0.2") / TCP(80, 1337);
+    EthernetII response = EthernetII() / IP("10.0.0.2", "10.0.0.1") / TCP(1337, 80);
+    const FlowKey key = key_for(request);
+    EXPECT_EQ(key, key_for(response));
+    EXPECT_EQ(key.hash(), key_for(response).hash());
+    // IP and TCP take the destination first
+    EXPECT_EQ(FlowKey(IPv4Address("10.0.0.2"), 1337, IPv4Address("10.0.0.1"), 80, 6), key);
+    EXPECT_EQ(4, key.ip_version);
+    EXPECT_EQ(6, key.protocol);
+
+    EthernetII other = EthernetII() / IP("10.0.0.1", "10.0.0.2") / UDP(80, 1337);
+    EXPECT_NE(key, key_for(other));
+}
+
+TEST_F(CaptureStoreTest, FlowKeyFromFrames) {
+    EthernetII tagged = EthernetII() / Dot1Q(10) / IP("10.0.0.1", "10.0.0.2") / UDP(53, 1000);
+    EXPECT_EQ(FlowKey(IPv4Address("10.0.0.1"), 53, IPv4Address("10.0.0.2"), 1000, 17),
+              key_for(tagged));
+
+    IP raw = IP("10.0.0.1", "10.0.0.2") / UDP(53, 1000);
+    EXPECT_EQ(key_for(tagged), key_for(raw, LINK_TYPE_RAW));
+
+    EthernetII ipv6 = EthernetII() / IPv6("fe80::1", "fe80::2") / TCP(22, 2222);
+    EXPECT_EQ(FlowKey(IPv6Address("fe80::2"), 2222, IPv6Address("fe80::1"), 22, 6),
+              key_for(ipv6));
+
+    FlowKey key;
+    EthernetII arp = EthernetII() / ARP();
+    PDU::serialization_type buffer = arp.serialize();
+    EXPECT_FALSE(FlowKey::from_frame(&buffer[0], buffer.size(), LINK_TYPE_ETHERNET, key));
+
+    // Only the first fragment has ports
+    IP fragment = IP("10.0.0.1", "10.0.0.2") / RawPDU("data");
+    fragment.fragment_offset(10);
+    buffer = fragment.serialize();
+    EXPECT_FALSE(FlowKey::from_frame(&buffer[0], buffer.size(), LINK_TYPE_RAW, key));
+
+    // Truncated frames and unknown link types are ignored
+    buffer = tagged.serialize();
+    EXPECT_FALSE(FlowKey::from_frame(&buffer[0], 20, LINK_TYPE_ETHERNET, key));
+    EXPECT_FALSE(FlowKey::from_frame(&buffer[0], buffer.size(), 127, key));
+}
+
+TEST_F(CaptureStoreTest, ReadFlows) {
+    EthernetII tcp_request = EthernetII() / IP("10.0.0.1", "10.0.0.2") / TCP(80, 1337) /
+                             RawPDU("GET /");
+    EthernetII tcp_response = EthernetII() / IP("10.0.0.2", "10.0.0.1") / TCP(1337, 80) /
+                              RawPDU("200 OK");
+    EthernetII udp = EthernetII() / IP("10.0.0.3", "8.8.8.8") / UDP(5353, 53);
+    EthernetII ipv6 = EthernetII() / IPv6("fe80::1", "fe80::2") / TCP(22, 2222);
+    EthernetII arp = EthernetII() / ARP();
+
+    vector<PDU::serialization_type> tcp_packets;
+    vector<PDU::serialization_type> udp_packets;
+    vector<string> completed;
+    {
+        CaptureStore store(FILE_NAME, LINK_TYPE_ETHERNET);
+        store.max_file_packets(7);
+        store.rotation_callback([&](const string& file_name) {
+            completed.push_back(file_name);
+        });
+        for (size_t i = 0; i < 20; ++i) {
+            const Timestamp timestamp(seconds(1000 + i));
+            EthernetII& tcp = (i % 2 == 0) ? tcp_request : tcp_response;
+            store.write(tcp, timestamp);
+            tcp_packets.push_back(tcp.serialize());
+            if (i % 4 == 0) {
+                Packet packet(udp, timestamp);
+                store.write(packet);
+                udp_packets.push_back(udp.serialize());
+            }
+            if (i % 5 == 0) {
+                store.write(arp, timestamp);
+            }
+        }
+        store.write(ipv6, Timestamp(seconds(2000)));
+        store.close();
+        EXPECT_EQ(30ULL, store.packets_written());
+    }
+    ASSERT_EQ(5U, completed.size());
+    EXPECT_EQ(FILE_NAME, completed[0]);
+
+    CaptureStoreReader reader(FILE_NAME);
+    EXPECT_EQ(5U, reader.file_count());
+    EXPECT_EQ(LINK_TYPE_ETHERNET, reader.link_type());
+    vector<CaptureStoreReader::Record> records = reader.read_flow(key_for(tcp_request));
+    EXPECT_EQ(tcp_packets, to_buffers(records));
+    ASSERT_EQ(20U, records.size());
+    EXPECT_EQ(1000, records[0].timestamp.seconds());
+    EXPECT_EQ(1019, records[19].timestamp.seconds());
+    EXPECT_EQ(tcp_packets[0].size(), records[0].original_size);
+
+    EXPECT_EQ(udp_packets, to_buffers(reader.read_flow(key_for(udp))));
+    EXPECT_EQ(1U, reader.read_flow(key_for(ipv6)).size());
+    EthernetII unknown = EthernetII() / IP("1.1.1.1", "2.2.2.2") / UDP(1, 2);
+    EXPECT_EQ(0U, reader.read_flow(key_for(unknown)).size());
+
+    vector<CaptureStoreReader::FlowInfo> flows = reader.flows();
+    ASSERT_EQ(3U, flows.size());
+    for (size_t i = 0; i < flows.size(); ++i) {
+        if (flows[i].key == key_for(tcp_request)) {
+            EXPECT_EQ(20ULL, flows[i].packets);
+        }
+        else if (flows[i].key == key_for(udp)) {
+            EXPECT_EQ(5ULL, flows[i].packets);
+        }
+        else {
+            EXPECT_EQ(key_for(ipv6), flows[i].key);
+            EXPECT_EQ(1ULL, flows[i].packets);
+        }
+    }
+}
+
+TEST_F(CaptureStoreTest, ReadTimeRange) {
+    vector<PDU::serialization_type> expected;
+    {
+        CaptureStore store(FILE_NAME, LINK_TYPE_ETHERNET);
+        store.max_file_packets(50);
+        for (size_t i = 0; i < 200; ++i) {
+            // 4 packets every second
+            const Timestamp timestamp(seconds(1000) + milliseconds(250 * i));
+            EthernetII packet = EthernetII() / IP("10.0.0.1", "10.0.0.2") /
+                                UDP(1000 + i, 53);
+            if (timestamp.seconds() >= 1010 && timestamp.seconds() < 1020) {
+                expected.push_back(packet.serialize());
+            }
+            store.write(packet, timestamp);
+        }
+    }
+    CaptureStoreReader reader(FILE_NAME);
+    EXPECT_EQ(4U, reader.file_count());
+    // This range spans 2 files
+    vector<CaptureStoreReader::Record> records =
+        reader.read_time_range(Timestamp(seconds(1010)), Timestamp(seconds(1020)));
+    EXPECT_EQ(expected, to_buffers(records));
+
+    // Ranges not aligned to buckets
+    records = reader.read_time_range(Timestamp(milliseconds(1010100)),
+                                     Timestamp(milliseconds(1010600)));
+    ASSERT_EQ(2U, records.size());
+    EXPECT_EQ(expected[1], records[0].data);
+    EXPECT_EQ(expected[2], records[1].data);
+
+    EXPECT_EQ(0U, reader.read_time_range(Timestamp(seconds(0)),
+                                         Timestamp(seconds(1000))).size());
+    EXPECT_EQ(200U, reader.read_time_range(Timestamp(seconds(0)),
+                                           Timestamp(seconds(2000))).size());
+}
+
+TEST_F(CaptureStoreTest, WriteEmptyPDU) {
+    {
+        CaptureStore store(FILE_NAME, LINK_TYPE_ETHERNET);
+        RawPDU packet((const uint8_t*)0, 0);
+        store.write(packet, Timestamp(seconds(1)));
+    }
+    CaptureStoreReader reader(FILE_NAME);
+    vector<CaptureStoreReader::Record> records =
+        reader.read_time_range(Timestamp(seconds(0)), Timestamp(seconds(2)));
+    ASSERT_EQ(1U, records.size());
+    EXPECT_TRUE(records[0].data.empty());
+}
+
+TEST_F(CaptureStoreTest, BucketDuration) {
+    {
+        CaptureStore store(FILE_NAME, LINK_TYPE_ETHERNET);
+        store.bucket_duration(seconds(60));
+        EthernetII packet = EthernetII() / IP("10.0.0.1", "10.0.0.2") / UDP(1, 53);
+        for (size_t i = 0; i < 10; ++i) {
+            store.write(packet, Timestamp(seconds(1000 + i * 30)));
+        }
+    }
+    CaptureStoreReader reader(FILE_NAME);
+    EXPECT_EQ(3U, reader.read_time_range(Timestamp(seconds(1030)),
+                                         Timestamp(seconds(1120))).size());
+}
+
+TEST_F(CaptureStoreTest, RestartRemovesStaleIndexes) {
+    EthernetII packet = EthernetII() / IP("10.0.0.1", "10.0.0.2") / UDP(1, 53);
+    {
+        CaptureStore store(FILE_NAME, LINK_TYPE_ETHERNET);
+        store.max_file_packets(2);
+        for (size_t i = 0; i < 6; ++i) {
+            store.write(packet, Timestamp(seconds(1000 + i)));
+        }
+    }
+    EXPECT_EQ(3U, CaptureStoreReader(FILE_NAME).file_count());
+    {
+        CaptureStore store(FILE_NAME, LINK_TYPE_ETHERNET);
+        store.write(packet, Timestamp(seconds(5000)));
+    }
+    // Only the new file is indexed
+    CaptureStoreReader reader(FILE_NAME);
+    EXPECT_EQ(1U, reader.file_count());
+    vector<CaptureStoreReader::Record> records = reader.read_flow(key_for(packet));
+    ASSERT_EQ(1U, records.size());
+    EXPECT_EQ(5000, records[0].timestamp.seconds());
+}
+
+TEST_F(CaptureStoreTest, FailedIndexWriteDropsEntries) {
+    EthernetII first = EthernetII() / IP("10.0.0.1", "10.0.0.2") / UDP(1, 53);
+    EthernetII second = EthernetII() / IP("10.0.0.3", "10.0.0.4") / UDP(2, 53);
+    const string failed_file_name = BufferedPacketWriter::file_name(FILE_NAME, 1);
+    const string last_file_name = BufferedPacketWriter::file_name(FILE_NAME, 2);
+    const string moved_file_name = "capture_store_test_moved.pcap";
+    // The index for the second file can't be written
+    const string blocker = failed_file_name + CaptureStore::INDEX_SUFFIX + ".tmp";
+    ASSERT_EQ(0, mkdir(blocker.c_str(), 0700));
+    {
+        CaptureStore store(FILE_NAME, LINK_TYPE_ETHERNET);
+        store.max_file_packets(2);
+        for (size_t i = 0; i < 4; ++i) {
+            store.write(first, Timestamp(seconds(1000 + i)));
+        }
+        EXPECT_THROW(store.write(second, Timestamp(seconds(1004))), file_open_error);
+        rmdir(blocker.c_str());
+        store.write(second, Timestamp(seconds(1005)));
+        store.write(second, Timestamp(seconds(1006)));
+    }
+    // The last file's index only contains its own records
+    rename(last_file_name.c_str(), moved_file_name.c_str());
+    rename((last_file_name + CaptureStore::INDEX_SUFFIX).c_str(),
+           (moved_file_name + CaptureStore::INDEX_SUFFIX).c_str());
+    {
+        CaptureStoreReader reader(moved_file_name);
+        EXPECT_EQ(0U, reader.read_flow(key_for(first)).size());
+        EXPECT_EQ(2U, reader.read_flow(key_for(second)).size());
+        EXPECT_EQ(2U, reader.read_time_range(Timestamp(seconds(0)),
+                                             Timestamp(seconds(2000))).size());
+    }
+    remove(moved_file_name.c_str());
+    remove((moved_file_name + CaptureStore::INDEX_SUFFIX).c_str());
+}
+
+TEST_F(CaptureStoreTest, MissingIndex) {
+    EXPECT_THROW(CaptureStoreReader reader(FILE_NAME), file_open_error);
+}
+
+TEST_F(CaptureStoreTest, InvalidIndex) {
+    {
+        CaptureStore store(FILE_NAME, LINK_TYPE_ETHERNET);
+        EthernetII packet = EthernetII() / IP("10.0.0.1", "10.0.0.2") / UDP(1, 53);
+        store.write(packet, Timestamp(seconds(1)));
+    }
+    // Truncate the index
+    const string index_file_name = FILE_NAME + CaptureStore::INDEX_SUFFIX;
+    std::ifstream input(index_file_name.c_str(), std::ios::binary);
+    string contents((std::istreambuf_iterator<char>(input)),
+                    std::istreambuf_iterator<char>());
+    input.close();
+    std::ofstream output(index_file_name.c_str(), std::ios::binary);
+    output << contents.substr(0, contents.size() - 1);
+    output.close();
+    EXPECT_THROW(CaptureStoreReader reader(FILE_NAME), file_read_error);
+}
+
+#endif // TINS_IS_CXX11 && !_WIN32
@@ -0,0 +1,209 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <tins/dns_builder.h>
+#include <tins/dns.h>
+#include <tins/exceptions.h>
+
+using std::string;
+using std::vector;
+
+using namespace Tins;
+
+class DNSBuilderTest : public testing::Test {
+public:
+    static const uint32_t BUFFER_SIZE = 512;
+
+    static void add_records(DNS& dns);
+    static void add_records(DNSBuilder& builder);
+    static void test_equals(const DNS::resources_type& resources1,
+                            const DNS::resources_type& resources2);
+
+    uint8_t buffer[BUFFER_SIZE];
+};
+
+const uint32_t DNSBuilderTest::BUFFER_SIZE;
+
+void DNSBuilderTest::add_records(DNS& dns) {
+    dns.add_query(DNS::query("www.example.com", DNS::A, DNS::INTERNET));
+    dns.add_query(DNS::query("example.com", DNS::MX, DNS::INTERNET));
+    dns.add_answer(DNS::resource("www.example.com", "192.168.0.1", DNS::A,
+                                 DNS::INTERNET, 0x1234));
+    dns.add_answer(DNS::resource("example.com", "mail.example.com", DNS::MX,
+                                 DNS::INTERNET, 0x762, 10));
+    dns.add_authority(DNS::resource("example.com", "ns1.example.com", DNS::NS,
+                                    DNS::INTERNET, 0x762));
+    dns.add_additional(DNS::resource("ns1.example.com", "f9a8::1", DNS::AAAA,
+                                     DNS::INTERNET, 0x9823));
+    dns.add_additional(DNS::resource("ns1.example.com", "some text", DNS::TXT,
+                                     DNS::INTERNET, 0x9823));
+}
+
+void DNSBuilderTest::add_records(DNSBuilder& builder) {
+    builder.add_query(DNS::query("www.example.com", DNS::A, DNS::INTERNET));
+    builder.add_query(DNS::query("example.com", DNS::MX, DNS::INTERNET));
+    builder.add_answer(DNS::resource("www.example.com", "192.168.0.1", DNS::A,
+                                     DNS::INTERNET, 0x1234));
+    builder.add_answer(DNS::resource("example.com", "mail.example.com", DNS::MX,
+                                     DNS::INTERNET, 0x762, 10));
+    builder.add_authority(DNS::resource("example.com", "ns1.example.com", DNS::NS,
+                                        DNS::INTERNET, 0x762));
+    builder.add_additional(DNS::resource("ns1.example.com", "f9a8::1", DNS::AAAA,
+                                         DNS::INTERNET, 0x9823));
+    builder.add_additional(DNS::resource("ns1.example.com", "some text", DNS::TXT,
+                                         DNS::INTERNET, 0x9823));
+}
+
+void DNSBuilderTest::test_equals(const DNS::resources_type& resources1,
+                                 const DNS::resources_type& resources2) {
+    ASSERT_EQ(resources1.size(), resources2.size());
+    for (size_t i = 0; i < resources1.size(); ++i) {
+        EXPECT_EQ(resources1[i].dname(), resources2[i].dname());
+        EXPECT_EQ(resources1[i].data(), resources2[i].data());
+        EXPECT_EQ(resources1[i].query_type(), resources2[i].query_type());
+        EXPECT_EQ(resources1[i].query_class(), resources2[i].query_class());
+        EXPECT_EQ(resources1[i].ttl(), resources2[i].ttl());
+        EXPECT_EQ(resources1[i].preference(), resources2[i].preference());
+    }
+}
+
+TEST_F(DNSBuilderTest, UncompressedMatchesDNS) {
+    DNS dns;
+    dns.id(0x9a7d);
+    dns.type(DNS::RESPONSE);
+    dns.opcode(0xa);
+    dns.authoritative_answer(1);
+    dns.recursion_desired(1);
+    dns.recursion_available(1);
+    dns.checking_disabled(1);
+    dns.rcode(0x3);
+    add_records(dns);
+
+    DNSBuilder builder(buffer, sizeof(buffer));
+    EXPECT_TRUE(builder.compression());
+    builder.compression(false);
+    builder.id(0x9a7d);
+    builder.type(DNS::RESPONSE);
+    builder.opcode(0xa);
+    builder.authoritative_answer(1);
+    builder.recursion_desired(1);
+    builder.recursion_available(1);
+    builder.checking_disabled(1);
+    builder.rcode(0x3);
+    add_records(builder);
+    EXPECT_EQ(2U, builder.count(DNS::QUESTIONS));
+    EXPECT_EQ(2U, builder.count(DNS::ANSWERS));
+    EXPECT_EQ(1U, builder.count(DNS::AUTHORITY));
+    EXPECT_EQ(2U, builder.count(DNS::ADDITIONAL));
+
+    DNS::serialization_type expected = dns.serialize();
+    EXPECT_EQ(expected, DNS::serialization_type(buffer, buffer + builder.size()));
+}
+
+TEST_F(DNSBuilderTest, CompressedNames) {
+    DNS dns;
+    add_records(dns);
+    DNS::serialization_type uncompressed = dns.serialize();
+
+    DNSBuilder builder(buffer, sizeof(buffer));
+    add_records(builder);
+    EXPECT_LT(builder.size(), uncompressed.size());
+
+    const DNS parsed(buffer, builder.size());
+    ASSERT_EQ(2U, parsed.queries().size());
+    EXPECT_EQ("www.example.com", parsed.queries()[0].dname());
+    EXPECT_EQ("example.com", parsed.queries()[1].dname());
+    EXPECT_EQ(DNS::MX, parsed.queries()[1].query_type());
+    test_equals(dns.answers(), parsed.answers());
+    test_equals(dns.authority(), parsed.authority());
+    test_equals(dns.additional(), parsed.additional());
+}
+
+TEST_F(DNSBuilderTest, CompressedNameLayout) {
+    DNSBuilder builder(buffer, sizeof(buffer));
+    builder.add_query(DNS::query("www.example.com", DNS::A, DNS::INTERNET));
+    const uint32_t query_size = builder.size();
+    // Suffixes are compared case insensitively
+    builder.add_answer(DNS::resource("WWW.Example.COM", "192.168.0.1", DNS::A,
+                                     DNS::INTERNET, 1));
+    EXPECT_EQ(query_size + 2 + 10 + 4, builder.size());
+    EXPECT_EQ(0xc0, buffer[query_size]);
+    EXPECT_EQ(12, buffer[query_size + 1]);
+
+    // Only the first label is written
+    const uint32_t answer_size = builder.size();
+    builder.add_answer(DNS::resource("mail.example.com", "192.168.0.2", DNS::A,
+                                     DNS::INTERNET, 1));
+    EXPECT_EQ(4, buffer[answer_size]);
+    EXPECT_EQ(0xc0, buffer[answer_size + 5]);
+    EXPECT_EQ(16, buffer[answer_size + 6]);
+
+    const DNS parsed(buffer, builder.size());
+    ASSERT_EQ(2U, parsed.answers().size());
+    EXPECT_EQ("www.example.com", parsed.answers()[0].dname());
+    EXPECT_EQ("mail.example.com", parsed.answers()[1].dname());
+}
+
+TEST_F(DNSBuilderTest, SectionOrder) {
+    DNSBuilder builder(buffer, sizeof(buffer));
+    builder.add_answer(DNS::resource("example.com", "192.168.0.1", DNS::A,
+                                     DNS::INTERNET, 1));
+    EXPECT_THROW(builder.add_query(DNS::query("example.com", DNS::A, DNS::INTERNET)),
+                 dns_section_out_of_order);
+    builder.add_additional(DNS::resource("example.com", "192.168.0.1", DNS::A,
+                                         DNS::INTERNET, 1));
+    EXPECT_THROW(builder.add_authority(DNS::resource("example.com", "192.168.0.1",
+                                                     DNS::A, DNS::INTERNET, 1)),
+                 dns_section_out_of_order);
+
+    builder.reset();
+    EXPECT_EQ(12U, builder.size());
+    builder.add_query(DNS::query("example.com", DNS::A, DNS::INTERNET));
+    EXPECT_EQ(1U, builder.count(DNS::QUESTIONS));
+    EXPECT_EQ(0U, builder.count(DNS::ANSWERS));
+}
+
+TEST_F(DNSBuilderTest, BufferTooSmall) {
+    EXPECT_THROW(DNSBuilder(buffer, 11), serialization_error);
+
+    DNSBuilder builder(buffer, 49);
+    builder.add_query(DNS::query("www.example.com", DNS::A, DNS::INTERNET));
+    const uint32_t size = builder.size();
+    EXPECT_THROW(
+        builder.add_answer(DNS::resource("some.other.name.com", "192.168.0.1",
+                                         DNS::A, DNS::INTERNET, 1)),
+        serialization_error
+    );
+    // The failed record leaves no trace
+    EXPECT_EQ(size, builder.size());
+    EXPECT_EQ(0U, builder.count(DNS::ANSWERS));
+    builder.truncated(1);
+    builder.add_answer(DNS::resource("www.example.com", "192.168.0.1",
+                                     DNS::A, DNS::INTERNET, 1));
+
+    const DNS parsed(buffer, builder.size());
+    EXPECT_EQ(1, parsed.truncated());
+    ASSERT_EQ(1U, parsed.answers().size());
+    EXPECT_EQ("www.example.com", parsed.answers()[0].dname());
+}
+
+TEST_F(DNSBuilderTest, InvalidNames) {
+    DNSBuilder builder(buffer, sizeof(buffer));
+    EXPECT_THROW(builder.add_query(DNS::query("www..com", DNS::A, DNS::INTERNET)),
+                 invalid_domain_name);
+    EXPECT_THROW(builder.add_query(DNS::query(string(64, 'a') + ".com", DNS::A,
+                                              DNS::INTERNET)),
+                 invalid_domain_name);
+    string long_name;
+    for (size_t i = 0; i < 26; ++i) {
+        long_name += "abcdefghi.";
+    }
+    EXPECT_THROW(builder.add_query(DNS::query(long_name, DNS::A, DNS::INTERNET)),
+                 invalid_domain_name);
+    EXPECT_EQ(12U, builder.size());
+
+    // A trailing dot is fine
+    builder.add_query(DNS::query("example.com.", DNS::A, DNS::INTERNET));
+    const DNS parsed(buffer, builder.size());
+    EXPECT_EQ("example.com", parsed.queries()[0].dname());
+}
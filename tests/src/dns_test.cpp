@@ -1,7 +1,11 @@
 #include <gtest/gtest.h>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 #include <tins/dns.h>
+#include <tins/ip_address.h>
 #include <tins/ipv6_address.h>
+#include <tins/exceptions.h>
 
 using namespace Tins;
 
@@ -661,3 +665,119 @@ TEST_F(DNSTest, BadPacketLength) {
 }
 
 
+
+TEST_F(DNSTest, RecordCursor) {
+    const DNS dns(dns_response1, sizeof(dns_response1));
+    DNS::record_view record;
+
+    DNS::record_cursor questions = dns.records(DNS::QUESTIONS);
+    ASSERT_TRUE(questions.next(record));
+    EXPECT_EQ(DNS::QUESTIONS, record.section());
+    EXPECT_EQ("google.com", record.name().to_string());
+    EXPECT_EQ(DNS::MX, record.type());
+    EXPECT_EQ(DNS::INTERNET, record.query_class());
+    EXPECT_EQ(0U, record.data_size());
+    EXPECT_FALSE(questions.next(record));
+
+    const char* expected_names[] = {
+        "alt4.aspmx.l.google.com", "alt3.aspmx.l.google.com",
+        "alt1.aspmx.l.google.com", "aspmx.l.google.com", "alt2.aspmx.l.google.com"
+    };
+    const uint16_t expected_preferences[] = { 50, 40, 20, 10, 30 };
+    DNS::resources_type answers = dns.answers();
+    DNS::record_cursor cursor = dns.records(DNS::ANSWERS);
+    size_t count = 0;
+    while (cursor.next(record)) {
+        ASSERT_LT(count, answers.size());
+        EXPECT_EQ(DNS::ANSWERS, record.section());
+        EXPECT_TRUE(record.name().matches("google.com"));
+        EXPECT_EQ(DNS::MX, record.type());
+        EXPECT_EQ(600U, record.ttl());
+        EXPECT_EQ(expected_preferences[count], record.preference());
+        EXPECT_EQ(expected_names[count], record.data_name().to_string());
+        EXPECT_EQ(answers[count].data(), record.data_name().to_string());
+        ++count;
+    }
+    EXPECT_EQ(5U, count);
+    EXPECT_FALSE(dns.records(DNS::AUTHORITY).next(record));
+    EXPECT_FALSE(dns.records(DNS::ADDITIONAL).next(record));
+}
+
+TEST_F(DNSTest, RecordCursorAllSections) {
+    DNS dns;
+    dns.add_query(DNS::query("www.example.com", DNS::A, DNS::INTERNET));
+    dns.add_answer(DNS::resource("www.example.com", "192.168.0.1", DNS::A,
+                                 DNS::INTERNET, 0x1234));
+    dns.add_authority(DNS::resource("example.com", "ns.example.com", DNS::NS,
+                                    DNS::INTERNET, 0x762));
+    dns.add_additional(DNS::resource("ns.example.com", "f9a8::1", DNS::AAAA,
+                                     DNS::INTERNET, 0x9823));
+    DNS::serialization_type buffer = dns.serialize();
+    const DNS parsed(&buffer[0], buffer.size());
+    DNS::record_view record;
+
+    DNS::record_cursor cursor = parsed.records(DNS::ANSWERS);
+    ASSERT_TRUE(cursor.next(record));
+    EXPECT_EQ(DNS::A, record.type());
+    EXPECT_EQ(0x1234U, record.ttl());
+    EXPECT_EQ(IPv4Address("192.168.0.1"), record.address());
+    EXPECT_THROW(record.address_v6(), malformed_packet);
+    EXPECT_THROW(record.data_name(), malformed_packet);
+    EXPECT_FALSE(cursor.next(record));
+
+    cursor = parsed.records(DNS::AUTHORITY);
+    ASSERT_TRUE(cursor.next(record));
+    EXPECT_EQ(DNS::AUTHORITY, record.section());
+    EXPECT_TRUE(record.name().matches("example.com"));
+    EXPECT_TRUE(record.data_name().matches("ns.example.com"));
+    EXPECT_FALSE(cursor.next(record));
+
+    cursor = parsed.records(DNS::ADDITIONAL);
+    ASSERT_TRUE(cursor.next(record));
+    EXPECT_EQ(DNS::AAAA, record.type());
+    EXPECT_EQ(IPv6Address("f9a8::1"), record.address_v6());
+    EXPECT_FALSE(cursor.next(record));
+}
+
+TEST_F(DNSTest, NameViewMatches) {
+    const DNS dns(dns_response1, sizeof(dns_response1));
+    DNS::record_view record;
+    DNS::record_cursor cursor = dns.records(DNS::ANSWERS);
+    ASSERT_TRUE(cursor.next(record));
+    const DNS::name_view name = record.data_name();
+    EXPECT_TRUE(name.matches("alt4.aspmx.l.google.com"));
+    EXPECT_TRUE(name.matches("ALT4.AspMx.L.Google.COM."));
+    EXPECT_TRUE(name.matches(std::string("alt4.aspmx.l.google.com")));
+    EXPECT_FALSE(name.matches("alt4.aspmx.l.google"));
+    EXPECT_FALSE(name.matches("alt4.aspmx.l.google.com.ar"));
+    EXPECT_FALSE(name.matches("alt4.aspmx.l.googlecom"));
+    EXPECT_FALSE(name.matches(""));
+
+    const uint8_t labels[] = {
+        4, 'a', 'l', 't', '4', 5, 'a', 's', 'p', 'm', 'x', 1, 'l',
+        6, 'G', 'O', 'O', 'G', 'L', 'E', 3, 'c', 'o', 'm', 0
+    };
+    EXPECT_TRUE(name.matches_labels(labels));
+    EXPECT_FALSE(name.matches_labels(labels + 5));
+
+    char output[DNS::name_view::MAX_NAME_SIZE];
+    EXPECT_EQ(23U, name.decode(output, sizeof(output)));
+    EXPECT_EQ(std::string("alt4.aspmx.l.google.com"), output);
+    EXPECT_EQ(23U, name.decode(output, 24));
+    EXPECT_THROW(name.decode(output, 23), std::length_error);
+}
+
+TEST_F(DNSTest, RecordCursorPointerLoop) {
+    // The answer's data points to itself
+    const uint8_t payload[] = {
+        0x00, 0x01, 0x81, 0x80, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x05, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x02,
+        0xc0, 0x17
+    };
+    const DNS dns(payload, sizeof(payload));
+    DNS::record_view record;
+    DNS::record_cursor cursor = dns.records(DNS::ANSWERS);
+    ASSERT_TRUE(cursor.next(record));
+    EXPECT_EQ(DNS::CNAME, record.type());
+    EXPECT_THROW(record.data_name().to_string(), dns_decompression_pointer_loops);
+}
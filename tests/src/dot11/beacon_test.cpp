@@ -4,6 +4,7 @@
 
 #include <gtest/gtest.h>
 #include <tins/rsn_information.h>
+#include <tins/exceptions.h>
 #include <tins/detail/smart_ptr.h>
 #include "tests/dot11_mgmt.h"
 
@@ -458,6 +459,62 @@ TEST_F(Dot11BeaconTest, PCAPLoad1) {
     EXPECT_TRUE(std::equal(serialized.begin(), serialized.end(), buffer));
 }
 
+// Enables lazy parsing of tagged parameters while in scope
+struct LazyTaggedParametersGuard {
+    LazyTaggedParametersGuard() {
+        Dot11::lazy_tagged_parameters(true);
+    }
+
+    ~LazyTaggedParametersGuard() {
+        Dot11::lazy_tagged_parameters(false);
+    }
+};
+
+TEST_F(Dot11BeaconTest, LazyTaggedParameters) {
+    EXPECT_FALSE(Dot11::lazy_tagged_parameters());
+    LazyTaggedParametersGuard guard;
+    const uint8_t buffer[] = {
+        128, 0, 0, 0, 255, 255, 255, 255, 255, 255, 244, 236, 56, 254, 77, 
+        146, 244, 236, 56, 254, 77, 146, 224, 234, 128, 209, 212, 206, 44, 
+        0, 0, 0, 100, 0, 49, 4, 0, 7, 83, 101, 103, 117, 110, 100, 111, 1, 
+        8, 130, 132, 139, 150, 12, 18, 24, 36, 3, 1, 1, 5, 4, 0, 1, 0, 0, 7, 
+        6, 85, 83, 32, 1, 13, 20, 42, 1, 0, 48, 20, 1, 0, 0, 15, 172, 4, 1, 
+        0, 0, 15, 172, 4, 1, 0, 0, 15, 172, 2, 0, 0, 50, 4, 48, 72, 96, 108, 
+        221, 24, 0, 80, 242, 2, 1, 1, 3, 0, 3, 164, 0, 0, 39, 164, 0, 0, 66, 
+        67, 94, 0, 98, 50, 47, 0, 221, 9, 0, 3, 127, 1, 1, 0, 0, 255, 127
+    };
+    Dot11Beacon dot11(buffer, sizeof(buffer));
+    EXPECT_EQ("Segundo", dot11.ssid());
+    EXPECT_EQ(1, dot11.ds_parameter_set());
+    EXPECT_EQ(0, dot11.erp_information());
+    EXPECT_THROW(dot11.challenge_text(), option_not_found);
+    EXPECT_EQ(sizeof(buffer), dot11.size());
+    Dot11Beacon copy = dot11;
+    EXPECT_EQ(PDU::serialization_type(buffer, buffer + sizeof(buffer)), copy.serialize());
+
+    // Looking up an option through the option list creates all of them
+    const Dot11::option* option = dot11.search_option(Dot11::SSID);
+    ASSERT_TRUE(option != 0);
+    EXPECT_EQ("Segundo", option->to<string>());
+    ASSERT_EQ(10U, dot11.options().size());
+    EXPECT_EQ(Dot11::VENDOR_SPECIFIC, dot11.options().back().option());
+    EXPECT_EQ(9U, dot11.options().back().data_size());
+    EXPECT_EQ(PDU::serialization_type(buffer, buffer + sizeof(buffer)), dot11.serialize());
+    EXPECT_EQ("Segundo", dot11.ssid());
+
+    // So does modifying them
+    EXPECT_TRUE(copy.remove_option(Dot11::SSID));
+    EXPECT_EQ(9U, copy.options().size());
+    EXPECT_EQ(sizeof(buffer) - 9, copy.size());
+    EXPECT_THROW(copy.ssid(), option_not_found);
+    copy.ssid("Segundo");
+    EXPECT_EQ("Segundo", copy.ssid());
+    EXPECT_EQ(sizeof(buffer), copy.serialize().size());
+
+    // Truncated tags are still rejected
+    EXPECT_THROW(Dot11Beacon(buffer, sizeof(buffer) - 1), malformed_packet);
+}
+
 TEST_F(Dot11BeaconTest, Serialize) {
     Dot11Beacon pdu(expected_packet, sizeof(expected_packet));
     PDU::serialization_type buffer = pdu.serialize();
@@ -0,0 +1,286 @@
+#include <tins/config.h>
+#include <gtest/gtest.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <sstream>
+#include <tins/tcp_ip/http_parser.h>
+#include <tins/tcp_ip/http_stream_parser.h>
+#include <tins/tcp_ip/stream_follower.h>
+#include <tins/tcp_ip/stream.h>
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/tcp.h>
+#include <tins/rawpdu.h>
+
+using namespace std;
+using namespace Tins;
+using namespace Tins::TCPIP;
+
+class HTTPParserTest : public testing::Test {
+public:
+    typedef HTTPParser::Slice Slice;
+
+    void setup(HTTPParser& parser);
+    // Feeds data in chunks of the given size, keeping unconsumed bytes around
+    // the way HTTPStreamParser does with a stream's payload
+    void feed(HTTPParser& parser, const string& data, size_t chunk_size);
+
+    vector<string> events;
+    string body;
+};
+
+void HTTPParserTest::setup(HTTPParser& parser) {
+    parser.request_line_callback([&](const HTTPParser::RequestLine& line) {
+        ostringstream oss;
+        oss << "request " << line.method.to_string() << " " << line.target.to_string()
+            << " " << (int)line.version_major << "." << (int)line.version_minor;
+        events.push_back(oss.str());
+    });
+    parser.status_line_callback([&](const HTTPParser::StatusLine& line) {
+        ostringstream oss;
+        oss << "status " << line.status_code << " " << line.reason.to_string();
+        events.push_back(oss.str());
+    });
+    parser.header_callback([&](const Slice& name, const Slice& value) {
+        events.push_back("header " + name.to_string() + "=" + value.to_string());
+    });
+    parser.headers_complete_callback([&]() {
+        events.push_back("headers");
+    });
+    parser.body_callback([&](const Slice& data) {
+        body += data.to_string();
+    });
+    parser.message_complete_callback([&]() {
+        events.push_back("complete " + body);
+        body.clear();
+    });
+}
+
+void HTTPParserTest::feed(HTTPParser& parser, const string& data, size_t chunk_size) {
+    vector<uint8_t> buffer;
+    for (size_t i = 0; i < data.size(); i += chunk_size) {
+        const size_t end = min(data.size(), i + chunk_size);
+        buffer.insert(buffer.end(), data.begin() + i, data.begin() + end);
+        const size_t consumed = parser.parse(buffer.data(), buffer.size());
+        ASSERT_LE(consumed, buffer.size());
+        buffer.erase(buffer.begin(), buffer.begin() + consumed);
+    }
+}
+
+TEST_F(HTTPParserTest, Request) {
+    HTTPParser parser(HTTPParser::REQUEST);
+    setup(parser);
+    const string data = "GET /index.html HTTP/1.1\r\nHost: libtins.github.io\r\n"
+                        "Accept:  */*  \r\n\r\n";
+    feed(parser, data, data.size());
+    vector<string> expected;
+    expected.push_back("request GET /index.html 1.1");
+    expected.push_back("header Host=libtins.github.io");
+    expected.push_back("header Accept=*/*");
+    expected.push_back("headers");
+    expected.push_back("complete ");
+    EXPECT_EQ(expected, events);
+    EXPECT_EQ(1U, parser.messages_parsed());
+    EXPECT_FALSE(parser.is_message_in_progress());
+    EXPECT_FALSE(parser.has_error());
+}
+
+TEST_F(HTTPParserTest, PipelinedRequestsByteByByte) {
+    const string data = "POST /a HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello"
+                        "GET /b HTTP/1.0\nHost: foo\n\n"
+                        "PUT /c HTTP/1.1\r\ncontent-length: 3\r\n\r\nabc";
+    for (size_t chunk_size = 1; chunk_size <= data.size(); ++chunk_size) {
+        events.clear();
+        HTTPParser parser(HTTPParser::REQUEST);
+        setup(parser);
+        feed(parser, data, chunk_size);
+        vector<string> expected;
+        expected.push_back("request POST /a 1.1");
+        expected.push_back("header Content-Length=5");
+        expected.push_back("headers");
+        expected.push_back("complete hello");
+        expected.push_back("request GET /b 1.0");
+        expected.push_back("header Host=foo");
+        expected.push_back("headers");
+        expected.push_back("complete ");
+        expected.push_back("request PUT /c 1.1");
+        expected.push_back("header content-length=3");
+        expected.push_back("headers");
+        expected.push_back("complete abc");
+        ASSERT_EQ(expected, events) << "chunk size " << chunk_size;
+        EXPECT_EQ(3U, parser.messages_parsed());
+    }
+}
+
+TEST_F(HTTPParserTest, ChunkedResponse) {
+    const string data = "HTTP/1.1 200 OK\r\nTransfer-Encoding: gzip, chunked\r\n\r\n"
+                        "5;name=value\r\nhello\r\n"
+                        "7\r\n, world\r\n"
+                        "0\r\nExpires: never\r\n\r\n"
+                        "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+    for (size_t chunk_size = 1; chunk_size <= data.size(); ++chunk_size) {
+        events.clear();
+        HTTPParser parser(HTTPParser::RESPONSE);
+        setup(parser);
+        feed(parser, data, chunk_size);
+        vector<string> expected;
+        expected.push_back("status 200 OK");
+        expected.push_back("header Transfer-Encoding=gzip, chunked");
+        expected.push_back("headers");
+        expected.push_back("complete hello, world");
+        expected.push_back("status 404 Not Found");
+        expected.push_back("header Content-Length=0");
+        expected.push_back("headers");
+        expected.push_back("complete ");
+        ASSERT_EQ(expected, events) << "chunk size " << chunk_size;
+    }
+}
+
+TEST_F(HTTPParserTest, ResponseUntilClose) {
+    HTTPParser parser(HTTPParser::RESPONSE);
+    setup(parser);
+    feed(parser, "HTTP/1.0 200 OK\r\n\r\nsome data", 4);
+    EXPECT_TRUE(parser.is_message_in_progress());
+    EXPECT_EQ(0U, parser.messages_parsed());
+    parser.finish();
+    EXPECT_EQ(1U, parser.messages_parsed());
+    EXPECT_EQ("complete some data", events.back());
+}
+
+TEST_F(HTTPParserTest, ResponsesWithoutBody) {
+    HTTPParser requests(HTTPParser::REQUEST);
+    HTTPParser responses(HTTPParser::RESPONSE);
+    requests.link_response_parser(&responses);
+    setup(responses);
+    const string request_data = "HEAD / HTTP/1.1\r\n\r\nGET / HTTP/1.1\r\n\r\n";
+    feed(requests, request_data, request_data.size());
+    // The first response answers a HEAD request, so its Content-Length
+    // doesn't describe its body
+    const string response_data = "HTTP/1.1 100 Continue\r\n\r\n"
+                                 "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\n"
+                                 "HTTP/1.1 304 Not Modified\r\n\r\n";
+    feed(responses, response_data, 3);
+    EXPECT_EQ(3U, responses.messages_parsed());
+    EXPECT_FALSE(responses.is_message_in_progress());
+    EXPECT_FALSE(responses.has_error());
+}
+
+TEST_F(HTTPParserTest, Upgrade) {
+    HTTPParser parser(HTTPParser::RESPONSE);
+    setup(parser);
+    const string data = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n\r\n"
+                        "\x81\x05hello";
+    const size_t consumed = parser.parse((const uint8_t*)data.data(), data.size());
+    EXPECT_EQ(data.size() - 7, consumed);
+    EXPECT_TRUE(parser.is_upgraded());
+    EXPECT_EQ(1U, parser.messages_parsed());
+}
+
+TEST_F(HTTPParserTest, MalformedData) {
+    const char* inputs[] = {
+        "GET\r\n\r\n",
+        "GET / FTP/1.1\r\n\r\n",
+        "GET / HTTP/1.1\r\nHost\r\n\r\n",
+        "GET / HTTP/1.1\r\nHost : foo\r\n\r\n",
+        "POST / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n1\r\naX\r\n",
+    };
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i) {
+        HTTPParser parser(HTTPParser::REQUEST);
+        const string data = inputs[i];
+        parser.parse((const uint8_t*)data.data(), data.size());
+        EXPECT_TRUE(parser.has_error()) << data;
+        // Nothing else is consumed after an error
+        EXPECT_EQ(0U, parser.parse((const uint8_t*)data.data(), data.size()));
+    }
+}
+
+TEST_F(HTTPParserTest, LineTooLong) {
+    HTTPParser parser(HTTPParser::REQUEST);
+    parser.max_line_size(16);
+    const string data = "GET /a/very/long/path";
+    EXPECT_EQ(0U, parser.parse((const uint8_t*)data.data(), data.size()));
+    EXPECT_TRUE(parser.has_error());
+}
+
+TEST_F(HTTPParserTest, StreamParser) {
+    const string request = "GET /a HTTP/1.1\r\nHost: foo\r\n\r\n"
+                           "GET /b HTTP/1.1\r\nHost: foo\r\n\r\n";
+    const string response = "HTTP/1.1 200 OK\r\nContent-Length: 3\r\n\r\nabc"
+                            "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                            "2\r\nde\r\n0\r\n\r\n";
+    vector<string> targets;
+    vector<string> bodies;
+    size_t client_buffered = 0;
+    StreamFollower follower;
+    shared_ptr<HTTPStreamParser> http_parser = make_shared<HTTPStreamParser>();
+    http_parser->request_parser().request_line_callback(
+        [&](const HTTPParser::RequestLine& line) {
+            targets.push_back(line.target.to_string());
+        });
+    http_parser->response_parser().body_callback([&](const Slice& data) {
+        bodies.push_back(data.to_string());
+    });
+    follower.new_stream_callback([&](Stream& stream) {
+        http_parser->attach(stream);
+    });
+
+    const uint32_t client_seq = 100;
+    const uint32_t server_seq = 5000;
+    EthernetII syn = EthernetII() / IP("4.3.2.1", "1.2.3.4") / TCP(80, 1234);
+    syn.rfind_pdu<TCP>().flags(TCP::SYN);
+    syn.rfind_pdu<TCP>().seq(client_seq - 1);
+    follower.process_packet(syn);
+    EthernetII syn_ack = EthernetII() / IP("1.2.3.4", "4.3.2.1") / TCP(1234, 80);
+    syn_ack.rfind_pdu<TCP>().flags(TCP::SYN | TCP::ACK);
+    syn_ack.rfind_pdu<TCP>().seq(server_seq - 1);
+    syn_ack.rfind_pdu<TCP>().ack_seq(client_seq);
+    follower.process_packet(syn_ack);
+
+    // Send everything in small segments
+    const size_t segment_size = 7;
+    for (size_t i = 0; i < request.size(); i += segment_size) {
+        EthernetII packet = EthernetII() / IP("4.3.2.1", "1.2.3.4") / TCP(80, 1234) /
+                            RawPDU(request.substr(i, segment_size));
+        packet.rfind_pdu<TCP>().flags(TCP::ACK);
+        packet.rfind_pdu<TCP>().seq(client_seq + i);
+        follower.process_packet(packet);
+        Stream& stream = follower.find_stream(IPv4Address("1.2.3.4"), 1234,
+                                              IPv4Address("4.3.2.1"), 80);
+        client_buffered = max(client_buffered, stream.client_payload().size());
+    }
+    for (size_t i = 0; i < response.size(); i += segment_size) {
+        EthernetII packet = EthernetII() / IP("1.2.3.4", "4.3.2.1") / TCP(1234, 80) /
+                            RawPDU(response.substr(i, segment_size));
+        packet.rfind_pdu<TCP>().flags(TCP::ACK);
+        packet.rfind_pdu<TCP>().seq(server_seq + i);
+        follower.process_packet(packet);
+    }
+    vector<string> expected_targets;
+    expected_targets.push_back("/a");
+    expected_targets.push_back("/b");
+    EXPECT_EQ(expected_targets, targets);
+    string full_body;
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        full_body += bodies[i];
+    }
+    EXPECT_EQ("abcde", full_body);
+    EXPECT_EQ(2U, http_parser->request_parser().messages_parsed());
+    EXPECT_EQ(2U, http_parser->response_parser().messages_parsed());
+    // Only incomplete lines should have been kept in the stream's buffer
+    EXPECT_LT(client_buffered, 32U);
+}
+
+#else
+
+TEST(HTTPParser, Dummy) {
+    
+}
+
+#endif // TINS_HAVE_TCPIP
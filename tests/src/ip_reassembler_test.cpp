@@ -7,6 +7,8 @@
 #include <tins/udp.h>
 #include <tins/ip.h>
 #include <tins/rawpdu.h>
+#include <tins/timestamp.h>
+#include <tins/constants.h>
 
 using std::vector;
 using std::pair;
@@ -20,8 +22,31 @@ public:
     static const size_t packet_sizes[], orderings[][11];
     
     void test_packets(const vector<pair<const uint8_t*, size_t> >& vt);
+    static IP make_fragment(uint16_t id, uint16_t offset, size_t size, bool more_fragments);
+    static Timestamp make_timestamp(long seconds);
 };
 
+IP IPv4ReassemblerTest::make_fragment(uint16_t id, uint16_t offset, size_t size,
+                                      bool more_fragments) {
+    vector<uint8_t> payload(size);
+    for (size_t i = 0; i < size; ++i) {
+        payload[i] = static_cast<uint8_t>(offset + i);
+    }
+    IP ip = IP("1.2.3.4", "4.3.2.1") / RawPDU(payload);
+    ip.id(id);
+    ip.protocol(Constants::IP::PROTO_UDP + 100);
+    ip.fragment_offset(offset / 8);
+    ip.flags(more_fragments ? IP::MORE_FRAGMENTS : static_cast<IP::Flags>(0));
+    return ip;
+}
+
+Timestamp IPv4ReassemblerTest::make_timestamp(long seconds) {
+    timeval tv;
+    tv.tv_sec = seconds;
+    tv.tv_usec = 0;
+    return tv;
+}
+
 const uint8_t IPv4ReassemblerTest::packets[][1514] = {
     {130,111,185,223,39,177,226,183,186,36,71,231,8,0,69,0,5,220,53,162,32,0,64,17,169,88,192,168,0,100,176,5,5,5,177,46,34,184,58,160,124,236,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65},
     {130,111,185,223,39,177,226,183,186,36,71,231,8,0,69,0,5,220,53,162,32,185,64,17,168,159,192,168,0,100,176,5,5,5,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65,65},
@@ -115,3 +140,143 @@ TEST_F(IPv4ReassemblerTest, PacketHasMFAndDF) {
     EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(packet1));
     EXPECT_EQ(IPv4Reassembler::REASSEMBLED, reassembler.process(packet2));
 }
+
+TEST_F(IPv4ReassemblerTest, OverlappingAndDuplicatedFragments) {
+    IPv4Reassembler reassembler;
+    IP fragments[] = {
+        make_fragment(1, 16, 16, true),
+        make_fragment(1, 16, 16, true),
+        make_fragment(1, 24, 16, false),
+        make_fragment(1, 0, 24, true)
+    };
+    for (size_t i = 0; i < 3; ++i) {
+        EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(fragments[i]));
+    }
+    EXPECT_EQ(1U, reassembler.datagram_count());
+    EXPECT_EQ(IPv4Reassembler::REASSEMBLED, reassembler.process(fragments[3]));
+    EXPECT_EQ(0U, reassembler.datagram_count());
+    EXPECT_EQ(0U, reassembler.buffered_bytes());
+    const RawPDU& raw = fragments[3].rfind_pdu<RawPDU>();
+    ASSERT_EQ(40U, raw.payload().size());
+    for (size_t i = 0; i < raw.payload().size(); ++i) {
+        EXPECT_EQ(i, raw.payload()[i]);
+    }
+    EXPECT_FALSE(fragments[3].is_fragmented());
+}
+
+TEST_F(IPv4ReassemblerTest, OverlappingFragmentsKeepFirstData) {
+    IPv4Reassembler reassembler;
+    IP first = make_fragment(1, 8, 16, true);
+    IP overlapping = make_fragment(1, 0, 40, true);
+    // Different data for the overlapping bytes
+    RawPDU::payload_type& payload = overlapping.rfind_pdu<RawPDU>().payload();
+    for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = 0xff;
+    }
+    IP last = make_fragment(1, 32, 8, false);
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(first));
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(last));
+    EXPECT_EQ(IPv4Reassembler::REASSEMBLED, reassembler.process(overlapping));
+    const RawPDU& raw = overlapping.rfind_pdu<RawPDU>();
+    ASSERT_EQ(40U, raw.payload().size());
+    for (size_t i = 0; i < raw.payload().size(); ++i) {
+        const bool received_first = (i >= 8 && i < 24) || i >= 32;
+        EXPECT_EQ(received_first ? i : 0xff, raw.payload()[i]);
+    }
+}
+
+TEST_F(IPv4ReassemblerTest, OversizedFragment) {
+    IPv4Reassembler reassembler;
+    IP first = make_fragment(1, 0, 16, true);
+    // The largest possible offset, which ends past 65535
+    IP oversized = make_fragment(1, 65528, 16, false);
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(first));
+    EXPECT_EQ(1U, reassembler.datagram_count());
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(oversized));
+    // Only the oversized fragment is dropped
+    EXPECT_EQ(1U, reassembler.datagram_count());
+    IP last = make_fragment(1, 16, 16, false);
+    EXPECT_EQ(IPv4Reassembler::REASSEMBLED, reassembler.process(last));
+    EXPECT_EQ(0U, reassembler.datagram_count());
+
+    // Datagrams aren't created for a single oversized fragment
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(oversized));
+    EXPECT_EQ(0U, reassembler.datagram_count());
+}
+
+TEST_F(IPv4ReassemblerTest, InconsistentFragment) {
+    IPv4Reassembler reassembler;
+    IP first = make_fragment(1, 0, 16, true);
+    IP past_end = make_fragment(1, 32, 16, true);
+    IP last = make_fragment(1, 16, 16, false);
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(first));
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(past_end));
+    EXPECT_EQ(1U, reassembler.datagram_count());
+    // There's data past this last fragment, so the fragment is dropped
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(last));
+    EXPECT_EQ(1U, reassembler.datagram_count());
+
+    IP middle = make_fragment(1, 16, 16, true);
+    IP actual_last = make_fragment(1, 48, 16, false);
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(middle));
+    EXPECT_EQ(IPv4Reassembler::REASSEMBLED, reassembler.process(actual_last));
+    EXPECT_EQ(64U, actual_last.rfind_pdu<RawPDU>().payload().size());
+    EXPECT_EQ(0U, reassembler.datagram_count());
+}
+
+TEST_F(IPv4ReassemblerTest, Timeout) {
+    IPv4Reassembler reassembler;
+    reassembler.fragment_timeout(10);
+    EXPECT_EQ(10U, reassembler.fragment_timeout());
+    IP first = make_fragment(1, 0, 16, true);
+    IP last = make_fragment(1, 16, 16, false);
+    IP other = make_fragment(2, 0, 16, true);
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(first, make_timestamp(100)));
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(other, make_timestamp(105)));
+    EXPECT_EQ(2U, reassembler.datagram_count());
+    // The first datagram expires before this fragment is processed
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(last, make_timestamp(110)));
+    EXPECT_EQ(1U, reassembler.expired_datagrams());
+    EXPECT_EQ(2U, reassembler.datagram_count());
+
+    IP other_last = make_fragment(2, 16, 16, false);
+    EXPECT_EQ(IPv4Reassembler::REASSEMBLED, 
+              reassembler.process(other_last, make_timestamp(111)));
+    EXPECT_EQ(1U, reassembler.datagram_count());
+}
+
+TEST_F(IPv4ReassemblerTest, MaxDatagrams) {
+    IPv4Reassembler reassembler;
+    reassembler.max_datagrams(2);
+    for (uint16_t id = 0; id < 5; ++id) {
+        IP fragment = make_fragment(id, 0, 16, true);
+        EXPECT_EQ(IPv4Reassembler::FRAGMENTED, 
+                  reassembler.process(fragment, make_timestamp(id)));
+    }
+    EXPECT_EQ(2U, reassembler.datagram_count());
+    EXPECT_EQ(3U, reassembler.evicted_datagrams());
+    // The most recent ones are kept
+    IP last = make_fragment(4, 16, 16, false);
+    EXPECT_EQ(IPv4Reassembler::REASSEMBLED, reassembler.process(last, make_timestamp(5)));
+    last = make_fragment(0, 16, 16, false);
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(last, make_timestamp(5)));
+}
+
+TEST_F(IPv4ReassemblerTest, MaxBufferedBytes) {
+    IPv4Reassembler reassembler;
+    reassembler.max_buffered_bytes(4096);
+    for (uint16_t id = 0; id < 100; ++id) {
+        IP fragment = make_fragment(id, 0, 512, true);
+        EXPECT_EQ(IPv4Reassembler::FRAGMENTED, 
+                  reassembler.process(fragment, make_timestamp(id)));
+        EXPECT_LE(reassembler.buffered_bytes(), 4096U);
+    }
+    EXPECT_GT(reassembler.evicted_datagrams(), 90U);
+    EXPECT_EQ(100U, reassembler.evicted_datagrams() + reassembler.datagram_count());
+
+    // A datagram that doesn't fit is dropped entirely
+    IP huge = make_fragment(1000, 0, 8000, true);
+    EXPECT_EQ(IPv4Reassembler::FRAGMENTED, reassembler.process(huge, make_timestamp(200)));
+    EXPECT_EQ(0U, reassembler.datagram_count());
+    EXPECT_EQ(0U, reassembler.buffered_bytes());
+}
@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <algorithm>
+#include <tins/ipv6_reassembler.h>
+#include <tins/ipv6.h>
+#include <tins/udp.h>
+#include <tins/rawpdu.h>
+#include <tins/timestamp.h>
+#include <tins/constants.h>
+
+using std::vector;
+
+using namespace Tins;
+
+class IPv6ReassemblerTest : public testing::Test {
+public:
+    IPv6ReassemblerTest();
+
+    IPv6 make_fragment(uint32_t id, size_t offset, size_t size, bool more_fragments);
+    static Timestamp make_timestamp(long seconds);
+
+    PDU::serialization_type full_packet;
+    PDU::serialization_type payload;
+};
+
+IPv6ReassemblerTest::IPv6ReassemblerTest() {
+    vector<uint8_t> data(3000);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>(i);
+    }
+    IPv6 packet = IPv6("fe80::1", "fe80::2") / UDP(53, 1000) / RawPDU(data);
+    full_packet = packet.serialize();
+    // Everything after the fixed IPv6 header
+    payload.assign(full_packet.begin() + 40, full_packet.end());
+}
+
+IPv6 IPv6ReassemblerTest::make_fragment(uint32_t id, size_t offset, size_t size,
+                                        bool more_fragments) {
+    const uint16_t field = static_cast<uint16_t>((offset / 8) << 3 | (more_fragments ? 1 : 0));
+    const uint8_t header_data[] = {
+        static_cast<uint8_t>(field >> 8), static_cast<uint8_t>(field & 0xff),
+        static_cast<uint8_t>(id >> 24), static_cast<uint8_t>(id >> 16),
+        static_cast<uint8_t>(id >> 8), static_cast<uint8_t>(id)
+    };
+    IPv6 fragment("fe80::1", "fe80::2");
+    fragment.next_header(Constants::IP::PROTO_UDP);
+    fragment.add_header(IPv6::ext_header(IPv6::FRAGMENT, sizeof(header_data), header_data));
+    fragment /= RawPDU(payload.begin() + offset, payload.begin() + offset + size);
+    // Parse it back so it looks like a captured packet
+    PDU::serialization_type buffer = fragment.serialize();
+    return IPv6(&buffer[0], static_cast<uint32_t>(buffer.size()));
+}
+
+Timestamp IPv6ReassemblerTest::make_timestamp(long seconds) {
+    timeval tv;
+    tv.tv_sec = seconds;
+    tv.tv_usec = 0;
+    return tv;
+}
+
+TEST_F(IPv6ReassemblerTest, Reassemble) {
+    const size_t orderings[][3] = {
+        { 0, 1, 2 },
+        { 2, 1, 0 },
+        { 1, 2, 0 }
+    };
+    const size_t fragment_size = 1232;
+    for (size_t i = 0; i < 3; ++i) {
+        IPv6Reassembler reassembler;
+        for (size_t j = 0; j < 3; ++j) {
+            const size_t index = orderings[i][j];
+            const size_t offset = index * fragment_size;
+            const size_t size = std::min(fragment_size, payload.size() - offset);
+            IPv6 fragment = make_fragment(1234, offset, size, index != 2);
+            IPv6Reassembler::PacketStatus status = reassembler.process(fragment);
+            if (j != 2) {
+                EXPECT_EQ(IPv6Reassembler::FRAGMENTED, status);
+                continue;
+            }
+            ASSERT_EQ(IPv6Reassembler::REASSEMBLED, status);
+            EXPECT_TRUE(fragment.search_header(IPv6::FRAGMENT) == 0);
+            EXPECT_EQ(Constants::IP::PROTO_UDP, fragment.next_header());
+            const UDP* udp = fragment.find_pdu<UDP>();
+            ASSERT_TRUE(udp != 0);
+            EXPECT_EQ(53, udp->dport());
+            EXPECT_EQ(1000, udp->sport());
+            EXPECT_EQ(payload.size(), fragment.payload_length());
+            EXPECT_EQ(full_packet, fragment.serialize());
+        }
+        EXPECT_EQ(0U, reassembler.datagram_count());
+    }
+}
+
+TEST_F(IPv6ReassemblerTest, NotFragmented) {
+    IPv6Reassembler reassembler;
+    IPv6 packet = IPv6("fe80::1", "fe80::2") / UDP(53, 1000);
+    EXPECT_EQ(IPv6Reassembler::NOT_FRAGMENTED, reassembler.process(packet));
+    // An atomic fragment
+    IPv6 atomic = make_fragment(1, 0, payload.size(), false);
+    EXPECT_EQ(IPv6Reassembler::NOT_FRAGMENTED, reassembler.process(atomic));
+    EXPECT_EQ(0U, reassembler.datagram_count());
+}
+
+TEST_F(IPv6ReassemblerTest, DifferentIdentifiers) {
+    IPv6Reassembler reassembler;
+    IPv6 first = make_fragment(1, 0, 1232, true);
+    IPv6 other = make_fragment(2, 1232, payload.size() - 1232, false);
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(first));
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, reassembler.process(other));
+    EXPECT_EQ(2U, reassembler.datagram_count());
+    reassembler.remove_stream(1, "fe80::2", "fe80::1");
+    EXPECT_EQ(1U, reassembler.datagram_count());
+}
+
+TEST_F(IPv6ReassemblerTest, TimeoutAndLimits) {
+    IPv6Reassembler reassembler;
+    reassembler.fragment_timeout(5);
+    reassembler.max_datagrams(3);
+    for (uint32_t id = 0; id < 5; ++id) {
+        IPv6 fragment = make_fragment(id, 0, 1232, true);
+        EXPECT_EQ(IPv6Reassembler::FRAGMENTED, 
+                  reassembler.process(fragment, make_timestamp(id)));
+    }
+    EXPECT_EQ(3U, reassembler.datagram_count());
+    EXPECT_EQ(2U, reassembler.evicted_datagrams());
+    IPv6 fragment = make_fragment(100, 0, 1232, true);
+    // Datagrams 2 and 3 are expired
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, 
+              reassembler.process(fragment, make_timestamp(8)));
+    EXPECT_EQ(2U, reassembler.expired_datagrams());
+    EXPECT_EQ(2U, reassembler.datagram_count());
+
+    reassembler.max_buffered_bytes(1024);
+    fragment = make_fragment(200, 0, 1232, true);
+    EXPECT_EQ(IPv6Reassembler::FRAGMENTED, 
+              reassembler.process(fragment, make_timestamp(8)));
+    EXPECT_EQ(0U, reassembler.datagram_count());
+    EXPECT_EQ(0U, reassembler.buffered_bytes());
+}
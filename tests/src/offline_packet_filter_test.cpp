@@ -11,6 +11,7 @@
 #include <tins/llc.h>
 #include <tins/udp.h>
 #include <tins/rawpdu.h>
+#include <tins/packet.h>
 
 using namespace Tins;
 
@@ -52,6 +53,19 @@ TEST_F(OfflinePacketFilterTest, MatchesFilterEthTcp) {
     }
 }
 
+TEST_F(OfflinePacketFilterTest, MatchesFilterRawFrame) {
+    OfflinePacketFilter filter("ip and port 55", DataLinkType<EthernetII>());
+    EthernetII matching = EthernetII() / IP() / TCP(55, 11) / RawPDU("test");
+    PDU::serialization_type buffer = matching.serialize();
+    // The captured bytes are used rather than the PDU
+    Packet packet(EthernetII() / IP() / TCP(45, 11) / RawPDU("test"), Timestamp());
+    EXPECT_FALSE(filter.matches_filter(packet));
+    packet.raw_frame(&buffer[0], buffer.size());
+    EXPECT_TRUE(filter.matches_filter(packet));
+    packet.discard_raw_frame();
+    EXPECT_FALSE(filter.matches_filter(packet));
+}
+
 TEST_F(OfflinePacketFilterTest, MatchesFilterEth) {
     OfflinePacketFilter filter("ether dst 00:01:02:03:04:05", DataLinkType<EthernetII>());
     {
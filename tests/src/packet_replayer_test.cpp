@@ -0,0 +1,155 @@
+#include <tins/cxxstd.h>
+
+#if TINS_IS_CXX11
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+#include <tins/packet_replayer.h>
+#include <tins/packet_sender.h>
+#include <tins/packet.h>
+#include <tins/ip.h>
+#include <tins/udp.h>
+#include <tins/rawpdu.h>
+#include <tins/exceptions.h>
+
+using std::vector;
+using std::chrono::milliseconds;
+
+using namespace Tins;
+
+class PacketReplayerTest : public testing::Test {
+public:
+    PacketReplayerTest();
+
+    // Sending through raw sockets requires privileges. Tests that
+    // transmit packets are skipped when they're not available.
+    bool can_send();
+    vector<Packet> make_packets(size_t count, milliseconds gap);
+
+    PacketSender sender;
+    PacketReplayer replayer;
+    IP packet;
+};
+
+PacketReplayerTest::PacketReplayerTest()
+: replayer(sender), packet(IP("127.0.0.1") / UDP(9, 1337) / RawPDU("replayed")) {
+
+}
+
+bool PacketReplayerTest::can_send() {
+    try {
+        sender.open_l3_socket(PacketSender::IP_UDP_SOCKET);
+        return true;
+    }
+    catch (socket_open_error&) {
+        return false;
+    }
+}
+
+vector<Packet> PacketReplayerTest::make_packets(size_t count, milliseconds gap) {
+    vector<Packet> packets;
+    for (size_t i = 0; i < count; ++i) {
+        packets.push_back(Packet(packet, Timestamp(gap * i)));
+    }
+    return packets;
+}
+
+TEST_F(PacketReplayerTest, DefaultPacing) {
+    EXPECT_EQ(PacketReplayer::ORIGINAL_TIMING, replayer.pacing_mode());
+    EXPECT_EQ(PacketReplayer::DEFAULT_SPIN_THRESHOLD, replayer.spin_threshold());
+}
+
+TEST_F(PacketReplayerTest, InvalidRates) {
+    EXPECT_THROW(replayer.pace_original(0), std::invalid_argument);
+    EXPECT_THROW(replayer.pace_packets_per_second(-1), std::invalid_argument);
+    EXPECT_THROW(replayer.pace_bits_per_second(0), std::invalid_argument);
+    EXPECT_EQ(PacketReplayer::ORIGINAL_TIMING, replayer.pacing_mode());
+}
+
+TEST_F(PacketReplayerTest, PacketWithoutPDU) {
+    Packet empty;
+    EXPECT_THROW(replayer.send(empty), invalid_packet);
+    EXPECT_EQ(0ULL, replayer.statistics().packets_sent);
+}
+
+TEST_F(PacketReplayerTest, TopSpeed) {
+    if (!can_send()) {
+        GTEST_SKIP() << "Sending packets requires privileges";
+    }
+    vector<Packet> packets = make_packets(20, milliseconds(1000));
+    replayer.pace_top_speed();
+    replayer.replay(packets.begin(), packets.end());
+    const PacketReplayer::Statistics& stats = replayer.statistics();
+    EXPECT_EQ(20ULL, stats.packets_sent);
+    EXPECT_EQ(20ULL * packet.size(), stats.bytes_sent);
+    EXPECT_EQ(0ULL, stats.send_errors);
+}
+
+TEST_F(PacketReplayerTest, OriginalTiming) {
+    if (!can_send()) {
+        GTEST_SKIP() << "Sending packets requires privileges";
+    }
+    vector<Packet> packets = make_packets(5, milliseconds(10));
+    replayer.pace_original(2.0);
+    replayer.replay(packets.begin(), packets.end());
+    const PacketReplayer::Statistics& stats = replayer.statistics();
+    EXPECT_EQ(5ULL, stats.packets_sent);
+    EXPECT_GE(stats.elapsed, milliseconds(20));
+    EXPECT_GE(stats.max_jitter, stats.mean_jitter());
+}
+
+TEST_F(PacketReplayerTest, PacketsPerSecond) {
+    if (!can_send()) {
+        GTEST_SKIP() << "Sending packets requires privileges";
+    }
+    vector<Packet> packets = make_packets(21, milliseconds(0));
+    replayer.pace_packets_per_second(1000);
+    replayer.replay(packets.begin(), packets.end());
+    const PacketReplayer::Statistics& stats = replayer.statistics();
+    EXPECT_EQ(21ULL, stats.packets_sent);
+    EXPECT_GE(stats.elapsed, milliseconds(20));
+    EXPECT_LE(stats.packets_per_second(), 1050);
+}
+
+TEST_F(PacketReplayerTest, BitsPerSecond) {
+    if (!can_send()) {
+        GTEST_SKIP() << "Sending packets requires privileges";
+    }
+    const uint32_t size = packet.size();
+    vector<Packet> packets = make_packets(11, milliseconds(0));
+    // One packet per millisecond
+    replayer.pace_bits_per_second(size * 8 * 1000.0, size);
+    replayer.replay(packets.begin(), packets.end());
+    const PacketReplayer::Statistics& stats = replayer.statistics();
+    EXPECT_EQ(11ULL, stats.packets_sent);
+    EXPECT_GE(stats.elapsed, milliseconds(10));
+}
+
+TEST_F(PacketReplayerTest, Burst) {
+    if (!can_send()) {
+        GTEST_SKIP() << "Sending packets requires privileges";
+    }
+    vector<Packet> packets = make_packets(6, milliseconds(0));
+    // The first 5 packets go out right away, the last one 100ms later
+    replayer.pace_packets_per_second(10, 5);
+    replayer.replay(packets.begin(), packets.begin() + 5);
+    replayer.send(packets.back());
+    EXPECT_GE(replayer.statistics().elapsed, milliseconds(100));
+}
+
+TEST_F(PacketReplayerTest, Reset) {
+    if (!can_send()) {
+        GTEST_SKIP() << "Sending packets requires privileges";
+    }
+    vector<Packet> packets = make_packets(2, milliseconds(1000));
+    replayer.send(packets[0]);
+    replayer.reset();
+    // The second packet is now the first one, so it's sent right away
+    replayer.send(packets[1]);
+    const PacketReplayer::Statistics& stats = replayer.statistics();
+    EXPECT_EQ(1ULL, stats.packets_sent);
+}
+
+#endif // TINS_IS_CXX11
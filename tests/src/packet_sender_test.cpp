@@ -0,0 +1,147 @@
+#if !defined(_WIN32)
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <vector>
+#include <netinet/in.h>
+#include <tins/packet_sender.h>
+#include <tins/ip.h>
+#include <tins/udp.h>
+#include <tins/rawpdu.h>
+#include <tins/exceptions.h>
+
+using std::vector;
+
+using namespace Tins;
+
+// A PDU that serializes to no bytes and is sent through a layer 3 socket
+class EmptyNetworkPDU : public PDU {
+public:
+    uint32_t header_size() const {
+        return 0;
+    }
+
+    PDUType pdu_type() const {
+        return USER_DEFINED_PDU;
+    }
+
+    EmptyNetworkPDU* clone() const {
+        return new EmptyNetworkPDU(*this);
+    }
+
+    void send(PacketSender& sender, const NetworkInterface&) {
+        sockaddr_in link_addr;
+        memset(&link_addr, 0, sizeof(link_addr));
+        link_addr.sin_family = AF_INET;
+        link_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        sender.send_l3(*this, (sockaddr*)&link_addr, sizeof(link_addr),
+                       PacketSender::IP_UDP_SOCKET);
+    }
+private:
+    void write_serialization(uint8_t*, uint32_t) {
+
+    }
+};
+
+class PacketSenderTest : public testing::Test {
+public:
+    PacketSenderTest();
+
+    // Sending through raw sockets requires privileges. Tests that
+    // transmit packets are skipped when they're not available.
+    bool can_send();
+
+    PacketSender sender;
+    IP packet;
+};
+
+PacketSenderTest::PacketSenderTest()
+: packet(IP("127.0.0.1") / UDP(9, 1337) / RawPDU("queued")) {
+
+}
+
+bool PacketSenderTest::can_send() {
+    try {
+        sender.open_l3_socket(PacketSender::IP_UDP_SOCKET);
+        return true;
+    }
+    catch (socket_open_error&) {
+        return false;
+    }
+}
+
+TEST_F(PacketSenderTest, FlushEmptyQueue) {
+    EXPECT_EQ(0U, sender.queued_packets());
+    PacketSender::BatchResult result = sender.flush();
+    EXPECT_EQ(0U, result.sent);
+    EXPECT_EQ(0U, result.failed);
+    sender.clear_queue();
+    EXPECT_EQ(0U, sender.queued_packets());
+}
+
+TEST_F(PacketSenderTest, QueueWithoutPrivileges) {
+    if (can_send()) {
+        GTEST_SKIP() << "Only applies when sockets can't be opened";
+    }
+    EXPECT_THROW(sender.queue(packet), socket_open_error);
+    EXPECT_EQ(0U, sender.queued_packets());
+    PacketSender::BatchResult result = sender.flush();
+    EXPECT_EQ(0U, result.sent);
+    EXPECT_EQ(0U, result.failed);
+}
+
+TEST_F(PacketSenderTest, QueueAndFlush) {
+    if (!can_send()) {
+        GTEST_SKIP() << "Sending packets requires privileges";
+    }
+    for (size_t i = 0; i < 3; ++i) {
+        sender.queue(packet);
+        EXPECT_EQ(i + 1, sender.queued_packets());
+    }
+    PacketSender::BatchResult result = sender.flush();
+    EXPECT_EQ(3U, result.sent);
+    EXPECT_EQ(0U, result.failed);
+    EXPECT_EQ(0U, sender.queued_packets());
+}
+
+TEST_F(PacketSenderTest, ClearQueue) {
+    if (!can_send()) {
+        GTEST_SKIP() << "Sending packets requires privileges";
+    }
+    sender.queue(packet);
+    sender.queue(packet);
+    EXPECT_EQ(2U, sender.queued_packets());
+    sender.clear_queue();
+    EXPECT_EQ(0U, sender.queued_packets());
+    PacketSender::BatchResult result = sender.flush();
+    EXPECT_EQ(0U, result.sent);
+    EXPECT_EQ(0U, result.failed);
+}
+
+TEST_F(PacketSenderTest, EmptySerializationCountsAsFailed) {
+    if (!can_send()) {
+        GTEST_SKIP() << "Sending packets requires privileges";
+    }
+    EmptyNetworkPDU empty;
+    sender.queue(packet);
+    sender.queue(empty);
+    sender.queue(packet);
+    EXPECT_EQ(3U, sender.queued_packets());
+    PacketSender::BatchResult result = sender.flush();
+    EXPECT_EQ(2U, result.sent);
+    EXPECT_EQ(1U, result.failed);
+    EXPECT_EQ(0U, sender.queued_packets());
+}
+
+TEST_F(PacketSenderTest, SendBatch) {
+    if (!can_send()) {
+        GTEST_SKIP() << "Sending packets requires privileges";
+    }
+    vector<IP> packets(5, packet);
+    PacketSender::BatchResult result = sender.send_batch(packets.begin(), packets.end());
+    EXPECT_EQ(5U, result.sent);
+    EXPECT_EQ(0U, result.failed);
+    EXPECT_EQ(0U, sender.queued_packets());
+}
+
+#endif // _WIN32
@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <tins/packet_template.h>
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/tcp.h>
+#include <tins/udp.h>
+#include <tins/icmp.h>
+#include <tins/icmpv6.h>
+#include <tins/rawpdu.h>
+#include <tins/exceptions.h>
+
+using std::string;
+
+using namespace Tins;
+
+class PacketTemplateTest : public testing::Test {
+public:
+    static void expect_same(const PacketTemplate& packet, PDU& pdu) {
+        PDU::serialization_type expected = pdu.serialize();
+        EXPECT_EQ(expected, packet.buffer());
+    }
+};
+
+TEST_F(PacketTemplateTest, FieldOffsets) {
+    EthernetII eth = EthernetII() / IP("1.2.3.4", "4.3.2.1") / TCP(80, 1024) / RawPDU("data");
+    PacketTemplate packet(eth);
+    EXPECT_EQ(eth.serialize(), packet.buffer());
+    EXPECT_EQ(0U, packet.field_offset(PacketTemplate::ETH_DST_ADDR));
+    EXPECT_EQ(6U, packet.field_offset(PacketTemplate::ETH_SRC_ADDR));
+    EXPECT_EQ(14U + 4, packet.field_offset(PacketTemplate::IPV4_ID));
+    EXPECT_EQ(14U + 16, packet.field_offset(PacketTemplate::IPV4_DST_ADDR));
+    EXPECT_EQ(34U + 2, packet.field_offset(PacketTemplate::DPORT));
+    EXPECT_EQ(4U, packet.field_size(PacketTemplate::TCP_SEQ));
+    EXPECT_EQ(54U, packet.payload_offset());
+    EXPECT_EQ(4U, packet.payload_size());
+    EXPECT_FALSE(packet.has_field(PacketTemplate::IPV6_SRC_ADDR));
+    EXPECT_FALSE(packet.has_field(PacketTemplate::ICMP_ID));
+    EXPECT_THROW(packet.icmp_id(1), field_not_present);
+}
+
+TEST_F(PacketTemplateTest, PatchTCP) {
+    EthernetII eth = EthernetII("00:01:02:03:04:05", "06:07:08:09:0a:0b") / 
+                     IP("1.2.3.4", "4.3.2.1") / TCP(80, 1024) / RawPDU("data");
+    PacketTemplate packet(eth);
+
+    packet.eth_dst_addr("aa:bb:cc:dd:ee:ff");
+    packet.ip_id(0x1234);
+    packet.ip_ttl(17);
+    packet.ip_src_addr("192.168.0.1");
+    packet.ip_dst_addr("10.0.0.254");
+    packet.sport(31337);
+    packet.dport(443);
+    packet.seq(0xdeadbeef);
+    packet.ack_seq(0x01020304);
+    packet.window(1234);
+    packet.write_payload(1, (const uint8_t*)"XYZ", 3);
+
+    eth.dst_addr("aa:bb:cc:dd:ee:ff");
+    IP& ip = eth.rfind_pdu<IP>();
+    ip.id(0x1234);
+    ip.ttl(17);
+    ip.src_addr("192.168.0.1");
+    ip.dst_addr("10.0.0.254");
+    TCP& tcp = eth.rfind_pdu<TCP>();
+    tcp.sport(31337);
+    tcp.dport(443);
+    tcp.seq(0xdeadbeef);
+    tcp.ack_seq(0x01020304);
+    tcp.window(1234);
+    eth.rfind_pdu<RawPDU>().payload(RawPDU::payload_type((const uint8_t*)"dXYZ", 
+                                                         (const uint8_t*)"dXYZ" + 4));
+    expect_same(packet, eth);
+}
+
+TEST_F(PacketTemplateTest, PatchUDPOddSizedPayload) {
+    IP ip = IP("1.2.3.4", "4.3.2.1") / UDP(53, 1024) / RawPDU("hello");
+    PacketTemplate packet(ip);
+    for (uint16_t i = 0; i < 300; ++i) {
+        packet.sport(i);
+        packet.ip_id(i);
+        const uint8_t value = static_cast<uint8_t>(i);
+        packet.write_payload(4, &value, 1);
+
+        ip.id(i);
+        ip.rfind_pdu<UDP>().sport(i);
+        const string payload = string("hell") + static_cast<char>(value);
+        ip.rfind_pdu<RawPDU>().payload(RawPDU::payload_type(payload.begin(), payload.end()));
+        expect_same(packet, ip);
+    }
+    EXPECT_THROW(packet.write_payload(4, (const uint8_t*)"ab", 2), serialization_error);
+}
+
+TEST_F(PacketTemplateTest, PatchICMP) {
+    ICMP icmp(ICMP::ECHO_REQUEST);
+    icmp.id(1);
+    icmp.sequence(1);
+    IP ip = IP("1.2.3.4", "4.3.2.1") / icmp / RawPDU("payload");
+    PacketTemplate packet(ip);
+    packet.icmp_id(0xabcd);
+    packet.icmp_sequence(0x8001);
+    packet.ip_src_addr("8.8.8.8");
+
+    ip.rfind_pdu<ICMP>().id(0xabcd);
+    ip.rfind_pdu<ICMP>().sequence(0x8001);
+    ip.src_addr("8.8.8.8");
+    expect_same(packet, ip);
+}
+
+TEST_F(PacketTemplateTest, PatchIPv6) {
+    ICMPv6 icmp(ICMPv6::ECHO_REQUEST);
+    icmp.identifier(1);
+    icmp.sequence(1);
+    IPv6 ipv6 = IPv6("2001:db8::1", "2001:db8::2") / icmp;
+    PacketTemplate packet(ipv6);
+    packet.ipv6_hop_limit(3);
+    packet.ipv6_src_addr("fe80::1234");
+    packet.icmp_sequence(77);
+
+    ipv6.hop_limit(3);
+    ipv6.src_addr("fe80::1234");
+    ipv6.rfind_pdu<ICMPv6>().sequence(77);
+    expect_same(packet, ipv6);
+
+    IPv6 udp_packet = IPv6("2001:db8::1", "2001:db8::2") / UDP(1, 2) / RawPDU("a");
+    PacketTemplate udp_template(udp_packet);
+    udp_template.ipv6_dst_addr("2001:db8::ffff");
+    udp_template.dport(5353);
+    udp_packet.dst_addr("2001:db8::ffff");
+    udp_packet.rfind_pdu<UDP>().dport(5353);
+    expect_same(udp_template, udp_packet);
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include <tins/packet.h>
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/udp.h>
+#include <tins/rawpdu.h>
+
+using namespace Tins;
+
+class PacketTest : public testing::Test {
+public:
+    static const uint8_t padded_frame[];
+};
+
+// A short UDP packet followed by Ethernet padding
+const uint8_t PacketTest::padded_frame[] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 8, 0, 69, 0, 0, 29, 0, 1, 0, 0,
+    128, 17, 185, 188, 1, 2, 3, 4, 4, 3, 2, 1, 0, 53, 5, 57, 0, 9, 149, 59,
+    97, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+TEST_F(PacketTest, NoRawFrameByDefault) {
+    Packet packet(EthernetII() / IP() / UDP(), Timestamp());
+    EXPECT_FALSE(packet.has_raw_frame());
+    EXPECT_TRUE(packet.raw_frame().empty());
+}
+
+TEST_F(PacketTest, RawFrame) {
+    EthernetII eth(padded_frame, sizeof(padded_frame));
+    Packet packet(eth, Timestamp());
+    packet.raw_frame(padded_frame, sizeof(padded_frame));
+    ASSERT_TRUE(packet.has_raw_frame());
+    EXPECT_EQ(
+        Packet::raw_frame_type(padded_frame, padded_frame + sizeof(padded_frame)),
+        packet.raw_frame()
+    );
+    packet.discard_raw_frame();
+    EXPECT_FALSE(packet.has_raw_frame());
+}
+
+TEST_F(PacketTest, RawFrameLength) {
+    Packet packet(EthernetII(padded_frame, sizeof(padded_frame)), Timestamp());
+    EXPECT_EQ(0U, packet.raw_frame_length());
+    packet.raw_frame(padded_frame, sizeof(padded_frame));
+    EXPECT_EQ(sizeof(padded_frame), packet.raw_frame_length());
+    packet.raw_frame(padded_frame, sizeof(padded_frame), 1500);
+    EXPECT_EQ(sizeof(padded_frame), packet.raw_frame().size());
+    EXPECT_EQ(1500U, packet.raw_frame_length());
+    packet.discard_raw_frame();
+    EXPECT_EQ(0U, packet.raw_frame_length());
+}
+
+TEST_F(PacketTest, RawFrameIsShared) {
+    Packet packet(EthernetII(padded_frame, sizeof(padded_frame)), Timestamp());
+    packet.raw_frame(padded_frame, sizeof(padded_frame));
+    Packet copied(packet);
+    EXPECT_EQ(&packet.raw_frame(), &copied.raw_frame());
+    Packet assigned;
+    assigned = packet;
+    EXPECT_EQ(&packet.raw_frame(), &assigned.raw_frame());
+
+    // Discarding it doesn't affect the copies
+    packet.discard_raw_frame();
+    EXPECT_FALSE(packet.has_raw_frame());
+    EXPECT_EQ(sizeof(padded_frame), copied.raw_frame().size());
+    EXPECT_EQ(sizeof(padded_frame), assigned.raw_frame().size());
+}
+
+#if TINS_IS_CXX11
+TEST_F(PacketTest, RawFrameIsMoved) {
+    Packet packet(EthernetII(padded_frame, sizeof(padded_frame)), Timestamp());
+    packet.raw_frame(padded_frame, sizeof(padded_frame));
+    Packet moved(std::move(packet));
+    EXPECT_EQ(sizeof(padded_frame), moved.raw_frame().size());
+    Packet assigned;
+    assigned = std::move(moved);
+    EXPECT_EQ(sizeof(padded_frame), assigned.raw_frame().size());
+}
+#endif // TINS_IS_CXX11
+
+TEST_F(PacketTest, MutableAccessDiscardsRawFrame) {
+    Packet packet(EthernetII(padded_frame, sizeof(padded_frame)), Timestamp());
+    packet.raw_frame(padded_frame, sizeof(padded_frame));
+    const Packet& const_packet = packet;
+    EXPECT_EQ(PDU::ETHERNET_II, const_packet.pdu()->pdu_type());
+    EXPECT_TRUE(packet.has_raw_frame());
+
+    packet.pdu()->rfind_pdu<EthernetII>().dst_addr("00:01:02:03:04:05");
+    EXPECT_FALSE(packet.has_raw_frame());
+
+    packet.raw_frame(padded_frame, sizeof(padded_frame));
+    delete packet.release_pdu();
+    EXPECT_FALSE(packet.has_raw_frame());
+}
+
+TEST_F(PacketTest, ModifyingDiscardsRawFrame) {
+    Packet packet(EthernetII(padded_frame, sizeof(padded_frame)), Timestamp());
+    packet.raw_frame(padded_frame, sizeof(padded_frame));
+    packet /= RawPDU("payload");
+    EXPECT_FALSE(packet.has_raw_frame());
+}
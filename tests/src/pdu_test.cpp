@@ -102,3 +102,21 @@ TEST_F(PDUTest, TinsCast) {
     EXPECT_THROW(tins_cast<UDP>(*pdu), bad_tins_cast);
 }
 
+TEST_F(PDUTest, SerializeIntoBuffer) {
+    IP packet = IP("192.168.0.1") / TCP(22, 52) / RawPDU("payload");
+    PDU::serialization_type buffer(1024, 0xff);
+    const uint8_t* storage = &buffer[0];
+    packet.serialize(buffer);
+    EXPECT_EQ(packet.serialize(), buffer);
+    // The buffer's storage is reused when it's large enough
+    EXPECT_EQ(storage, &buffer[0]);
+
+    IP small_packet = IP("192.168.0.1") / UDP(53, 1337);
+    small_packet.serialize(buffer);
+    EXPECT_EQ(small_packet.serialize(), buffer);
+    EXPECT_EQ(storage, &buffer[0]);
+
+    PDU::serialization_type empty_buffer;
+    packet.serialize(empty_buffer);
+    EXPECT_EQ(packet.serialize(), empty_buffer);
+}
@@ -0,0 +1,273 @@
+#include <tins/config.h>
+#include <tins/cxxstd.h>
+#include <gtest/gtest.h>
+
+#if defined(TINS_HAVE_EPOLL) && TINS_IS_CXX11
+
+#include <vector>
+#include <tins/probe_engine.h>
+#include <tins/packet_sender.h>
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/tcp.h>
+#include <tins/udp.h>
+#include <tins/icmp.h>
+#include <tins/icmpv6.h>
+#include <tins/arp.h>
+#include <tins/rawpdu.h>
+#include <tins/constants.h>
+
+using std::vector;
+
+using namespace Tins;
+
+class ProbeEngineTest : public testing::Test {
+public:
+    ProbeEngineTest();
+
+    ProbeEngine::callback_type make_callback();
+    bool process(PDU& response);
+
+    PacketSender sender;
+    ProbeEngine engine;
+    vector<ProbeEngine::probe_id> completed;
+    vector<bool> responded;
+};
+
+ProbeEngineTest::ProbeEngineTest()
+: engine(sender) {
+
+}
+
+ProbeEngine::callback_type ProbeEngineTest::make_callback() {
+    return [&](ProbeEngine::probe_id id, const PDU&, PDU* response) {
+        completed.push_back(id);
+        responded.push_back(response != 0);
+    };
+}
+
+bool ProbeEngineTest::process(PDU& response) {
+    uint16_t ether_type = Constants::Ethernet::IP;
+    if (response.pdu_type() == PDU::IPv6) {
+        ether_type = Constants::Ethernet::IPV6;
+    }
+    else if (response.pdu_type() == PDU::ARP) {
+        ether_type = Constants::Ethernet::ARP;
+    }
+    PDU::serialization_type buffer = response.serialize();
+    return engine.process_packet(&buffer[0], buffer.size(), ether_type);
+}
+
+TEST_F(ProbeEngineTest, TCPResponse) {
+    IP probe = IP("10.0.0.1", "10.0.0.2") / TCP(80, 1337);
+    ProbeEngine::probe_id id = engine.expect(probe, make_callback());
+    EXPECT_EQ(1UL, engine.outstanding_probes());
+
+    // Same addresses, but the ports aren't swapped
+    IP other = IP("10.0.0.2", "10.0.0.1") / TCP(1337, 81);
+    EXPECT_FALSE(process(other));
+
+    IP response = IP("10.0.0.2", "10.0.0.1") / TCP(1337, 80);
+    EXPECT_TRUE(process(response));
+    ASSERT_EQ(1UL, completed.size());
+    EXPECT_EQ(id, completed[0]);
+    EXPECT_TRUE(responded[0]);
+    EXPECT_EQ(0UL, engine.outstanding_probes());
+
+    // It's not outstanding anymore
+    EXPECT_FALSE(process(response));
+}
+
+TEST_F(ProbeEngineTest, LinkLayerProbe) {
+    EthernetII probe = EthernetII() / IP("10.0.0.1", "10.0.0.2") / UDP(53, 1337) / RawPDU("a");
+    engine.expect(probe, make_callback());
+
+    IP response = IP("10.0.0.2", "10.0.0.1") / UDP(1337, 53) / RawPDU("b");
+    EXPECT_TRUE(process(response));
+    EXPECT_EQ(1UL, completed.size());
+}
+
+TEST_F(ProbeEngineTest, ICMPEchoResponse) {
+    ICMP icmp(ICMP::ECHO_REQUEST);
+    icmp.id(0x1234);
+    icmp.sequence(7);
+    IP probe = IP("10.0.0.1", "10.0.0.2") / icmp;
+    engine.expect(probe, make_callback());
+
+    ICMP reply(ICMP::ECHO_REPLY);
+    reply.id(0x1234);
+    reply.sequence(8);
+    IP response = IP("10.0.0.2", "10.0.0.1") / reply;
+    EXPECT_FALSE(process(response));
+
+    response.rfind_pdu<ICMP>().sequence(7);
+    EXPECT_TRUE(process(response));
+    EXPECT_EQ(1UL, completed.size());
+}
+
+TEST_F(ProbeEngineTest, ICMPErrorResponse) {
+    IP probe = IP("10.0.0.1", "10.0.0.2") / UDP(33434, 1337) / RawPDU("payload");
+    probe.id(0x4321);
+    probe.ttl(1);
+    engine.expect(probe, make_callback());
+    PDU::serialization_type probe_buffer = probe.serialize();
+    probe_buffer.resize(probe.header_size() + 8);
+
+    // Sent by a router rather than by the probe's destination
+    IP response = IP("10.0.0.1", "192.168.1.1") / ICMP(ICMP::TIME_EXCEEDED) /
+                  RawPDU(probe_buffer.begin(), probe_buffer.end());
+    EXPECT_TRUE(process(response));
+    ASSERT_EQ(1UL, completed.size());
+    EXPECT_TRUE(responded[0]);
+}
+
+TEST_F(ProbeEngineTest, ICMPErrorWithDifferentIdentifier) {
+    IP probe = IP("10.0.0.1", "10.0.0.2") / UDP(33434, 1337);
+    probe.id(1);
+    engine.expect(probe, make_callback());
+    probe.id(2);
+    PDU::serialization_type probe_buffer = probe.serialize();
+
+    IP response = IP("10.0.0.1", "10.0.0.2") / ICMP(ICMP::DEST_UNREACHABLE) /
+                  RawPDU(probe_buffer.begin(), probe_buffer.end());
+    EXPECT_FALSE(process(response));
+    EXPECT_EQ(1UL, engine.outstanding_probes());
+}
+
+TEST_F(ProbeEngineTest, ARPResponse) {
+    EthernetII probe = ARP::make_arp_request("10.0.0.2", "10.0.0.1", "00:01:02:03:04:05");
+    engine.expect(probe, make_callback());
+
+    ARP response("10.0.0.1", "10.0.0.2", "00:01:02:03:04:05", "06:07:08:09:0a:0b");
+    response.opcode(ARP::REPLY);
+    EXPECT_TRUE(process(response));
+    EXPECT_EQ(1UL, completed.size());
+}
+
+TEST_F(ProbeEngineTest, ICMPv6EchoResponse) {
+    ICMPv6 icmp(ICMPv6::ECHO_REQUEST);
+    icmp.identifier(99);
+    icmp.sequence(3);
+    IPv6 probe = IPv6("2001:db8::2", "2001:db8::1") / icmp;
+    engine.expect(probe, make_callback());
+
+    ICMPv6 reply(ICMPv6::ECHO_REPLY);
+    reply.identifier(99);
+    reply.sequence(3);
+    IPv6 response = IPv6("2001:db8::1", "2001:db8::2") / reply;
+    EXPECT_TRUE(process(response));
+    EXPECT_EQ(1UL, completed.size());
+}
+
+TEST_F(ProbeEngineTest, BroadcastProbe) {
+    IP probe = IP("255.255.255.255", "10.0.0.1") / UDP(67, 68) / RawPDU("a");
+    engine.expect(probe, make_callback());
+
+    IP response = IP("10.0.0.1", "10.0.0.254") / UDP(68, 67) / RawPDU("b");
+    EXPECT_TRUE(process(response));
+    EXPECT_EQ(1UL, completed.size());
+}
+
+TEST_F(ProbeEngineTest, MultipleProbes) {
+    vector<ProbeEngine::probe_id> ids;
+    for (uint16_t port = 1; port <= 100; ++port) {
+        IP probe = IP("10.0.0.1", "10.0.0.2") / TCP(port, 1337);
+        ids.push_back(engine.expect(probe, make_callback()));
+    }
+    EXPECT_EQ(100UL, engine.outstanding_probes());
+    for (uint16_t port = 100; port >= 1; --port) {
+        IP response = IP("10.0.0.2", "10.0.0.1") / TCP(1337, port);
+        EXPECT_TRUE(process(response));
+        EXPECT_EQ(ids[port - 1], completed.back());
+    }
+    EXPECT_EQ(0UL, engine.outstanding_probes());
+}
+
+TEST_F(ProbeEngineTest, Timeout) {
+    IP probe = IP("10.0.0.1", "10.0.0.2") / TCP(80, 1337);
+    ProbeEngine::probe_id first = engine.expect(probe, make_callback(),
+                                                ProbeEngine::duration_type(100));
+    ProbeEngine::probe_id second = engine.expect(probe, make_callback(),
+                                                 ProbeEngine::duration_type(10000));
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    EXPECT_EQ(0UL, engine.expire(now));
+    EXPECT_EQ(1UL, engine.expire(now + std::chrono::seconds(1)));
+    ASSERT_EQ(1UL, completed.size());
+    EXPECT_EQ(first, completed[0]);
+    EXPECT_FALSE(responded[0]);
+
+    EXPECT_TRUE(engine.cancel(second));
+    EXPECT_FALSE(engine.cancel(second));
+    EXPECT_EQ(0UL, engine.expire(now + std::chrono::seconds(20)));
+    EXPECT_EQ(1UL, completed.size());
+}
+
+TEST_F(ProbeEngineTest, AgreesWithMatchesResponse) {
+    ICMP echo(ICMP::ECHO_REQUEST);
+    echo.id(5);
+    echo.sequence(6);
+    ICMP echo_reply(ICMP::ECHO_REPLY);
+    echo_reply.id(5);
+    echo_reply.sequence(6);
+    ICMP other_reply = echo_reply;
+    other_reply.sequence(7);
+    ICMPv6 echo6(ICMPv6::ECHO_REQUEST);
+    echo6.identifier(5);
+    echo6.sequence(6);
+    ICMPv6 echo6_reply(ICMPv6::ECHO_REPLY);
+    echo6_reply.identifier(5);
+    echo6_reply.sequence(6);
+    ARP arp_reply("10.0.0.1", "10.0.0.2");
+    arp_reply.opcode(ARP::REPLY);
+    ARP other_arp_reply("10.0.0.1", "10.0.0.3");
+    other_arp_reply.opcode(ARP::REPLY);
+
+    IP tcp_probe = IP("10.0.0.1", "10.0.0.2") / TCP(80, 1337);
+    IP udp_probe = IP("10.0.0.1", "10.0.0.2") / UDP(53, 1337) / RawPDU("a");
+    IP udp_empty_probe = IP("10.0.0.1", "10.0.0.2") / UDP(53, 1337);
+    IP icmp_probe = IP("10.0.0.1", "10.0.0.2") / echo;
+    IPv6 icmp6_probe = IPv6("2001:db8::2", "2001:db8::1") / echo6;
+    ARP arp_probe("10.0.0.2", "10.0.0.1");
+
+    IP tcp_response = IP("10.0.0.2", "10.0.0.1") / TCP(1337, 80);
+    IP tcp_other_ports = IP("10.0.0.2", "10.0.0.1") / TCP(80, 1337);
+    IP tcp_other_address = IP("10.0.0.2", "10.0.0.3") / TCP(1337, 80);
+    IP udp_response = IP("10.0.0.2", "10.0.0.1") / UDP(1337, 53) / RawPDU("b");
+    IP udp_empty_response = IP("10.0.0.2", "10.0.0.1") / UDP(1337, 53);
+    IP icmp_response = IP("10.0.0.2", "10.0.0.1") / echo_reply;
+    IP icmp_other_response = IP("10.0.0.2", "10.0.0.1") / other_reply;
+    IP icmp_request = IP("10.0.0.2", "10.0.0.1") / echo;
+    IPv6 icmp6_response = IPv6("2001:db8::1", "2001:db8::2") / echo6_reply;
+
+    PDU* probes[] = { 
+        &tcp_probe, &udp_probe, &udp_empty_probe, &icmp_probe, &icmp6_probe, &arp_probe
+    };
+    PDU* responses[] = { 
+        &tcp_response, &tcp_other_ports, &tcp_other_address, &udp_response, 
+        &udp_empty_response, &icmp_response, &icmp_other_response, &icmp_request,
+        &icmp6_response, &arp_reply, &other_arp_reply
+    };
+    size_t matches = 0;
+    for (size_t i = 0; i < sizeof(probes) / sizeof(probes[0]); ++i) {
+        for (size_t j = 0; j < sizeof(responses) / sizeof(responses[0]); ++j) {
+            ProbeEngine::probe_id id = engine.expect(*probes[i], make_callback());
+            PDU::serialization_type buffer = responses[j]->serialize();
+            const bool expected = probes[i]->matches_response(&buffer[0], buffer.size());
+            EXPECT_EQ(expected, process(*responses[j])) << "probe " << i 
+                                                        << ", response " << j;
+            matches += expected ? 1 : 0;
+            engine.cancel(id);
+        }
+    }
+    // Make sure some of them actually match
+    EXPECT_EQ(6UL, matches);
+}
+
+#else
+
+TEST(ProbeEngine, Dummy) {
+    
+}
+
+#endif // TINS_HAVE_EPOLL && TINS_IS_CXX11
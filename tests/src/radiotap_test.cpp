@@ -12,11 +12,13 @@
 #include <tins/snap.h>
 #include <tins/eapol.h>
 #include <tins/utils.h>
+#include <tins/utils/radiotap_decoder.h>
 #include <tins/utils/radiotap_parser.h>
 #include <tins/utils/radiotap_writer.h>
 
 using namespace std;
 using namespace Tins;
+using Tins::Utils::RadioTapDecoder;
 using Tins::Utils::RadioTapParser;
 using Tins::Utils::RadioTapWriter;
 
@@ -782,4 +784,125 @@ TEST_F(RadioTapTest, RadioTapWriterAlignment) {
     EXPECT_EQ(buffer, expected);
 }
 
+// RadioTapDecoder
+
+void test_decoder_matches(const uint8_t* buffer, uint32_t total_sz) {
+    const uint32_t fields = RadioTap::TSFT | RadioTap::FLAGS | RadioTap::RATE |
+                            RadioTap::CHANNEL | RadioTap::DBM_SIGNAL |
+                            RadioTap::DBM_NOISE | RadioTap::ANTENNA |
+                            RadioTap::RX_FLAGS | RadioTap::XCHANNEL | RadioTap::MCS;
+    RadioTap radio(buffer, total_sz);
+    RadioTapDecoder decoder(fields);
+    decoder.decode(buffer, total_sz);
+    EXPECT_EQ(radio.length(), decoder.length());
+    // Only the first present flags word is decoded
+    uint32_t present;
+    memcpy(&present, buffer + 4, sizeof(present));
+    EXPECT_EQ(Endian::le_to_host(present) & fields, decoder.present());
+    if (decoder.has_field(RadioTap::TSFT)) {
+        EXPECT_EQ(radio.tsft(), decoder.tsft());
+    }
+    if (decoder.has_field(RadioTap::FLAGS)) {
+        EXPECT_EQ(radio.flags(), decoder.flags());
+    }
+    if (decoder.has_field(RadioTap::RATE)) {
+        EXPECT_EQ(radio.rate(), decoder.rate());
+    }
+    if (decoder.has_field(RadioTap::CHANNEL)) {
+        EXPECT_EQ(radio.channel_freq(), decoder.channel_freq());
+        EXPECT_EQ(radio.channel_type(), decoder.channel_type());
+    }
+    if (decoder.has_field(RadioTap::DBM_SIGNAL)) {
+        EXPECT_EQ(radio.dbm_signal(), decoder.dbm_signal());
+    }
+    if (decoder.has_field(RadioTap::DBM_NOISE)) {
+        EXPECT_EQ(radio.dbm_noise(), decoder.dbm_noise());
+    }
+    if (decoder.has_field(RadioTap::ANTENNA)) {
+        EXPECT_EQ(radio.antenna(), decoder.antenna());
+    }
+    if (decoder.has_field(RadioTap::RX_FLAGS)) {
+        EXPECT_EQ(radio.rx_flags(), decoder.rx_flags());
+    }
+    if (decoder.has_field(RadioTap::XCHANNEL)) {
+        EXPECT_EQ(radio.xchannel().frequency, decoder.xchannel().frequency);
+        EXPECT_EQ(radio.xchannel().channel, decoder.xchannel().channel);
+    }
+    if (decoder.has_field(RadioTap::MCS)) {
+        EXPECT_EQ(radio.mcs().mcs, decoder.mcs().mcs);
+        EXPECT_EQ(radio.mcs().flags, decoder.mcs().flags);
+    }
+}
+
+TEST_F(RadioTapTest, DecoderMatchesParsedFields) {
+    test_decoder_matches(expected_packet, sizeof(expected_packet));
+    test_decoder_matches(expected_packet1, sizeof(expected_packet1));
+    test_decoder_matches(expected_packet2, sizeof(expected_packet2));
+    test_decoder_matches(expected_packet3, sizeof(expected_packet3));
+    test_decoder_matches(expected_packet4, sizeof(expected_packet4));
+    test_decoder_matches(expected_packet5, sizeof(expected_packet5));
+    test_decoder_matches(expected_packet6, sizeof(expected_packet6));
+}
+
+TEST_F(RadioTapTest, DecoderCachesLayouts) {
+    RadioTapDecoder decoder(RadioTap::TSFT | RadioTap::RATE | RadioTap::CHANNEL |
+                            RadioTap::DBM_SIGNAL);
+    RadioTap radio;
+    radio.rate(0x16);
+    radio.inner_pdu(Dot11Data());
+    PDU::serialization_type buffer = radio.serialize();
+    for (size_t i = 0; i < 3; ++i) {
+        decoder.decode(&buffer[0], buffer.size());
+        EXPECT_EQ(1U, decoder.layout_count());
+        EXPECT_EQ(0ULL, decoder.tsft());
+        EXPECT_EQ(0x16, decoder.rate());
+        EXPECT_EQ(Utils::channel_to_mhz(1), decoder.channel_freq());
+        EXPECT_EQ(-50, decoder.dbm_signal());
+        EXPECT_THROW(decoder.antenna(), field_not_present);
+    }
+
+    // A different layout moves the signal field
+    const uint8_t other[] = {
+        0, 0, 15, 0, 0x2c, 0, 0, 0, 0x0c, 0, 0x6c, 0x09, 0xa0, 0, 0xce
+    };
+    decoder.decode(other, sizeof(other));
+    EXPECT_EQ(2U, decoder.layout_count());
+    EXPECT_FALSE(decoder.has_field(RadioTap::TSFT));
+    EXPECT_THROW(decoder.tsft(), field_not_present);
+    EXPECT_EQ(0x0c, decoder.rate());
+    EXPECT_EQ(2412, decoder.channel_freq());
+    EXPECT_EQ(-50, decoder.dbm_signal());
+
+    decoder.decode(&buffer[0], buffer.size());
+    EXPECT_EQ(2U, decoder.layout_count());
+    EXPECT_EQ(0x16, decoder.rate());
+
+    // The cache is bounded. Fields after the rate don't need to fit
+    RadioTapDecoder rate_decoder(RadioTap::RATE);
+    for (uint32_t i = 0; i <= RadioTapDecoder::MAX_LAYOUTS; ++i) {
+        uint8_t header[] = { 0, 0, 9, 0, 0, 0, 0, 0, 0x16 };
+        const uint32_t present = Endian::host_to_le<uint32_t>(RadioTap::RATE |
+                                                              (1U << (i + 3)));
+        memcpy(header + 4, &present, sizeof(present));
+        rate_decoder.decode(header, sizeof(header));
+        EXPECT_EQ(0x16, rate_decoder.rate());
+    }
+    EXPECT_EQ(RadioTapDecoder::MAX_LAYOUTS, rate_decoder.layout_count());
+}
+
+TEST_F(RadioTapTest, DecoderMalformedHeaders) {
+    RadioTapDecoder decoder(RadioTap::TSFT | RadioTap::DBM_SIGNAL);
+    const uint8_t truncated[] = { 0, 0, 32, 0, 0x21, 0, 0, 0 };
+    EXPECT_THROW(decoder.decode(truncated, sizeof(truncated)), malformed_packet);
+    // The TSFT field doesn't fit in the header
+    const uint8_t short_header[] = { 0, 0, 12, 0, 0x21, 0, 0, 0, 1, 2, 3, 4 };
+    EXPECT_THROW(decoder.decode(short_header, sizeof(short_header)), malformed_packet);
+    // Extended bitmap past the end of the header
+    const uint8_t extended[] = { 0, 0, 8, 0, 0, 0, 0, 0x80 };
+    EXPECT_THROW(decoder.decode(extended, sizeof(extended)), malformed_packet);
+    const uint8_t empty[] = { 0, 0, 8, 0, 0, 0, 0, 0 };
+    decoder.decode(empty, sizeof(empty));
+    EXPECT_EQ(0U, decoder.present());
+}
+
 #endif // TINS_HAVE_DOT11
@@ -401,6 +401,96 @@ TEST_F(FlowTest, StreamFollower_TCPOptions) {
     EXPECT_TRUE(stream.server_flow().sack_permitted());
 }
 
+TEST_F(FlowTest, StreamFollower_Metrics) {
+    vector<EthernetII> packets = three_way_handshake(29, 60, "1.2.3.4", 22, "4.3.2.1", 25);
+    StreamFollower follower;
+    follower.new_stream_callback([&](Stream& stream) {
+        stream.enable_metrics();
+    });
+    auto make_packet = [](bool from_client, uint32_t seq, uint32_t ack,
+                          size_t payload_size, uint16_t window) {
+        EthernetII packet = from_client ?
+            EthernetII() / IP("4.3.2.1", "1.2.3.4") / TCP(25, 22) :
+            EthernetII() / IP("1.2.3.4", "4.3.2.1") / TCP(22, 25);
+        TCP& tcp = packet.rfind_pdu<TCP>();
+        tcp.flags(TCP::ACK);
+        tcp.seq(seq);
+        tcp.ack_seq(ack);
+        tcp.window(window);
+        if (payload_size > 0) {
+            packet /= RawPDU(string(payload_size, 'A'));
+        }
+        return packet;
+    };
+    auto process = [&](EthernetII packet, int ms) {
+        Packet wrapped(packet, duration_cast<microseconds>(milliseconds(ms)));
+        follower.process_packet(wrapped);
+    };
+    process(packets[0], 0);
+    process(packets[1], 10);
+    process(packets[2], 15);
+    // Two data segments, the first one is timed
+    process(make_packet(true, 30, 61, 10, 1000), 20);
+    process(make_packet(true, 40, 61, 10, 1000), 21);
+    process(make_packet(false, 61, 40, 0, 1000), 50);
+    // This one leaves a hole and is out of order
+    process(make_packet(true, 60, 61, 10, 1000), 52);
+    process(make_packet(true, 50, 61, 10, 1000), 53);
+    // Retransmission
+    process(make_packet(true, 30, 61, 10, 1000), 54);
+    // Server advertises a zero window twice, then opens it and closes it again
+    process(make_packet(false, 61, 70, 0, 0), 60);
+    process(make_packet(false, 61, 70, 0, 0), 61);
+    process(make_packet(false, 61, 70, 0, 100), 62);
+    process(make_packet(false, 61, 70, 0, 0), 63);
+
+    Stream& stream = follower.find_stream(IPv4Address("1.2.3.4"), 22,
+                                          IPv4Address("4.3.2.1"), 25);
+    ASSERT_TRUE(stream.metrics_enabled());
+    const FlowMetrics& client = stream.client_flow().metrics();
+    const FlowMetrics& server = stream.server_flow().metrics();
+    ASSERT_TRUE(client.has_handshake_rtt());
+    EXPECT_EQ(milliseconds(10), client.handshake_rtt());
+    ASSERT_TRUE(server.has_handshake_rtt());
+    EXPECT_EQ(milliseconds(5), server.handshake_rtt());
+
+    // The second timed segment was ambiguous, so there's a single sample
+    EXPECT_EQ(1U, client.rtt_samples());
+    EXPECT_EQ(milliseconds(30), client.last_rtt());
+    EXPECT_EQ(milliseconds(30), client.min_rtt());
+    EXPECT_EQ(milliseconds(30), client.max_rtt());
+    EXPECT_EQ(milliseconds(30), client.smoothed_rtt());
+
+    EXPECT_EQ(1U, client.retransmitted_segments());
+    EXPECT_EQ(1U, client.out_of_order_segments());
+    EXPECT_EQ(0U, client.zero_window_events());
+    EXPECT_EQ(0U, client.bytes_in_flight());
+    EXPECT_EQ(30U, client.max_bytes_in_flight());
+
+    EXPECT_EQ(0U, server.retransmitted_segments());
+    EXPECT_EQ(2U, server.zero_window_events());
+}
+
+TEST_F(FlowTest, Stream_MetricsWithoutTimestamps) {
+    vector<EthernetII> packets = three_way_handshake(29, 60, "1.2.3.4", 22, "4.3.2.1", 25);
+    Stream stream(packets[0]);
+    EXPECT_FALSE(stream.metrics_enabled());
+    stream.enable_metrics();
+    stream.client_flow().data_callback([](Flow&) { });
+    stream.server_flow().data_callback([](Flow&) { });
+    for (size_t i = 0; i < packets.size(); ++i) {
+        stream.process_packet(packets[i]);
+    }
+    // Untimestamped packets don't produce bogus RTT samples
+    EXPECT_FALSE(stream.client_flow().metrics().has_handshake_rtt());
+    EXPECT_FALSE(stream.server_flow().metrics().has_handshake_rtt());
+
+    // Copies get their own metrics
+    Stream copy(stream);
+    EXPECT_TRUE(copy.metrics_enabled());
+    EXPECT_NE(&stream.client_flow().metrics(), &copy.client_flow().metrics());
+}
+
 TEST_F(FlowTest, StreamFollower_CleanupWorks) {
     using std::placeholders::_1;
 
@@ -619,9 +709,6 @@ TEST_F(FlowTest, StreamFollower_AttachToStreams_RecoveryMode) {
 
 #ifdef TINS_HAVE_ACK_TRACKER
 
-using namespace boost;
-using namespace boost::icl;
-
 class AckTrackerTest : public testing::Test {
 public:
     typedef AckedRange::interval_type interval_type;
@@ -678,7 +765,7 @@ TEST_F(AckTrackerTest, AckedRange_2) {
 TEST_F(AckTrackerTest, AckedRange_3) {
     AckedRange range(0, 0);
     EXPECT_TRUE(range.has_next());
-    EXPECT_TRUE(interval_type::right_open(0, 1) == range.next());
+    EXPECT_TRUE(interval_type::closed(0, 0) == range.next());
     EXPECT_FALSE(range.has_next());
 }
 
@@ -686,7 +773,7 @@ TEST_F(AckTrackerTest, AckedRange_4) {
     uint32_t maximum = numeric_limits<uint32_t>::max();
     AckedRange range(maximum, maximum);
     EXPECT_TRUE(range.has_next());
-    EXPECT_TRUE(interval_type::left_open(maximum - 1, maximum) == range.next());
+    EXPECT_TRUE(interval_type::closed(maximum, maximum) == range.next());
     EXPECT_FALSE(range.has_next());
 }
 
@@ -814,6 +901,207 @@ TEST_F(AckTrackerTest, AckingTcp_SackOutOfOrder2) {
     EXPECT_EQ(11U, tracker.ack_number());
 }
 
+TEST_F(AckTrackerTest, AckingTcp_SackStraddlingAck) {
+    AckTracker tracker(100, true);
+    tracker.process_packet(make_tcp_ack(100, make_pair(120, 130)));
+    EXPECT_TRUE(tracker.is_segment_acked(90, 10));
+    EXPECT_FALSE(tracker.is_segment_acked(90, 20));
+    tracker.process_packet(make_tcp_ack(100, make_pair(100, 120)));
+    EXPECT_EQ(119U, tracker.ack_number());
+    EXPECT_TRUE(tracker.is_segment_acked(110, 5));
+    EXPECT_TRUE(tracker.is_segment_acked(120, 10));
+    EXPECT_FALSE(tracker.is_segment_acked(120, 11));
+}
+
+TEST_F(AckTrackerTest, SackScoreboard_Merge) {
+    SackScoreboard scoreboard;
+    scoreboard.insert(10, 19);
+    scoreboard.insert(30, 39);
+    scoreboard.insert(50, 59);
+    EXPECT_EQ(3U, scoreboard.iterative_size());
+    EXPECT_EQ(30U, scoreboard.size());
+    // Adjacent to the first one
+    scoreboard.insert(20, 24);
+    EXPECT_EQ(3U, scoreboard.iterative_size());
+    // Overlaps the last two
+    scoreboard.insert(35, 52);
+    ASSERT_EQ(2U, scoreboard.iterative_size());
+    EXPECT_TRUE(SequenceInterval::closed(10, 24) == *scoreboard.begin());
+    EXPECT_TRUE(SequenceInterval::closed(30, 59) == *(scoreboard.begin() + 1));
+    EXPECT_TRUE(scoreboard.contains(31, 59));
+    EXPECT_FALSE(scoreboard.contains(20, 30));
+    EXPECT_FALSE(scoreboard.contains(0, 9));
+}
+
+TEST_F(AckTrackerTest, SackScoreboard_WrapAround) {
+    uint32_t maximum = numeric_limits<uint32_t>::max();
+    SackScoreboard scoreboard;
+    scoreboard.insert(10, 19);
+    scoreboard.insert(maximum - 9, maximum);
+    scoreboard.insert(0, 4);
+    ASSERT_EQ(2U, scoreboard.iterative_size());
+    EXPECT_TRUE(SequenceInterval::closed(maximum - 9, 4) == *scoreboard.begin());
+    EXPECT_TRUE(scoreboard.contains(maximum - 2, 2));
+    EXPECT_EQ(25U, scoreboard.size());
+
+    scoreboard.erase_until(2);
+    ASSERT_EQ(2U, scoreboard.iterative_size());
+    EXPECT_TRUE(SequenceInterval::closed(3, 4) == *scoreboard.begin());
+    scoreboard.erase_until(15);
+    ASSERT_EQ(1U, scoreboard.iterative_size());
+    EXPECT_TRUE(SequenceInterval::closed(16, 19) == *scoreboard.begin());
+}
+
+TEST_F(AckTrackerTest, SackScoreboard_Overflow) {
+    SackScoreboard scoreboard;
+    for (uint32_t i = 0; i < SackScoreboard::MAX_INTERVALS; ++i) {
+        scoreboard.insert(i * 10 + 100, i * 10 + 104);
+    }
+    EXPECT_EQ(SackScoreboard::MAX_INTERVALS, scoreboard.iterative_size());
+    EXPECT_EQ(0U, scoreboard.dropped_intervals());
+    // Further away than any other interval, this one is dropped
+    scoreboard.insert(10000, 10010);
+    EXPECT_EQ(1U, scoreboard.dropped_intervals());
+    EXPECT_FALSE(scoreboard.contains(10000, 10010));
+    // This one makes the furthest interval be dropped
+    scoreboard.insert(0, 10);
+    EXPECT_EQ(2U, scoreboard.dropped_intervals());
+    EXPECT_EQ(SackScoreboard::MAX_INTERVALS, scoreboard.iterative_size());
+    EXPECT_TRUE(scoreboard.contains(0, 10));
+    EXPECT_TRUE(SequenceInterval::closed(400, 404) == *(scoreboard.end() - 1));
+    // Merging doesn't require any extra space
+    scoreboard.insert(105, 109);
+    EXPECT_EQ(2U, scoreboard.dropped_intervals());
+    EXPECT_EQ(SackScoreboard::MAX_INTERVALS - 1, scoreboard.iterative_size());
+
+    // Advancing the cumulative ACK resets the count
+    scoreboard.erase_until(50);
+    EXPECT_EQ(0U, scoreboard.dropped_intervals());
+    EXPECT_EQ(SackScoreboard::MAX_INTERVALS - 2, scoreboard.iterative_size());
+    scoreboard.insert(1000, 1010);
+    scoreboard.insert(2000, 2010);
+    scoreboard.insert(3000, 3010);
+    EXPECT_EQ(1U, scoreboard.dropped_intervals());
+
+    scoreboard.clear();
+    EXPECT_TRUE(scoreboard.empty());
+    EXPECT_EQ(0U, scoreboard.dropped_intervals());
+}
+
+TEST_F(AckTrackerTest, StreamFollower_DroppedSackedIntervals) {
+    const uint32_t max_dropped_values[] = { 1024, 4 };
+    for (size_t n = 0; n < 2; ++n) {
+        // Client 1.2.3.4:22 and server 4.3.2.1:25
+        vector<EthernetII> packets;
+        packets.push_back(EthernetII() / IP("4.3.2.1", "1.2.3.4") / TCP(25, 22));
+        packets.push_back(EthernetII() / IP("1.2.3.4", "4.3.2.1") / TCP(22, 25));
+        packets.push_back(EthernetII() / IP("4.3.2.1", "1.2.3.4") / TCP(25, 22));
+        packets[0].rfind_pdu<TCP>().flags(TCP::SYN);
+        packets[0].rfind_pdu<TCP>().seq(29);
+        packets[1].rfind_pdu<TCP>().flags(TCP::SYN | TCP::ACK);
+        packets[1].rfind_pdu<TCP>().seq(60);
+        packets[1].rfind_pdu<TCP>().ack_seq(30);
+        packets[2].rfind_pdu<TCP>().flags(TCP::ACK);
+        packets[2].rfind_pdu<TCP>().seq(30);
+        packets[2].rfind_pdu<TCP>().ack_seq(61);
+
+        bool terminated = false;
+        StreamFollower follower;
+        follower.max_dropped_sacked_intervals(max_dropped_values[n]);
+        follower.new_stream_callback([&](Stream& stream) {
+            stream.enable_ack_tracking();
+        });
+        follower.stream_termination_callback([&](Stream&, StreamFollower::TerminationReason reason) {
+            terminated = (reason == StreamFollower::SACKED_SEGMENTS);
+        });
+        for (size_t i = 0; i < packets.size(); ++i) {
+            follower.process_packet(packets[i]);
+        }
+        Stream& stream = follower.find_stream(IPv4Address("1.2.3.4"), 22,
+                                              IPv4Address("4.3.2.1"), 25);
+        stream.client_flow().ack_tracker().use_sack();
+        stream.server_flow().ack_tracker().use_sack();
+        // Every ACK SACKs a new hole, so the scoreboards overflow
+        const uint32_t hole_count = SackScoreboard::MAX_INTERVALS + 10;
+        for (uint32_t i = 0; i < hole_count && !terminated; ++i) {
+            EthernetII client_ack = EthernetII() / IP("4.3.2.1", "1.2.3.4") / 
+                                    (make_tcp_ack(61, make_pair(100 + i * 10, 105 + i * 10)));
+            EthernetII server_ack = EthernetII() / IP("1.2.3.4", "4.3.2.1") / 
+                                    (make_tcp_ack(30, make_pair(100 + i * 10, 105 + i * 10)));
+            client_ack.rfind_pdu<TCP>().sport(22);
+            client_ack.rfind_pdu<TCP>().dport(25);
+            client_ack.rfind_pdu<TCP>().flags(TCP::ACK);
+            server_ack.rfind_pdu<TCP>().sport(25);
+            server_ack.rfind_pdu<TCP>().dport(22);
+            server_ack.rfind_pdu<TCP>().flags(TCP::ACK);
+            follower.process_packet(client_ack);
+            follower.process_packet(server_ack);
+        }
+        // Overflowing the scoreboards only terminates the stream past the limit
+        EXPECT_EQ(n == 1, terminated);
+        if (n == 0) {
+            Stream& stream = follower.find_stream(IPv4Address("1.2.3.4"), 22,
+                                                  IPv4Address("4.3.2.1"), 25);
+            EXPECT_GT(stream.client_flow().ack_tracker().acked_intervals().dropped_intervals() +
+                      stream.server_flow().ack_tracker().acked_intervals().dropped_intervals(), 0U);
+        }
+    }
+}
+
+TEST_F(AckTrackerTest, StreamFollower_DroppedSackedIntervalsWhileAckAdvances) {
+    // Client 1.2.3.4:22 and server 4.3.2.1:25
+    vector<EthernetII> packets;
+    packets.push_back(EthernetII() / IP("4.3.2.1", "1.2.3.4") / TCP(25, 22));
+    packets.push_back(EthernetII() / IP("1.2.3.4", "4.3.2.1") / TCP(22, 25));
+    packets.push_back(EthernetII() / IP("4.3.2.1", "1.2.3.4") / TCP(25, 22));
+    packets[0].rfind_pdu<TCP>().flags(TCP::SYN);
+    packets[0].rfind_pdu<TCP>().seq(29);
+    packets[1].rfind_pdu<TCP>().flags(TCP::SYN | TCP::ACK);
+    packets[1].rfind_pdu<TCP>().seq(60);
+    packets[1].rfind_pdu<TCP>().ack_seq(30);
+    packets[2].rfind_pdu<TCP>().flags(TCP::ACK);
+    packets[2].rfind_pdu<TCP>().seq(30);
+    packets[2].rfind_pdu<TCP>().ack_seq(61);
+
+    bool terminated = false;
+    StreamFollower follower;
+    follower.max_dropped_sacked_intervals(4);
+    follower.new_stream_callback([&](Stream& stream) {
+        stream.enable_ack_tracking();
+    });
+    follower.stream_termination_callback([&](Stream&, StreamFollower::TerminationReason) {
+        terminated = true;
+    });
+    for (size_t i = 0; i < packets.size(); ++i) {
+        follower.process_packet(packets[i]);
+    }
+    Stream& stream = follower.find_stream(IPv4Address("1.2.3.4"), 22,
+                                          IPv4Address("4.3.2.1"), 25);
+    stream.client_flow().ack_tracker().use_sack();
+    stream.server_flow().ack_tracker().use_sack();
+    // Each round overflows the scoreboard by a few intervals, which stays
+    // under the limit, and then the cumulative ACK moves past every hole
+    uint32_t ack_number = 61;
+    for (uint32_t round = 0; round < 20 && !terminated; ++round) {
+        for (uint32_t i = 0; i < SackScoreboard::MAX_INTERVALS + 4; ++i) {
+            const uint32_t first = ack_number + 100 + i * 10;
+            EthernetII ack = EthernetII() / IP("4.3.2.1", "1.2.3.4") /
+                             (make_tcp_ack(ack_number, make_pair(first, first + 5)));
+            ack.rfind_pdu<TCP>().sport(22);
+            ack.rfind_pdu<TCP>().dport(25);
+            ack.rfind_pdu<TCP>().flags(TCP::ACK);
+            follower.process_packet(ack);
+        }
+        ack_number += 1000;
+        EthernetII ack = EthernetII() / IP("4.3.2.1", "1.2.3.4") / make_tcp_ack(ack_number);
+        ack.rfind_pdu<TCP>().sport(22);
+        ack.rfind_pdu<TCP>().dport(25);
+        ack.rfind_pdu<TCP>().flags(TCP::ACK);
+        follower.process_packet(ack);
+    }
+    EXPECT_FALSE(terminated);
+}
+
 TEST_F(FlowTest, AckNumbersAreCorrect) {
     using std::placeholders::_1;
 
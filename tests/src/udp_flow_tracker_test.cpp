@@ -0,0 +1,193 @@
+#include <tins/config.h>
+#include <gtest/gtest.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <vector>
+#include <chrono>
+#include <tins/tcp_ip/udp_flow_tracker.h>
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/udp.h>
+#include <tins/tcp.h>
+#include <tins/rawpdu.h>
+#include <tins/ip_address.h>
+#include <tins/ipv6_address.h>
+#include <tins/exceptions.h>
+
+using namespace std;
+using namespace std::chrono;
+using namespace Tins;
+using namespace Tins::TCPIP;
+
+class UDPFlowTrackerTest : public testing::Test {
+public:
+    typedef UDPFlowTracker::TerminationReason reason_type;
+
+    static IP make_packet(const char* src_addr, uint16_t sport, const char* dst_addr,
+                          uint16_t dport, size_t payload_size);
+
+    void on_new_flow(UDPFlow& flow) {
+        new_flows.push_back(&flow);
+    }
+
+    void on_termination(UDPFlow& flow, reason_type reason) {
+        terminated.push_back(make_pair(flow.client_port(), reason));
+    }
+
+    void setup(UDPFlowTracker& tracker) {
+        using std::placeholders::_1;
+        using std::placeholders::_2;
+        tracker.new_flow_callback(bind(&UDPFlowTrackerTest::on_new_flow, this, _1));
+        tracker.flow_termination_callback(bind(&UDPFlowTrackerTest::on_termination,
+                                               this, _1, _2));
+    }
+
+    vector<UDPFlow*> new_flows;
+    vector<pair<uint16_t, reason_type> > terminated;
+};
+
+IP UDPFlowTrackerTest::make_packet(const char* src_addr, uint16_t sport,
+                                   const char* dst_addr, uint16_t dport,
+                                   size_t payload_size) {
+    return IP(dst_addr, src_addr) / UDP(dport, sport) / 
+           RawPDU(string(payload_size, 'A'));
+}
+
+TEST_F(UDPFlowTrackerTest, Counters) {
+    UDPFlowTracker tracker;
+    setup(tracker);
+    vector<UDPFlow::Direction> directions;
+    tracker.data_callback([&](UDPFlow&, UDPFlow::Direction direction, const UDP&) {
+        directions.push_back(direction);
+    });
+    IP query = make_packet("1.2.3.4", 1025, "8.8.8.8", 53, 30);
+    IP response = make_packet("8.8.8.8", 53, "1.2.3.4", 1025, 100);
+    tracker.process_packet(query, microseconds(1));
+    tracker.process_packet(response, microseconds(2));
+    tracker.process_packet(query, microseconds(3));
+
+    ASSERT_EQ(1U, new_flows.size());
+    EXPECT_EQ(1U, tracker.flows_count());
+    UDPFlow& flow = tracker.find_flow(IPv4Address("1.2.3.4"), 1025, 
+                                      IPv4Address("8.8.8.8"), 53);
+    EXPECT_EQ(new_flows[0], &flow);
+    EXPECT_FALSE(flow.is_v6());
+    EXPECT_EQ(IPv4Address("1.2.3.4"), flow.client_addr_v4());
+    EXPECT_EQ(IPv4Address("8.8.8.8"), flow.server_addr_v4());
+    EXPECT_EQ(1025, flow.client_port());
+    EXPECT_EQ(53, flow.server_port());
+    EXPECT_EQ(2U, flow.client_packets());
+    EXPECT_EQ(60U, flow.client_bytes());
+    EXPECT_EQ(1U, flow.server_packets());
+    EXPECT_EQ(100U, flow.server_bytes());
+    EXPECT_EQ(microseconds(1), flow.create_time());
+    EXPECT_EQ(microseconds(3), flow.last_seen());
+
+    ASSERT_EQ(3U, directions.size());
+    EXPECT_EQ(UDPFlow::CLIENT_TO_SERVER, directions[0]);
+    EXPECT_EQ(UDPFlow::SERVER_TO_CLIENT, directions[1]);
+    EXPECT_EQ(UDPFlow::CLIENT_TO_SERVER, directions[2]);
+}
+
+TEST_F(UDPFlowTrackerTest, SamePortDirection) {
+    UDPFlowTracker tracker;
+    IP request = make_packet("10.0.0.1", 123, "10.0.0.2", 123, 48);
+    IP reply = make_packet("10.0.0.2", 123, "10.0.0.1", 123, 48);
+    tracker.process_packet(request, microseconds(1));
+    tracker.process_packet(reply, microseconds(2));
+    tracker.process_packet(reply, microseconds(3));
+    UDPFlow& flow = tracker.find_flow(IPv4Address("10.0.0.1"), 123, 
+                                      IPv4Address("10.0.0.2"), 123);
+    EXPECT_EQ(1U, flow.client_packets());
+    EXPECT_EQ(2U, flow.server_packets());
+}
+
+TEST_F(UDPFlowTrackerTest, IPv6Flow) {
+    UDPFlowTracker tracker;
+    IPv6 packet = IPv6("::2", "::1") / UDP(53, 2000) / RawPDU("hello");
+    tracker.process_packet(packet, microseconds(1));
+    UDPFlow& flow = tracker.find_flow(IPv6Address("::1"), 2000, IPv6Address("::2"), 53);
+    EXPECT_TRUE(flow.is_v6());
+    EXPECT_EQ(IPv6Address("::1"), flow.client_addr_v6());
+    EXPECT_EQ(5U, flow.client_bytes());
+}
+
+TEST_F(UDPFlowTrackerTest, NonUDPPacketsAreIgnored) {
+    UDPFlowTracker tracker;
+    setup(tracker);
+    IP packet = IP("1.2.3.4", "4.3.2.1") / TCP(22, 1025);
+    tracker.process_packet(packet, microseconds(1));
+    EXPECT_EQ(0U, tracker.flows_count());
+    EXPECT_EQ(0U, new_flows.size());
+}
+
+TEST_F(UDPFlowTrackerTest, FindNonExistingFlow) {
+    UDPFlowTracker tracker;
+    EXPECT_THROW(
+        tracker.find_flow(IPv4Address("1.2.3.4"), 1, IPv4Address("4.3.2.1"), 2),
+        stream_not_found
+    );
+}
+
+TEST_F(UDPFlowTrackerTest, Timeout) {
+    UDPFlowTracker tracker;
+    setup(tracker);
+    tracker.flow_keep_alive(seconds(10));
+    for (uint16_t port = 1000; port < 1010; ++port) {
+        IP packet = make_packet("1.2.3.4", port, "4.3.2.1", 53, 10);
+        tracker.process_packet(packet, seconds(port - 1000));
+    }
+    // Refresh the first flow
+    IP packet = make_packet("4.3.2.1", 53, "1.2.3.4", 1000, 10);
+    tracker.process_packet(packet, seconds(9));
+    EXPECT_EQ(10U, tracker.flows_count());
+
+    // Flows 1001 to 1005 are expired, but only a few of them per packet
+    packet = make_packet("1.2.3.4", 2000, "4.3.2.1", 53, 10);
+    tracker.process_packet(packet, seconds(15));
+    EXPECT_LT(tracker.flows_count(), 11U);
+    EXPECT_GT(tracker.flows_count(), 6U);
+    tracker.process_packet(packet, seconds(15));
+    tracker.process_packet(packet, seconds(15));
+    EXPECT_EQ(6U, tracker.flows_count());
+
+    ASSERT_EQ(5U, terminated.size());
+    for (size_t i = 0; i < terminated.size(); ++i) {
+        EXPECT_EQ(1001 + i, terminated[i].first);
+        EXPECT_EQ(UDPFlowTracker::TIMEOUT, terminated[i].second);
+    }
+    tracker.cleanup_flows(seconds(100));
+    EXPECT_EQ(0U, tracker.flows_count());
+    EXPECT_EQ(11U, terminated.size());
+}
+
+TEST_F(UDPFlowTrackerTest, MaxFlows) {
+    UDPFlowTracker tracker;
+    setup(tracker);
+    tracker.max_flows(3);
+    for (uint16_t port = 1000; port < 1005; ++port) {
+        IP packet = make_packet("1.2.3.4", port, "4.3.2.1", 53, 10);
+        tracker.process_packet(packet, microseconds(port));
+        if (port == 1002) {
+            // Refresh the first flow so it's not the least recently seen one
+            packet = make_packet("1.2.3.4", 1000, "4.3.2.1", 53, 10);
+            tracker.process_packet(packet, microseconds(port));
+        }
+    }
+    EXPECT_EQ(3U, tracker.flows_count());
+    ASSERT_EQ(2U, terminated.size());
+    EXPECT_EQ(1001, terminated[0].first);
+    EXPECT_EQ(UDPFlowTracker::MAX_FLOWS, terminated[0].second);
+    EXPECT_EQ(1002, terminated[1].first);
+    EXPECT_NO_THROW(tracker.find_flow(IPv4Address("1.2.3.4"), 1000, 
+                                      IPv4Address("4.3.2.1"), 53));
+}
+
+#else
+
+TEST(Foo, Dummy) {
+
+}
+
+#endif // TINS_HAVE_TCPIP
@@ -71,3 +71,19 @@ TEST_F(UtilsTest, Crc32) {
 
     EXPECT_EQ(crc, 0x78840f54U);
 }
+
+TEST_F(UtilsTest, Crc32Lengths) {
+    // Compare against a bitwise implementation, covering every alignment
+    // of the 8 bytes blocks
+    for (uint32_t size = 0; size <= 40; ++size) {
+        uint32_t expected = 0xffffffff;
+        for (uint32_t i = 0; i < size; ++i) {
+            expected ^= data[i];
+            for (int bit = 0; bit < 8; ++bit) {
+                expected = (expected >> 1) ^ ((expected & 1) ? 0xedb88320 : 0);
+            }
+        }
+        EXPECT_EQ(~expected, Utils::crc32(data, size));
+    }
+    EXPECT_EQ(0xcbf43926U, Utils::crc32((const uint8_t*)"123456789", 9));
+}
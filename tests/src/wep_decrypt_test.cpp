@@ -5,6 +5,7 @@
 #include <gtest/gtest.h>
 #include <cstring>
 #include <string>
+#include <vector>
 #include <stdint.h>
 #include <tins/crypto.h>
 #include <tins/arp.h>
@@ -46,4 +47,54 @@ TEST_F(WEPDecryptTest, Decrypt1) {
     EXPECT_FALSE(decrypter.decrypt(dot11));
 }
 
+TEST_F(WEPDecryptTest, DecryptInPlace) {
+    Dot11Data dot11(expected_packet, sizeof(expected_packet));
+    Crypto::WEPDecrypter decrypter;
+    decrypter.add_password("00:12:bf:12:32:29", "\x1f\x1f\x1f\x1f\x1f");
+    ASSERT_TRUE(decrypter.decrypt(dot11));
+
+    std::vector<uint8_t> frame(expected_packet, expected_packet + sizeof(expected_packet));
+    uint8_t* plaintext = 0;
+    uint32_t plaintext_size = 0;
+    ASSERT_TRUE(decrypter.decrypt_in_place(&frame[0], frame.size(), plaintext,
+                                           plaintext_size));
+    EXPECT_EQ(dot11.inner_pdu()->serialize(),
+              PDU::serialization_type(plaintext, plaintext + plaintext_size));
+    // The frame's header is kept, with the protected flag cleared
+    EXPECT_EQ(&frame[0] + dot11.header_size(), plaintext);
+    EXPECT_EQ(0, frame[1] & 0x40);
+    // It's no longer protected
+    EXPECT_FALSE(decrypter.decrypt_in_place(&frame[0], frame.size(), plaintext,
+                                            plaintext_size));
+}
+
+TEST_F(WEPDecryptTest, DecryptInPlaceBatch) {
+    Crypto::WEPDecrypter decrypter;
+    decrypter.add_password("00:12:bf:12:32:29", "\x1f\x1f\x1f\x1f\x1f");
+    std::vector<std::vector<uint8_t> > buffers(5, std::vector<uint8_t>(
+        expected_packet, expected_packet + sizeof(expected_packet)));
+    // Corrupt the ICV, unknown BSSID and truncated frames, followed by a
+    // valid one from the first BSSID
+    buffers[1].back() ^= 1;
+    buffers[2][10] ^= 1;
+    buffers[3].resize(30);
+    std::vector<Crypto::InPlaceFrame> frames;
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        frames.push_back(Crypto::InPlaceFrame(&buffers[i][0], buffers[i].size()));
+    }
+    frames.push_back(Crypto::InPlaceFrame(&buffers[0][0], buffers[0].size()));
+    EXPECT_EQ(2U, decrypter.decrypt_in_place(&frames[0], frames.size()));
+    EXPECT_EQ(&buffers[0][0] + 24, frames[0].plaintext);
+    EXPECT_EQ(sizeof(expected_packet) - 32, frames[0].plaintext_size);
+    EXPECT_EQ(&buffers[4][0] + 24, frames[4].plaintext);
+    EXPECT_EQ(sizeof(expected_packet) - 32, frames[4].plaintext_size);
+    // The same frame can't be decrypted twice
+    for (size_t i = 1; i < frames.size(); ++i) {
+        if (i != 4) {
+            EXPECT_TRUE(frames[i].plaintext == 0);
+            EXPECT_EQ(0U, frames[i].plaintext_size);
+        }
+    }
+}
+
 #endif // TINS_HAVE_DOT11
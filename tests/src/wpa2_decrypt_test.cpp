@@ -3,15 +3,30 @@
 #if defined(TINS_HAVE_DOT11) && defined(TINS_HAVE_WPA2_DECRYPTION)
 
 #include <gtest/gtest.h>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <vector>
 #include <stdint.h>
+#ifndef _WIN32
+    #include <sys/stat.h>
+#endif // _WIN32
 #include <tins/crypto.h>
+#include <tins/decryption_pipeline.h>
+#include <tins/exceptions.h>
+#include <tins/handshake_capturer.h>
 #include <tins/radiotap.h>
+#include <tins/rawpdu.h>
+#include <tins/snap.h>
 #include <tins/dot11/dot11_data.h>
 #include <tins/udp.h>
 #include <tins/tcp.h>
 #include <tins/arp.h>
+#include <tins/packet.h>
 
 using namespace Tins;
 
@@ -162,6 +177,28 @@ TEST_F(WPA2DecryptTest, DecryptCCMPUsingBeacon) {
     }
 }
 
+TEST_F(WPA2DecryptTest, DecryptCCMPUsingCopiedDecrypter) {
+    Crypto::WPA2Decrypter* original = new Crypto::WPA2Decrypter();
+    original->add_ap_data("Induction", "Coherer");
+    // Capture the handshake before copying
+    for(size_t i = 0; i < 5; ++i) {
+        RadioTap radio(ccmp_packets[i], ccmp_packets_size[i]);
+        ASSERT_FALSE(original->decrypt(radio));
+    }
+    Crypto::WPA2Decrypter copied(*original);
+    Crypto::WPA2Decrypter assigned;
+    assigned = *original;
+    delete original;
+    EXPECT_EQ(1U, copied.get_keys().size());
+
+    RadioTap radio5(ccmp_packets[5], ccmp_packets_size[5]);
+    ASSERT_TRUE(copied.decrypt(radio5));
+    check_ccmp_packet5(radio5);
+    RadioTap radio6(ccmp_packets[6], ccmp_packets_size[6]);
+    ASSERT_TRUE(assigned.decrypt(radio6));
+    check_ccmp_packet6(radio6);
+}
+
 TEST_F(WPA2DecryptTest, DecryptCCMPQosUsingBeacon) {
     Crypto::WPA2Decrypter decrypter;
     decrypter.add_ap_data("password1", "Testing");
@@ -194,6 +231,25 @@ TEST_F(WPA2DecryptTest, DecryptCCMPWithoutUsingBeacon) {
     }
 }
 
+TEST_F(WPA2DecryptTest, DecryptCCMPWithInvalidMIC) {
+    Crypto::WPA2Decrypter decrypter;
+    decrypter.add_ap_data("Induction", "Coherer", "00:0c:41:82:b2:55");
+    for(size_t i = 1; i < 5; ++i) {
+        RadioTap radio(ccmp_packets[i], ccmp_packets_size[i]);
+        ASSERT_FALSE(decrypter.decrypt(radio));
+    }
+    // Corrupt the encrypted data
+    std::vector<uint8_t> buffer(ccmp_packets[5], ccmp_packets[5] + ccmp_packets_size[5]);
+    buffer[buffer.size() - 20] ^= 0xff;
+    RadioTap corrupted(&buffer[0], buffer.size());
+    EXPECT_FALSE(decrypter.decrypt(corrupted));
+
+    // The same keys are still usable afterwards
+    RadioTap radio(ccmp_packets[5], ccmp_packets_size[5]);
+    ASSERT_TRUE(decrypter.decrypt(radio));
+    check_ccmp_packet5(radio);
+}
+
 TEST_F(WPA2DecryptTest, DecryptCCMPUsingKey) {
     Crypto::WPA2Decrypter::addr_pair addresses;
     Crypto::WPA2::SessionKeys session_keys;
@@ -225,6 +281,26 @@ TEST_F(WPA2DecryptTest, DecryptCCMPUsingKey) {
     EXPECT_TRUE(session_keys.uses_ccmp());
 }
 
+TEST_F(WPA2DecryptTest, DecryptCCMPUsingConstKeys) {
+    Crypto::WPA2Decrypter decrypter;
+    decrypter.add_ap_data("Induction", "Coherer", "00:0c:41:82:b2:55");
+    for(size_t i = 1; i < 5; ++i) {
+        RadioTap radio(ccmp_packets[i], ccmp_packets_size[i]);
+        ASSERT_FALSE(decrypter.decrypt(radio));
+    }
+    const Crypto::WPA2Decrypter::keys_map& keys = decrypter.get_keys();
+    ASSERT_EQ(1ULL, keys.size());
+    const Crypto::WPA2::SessionKeys& session_keys = keys.begin()->second;
+
+    RadioTap radio(ccmp_packets[5], ccmp_packets_size[5]);
+    Dot11Data& data = radio.rfind_pdu<Dot11Data>();
+    SNAP* snap = session_keys.decrypt_unicast(data, data.rfind_pdu<RawPDU>());
+    ASSERT_TRUE(snap != 0);
+    data.inner_pdu(snap);
+    data.wep(0);
+    check_ccmp_packet5(radio);
+}
+
 TEST_F(WPA2DecryptTest, DecryptTKIPUsingBeacon) {
     Crypto::WPA2Decrypter decrypter;
     decrypter.add_ap_data("libtinstest", "NODO");
@@ -320,6 +396,200 @@ TEST_F(WPA2DecryptTest, DecryptCCMPAndTKIPUsingBeacon) {
     }
 }
 
+TEST_F(WPA2DecryptTest, AddApDataInBulk) {
+    typedef Crypto::WPA2Decrypter::ap_credentials ap_credentials;
+    std::vector<ap_credentials> credentials;
+    credentials.push_back(ap_credentials("libtinstest", "NODO"));
+    credentials.push_back(ap_credentials("Induction", "Coherer"));
+    credentials.push_back(ap_credentials("unused", "Other"));
+    Crypto::WPA2::PMKCache cache;
+    Crypto::WPA2Decrypter decrypter;
+    decrypter.add_ap_data(credentials, &cache, 2);
+
+    EXPECT_EQ(3U, cache.size());
+    Crypto::WPA2::PMKCache::pmk_type pmk;
+    ASSERT_TRUE(cache.find("Induction", "Coherer", pmk));
+    EXPECT_EQ(Crypto::WPA2::SupplicantData("Induction", "Coherer").pmk(), pmk);
+    EXPECT_FALSE(cache.find("Induction", "NODO", pmk));
+    EXPECT_FALSE(cache.find("induction", "Coherer", pmk));
+
+    for(size_t i = 0; i < 7; ++i) {
+        RadioTap radio(ccmp_packets[i], ccmp_packets_size[i]);
+        EXPECT_EQ(i > 4, decrypter.decrypt(radio));
+    }
+    for(size_t i = 0; i < 7; ++i) {
+        RadioTap radio(tkip_packets[i], tkip_packets_size[i]);
+        EXPECT_EQ(i > 4, decrypter.decrypt(radio));
+    }
+}
+
+TEST_F(WPA2DecryptTest, PMKCacheSaveAndLoad) {
+    const std::string file_name = "wpa2_decrypt_test_pmks.bin";
+    Crypto::WPA2::PMKCache::pmk_type expected_pmk =
+        Crypto::WPA2::SupplicantData("Induction", "Coherer").pmk();
+    {
+        Crypto::WPA2::PMKCache cache;
+        EXPECT_TRUE(cache.insert("Induction", "Coherer", expected_pmk));
+        // Too long to be stored
+        EXPECT_FALSE(cache.insert("Induction", std::string(256, 'a'), expected_pmk));
+        cache.save(file_name);
+    }
+    #ifndef _WIN32
+        // Only the owner can read the PMKs
+        struct stat file_stat;
+        ASSERT_EQ(0, stat(file_name.c_str(), &file_stat));
+        EXPECT_EQ(0U, file_stat.st_mode & 0077U);
+    #endif // _WIN32
+    Crypto::WPA2::PMKCache cache(file_name);
+    EXPECT_EQ(1U, cache.size());
+    Crypto::WPA2::PMKCache::pmk_type pmk;
+    ASSERT_TRUE(cache.find("Induction", "Coherer", pmk));
+    EXPECT_EQ(expected_pmk, pmk);
+
+    // The cached PMK is used as is
+    std::vector<Crypto::WPA2Decrypter::ap_credentials> credentials;
+    credentials.push_back(Crypto::WPA2Decrypter::ap_credentials("Induction", "Coherer"));
+    Crypto::WPA2Decrypter decrypter;
+    decrypter.add_ap_data(credentials, &cache);
+    EXPECT_EQ(1U, cache.size());
+    for(size_t i = 0; i < 7; ++i) {
+        RadioTap radio(ccmp_packets[i], ccmp_packets_size[i]);
+        if(i > 4) {
+            ASSERT_TRUE(decrypter.decrypt(radio));
+            if(i == 5)
+                check_ccmp_packet5(radio);
+            else
+                check_ccmp_packet6(radio);
+        }
+        else 
+            ASSERT_FALSE(decrypter.decrypt(radio));
+    }
+
+    // Truncate the file
+    {
+        std::ifstream input(file_name.c_str(), std::ios::binary);
+        std::string contents((std::istreambuf_iterator<char>(input)),
+                             std::istreambuf_iterator<char>());
+        input.close();
+        std::ofstream output(file_name.c_str(), std::ios::binary);
+        output << contents.substr(0, contents.size() - 1);
+    }
+    EXPECT_THROW(cache.load(file_name), file_read_error);
+    EXPECT_EQ(1U, cache.size());
+    remove(file_name.c_str());
+    EXPECT_THROW(cache.load(file_name), file_open_error);
+}
+
+TEST_F(WPA2DecryptTest, DecryptInPlace) {
+    Crypto::WPA2Decrypter decrypter;
+    Crypto::WPA2Decrypter pdu_decrypter;
+    decrypter.add_ap_data("libtinstest", "NODO");
+    decrypter.add_ap_data("Induction", "Coherer");
+    pdu_decrypter.add_ap_data("libtinstest", "NODO");
+    pdu_decrypter.add_ap_data("Induction", "Coherer");
+    for(size_t n = 0; n < 2; ++n) {
+        for(size_t i = 0; i < 7; ++i) {
+            const uint8_t* packet = (n == 0) ? ccmp_packets[i] : tkip_packets[i];
+            const size_t packet_size = (n == 0) ? ccmp_packets_size[i] : tkip_packets_size[i];
+            RadioTap radio(packet, packet_size);
+            // The 802.11 frame, without the radiotap header and FCS
+            PDU::serialization_type frame = radio.inner_pdu()->serialize();
+            uint8_t* plaintext = 0;
+            uint32_t plaintext_size = 0;
+            const bool decrypted = decrypter.decrypt_in_place(&frame[0], frame.size(),
+                                                              plaintext, plaintext_size);
+            ASSERT_EQ(i > 4, decrypted);
+            ASSERT_EQ(decrypted, pdu_decrypter.decrypt(radio));
+            if(decrypted) {
+                EXPECT_EQ(radio.rfind_pdu<SNAP>().serialize(),
+                          PDU::serialization_type(plaintext, plaintext + plaintext_size));
+                // The frame's header is kept, with the protected flag cleared
+                EXPECT_EQ(&frame[0] + radio.rfind_pdu<Dot11Data>().header_size(), plaintext);
+                EXPECT_EQ(0, frame[1] & 0x40);
+                if(n == 0 && i == 5) {
+                    check_ccmp_packet5(Dot11Data(&frame[0], plaintext - &frame[0] +
+                                                 plaintext_size));
+                }
+            }
+        }
+    }
+    EXPECT_EQ(2U, decrypter.get_keys().size());
+}
+
+TEST_F(WPA2DecryptTest, DecryptInPlaceBatch) {
+    Crypto::WPA2Decrypter decrypter;
+    Crypto::WPA2Decrypter pdu_decrypter;
+    decrypter.add_ap_data("libtinstest", "NODO");
+    decrypter.add_ap_data("Induction", "Coherer");
+    pdu_decrypter.add_ap_data("libtinstest", "NODO");
+    pdu_decrypter.add_ap_data("Induction", "Coherer");
+    vector<RadioTap> packets;
+    vector<PDU::serialization_type> buffers;
+    for(size_t i = 0; i < 7; ++i) {
+        packets.push_back(RadioTap(ccmp_packets[i], ccmp_packets_size[i]));
+        packets.push_back(RadioTap(tkip_packets[i], tkip_packets_size[i]));
+    }
+    for(size_t i = 0; i < packets.size(); ++i) {
+        buffers.push_back(packets[i].inner_pdu()->serialize());
+    }
+    vector<Crypto::InPlaceFrame> frames;
+    for(size_t i = 0; i < buffers.size(); ++i) {
+        frames.push_back(Crypto::InPlaceFrame(&buffers[i][0], buffers[i].size()));
+    }
+    // Handshakes in the batch are used to decrypt the frames after them
+    EXPECT_EQ(4U, decrypter.decrypt_in_place(&frames[0], frames.size()));
+    for(size_t i = 0; i < packets.size(); ++i) {
+        if(pdu_decrypter.decrypt(packets[i])) {
+            ASSERT_TRUE(frames[i].plaintext != 0);
+            EXPECT_EQ(packets[i].rfind_pdu<SNAP>().serialize(),
+                      PDU::serialization_type(frames[i].plaintext,
+                                              frames[i].plaintext + frames[i].plaintext_size));
+        }
+        else {
+            EXPECT_TRUE(frames[i].plaintext == 0);
+            EXPECT_EQ(0U, frames[i].plaintext_size);
+        }
+    }
+    EXPECT_EQ(2U, decrypter.get_keys().size());
+}
+
+TEST_F(WPA2DecryptTest, DecryptInPlaceBatchGroupedByConversation) {
+    Crypto::WPA2Decrypter decrypter;
+    decrypter.add_ap_data("libtinstest", "NODO");
+    decrypter.add_ap_data("Induction", "Coherer");
+    vector<PDU::serialization_type> buffers;
+    // Both handshakes, then the data frames of each conversation
+    for(size_t i = 0; i < 5; ++i) {
+        buffers.push_back(RadioTap(ccmp_packets[i], ccmp_packets_size[i]).inner_pdu()->serialize());
+        buffers.push_back(RadioTap(tkip_packets[i], tkip_packets_size[i]).inner_pdu()->serialize());
+    }
+    for(size_t i = 5; i < 7; ++i) {
+        buffers.push_back(RadioTap(ccmp_packets[i], ccmp_packets_size[i]).inner_pdu()->serialize());
+    }
+    for(size_t i = 5; i < 7; ++i) {
+        buffers.push_back(RadioTap(tkip_packets[i], tkip_packets_size[i]).inner_pdu()->serialize());
+    }
+    const vector<PDU::serialization_type> original = buffers;
+    vector<Crypto::InPlaceFrame> frames;
+    for(size_t i = 0; i < buffers.size(); ++i) {
+        frames.push_back(Crypto::InPlaceFrame(&buffers[i][0], buffers[i].size()));
+    }
+    EXPECT_EQ(4U, decrypter.decrypt_in_place(&frames[0], frames.size()));
+    // Same results as decrypting them one at a time
+    Crypto::WPA2Decrypter single_decrypter;
+    single_decrypter.add_ap_data("libtinstest", "NODO");
+    single_decrypter.add_ap_data("Induction", "Coherer");
+    for(size_t i = 0; i < original.size(); ++i) {
+        PDU::serialization_type buffer = original[i];
+        uint8_t* plaintext = 0;
+        uint32_t plaintext_size = 0;
+        const bool decrypted = single_decrypter.decrypt_in_place(&buffer[0], buffer.size(),
+                                                                 plaintext, plaintext_size);
+        EXPECT_EQ(decrypted, frames[i].plaintext != 0);
+        EXPECT_EQ(buffer, buffers[i]);
+    }
+}
+
 TEST_F(WPA2DecryptTest, DecryptCCMPAndTKIPWithoutUsingBeacon) {
     Crypto::WPA2Decrypter decrypter;
     decrypter.add_ap_data("libtinstest", "NODO", "00:1b:11:d2:1b:eb");
@@ -407,6 +677,257 @@ TEST_F(WPA2DecryptTest, AccessPointFoundCallback) {
     EXPECT_EQ(address_type("00:1b:11:d2:1b:eb"), data.bssid);
 }
 
+TEST_F(WPA2DecryptTest, DecryptionPipelineKeepsOrder) {
+    using std::chrono::seconds;
+    vector<uint32_t> sequences;
+    vector<bool> decrypted_frames;
+    Crypto::DecryptionPipeline pipeline(3, Crypto::DecryptionPipeline::ORDERED,
+        [&](Packet& packet, bool decrypted) {
+            const uint32_t sequence = packet.timestamp().seconds();
+            sequences.push_back(sequence);
+            decrypted_frames.push_back(decrypted);
+            if (decrypted && sequence % 4 == 0) {
+                check_ccmp_packet5(*packet.pdu());
+            }
+            else if (decrypted && sequence % 4 == 1) {
+                check_tkip_packet5(*packet.pdu());
+            }
+        }, 4);
+    EXPECT_EQ(3U, pipeline.thread_count());
+    size_t handshakes = 0;
+    pipeline.handshake_captured_callback([&](const string&, const HWAddress<6>&,
+                                             const HWAddress<6>&) {
+        ++handshakes;
+    });
+    pipeline.add_ap_data("Induction", "Coherer");
+    pipeline.add_ap_data("libtinstest", "NODO", "00:1b:11:d2:1b:eb");
+
+    vector<bool> expected;
+    uint32_t sequence = 0;
+    // Frames are tagged with sequence numbers, so that the checks above
+    // know which frame they're looking at
+    const uint8_t* frames[4] = { ccmp_packets[5], tkip_packets[5],
+                                 ccmp_packets[6], tkip_packets[6] };
+    const size_t sizes[4] = { ccmp_packets_size[5], tkip_packets_size[5],
+                              ccmp_packets_size[6], tkip_packets_size[6] };
+    // These can't be decrypted before the handshakes
+    for (size_t i = 0; i < 4; ++i) {
+        RadioTap radio(frames[i], sizes[i]);
+        EXPECT_TRUE(pipeline.process(Packet(radio, Timestamp(seconds(sequence++)))));
+        expected.push_back(false);
+    }
+    for (size_t i = 0; i < 5; ++i) {
+        RadioTap ccmp(ccmp_packets[i], ccmp_packets_size[i]);
+        RadioTap tkip(tkip_packets[i], tkip_packets_size[i]);
+        pipeline.process(Packet(ccmp, Timestamp(seconds(sequence))));
+        pipeline.process(Packet(tkip, Timestamp(seconds(sequence + 2))));
+        sequence += 4;
+        expected.push_back(false);
+        expected.push_back(false);
+    }
+    for (size_t i = 0; i < 200; ++i) {
+        for (size_t j = 0; j < 4; ++j) {
+            RadioTap radio(frames[j], sizes[j]);
+            pipeline.process(Packet(radio, Timestamp(seconds(sequence++))));
+            expected.push_back(true);
+        }
+    }
+    pipeline.flush();
+    EXPECT_EQ(2U, handshakes);
+    EXPECT_EQ(2U, pipeline.get_keys().size());
+    ASSERT_EQ(expected.size(), decrypted_frames.size());
+    EXPECT_EQ(expected, decrypted_frames);
+    for (size_t i = 1; i < sequences.size(); ++i) {
+        EXPECT_LT(sequences[i - 1], sequences[i]);
+    }
+    pipeline.stop();
+    RadioTap radio(ccmp_packets[5], ccmp_packets_size[5]);
+    EXPECT_FALSE(pipeline.process(Packet(radio, Timestamp())));
+}
+
+TEST_F(WPA2DecryptTest, DecryptionPipelinePerShard) {
+    using std::chrono::microseconds;
+    std::mutex mutex;
+    // The frames exchanged within each network, in the order they were seen
+    vector<uint64_t> ccmp_frames;
+    vector<uint64_t> tkip_frames;
+    size_t frame_count = 0;
+    size_t decrypted_count = 0;
+    Crypto::DecryptionPipeline pipeline(2, Crypto::DecryptionPipeline::PER_SHARD,
+        [&](Packet& packet, bool decrypted) {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++frame_count;
+            decrypted_count += decrypted ? 1 : 0;
+            if (packet.pdu()->find_pdu<Dot11Data>()) {
+                const uint64_t value = packet.timestamp().microseconds();
+                (value % 2 == 0 ? ccmp_frames : tkip_frames).push_back(value);
+            }
+        }, 8);
+    pipeline.add_ap_data("Induction", "Coherer");
+    pipeline.add_ap_data("libtinstest", "NODO");
+    uint64_t sequence = 0;
+    for (size_t i = 0; i < 300; ++i) {
+        const size_t index = std::min<size_t>(i, 5 + i % 2);
+        RadioTap ccmp(ccmp_packets[index], ccmp_packets_size[index]);
+        RadioTap tkip(tkip_packets[index], tkip_packets_size[index]);
+        pipeline.process(Packet(ccmp, Timestamp(microseconds(sequence))));
+        pipeline.process(Packet(tkip, Timestamp(microseconds(sequence + 1))));
+        sequence += 2;
+    }
+    pipeline.stop();
+    EXPECT_EQ(600U, frame_count);
+    EXPECT_EQ(590U, decrypted_count);
+    EXPECT_EQ(299U, ccmp_frames.size());
+    EXPECT_EQ(299U, tkip_frames.size());
+    for (size_t i = 1; i < ccmp_frames.size(); ++i) {
+        EXPECT_LT(ccmp_frames[i - 1], ccmp_frames[i]);
+        EXPECT_LT(tkip_frames[i - 1], tkip_frames[i]);
+    }
+}
+
+TEST_F(WPA2DecryptTest, DecryptionPipelineKeepsRawFrames) {
+    vector<bool> raw_frames;
+    vector<bool> decrypted_frames;
+    Crypto::DecryptionPipeline pipeline(2, Crypto::DecryptionPipeline::ORDERED,
+        [&](Packet& packet, bool decrypted) {
+            raw_frames.push_back(static_cast<const Packet&>(packet).has_raw_frame());
+            decrypted_frames.push_back(decrypted);
+        });
+    pipeline.add_ap_data("Induction", "Coherer");
+    for (size_t i = 0; i < 7; ++i) {
+        RadioTap radio(ccmp_packets[i], ccmp_packets_size[i]);
+        Packet packet(radio, Timestamp());
+        packet.raw_frame(ccmp_packets[i], ccmp_packets_size[i]);
+        pipeline.process(packet);
+    }
+    pipeline.stop();
+    ASSERT_EQ(7U, raw_frames.size());
+    for (size_t i = 0; i < raw_frames.size(); ++i) {
+        EXPECT_EQ(i >= 5, decrypted_frames[i]);
+        EXPECT_EQ(!decrypted_frames[i], raw_frames[i]);
+    }
+}
+
+TEST_F(WPA2DecryptTest, DecryptionPipelineCallbackError) {
+    size_t calls = 0;
+    Crypto::DecryptionPipeline pipeline(2, Crypto::DecryptionPipeline::ORDERED,
+        [&](Packet&, bool) {
+            if (++calls == 3) {
+                throw std::runtime_error("error");
+            }
+        });
+    for (size_t i = 0; i < 7; ++i) {
+        RadioTap radio(ccmp_packets[i], ccmp_packets_size[i]);
+        pipeline.process(Packet(radio, Timestamp()));
+    }
+    EXPECT_THROW(pipeline.flush(), std::runtime_error);
+    EXPECT_EQ(3U, calls);
+    // The error is only reported once
+    pipeline.stop();
+}
+
+TEST_F(WPA2DecryptTest, HandshakeCapturerCallback) {
+    vector<RSNHandshake> handshakes;
+    RSNHandshakeCapturer capturer;
+    capturer.handshake_callback([&](const RSNHandshake& handshake) {
+        handshakes.push_back(handshake);
+    });
+    for (size_t i = 1; i < 5; ++i) {
+        RadioTap ccmp(ccmp_packets[i], ccmp_packets_size[i]);
+        RadioTap tkip(tkip_packets[i], tkip_packets_size[i]);
+        EXPECT_EQ(i == 4, capturer.process_packet(ccmp));
+        EXPECT_EQ(i == 4, capturer.process_packet(tkip));
+        EXPECT_EQ(i == 4 ? 0U : 2U, capturer.partial_handshakes_count());
+    }
+    // Completed handshakes are only handed to the callback
+    EXPECT_TRUE(capturer.handshakes().empty());
+    ASSERT_EQ(2U, handshakes.size());
+    EXPECT_EQ(address_type("00:0c:41:82:b2:55"), handshakes[0].client_address());
+    EXPECT_EQ(address_type("00:1b:11:d2:1b:eb"), handshakes[1].client_address());
+    EXPECT_EQ(4U, handshakes[0].handshake().size());
+}
+
+TEST_F(WPA2DecryptTest, HandshakeCapturerExpiresPartialHandshakes) {
+    using std::chrono::seconds;
+
+    RSNHandshakeCapturer capturer;
+    capturer.partial_handshake_keep_alive(seconds(10));
+    for (size_t i = 1; i < 5; ++i) {
+        RadioTap radio(ccmp_packets[i], ccmp_packets_size[i]);
+        // The last packets arrive too late
+        const seconds ts(i < 3 ? i : 20 + i);
+        EXPECT_FALSE(capturer.process_packet(radio, ts));
+    }
+    EXPECT_EQ(0U, capturer.partial_handshakes_count());
+    EXPECT_TRUE(capturer.handshakes().empty());
+
+    for (size_t i = 1; i < 3; ++i) {
+        RadioTap radio(tkip_packets[i], tkip_packets_size[i]);
+        Packet packet(radio, Timestamp(seconds(100 + i)));
+        EXPECT_FALSE(capturer.process_packet(packet));
+    }
+    EXPECT_EQ(1U, capturer.partial_handshakes_count());
+    capturer.cleanup_handshakes(seconds(111));
+    EXPECT_EQ(1U, capturer.partial_handshakes_count());
+    capturer.cleanup_handshakes(seconds(112));
+    EXPECT_EQ(0U, capturer.partial_handshakes_count());
+}
+
+TEST_F(WPA2DecryptTest, HandshakeCapturerPacketWithoutPDU) {
+    RSNHandshakeCapturer capturer;
+    EXPECT_FALSE(capturer.process_packet(Packet()));
+    EXPECT_EQ(0U, capturer.partial_handshakes_count());
+}
+
+TEST_F(WPA2DecryptTest, HandshakeCapturerMaxPartialHandshakes) {
+    RSNHandshakeCapturer capturer;
+    capturer.max_partial_handshakes(1);
+    for (size_t i = 1; i < 5; ++i) {
+        // The TKIP handshake keeps evicting the CCMP one
+        RadioTap ccmp(ccmp_packets[i], ccmp_packets_size[i]);
+        RadioTap tkip(tkip_packets[i], tkip_packets_size[i]);
+        EXPECT_FALSE(capturer.process_packet(ccmp));
+        EXPECT_EQ(i == 4, capturer.process_packet(tkip));
+        EXPECT_LE(capturer.partial_handshakes_count(), 1U);
+    }
+    ASSERT_EQ(1U, capturer.handshakes().size());
+    EXPECT_EQ(address_type("00:1b:11:d2:1b:eb"), capturer.handshakes()[0].client_address());
+}
+
+TEST_F(WPA2DecryptTest, HandshakeCapturerDefaultLimit) {
+    const size_t limit = RSNHandshakeCapturer::DEFAULT_MAX_PARTIAL_HANDSHAKES;
+    RSNHandshakeCapturer capturer;
+    RadioTap radio(ccmp_packets[1], ccmp_packets_size[1]);
+    Dot11Data& data = radio.rfind_pdu<Dot11Data>();
+    for (size_t i = 0; i < limit + 10; ++i) {
+        // A different client on each handshake
+        const uint8_t client[] = { 2, 0, 0, 0, uint8_t(i >> 8), uint8_t(i) };
+        data.addr1(address_type(client));
+        EXPECT_FALSE(capturer.process_packet(radio));
+    }
+    EXPECT_EQ(limit, capturer.partial_handshakes_count());
+}
+
+TEST_F(WPA2DecryptTest, HandshakeCapturerCopy) {
+    RSNHandshakeCapturer capturer;
+    for (size_t i = 1; i < 4; ++i) {
+        RadioTap ccmp(ccmp_packets[i], ccmp_packets_size[i]);
+        RadioTap tkip(tkip_packets[i], tkip_packets_size[i]);
+        capturer.process_packet(ccmp);
+        capturer.process_packet(tkip);
+    }
+    RSNHandshakeCapturer copy(capturer);
+    capturer = RSNHandshakeCapturer();
+    EXPECT_EQ(2U, copy.partial_handshakes_count());
+    // The copy keeps its own eviction order
+    copy.max_partial_handshakes(1);
+    RadioTap ccmp(ccmp_packets[4], ccmp_packets_size[4]);
+    RadioTap tkip(tkip_packets[4], tkip_packets_size[4]);
+    EXPECT_FALSE(copy.process_packet(ccmp));
+    EXPECT_TRUE(copy.process_packet(tkip));
+    EXPECT_EQ(0U, copy.partial_handshakes_count());
+}
+
 #endif // TINS_HAVE_WPA2_CALLBACKS
 
 #endif // defined(TINS_HAVE_DOT11) && defined(TINS_HAVE_WPA2_DECRYPTION)